@@ -0,0 +1,405 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2024 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+/*
+ * Broker-free benchmark suite.
+ *
+ * Runs a fixed set of scenarios against librdkafka's built-in mock cluster,
+ * so results only depend on the binding, librdkafka and the machine, and
+ * can be compared between releases.
+ *
+ * Usage: node bench/mock-cluster.js [messages] [scenario-filter]
+ *
+ * Every scenario prints one JSON line to stdout with msgs/s, MB/s and,
+ * where it applies, latency percentiles in milliseconds. Progress goes to
+ * stderr.
+ */
+
+var Kafka = require('../');
+var KafkaJS = require('../').KafkaJS;
+
+var MESSAGES = parseInt(process.argv[2], 10) || 100000;
+var FILTER = process.argv[3] || '';
+var CONSUME_PAYLOAD_SIZE = 1024;
+
+function log() {
+  console.error.apply(console, arguments);
+}
+
+function percentiles(samples) {
+  if (samples.length === 0) {
+    return null;
+  }
+  samples.sort(function(a, b) { return a - b; });
+  function at(p) {
+    return samples[Math.min(samples.length - 1, Math.floor(p * samples.length))];
+  }
+  return { p50: at(0.5), p90: at(0.9), p99: at(0.99), max: samples[samples.length - 1] };
+}
+
+function report(scenario, messages, bytes, startNs, latencies) {
+  var seconds = Number(process.hrtime.bigint() - startNs) / 1e9;
+  var result = {
+    scenario: scenario,
+    messages: messages,
+    seconds: +seconds.toFixed(3),
+    msgsPerSec: Math.round(messages / seconds),
+    mbPerSec: +(bytes / seconds / (1024 * 1024)).toFixed(2),
+  };
+  if (latencies) {
+    result.latencyMs = percentiles(latencies);
+  }
+  console.log(JSON.stringify(result));
+}
+
+/**
+ * Start the mock cluster.
+ *
+ * The cluster lives inside the client that creates it, so that client is
+ * kept connected for the whole run and every scenario connects to the
+ * brokers it advertises.
+ */
+function startCluster(cb) {
+  var holder = new Kafka.Producer({
+    'test.mock.num.brokers': 3,
+    'dr_cb': false,
+  });
+
+  holder.connect({}, function(err, metadata) {
+    if (err) {
+      return cb(err);
+    }
+    var brokers = metadata.brokers.map(function(broker) {
+      return broker.host + ':' + broker.port;
+    }).join(',');
+    cb(null, holder, brokers);
+  });
+}
+
+function producerConfig(brokers) {
+  return {
+    'metadata.broker.list': brokers,
+    'dr_cb': true,
+    'linger.ms': 5,
+    'queue.buffering.max.messages': 1000000,
+    'allow.auto.create.topics': true,
+  };
+}
+
+/**
+ * Produce count messages of the given size as fast as the queue allows, and
+ * call back once every delivery report has arrived.
+ */
+function produceAll(brokers, topic, count, size, headers, cb) {
+  var producer = new Kafka.Producer(producerConfig(brokers));
+  var payload = Buffer.alloc(size, 'x');
+  var messageHeaders = headers ? [{ trace: 'abc' }, { source: Buffer.from('bench') }] : undefined;
+  var sent = 0;
+  var delivered = 0;
+  var startNs;
+
+  producer.setPollInterval(10);
+  producer.on('delivery-report', function(err) {
+    if (err) {
+      return cb(err);
+    }
+    delivered++;
+    if (delivered === count) {
+      producer.disconnect(function() {
+        cb(null, startNs);
+      });
+    }
+  });
+
+  producer.connect({}, function(err) {
+    if (err) {
+      return cb(err);
+    }
+    startNs = process.hrtime.bigint();
+    (function send() {
+      while (sent < count) {
+        try {
+          producer.produce(topic, null, payload, null, null, null, messageHeaders);
+        } catch (e) {
+          if (e.code === Kafka.CODES.ERRORS.ERR__QUEUE_FULL) {
+            return setTimeout(send, 1);
+          }
+          return cb(e);
+        }
+        sent++;
+      }
+    })();
+  });
+}
+
+function produceThroughput(size, headers) {
+  var name = 'produce/' + size + 'b' + (headers ? '/headers' : '');
+  return {
+    name: name,
+    run: function(brokers, cb) {
+      produceAll(brokers, 'bench-produce-' + size, MESSAGES, size, headers, function(err, startNs) {
+        if (err) {
+          return cb(err);
+        }
+        report(name, MESSAGES, MESSAGES * size, startNs);
+        cb();
+      });
+    }
+  };
+}
+
+/**
+ * Delivery report latency: messages are produced in small bursts so the
+ * numbers reflect the round trip through librdkafka and the dispatcher
+ * rather than time spent queued behind earlier messages.
+ */
+var drLatency = {
+  name: 'produce/dr-latency',
+  run: function(brokers, cb) {
+    var count = Math.min(MESSAGES, 20000);
+    var burst = 100;
+    var producer = new Kafka.Producer(Object.assign(producerConfig(brokers), { 'linger.ms': 0 }));
+    var payload = Buffer.alloc(CONSUME_PAYLOAD_SIZE, 'x');
+    var latencies = [];
+    var sent = 0;
+    var startNs;
+
+    producer.setPollInterval(1);
+    producer.on('delivery-report', function(err, dr) {
+      if (err) {
+        return cb(err);
+      }
+      latencies.push(Number(process.hrtime.bigint() - dr.opaque) / 1e6);
+      if (latencies.length === count) {
+        finish();
+      } else if (latencies.length === sent) {
+        setImmediate(sendBurst);
+      }
+    });
+
+    function sendBurst() {
+      for (var i = 0; i < burst && sent < count; i++, sent++) {
+        producer.produce('bench-dr-latency', null, payload, null, null, process.hrtime.bigint());
+      }
+    }
+
+    function finish() {
+      report(drLatency.name, count, count * payload.length, startNs, latencies);
+      producer.disconnect(function() {
+        cb();
+      });
+    }
+
+    producer.connect({}, function(err) {
+      if (err) {
+        return cb(err);
+      }
+      startNs = process.hrtime.bigint();
+      sendBurst();
+    });
+  }
+};
+
+var CONSUME_TOPIC = 'bench-consume';
+
+// Fill the topic read by the consume scenarios
+var seedConsumeTopic = {
+  name: 'consume/seed',
+  run: function(brokers, cb) {
+    produceAll(brokers, CONSUME_TOPIC, MESSAGES, CONSUME_PAYLOAD_SIZE, false, cb);
+  }
+};
+
+function newAssignedConsumer(brokers) {
+  var consumer = new Kafka.KafkaConsumer({
+    'metadata.broker.list': brokers,
+    'group.id': 'bench-' + Date.now() + '-' + Math.random(),
+    'enable.auto.commit': false,
+  }, {
+    'auto.offset.reset': 'earliest',
+  });
+  return consumer;
+}
+
+// Assign every partition of the consume topic from the start
+function assignAll(consumer, cb) {
+  consumer.getMetadata({ topic: CONSUME_TOPIC }, function(err, metadata) {
+    if (err) {
+      return cb(err);
+    }
+    var assignments = [];
+    metadata.topics.forEach(function(topic) {
+      if (topic.name !== CONSUME_TOPIC) {
+        return;
+      }
+      topic.partitions.forEach(function(partition) {
+        assignments.push({ topic: CONSUME_TOPIC, partition: partition.id, offset: 0 });
+      });
+    });
+    consumer.assign(assignments);
+    cb();
+  });
+}
+
+var consumeNum = {
+  name: 'consume/consumeNum',
+  run: function(brokers, cb) {
+    var consumer = newAssignedConsumer(brokers);
+    var received = 0;
+    var bytes = 0;
+    var startNs;
+
+    consumer.connect({}, function(err) {
+      if (err) {
+        return cb(err);
+      }
+      assignAll(consumer, function(err) {
+        if (err) {
+          return cb(err);
+        }
+        startNs = process.hrtime.bigint();
+        next();
+      });
+
+      function next() {
+        consumer.consume(1000, function(err, messages) {
+          if (err) {
+            return cb(err);
+          }
+          for (var i = 0; i < messages.length; i++) {
+            bytes += messages[i].size;
+          }
+          received += messages.length;
+          if (received < MESSAGES) {
+            return setImmediate(next);
+          }
+          report(consumeNum.name, received, bytes, startNs);
+          consumer.disconnect(function() {
+            cb();
+          });
+        });
+      }
+    });
+  }
+};
+
+var consumeFlowing = {
+  name: 'consume/flowing',
+  run: function(brokers, cb) {
+    var consumer = newAssignedConsumer(brokers);
+    var received = 0;
+    var bytes = 0;
+    var startNs;
+
+    consumer.on('data', function(message) {
+      bytes += message.size;
+      if (++received === MESSAGES) {
+        report(consumeFlowing.name, received, bytes, startNs);
+        consumer.disconnect(function() {
+          cb();
+        });
+      }
+    });
+
+    consumer.connect({}, function(err) {
+      if (err) {
+        return cb(err);
+      }
+      assignAll(consumer, function(err) {
+        if (err) {
+          return cb(err);
+        }
+        startNs = process.hrtime.bigint();
+        consumer.consume();
+      });
+    });
+  }
+};
+
+function kafkaJSConsume(mode) {
+  var name = 'kafkajs/' + mode;
+  return {
+    name: name,
+    run: function(brokers, cb) {
+      var kafka = new KafkaJS.Kafka({ kafkaJS: { brokers: brokers.split(','), logLevel: KafkaJS.logLevel.NOTHING } });
+      var consumer = kafka.consumer({
+        kafkaJS: { groupId: 'bench-' + Date.now() + '-' + Math.random(), fromBeginning: true, autoCommit: false },
+      });
+      var received = 0;
+      var bytes = 0;
+      var startNs;
+      var finished = false;
+
+      function count(message) {
+        bytes += message.value ? message.value.length : 0;
+        if (++received === MESSAGES && !finished) {
+          finished = true;
+          report(name, received, bytes, startNs);
+          // Disconnecting from inside the handler would wait for itself
+          setImmediate(function() {
+            consumer.disconnect().then(function() { cb(); }, cb);
+          });
+        }
+      }
+
+      var handlers = mode === 'eachBatch' ?
+        { eachBatch: async function(payload) { payload.batch.messages.forEach(count); } } :
+        { eachMessage: async function(payload) { count(payload.message); } };
+
+      consumer.connect()
+        .then(function() { return consumer.subscribe({ topic: CONSUME_TOPIC }); })
+        .then(function() {
+          startNs = process.hrtime.bigint();
+          return consumer.run(handlers);
+        })
+        .catch(cb);
+    }
+  };
+}
+
+var scenarios = [
+  produceThroughput(64, false),
+  produceThroughput(1024, false),
+  produceThroughput(1024, true),
+  produceThroughput(16384, false),
+  drLatency,
+  seedConsumeTopic,
+  consumeNum,
+  consumeFlowing,
+  kafkaJSConsume('eachMessage'),
+  kafkaJSConsume('eachBatch'),
+];
+
+startCluster(function(err, holder, brokers) {
+  if (err) {
+    log('Could not start the mock cluster:', err);
+    process.exit(1);
+  }
+  log('Mock cluster at %s, %d messages per scenario', brokers, MESSAGES);
+
+  var i = 0;
+  (function next() {
+    if (i === scenarios.length) {
+      return holder.disconnect();
+    }
+    var scenario = scenarios[i++];
+    // The seed always has to run for the consume scenarios
+    if (FILTER && scenario !== seedConsumeTopic && scenario.name.indexOf(FILTER) === -1) {
+      return next();
+    }
+    log('Running %s', scenario.name);
+    scenario.run(brokers, function(err) {
+      if (err) {
+        log('%s failed:', scenario.name, err);
+        process.exitCode = 1;
+      }
+      next();
+    });
+  })();
+});
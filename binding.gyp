@@ -14,11 +14,21 @@
         'src/common.cc',
         'src/config.cc',
         'src/connection.cc',
+        'src/consume-watcher.cc',
         'src/errors.cc',
         'src/kafka-consumer.cc',
+        'src/latency-histogram.cc',
+        'src/metadata-cache.cc',
+        'src/metrics.cc',
+        'src/offset-tracker.cc',
+        'src/produce-channel.cc',
         'src/producer.cc',
+        'src/shared-producer.cc',
+        'src/stats.cc',
         'src/topic.cc',
+        'src/worker-pool.cc',
         'src/workers.cc',
+        'src/zero-copy-messages.cc',
         'src/admin.cc'
       ],
       "include_dirs": [
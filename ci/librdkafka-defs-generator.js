@@ -114,6 +114,172 @@ function addSpecialGlobalProps(globalProps) {
     "rawType": "boolean",
     "type": "boolean"
   });
+  globalProps.push({
+    "property": "stats_fields",
+    "consumerOrProducer": "*",
+    "range": "",
+    "defaultValue": "",
+    "importance": "low",
+    "description": "Parse statistics natively and emit only these fields (per broker, topic partition or top level) as a `stats` object on `event.stats`, instead of the raw JSON `message`. Accepts an array or a comma-separated list of field names, or `true` for a default set of counters and queue depths.",
+    "rawType": "string",
+    "type": "boolean | string | string[]"
+  });
+  globalProps.push({
+    "property": "shared_result_queue",
+    "consumerOrProducer": "*",
+    "range": "",
+    "defaultValue": "false",
+    "importance": "low",
+    "description": "AdminClient only. Collect the results of all admin operations on one queue served by a single native thread, instead of holding a libuv threadpool thread for every operation in flight.",
+    "rawType": "boolean",
+    "type": "boolean"
+  });
+  globalProps.push({
+    "property": "event_backlog_max",
+    "consumerOrProducer": "*",
+    "range": "0 .. 2147483647",
+    "defaultValue": "10000",
+    "importance": "low",
+    "description": "Number of queued events past which `event.log` and `event.stats` events are dropped until the event loop catches up. Errors are always kept. 0 never drops anything.",
+    "rawType": "integer",
+    "type": "number"
+  });
+  globalProps.push({
+    "property": "latency_histograms",
+    "consumerOrProducer": "*",
+    "range": "true, false",
+    "defaultValue": "false",
+    "importance": "low",
+    "description": "Record per topic latency histograms natively, readable with `getLatencyHistograms()`. Producers measure the time from produce to a successful delivery report, consumers the time from the message timestamp to the message being consumed. Has no effect on the AdminClient.",
+    "rawType": "boolean",
+    "type": "boolean"
+  });
+}
+
+function addSpecialProducerProps(producerProps) {
+  producerProps.push({
+    "property": "zero_copy_produce",
+    "consumerOrProducer": "P",
+    "range": "",
+    "defaultValue": "false",
+    "importance": "low",
+    "description": "Produce message payloads without copying them. The Buffer of every message is referenced until its delivery report has been handled, and must not be modified until then.",
+    "rawType": "boolean",
+    "type": "boolean"
+  });
+  producerProps.push({
+    "property": "dr_batch_size",
+    "consumerOrProducer": "P",
+    "range": "",
+    "defaultValue": "0",
+    "importance": "low",
+    "description": "Deliver up to this many delivery reports at once, with a single `delivery-report-batch` event. `delivery-report` is still emitted for every report if it has listeners. 0 disables batching.",
+    "rawType": "integer",
+    "type": "number"
+  });
+  producerProps.push({
+    "property": "dr_backlog_max",
+    "consumerOrProducer": "P",
+    "range": "0 .. 2147483647",
+    "defaultValue": "0",
+    "importance": "low",
+    "description": "Number of delivery reports waiting for the event loop at which `produce()` fails with `ERR__QUEUE_FULL`, until the backlog is down to half and a `drain` event is emitted. 0 for no limit.",
+    "rawType": "integer",
+    "type": "number"
+  });
+  producerProps.push({
+    "property": "dr_backlog_max_bytes",
+    "consumerOrProducer": "P",
+    "range": "0 .. 2147483647",
+    "defaultValue": "0",
+    "importance": "low",
+    "description": "Memory held by delivery reports waiting for the event loop at which `produce()` fails with `ERR__QUEUE_FULL`, until the backlog is down to half and a `drain` event is emitted. 0 for no limit.",
+    "rawType": "integer",
+    "type": "number"
+  });
+  producerProps.push({
+    "property": "dr_opaque_ids",
+    "consumerOrProducer": "P",
+    "range": "",
+    "defaultValue": "false",
+    "importance": "low",
+    "description": "Produce with non-negative integer opaques that are handed back as is in delivery reports, rather than arbitrary values that need a handle kept alive for every message. `produce()` throws for any other opaque.",
+    "rawType": "boolean",
+    "type": "boolean"
+  });
+  producerProps.push({
+    "property": "shared_handle",
+    "consumerOrProducer": "P",
+    "range": "",
+    "defaultValue": "false",
+    "importance": "low",
+    "description": "Connect through one librdkafka instance shared by all producers of the same thread, the main thread or a worker, that have the same configuration and set this, instead of one per producer. Each producer still gets only its own delivery reports, events go to all of them. A flush waits for the messages of all of them. Not available with transactions, OAUTHBEARER or produce channels.",
+    "rawType": "boolean",
+    "type": "boolean"
+  });
+}
+
+function addSpecialConsumerProps(consumerProps) {
+  consumerProps.push({
+    "property": "zero_copy_consume",
+    "consumerOrProducer": "C",
+    "range": "",
+    "defaultValue": "false",
+    "importance": "low",
+    "description": "Consume message values without copying them. Each value Buffer references librdkafka's fetch memory and keeps its message alive until it is garbage collected. Buffers still alive when the consumer disconnects are emptied, so copy values that need to outlive it.",
+    "rawType": "boolean",
+    "type": "boolean"
+  });
+  consumerProps.push({
+    "property": "partition_queues",
+    "consumerOrProducer": "C",
+    "range": "",
+    "defaultValue": "false",
+    "importance": "low",
+    "description": "Give every assigned partition its own queue, read with `consumePartition()`, so partitions can be consumed in parallel. Rebalances and errors are still only served by `consume()`, which must keep being called.",
+    "rawType": "boolean",
+    "type": "boolean"
+  });
+  consumerProps.push({
+    "property": "offset_tracking",
+    "consumerOrProducer": "C",
+    "range": "",
+    "defaultValue": "false",
+    "importance": "low",
+    "description": "Track consumed messages until they are passed to `resolveOffset()`, in any order, and store the offset up to which every message of a partition was resolved in batches. Requires `enable.auto.offset.store` to be false. When set, the KafkaJS consumer also uses it for the offsets it stores itself.",
+    "rawType": "boolean",
+    "type": "boolean"
+  });
+  consumerProps.push({
+    "property": "offset_tracking_interval_ms",
+    "consumerOrProducer": "C",
+    "range": "0 .. 2147483647",
+    "defaultValue": "500",
+    "importance": "low",
+    "description": "How often the offsets found by `offset_tracking` are stored, at the latest. They are always stored before a commit, a revoke or a disconnect.",
+    "rawType": "integer",
+    "type": "number"
+  });
+  consumerProps.push({
+    "property": "consume_backlog_max",
+    "consumerOrProducer": "C",
+    "range": "0 .. 2147483647",
+    "defaultValue": "10000",
+    "importance": "low",
+    "description": "Number of messages read by the consume loop that may wait for the event loop. Once reached the loop stops consuming until the event loop catches up. 0 for no limit.",
+    "rawType": "integer",
+    "type": "number"
+  });
+  consumerProps.push({
+    "property": "event_driven_consume",
+    "consumerOrProducer": "C",
+    "range": "",
+    "defaultValue": "false",
+    "importance": "low",
+    "description": "Make the consume loop read on the event loop whenever librdkafka has messages for the consumer, instead of a background thread waiting on timeouts. Messages are read in batches of the consume loop batch size, or 1000 if it is unset. Only the flowing consume loop reads this way, `consume(number, cb)` still waits on a worker thread. Cannot be combined with `partition_queues`.",
+    "rawType": "boolean",
+    "type": "boolean"
+  });
 }
 
 function generateConfigDTS(file) {
@@ -130,6 +296,9 @@ function generateConfigDTS(file) {
     globalProps.filter(i => i.consumerOrProducer === 'C'),
   ];
 
+  addSpecialProducerProps(producerGlobalProps);
+  addSpecialConsumerProps(consumerGlobalProps);
+
   const [topicSharedProps, producerTopicProps, consumerTopicProps] = [
     topicProps.filter(i => i.consumerOrProducer === '*'),
     topicProps.filter(i => i.consumerOrProducer === 'P'),
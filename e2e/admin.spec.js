@@ -184,4 +184,43 @@ describe('Admin', function() {
     });
   });
 
+
+  describe('shared_result_queue', function() {
+    var sharedClient;
+
+    beforeEach(function() {
+      sharedClient = Kafka.AdminClient.create({
+        'client.id': 'kafka-test-shared',
+        'metadata.broker.list': kafkaBrokerList,
+        'shared_result_queue': true
+      });
+    });
+
+    afterEach(function() {
+      sharedClient.disconnect();
+    });
+
+    it('should run concurrent operations on the shared queue', function(done) {
+      var topicNames = [0, 1, 2].map(function(i) {
+        return 'admin-test-topic-shared-' + i + '-' + time;
+      });
+      var remaining = topicNames.length;
+
+      topicNames.forEach(function(topicName) {
+        sharedClient.createTopic({
+          topic: topicName,
+          num_partitions: 1,
+          replication_factor: 1
+        }, function(err) {
+          t.ifError(err);
+          if (--remaining === 0) {
+            sharedClient.listGroups(function(listErr) {
+              t.ifError(listErr);
+              done();
+            });
+          }
+        });
+      });
+    });
+  });
 });
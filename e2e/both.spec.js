@@ -305,6 +305,146 @@ describe('Consumer/Producer', function() {
     });
   });
 
+  it('should empty zero copy values that are kept across disconnect', function(done) {
+    var zeroCopyConsumer = new Kafka.KafkaConsumer({
+      'metadata.broker.list': kafkaBrokerList,
+      'group.id': 'kafka-mocha-grp-' + crypto.randomBytes(20).toString('hex'),
+      'fetch.wait.max.ms': 1000,
+      'session.timeout.ms': 10000,
+      'zero_copy_consume': true
+    }, {
+      'auto.offset.reset': 'largest'
+    });
+
+    eventListener(zeroCopyConsumer);
+
+    zeroCopyConsumer.connect({}, function(err) {
+      t.ifError(err);
+
+      zeroCopyConsumer.once('data', function(message) {
+        var value = message.value;
+        t.equal(value.toString(), 'value', 'invalid message value');
+
+        // Must not wait for the buffer to be collected
+        zeroCopyConsumer.disconnect(function(err) {
+          t.ifError(err);
+          t.equal(value.length, 0, 'the value should be detached');
+          done();
+        });
+      });
+
+      zeroCopyConsumer.subscribe([topic]);
+      zeroCopyConsumer.consume();
+
+      setTimeout(function() {
+        producer.produce(topic, null, Buffer.from('value'), 'key');
+      }, 2000);
+    });
+  });
+
+  it('should be able to produce and consume messages: event_driven_consume', function(done) {
+    var eventConsumer = new Kafka.KafkaConsumer({
+      'metadata.broker.list': kafkaBrokerList,
+      'group.id': 'kafka-mocha-grp-' + crypto.randomBytes(20).toString('hex'),
+      'fetch.wait.max.ms': 1000,
+      'session.timeout.ms': 10000,
+      'event_driven_consume': true
+    }, {
+      'auto.offset.reset': 'largest'
+    });
+
+    eventListener(eventConsumer);
+
+    eventConsumer.connect({}, function(err) {
+      t.ifError(err);
+
+      eventConsumer.on('data', function(message) {
+        t.equal('value', message.value.toString(), 'invalid message value');
+        t.equal(topic, message.topic, 'invalid message topic');
+        // Stops the watcher while it is calling back
+        eventConsumer.disconnect(function(err) {
+          done(err);
+        });
+      });
+
+      eventConsumer.subscribe([topic]);
+      eventConsumer.consume();
+
+      setTimeout(function() {
+        producer.produce(topic, null, Buffer.from('value'), 'key');
+      }, 2000);
+    });
+  });
+
+  it('should record consume latencies in histogram buckets', function(done) {
+    var latencyConsumer = new Kafka.KafkaConsumer({
+      'metadata.broker.list': kafkaBrokerList,
+      'group.id': 'kafka-mocha-grp-' + crypto.randomBytes(20).toString('hex'),
+      'fetch.wait.max.ms': 1000,
+      'session.timeout.ms': 10000,
+      'latency_histograms': true
+    }, {
+      'auto.offset.reset': 'largest'
+    });
+
+    eventListener(latencyConsumer);
+
+    // The latency of a message is the time since its timestamp, so these
+    // are a minute, two minutes, ... up to 100 minutes, plus the time taken
+    // to deliver them
+    var minuteUs = 60 * 1000 * 1000;
+    var slackUs = 30 * 1000 * 1000;
+    var count = 100;
+
+    // Percentiles are the highest value of their bucket, which is at most
+    // 1/32 above the values counted in it
+    function assertBucket(actual, expected, name) {
+      t.ok(actual >= expected, name + ' ' + actual + ' is below ' + expected);
+      t.ok(actual <= (expected + slackUs) * (1 + 1 / 32),
+        name + ' ' + actual + ' is too far above ' + expected);
+    }
+
+    latencyConsumer.connect({}, function(err) {
+      t.ifError(err);
+
+      var received = 0;
+      latencyConsumer.on('data', function() {
+        if (++received < count) {
+          return;
+        }
+
+        var histogram = latencyConsumer.getLatencyHistograms()[topic];
+        t.equal(histogram.count, count);
+        t.ok(histogram.min >= minuteUs && histogram.min <= minuteUs + slackUs,
+          'invalid min ' + histogram.min);
+        t.ok(histogram.max >= count * minuteUs &&
+          histogram.max <= count * minuteUs + slackUs,
+          'invalid max ' + histogram.max);
+        assertBucket(histogram.p50, 50 * minuteUs, 'p50');
+        assertBucket(histogram.p90, 90 * minuteUs, 'p90');
+        assertBucket(histogram.p99, 99 * minuteUs, 'p99');
+        t.equal(histogram.p999, histogram.max);
+
+        latencyConsumer.resetLatencyHistograms();
+        t.equal(latencyConsumer.getLatencyHistograms()[topic].count, 0);
+
+        latencyConsumer.disconnect(function(err) {
+          done(err);
+        });
+      });
+
+      latencyConsumer.subscribe([topic]);
+      latencyConsumer.consume();
+
+      setTimeout(function() {
+        var now = Date.now();
+        for (var i = 1; i <= count; i++) {
+          producer.produce(topic, null, Buffer.from('value'), 'key', now - i * 60 * 1000);
+        }
+      }, 2000);
+    });
+  });
+
   it('should emit \'partition.eof\' events in consumeLoop', function(done) {
 
     crypto.randomBytes(4096, function(ex, buffer) {
@@ -493,6 +633,161 @@ describe('Consumer/Producer', function() {
     }, 2000);
   });
 
+  describe('with offset_tracking', function() {
+    var trackingConsumer;
+
+    beforeEach(function(done) {
+      trackingConsumer = new Kafka.KafkaConsumer({
+        'metadata.broker.list': kafkaBrokerList,
+        'group.id': 'kafka-mocha-grp-' + crypto.randomBytes(20).toString('hex'),
+        'enable.auto.commit': false,
+        'enable.auto.offset.store': false,
+        'offset_tracking': true,
+        // Only store before the commits of the tests
+        'offset_tracking_interval_ms': 60000
+      }, {});
+
+      trackingConsumer.connect({}, function(err) {
+        t.ifError(err);
+        done();
+      });
+
+      eventListener(trackingConsumer);
+    });
+
+    afterEach(function(done) {
+      trackingConsumer.disconnect(function() {
+        done();
+      });
+    });
+
+    // Produce count messages to partition 0 and consume them from offset,
+    // which is the offset of the first of them
+    function produceAndConsume(count, cb) {
+      trackingConsumer.queryWatermarkOffsets(topic, 0, 5000, function(err, offsets) {
+        t.ifError(err);
+        var offset = offsets.highOffset;
+
+        for (var i = 0; i < count; i++) {
+          producer.produce(topic, 0, Buffer.from('value ' + i));
+        }
+        producer.flush(10000, function(err) {
+          t.ifError(err);
+          trackingConsumer.assign([{ topic: topic, partition: 0, offset: offset }]);
+          consumeFrom(offset, count, function() {
+            cb(offset);
+          });
+        });
+      });
+    }
+
+    // Consume until count messages from offset on were read
+    function consumeFrom(offset, count, cb) {
+      var offsets = [];
+      (function next() {
+        trackingConsumer.consume(count - offsets.length, function(err, messages) {
+          t.ifError(err);
+          messages.forEach(function(message) {
+            offsets.push(message.offset);
+          });
+          if (offsets.length < count) {
+            return next();
+          }
+          t.deepStrictEqual(offsets, offsets.map(function(o, i) {
+            return offset + i;
+          }));
+          cb();
+        });
+      })();
+    }
+
+    // Commit what was resolved and check the offset committed for partition 0
+    function commitAndCheck(expected, cb) {
+      try {
+        trackingConsumer.commitSync(null);
+      } catch (e) {
+        // Nothing was stored since the last commit
+        if (e.code !== Kafka.CODES.ERRORS.ERR__NO_OFFSET) {
+          throw e;
+        }
+      }
+
+      trackingConsumer.committed([{ topic: topic, partition: 0 }], 5000, function(err, committed) {
+        t.ifError(err);
+        t.equal(committed[0].offset, expected);
+        cb();
+      });
+    }
+
+    function resolve(offset, partition) {
+      trackingConsumer.resolveOffset({ topic: topic, partition: partition || 0, offset: offset });
+    }
+
+    it('should hold back the store until every earlier message was resolved', function(done) {
+      produceAndConsume(3, function(offset) {
+        resolve(offset + 1);
+        commitAndCheck(undefined, function() {
+          resolve(offset);
+          commitAndCheck(offset + 2, function() {
+            resolve(offset + 2);
+            commitAndCheck(offset + 3, done);
+          });
+        });
+      });
+    });
+
+    it('should track messages handed out again after a seek', function(done) {
+      produceAndConsume(3, function(offset) {
+        // Dropped by the seek, the message has to be resolved again
+        resolve(offset + 2);
+        trackingConsumer.seek({ topic: topic, partition: 0, offset: offset }, 5000, function(err) {
+          t.ifError(err);
+          consumeFrom(offset, 3, function() {
+            resolve(offset);
+            resolve(offset + 1);
+            commitAndCheck(offset + 2, function() {
+              resolve(offset + 2);
+              commitAndCheck(offset + 3, done);
+            });
+          });
+        });
+      });
+    });
+
+    it('should forget the messages of a revoked partition', function(done) {
+      produceAndConsume(3, function(offset) {
+        // Held back by the first message, which is never resolved
+        resolve(offset + 1);
+        trackingConsumer.unassign();
+        trackingConsumer.assign([{ topic: topic, partition: 0, offset: offset + 2 }]);
+        consumeFrom(offset + 2, 1, function() {
+          resolve(offset + 2);
+          commitAndCheck(offset + 3, done);
+        });
+      });
+    });
+
+    it('should ignore resolved offsets it did not hand out after the tracked ones', function(done) {
+      produceAndConsume(2, function(offset) {
+        resolve(offset + 5);
+        commitAndCheck(undefined, function() {
+          resolve(offset);
+          resolve(offset + 1);
+          commitAndCheck(offset + 2, done);
+        });
+      });
+    });
+
+    it('should accept resolved offsets of partitions it does not track', function(done) {
+      produceAndConsume(1, function(offset) {
+        // Not assigned, so the store fails for that partition only
+        resolve(0, 1);
+        resolve(offset);
+        commitAndCheck(offset + 1, done);
+      });
+    });
+  });
+
   describe('Exceptional case -  offset_commit_cb true', function() {
     var grp = 'kafka-mocha-grp-' + crypto.randomBytes(20).toString('hex');
     var consumerOpts = {
@@ -135,6 +135,22 @@ describe('Consumer', function() {
       done();
     });
 
+    it('after assign, getLag and queryLag should return the assigned partitions', function(done) {
+      consumer.assign([{topic:topic, partition:0}]);
+      var lag = consumer.getLag();
+      t.deepStrictEqual(lag.topics, [topic]);
+      t.equal(lag.partition.length, 1);
+      t.equal(lag.partition[0], 0);
+      t.equal(lag.lag[0], -1, 'before consuming, lag is not known');
+
+      consumer.queryLag(5000, function(err, queried) {
+        t.ifError(err);
+        t.equal(queried.topicIndex[0], 0);
+        t.equal(queried.highOffset[0] >= 0, true, 'end offset is queried');
+        done();
+      });
+    });
+
     it('should obey the timeout', function(done) {
       consumer.committed(null, 0, function(err, committed) {
         if (!err) {
@@ -191,6 +207,20 @@ describe('Consumer', function() {
         cb();
       });
     });
+
+    it('should be able to seek several partitions at once', function(cb) {
+      consumer.seekPartitions([
+        { topic: 'test', partition: 0, offset: 0 },
+        { topic: 'test', partition: 1, offset: 0 }
+      ], 1000, function(err, partitions) {
+        t.ifError(err);
+        t.equal(partitions.length, 2);
+        t.equal(partitions[0].error, undefined);
+        // Not assigned
+        t.equal(partitions[1].error instanceof Error, true);
+        cb();
+      });
+    });
   });
 
   describe('subscribe', function() {
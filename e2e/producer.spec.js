@@ -211,6 +211,22 @@ describe('Producer', function() {
       producer.produce('test', null, Buffer.from('hai'), 'key');
     });
 
+    it('should produce a message with a string payload', function(done) {
+      var tt = setInterval(function() {
+        producer.poll();
+      }, 200);
+
+      producer.once('delivery-report', function(err, report) {
+        clearInterval(tt);
+        t.ifError(err);
+        t.equal(report.key.toString(), 'kéy');
+        t.equal(report.value.toString(), 'hai ☃');
+        done();
+      });
+
+      producer.produce('test', null, 'hai ☃', 'kéy');
+    });
+
     it('should produce a message with an empty payload and empty key (https://github.com/confluentinc/confluent-kafka-javascript/issues/117)', function(done) {
       var tt = setInterval(function() {
         producer.poll();
@@ -280,4 +296,148 @@ describe('Producer', function() {
 
   });
 
+  describe('with dr_opaque_ids', function() {
+    beforeEach(function(done) {
+      producer = new Kafka.Producer({
+        'client.id': 'kafka-test-opaque-ids',
+        'metadata.broker.list': kafkaBrokerList,
+        'dr_cb': true,
+        'dr_opaque_ids': true
+      });
+      producer.connect({}, function(err) {
+        t.ifError(err);
+        done();
+      });
+    });
+
+    afterEach(function(done) {
+      producer.disconnect(function() {
+        done();
+      });
+    });
+
+    it('should produce a message with an id opaque', function(done) {
+      var tt = setInterval(function() {
+        producer.poll();
+      }, 200);
+
+      producer.once('delivery-report', function(err, report) {
+        clearInterval(tt);
+        t.ifError(err);
+        t.strictEqual(report.opaque, 7);
+        done();
+      });
+
+      producer.produce('test', null, Buffer.from('value'), null, null, 7);
+    });
+
+    it('should produce a message with a null opaque and headers', function(done) {
+      var tt = setInterval(function() {
+        producer.poll();
+      }, 200);
+
+      producer.once('delivery-report', function(err, report) {
+        clearInterval(tt);
+        t.ifError(err);
+        t.strictEqual(report.opaque, undefined);
+        done();
+      });
+
+      producer.produce('test', null, Buffer.from('value'), null, null, null, [{ key: 'value' }]);
+    });
+  });
+
+  describe('with a shared handle', function() {
+    var producers;
+
+    beforeEach(function(done) {
+      producers = [0, 1].map(function() {
+        return new Kafka.Producer({
+          'client.id': 'kafka-test-shared',
+          'metadata.broker.list': kafkaBrokerList,
+          'dr_cb': true,
+          'shared_handle': true
+        });
+      });
+
+      var connected = 0;
+      producers.forEach(function(p) {
+        p.connect({}, function(err) {
+          t.ifError(err);
+          if (++connected === producers.length) {
+            done();
+          }
+        });
+      });
+    });
+
+    afterEach(function(done) {
+      var connected = producers.filter(function(p) {
+        return p.isConnected();
+      });
+      if (connected.length === 0) {
+        return done();
+      }
+      var disconnected = 0;
+      connected.forEach(function(p) {
+        p.disconnect(function() {
+          if (++disconnected === connected.length) {
+            done();
+          }
+        });
+      });
+    });
+
+    it('should connect both producers through the same handle', function(done) {
+      t.ok(producers[0].name);
+      t.equal(producers[0].name, producers[1].name);
+
+      var other = new Kafka.Producer({
+        'client.id': 'kafka-test-shared-other',
+        'metadata.broker.list': kafkaBrokerList,
+        'dr_cb': true,
+        'shared_handle': true
+      });
+      other.connect({}, function(err) {
+        t.ifError(err);
+        t.notEqual(other.name, producers[0].name);
+        other.disconnect(function() {
+          done();
+        });
+      });
+    });
+
+    it('should deliver reports only to the producer of the message', function(done) {
+      var reports = [0, 0];
+
+      producers.forEach(function(p, i) {
+        p.setPollInterval(10);
+        p.on('delivery-report', function(err, report) {
+          t.ifError(err);
+          t.equal(report.opaque, i);
+          reports[i]++;
+          if (reports[0] === 10 && reports[1] === 10) {
+            done();
+          }
+        });
+      });
+
+      for (var i = 0; i < 10; i++) {
+        producers[0].produce('test', null, Buffer.from('value'), null, null, 0);
+        producers[1].produce('test', null, Buffer.from('value'), null, null, 1);
+      }
+    });
+
+    it('should keep the handle for the remaining producer', function(done) {
+      producers[0].disconnect(function() {
+        producers[1].setPollInterval(10);
+        producers[1].once('delivery-report', function(err) {
+          t.ifError(err);
+          done();
+        });
+        producers[1].produce('test', null, Buffer.from('value'));
+      });
+    });
+  });
+
 });
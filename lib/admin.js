@@ -119,9 +119,17 @@ function AdminClient(conf) {
    * for the topic.
    */
 
+  // Not a librdkafka property, handled natively
+  var shared_result_queue = conf.shared_result_queue || false;
+  delete conf.shared_result_queue;
+
   Client.call(this, conf, Kafka.AdminClient);
   this._isConnected = false;
   this.globalConfig = conf;
+
+  if (shared_result_queue) {
+    this._client.setSharedQueue(true);
+  }
 }
 
 /**
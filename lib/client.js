@@ -53,6 +53,29 @@ function Client(globalConf, SubClientType, topicConf) {
   // key is a real conf value
   delete globalConf.event_cb;
 
+  // stats_fields is handled here as well. When set, statistics are parsed
+  // natively and event.stats gets a `stats` object with only the selected
+  // fields instead of the raw JSON `message`. `true` selects a default set
+  // of counters and queue depths.
+  var statsFields = globalConf.stats_fields;
+  delete globalConf.stats_fields;
+  if (statsFields === true) {
+    statsFields = [];
+  } else if (typeof statsFields === 'string') {
+    statsFields = statsFields.split(',').map(function(field) {
+      return field.trim();
+    }).filter(Boolean);
+  }
+
+  // event_backlog_max bounds the events waiting for the event loop. Once
+  // that many are queued, logs and statistics are dropped until it catches
+  // up; errors are always kept. 0 never drops anything.
+  var eventBacklogMax = globalConf.event_backlog_max;
+  delete globalConf.event_backlog_max;
+
+  var latencyHistograms = globalConf.latency_histograms;
+  delete globalConf.latency_histograms;
+
   // These properties are not meant to be user-set.
   // Clients derived from this might want to change them, but for
   // now we override them.
@@ -61,6 +84,14 @@ function Client(globalConf, SubClientType, topicConf) {
 
   this._client = new SubClientType(globalConf, topicConf);
 
+  if (Array.isArray(statsFields)) {
+    this._client.setStatsFields(statsFields);
+  }
+
+  if (latencyHistograms) {
+    this._client.setLatencyHistograms(true);
+  }
+
   // We should not modify the globalConf object. We have cloned it already.
   delete globalConf['client.software.name'];
   delete globalConf['client.software.version'];
@@ -98,6 +129,10 @@ function Client(globalConf, SubClientType, topicConf) {
           this.emit('event.' + eventType, eventData);
       }
     }.bind(this);
+
+    if (eventBacklogMax !== undefined) {
+      this._cb_configs.event.event_cb.max_queued = eventBacklogMax;
+    }
   }
 
   if (Object.hasOwn(this._cb_configs.global, 'oauthbearer_token_refresh_cb')) {
@@ -424,6 +459,104 @@ Client.prototype.getMetadata = function(metadataOptions, cb) {
 
 };
 
+/**
+ * Keep the metadata of all topics cached natively, refreshed every interval
+ * milliseconds off the event loop.
+ *
+ * Unlike getMetadata, a refresh does not build the metadata of the whole
+ * cluster as JS objects. Cached topics are looked up one at a time with
+ * getCachedTopicMetadata, and whatever changed between two refreshes is
+ * emitted as a 'metadata-change' event.
+ *
+ * @param {number} interval - Milliseconds between refreshes, 0 to stop.
+ * @fires Client#metadata-change
+ * @return {Client} - Returns itself.
+ */
+Client.prototype.setMetadataRefreshInterval = function(interval) {
+  if (this._metadataRefreshInterval) {
+    clearInterval(this._metadataRefreshInterval);
+    this._metadataRefreshInterval = undefined;
+  }
+
+  // Only the last call counts
+  if (this._metadataRefreshOnReady) {
+    this.removeListener('ready', this._metadataRefreshOnReady);
+    this._metadataRefreshOnReady = undefined;
+  }
+  if (this._metadataRefreshOnDisconnected) {
+    this.removeListener('disconnected', this._metadataRefreshOnDisconnected);
+    this._metadataRefreshOnDisconnected = undefined;
+  }
+
+  if (!interval) {
+    return this;
+  }
+
+  var self = this;
+
+  if (!this._isConnected) {
+    this._metadataRefreshOnReady = function() {
+      self._metadataRefreshOnReady = undefined;
+      self.setMetadataRefreshInterval(interval);
+    };
+    this.once('ready', this._metadataRefreshOnReady);
+    return this;
+  }
+
+  var refreshing = false;
+  function refresh() {
+    // A slow cluster must not pile up refreshes
+    if (refreshing || !self.isConnected()) {
+      return;
+    }
+    refreshing = true;
+    self._client.refreshMetadataCache(30000, function(err, changes) {
+      refreshing = false;
+      if (err) {
+        self.emit('event.error', LibrdKafkaError.create(err));
+        return;
+      }
+      if (changes.length > 0) {
+        /**
+         * Metadata change event. Emitted after a metadata cache refresh
+         * that found topics added or removed, partitions added, or leaders
+         * or replicas moved.
+         *
+         * @event Client#metadata-change
+         * @type {object[]}
+         */
+        self.emit('metadata-change', changes);
+      }
+    });
+  }
+
+  refresh();
+  this._metadataRefreshInterval = setInterval(refresh, interval).unref();
+
+  this._metadataRefreshOnDisconnected = function() {
+    self._metadataRefreshOnDisconnected = undefined;
+    self.setMetadataRefreshInterval(0);
+  };
+  this.once('disconnected', this._metadataRefreshOnDisconnected);
+
+  return this;
+};
+
+/**
+ * Get the metadata of a topic from the metadata cache.
+ *
+ * @param {string} topic - Name of the topic.
+ * @return {object|null} - The topic, in the same layout as the topics
+ * returned by getMetadata, or null if it was not found by the last refresh.
+ * @see Client#setMetadataRefreshInterval
+ */
+Client.prototype.getCachedTopicMetadata = function(topic) {
+  if (!this._client) {
+    return null;
+  }
+  return this._client.getCachedTopicMetadata(topic);
+};
+
 /**
  * Query offsets from the broker.
  *
@@ -531,6 +664,44 @@ Client.prototype.setSaslCredentials = function(username, password) {
   this._client.setSaslCredentials(username, password);
 };
 
+/**
+ * Get counters of the binding itself, complementing librdkafka's statistics.
+ *
+ * `dispatchers` holds, per callback dispatcher of this client, the number of
+ * main thread wake-ups, the items handed to JS and the current and highest
+ * queue depth. `messagesConverted`, `connectionLock` (contended acquisitions
+ * and nanoseconds spent waiting) and `workersInFlight` (per worker type) are
+ * shared by all clients of the process.
+ *
+ * @return {object} - The native metrics.
+ */
+Client.prototype.getNativeMetrics = function() {
+  return this._client.getNativeMetrics();
+};
+
+/**
+ * Get the latency histograms of the client, when enabled with the
+ * `latency_histograms` configuration property.
+ *
+ * Holds per topic the `count`, `min`, `max` and `mean` latencies and the
+ * `p50`, `p90`, `p99` and `p999` percentiles, all in microseconds and the
+ * percentiles within 3%. Producers measure from produce to a successful
+ * delivery report, consumers from the message timestamp to the message
+ * being consumed.
+ *
+ * @return {object} - The histograms by topic name.
+ */
+Client.prototype.getLatencyHistograms = function() {
+  return this._client.getLatencyHistograms();
+};
+
+/**
+ * Clear the latency histograms, to start a new measurement interval.
+ */
+Client.prototype.resetLatencyHistograms = function() {
+  this._client.resetLatencyHistograms();
+};
+
 /**
  * Wrap a potential RdKafka error.
  *
@@ -21,6 +21,9 @@ var shallowCopy = require('./util').shallowCopy;
 var DEFAULT_CONSUME_LOOP_TIMEOUT_DELAY = 500;
 var DEFAULT_CONSUME_TIME_OUT = 1000;
 const DEFAULT_IS_TIMEOUT_ONLY_FOR_FIRST_MESSAGE = false;
+var DEFAULT_OFFSET_TRACKING_INTERVAL_MS = 500;
+var DEFAULT_OFFSET_TRACKING_THRESHOLD = 1000;
+var DEFAULT_EVENT_DRIVEN_BATCH_SIZE = 1000;
 util.inherits(KafkaConsumer, Client);
 
 /**
@@ -120,6 +123,56 @@ function KafkaConsumer(conf, topicConf) {
     };
   }
 
+  /*
+   * zero_copy_consume is handled here rather than by librdkafka. When set,
+   * message values are buffers pointing straight into librdkafka's fetch
+   * memory instead of copies of it. Each buffer keeps its message alive
+   * until it is garbage collected. Buffers still alive on disconnect are
+   * emptied, so values must be copied if they need to outlive the consumer.
+   */
+  var zeroCopyConsume = conf.zero_copy_consume;
+  delete conf.zero_copy_consume;
+
+  /*
+   * partition_queues is handled here as well. When set, every assigned
+   * partition gets its own queue which is read with consumePartition, so
+   * partitions can be consumed independently of each other. Rebalances and
+   * errors are still only served by consume, which has to keep being called.
+   */
+  var partitionQueues = conf.partition_queues;
+  delete conf.partition_queues;
+
+  /*
+   * consume_backlog_max limits the messages read by the consume loop that
+   * wait for the event loop. Once it is reached the loop stops consuming
+   * until the event loop catches up, leaving messages with librdkafka.
+   * 0 removes the limit.
+   */
+  var consumeBacklogMax = conf.consume_backlog_max;
+  delete conf.consume_backlog_max;
+
+  /*
+   * event_driven_consume makes the consume loop read on the event loop
+   * whenever librdkafka reports messages, without a background thread
+   * waiting on timeouts. Messages are read in batches of the consume loop
+   * batch size, or DEFAULT_EVENT_DRIVEN_BATCH_SIZE when it is unset. Only
+   * the flowing consume loop reads this way; consume(number, cb) still
+   * waits on a worker thread.
+   */
+  var eventDrivenConsume = conf.event_driven_consume;
+  delete conf.event_driven_consume;
+
+  /*
+   * offset_tracking is handled here too. When set, consumed messages are
+   * tracked natively until they are passed to resolveOffset, in any order,
+   * and the offset up to which everything was resolved is stored for each
+   * partition in batches. Requires enable.auto.offset.store to be false.
+   */
+  var offsetTracking = conf.offset_tracking;
+  var offsetTrackingIntervalMs = conf.offset_tracking_interval_ms;
+  delete conf.offset_tracking;
+  delete conf.offset_tracking_interval_ms;
+
   /**
    * KafkaConsumer message.
    *
@@ -138,12 +191,33 @@ function KafkaConsumer(conf, topicConf) {
 
   Client.call(this, conf, Kafka.KafkaConsumer, topicConf);
 
+  if (zeroCopyConsume) {
+    this._client.setZeroCopyConsume(true);
+  }
+
+  if (partitionQueues) {
+    this._client.setPartitionQueues(true);
+  }
+
+  if (consumeBacklogMax !== undefined) {
+    this._client.setConsumeBacklogMax(consumeBacklogMax);
+  }
+
+  if (offsetTracking) {
+    this._client.setOffsetTracking(true,
+      offsetTrackingIntervalMs !== undefined ? offsetTrackingIntervalMs : DEFAULT_OFFSET_TRACKING_INTERVAL_MS,
+      DEFAULT_OFFSET_TRACKING_THRESHOLD);
+  }
+
   this.globalConfig = conf;
   this.topicConfig = topicConf;
 
   this._consumeTimeout = DEFAULT_CONSUME_TIME_OUT;
   this._consumeLoopTimeoutDelay = DEFAULT_CONSUME_LOOP_TIMEOUT_DELAY;
   this._consumeIsTimeoutOnlyForFirstMessage = DEFAULT_IS_TIMEOUT_ONLY_FOR_FIRST_MESSAGE;
+  this._consumeLoopBatchSize = 0;
+  this._consumeLoopBatchTimeout = 0;
+  this._eventDrivenConsume = !!eventDrivenConsume;
 }
 
 /**
@@ -162,6 +236,23 @@ KafkaConsumer.prototype.setDefaultConsumeLoopTimeoutDelay = function(intervalMs)
   this._consumeLoopTimeoutDelay = intervalMs;
 };
 
+/**
+ * Batch the messages read by the consume loop.
+ *
+ * The background thread collects up to `size` messages, waiting at most
+ * `timeoutMs` after the first one, before handing them over together. This
+ * cuts down on wake-ups and calls into JavaScript at high throughput; `data`
+ * is still emitted and the callback still called once per message.
+ *
+ * Takes effect the next time consume is called without a number.
+ * @param {number} size - maximum number of messages per batch, 0 disables batching
+ * @param {number} timeoutMs - milliseconds to wait for a batch to fill up
+ */
+KafkaConsumer.prototype.setDefaultConsumeLoopBatch = function(size, timeoutMs) {
+  this._consumeLoopBatchSize = size || 0;
+  this._consumeLoopBatchTimeout = timeoutMs || 0;
+};
+
 /**
  * If true:
  *  In consume(number, cb), we will wait for `timeoutMs` for the first message to be fetched.
@@ -276,6 +367,48 @@ KafkaConsumer.prototype.seek = function(toppar, timeout, cb) {
   return this;
 };
 
+/**
+ * Seek several partitions at once.
+ *
+ * All partitions are seeked with a single native call on one thread pool
+ * thread, rather than one for each like seek. The partitions must be
+ * assigned.
+ *
+ * @example
+ * consumer.seekPartitions([
+ *   { topic: 'topic', partition: 0, offset: 1000 },
+ *   { topic: 'topic', partition: 1, offset: 2000 }
+ * ], 1000, function(err, partitions) {
+ *   // partitions[i].error is set for partitions that could not be seeked
+ * });
+ *
+ * @param {TopicPartition[]} toppars - Topic partitions with the offsets to
+ * seek to.
+ * @param {number} timeout - Number of ms to wait for the seeks. If it is 0,
+ * the seeks happen in the background and no errors are reported.
+ * @param {Function} cb - Callback called with an error if the seek could not
+ * be done at all, otherwise with the partitions, each with an error property
+ * if seeking it failed.
+ * @return {Client} - Returns itself
+ */
+KafkaConsumer.prototype.seekPartitions = function(toppars, timeout, cb) {
+  this._client.seekPartitions(TopicPartition.map(toppars), timeout, function(err, partitions) {
+    if (err) {
+      cb(LibrdKafkaError.create(err));
+      return;
+    }
+
+    for (var i = 0; i < partitions.length; i++) {
+      if (partitions[i].error) {
+        partitions[i].error = LibrdKafkaError.create(partitions[i].error);
+      }
+    }
+
+    cb(null, partitions);
+  });
+  return this;
+};
+
 /**
  * Assign the consumer specific partitions and topics. Used for
  * eager (non-cooperative) rebalancing.
@@ -491,6 +624,33 @@ KafkaConsumer.prototype.consume = function(number, cb) {
 KafkaConsumer.prototype._consumeLoop = function(timeoutMs, cb) {
   var self = this;
   var retryReadInterval = this._consumeLoopTimeoutDelay;
+
+  function readBatchCallback(err, messages, eofEvents, warning) {
+    if (err) {
+      cb(LibrdKafkaError.create(err));
+    } else if (warning) {
+      self.emit('warning', LibrdKafkaError.create(warning));
+    } else {
+      self._emitMessages(messages, eofEvents, function(message) {
+        cb(null, message);
+      });
+    }
+  }
+
+  if (this._eventDrivenConsume) {
+    self._client.consumeOnEvents(
+      this._consumeLoopBatchSize > 0 ? this._consumeLoopBatchSize : DEFAULT_EVENT_DRIVEN_BATCH_SIZE,
+      readBatchCallback);
+    return;
+  }
+
+  if (this._consumeLoopBatchSize > 0) {
+    self._client.consumeLoop(timeoutMs, retryReadInterval,
+      this._consumeLoopBatchSize, this._consumeLoopBatchTimeout,
+      readBatchCallback);
+    return;
+  }
+
   self._client.consumeLoop(timeoutMs, retryReadInterval, function readCallback(err, message, eofEvent, warning) {
 
     if (err) {
@@ -537,31 +697,89 @@ KafkaConsumer.prototype._consumeNum = function(timeoutMs, numMessages, cb) {
       return;
     }
 
-    var currentEofEventsIndex = 0;
+    self._emitMessages(messages, eofEvents);
 
-    function emitEofEventsFor(messageIndex) {
-      while (currentEofEventsIndex < eofEvents.length && eofEvents[currentEofEventsIndex].messageIndex === messageIndex) {
-        delete eofEvents[currentEofEventsIndex].messageIndex;
-        self.emit('partition.eof', eofEvents[currentEofEventsIndex])
-        ++currentEofEventsIndex;
-      }
+    if (cb) {
+      cb(null, messages);
     }
 
-    emitEofEventsFor(-1);
+  });
 
-    for (var i = 0; i < messages.length; i++) {
-      self.emit('data', messages[i]);
-      emitEofEventsFor(i);
-    }
+};
 
-    emitEofEventsFor(messages.length);
+/**
+ * Read a number of messages from a single assigned partition.
+ *
+ * Requires the consumer to be created with `partition_queues` set. Works
+ * like `consume(number, cb)`, but only returns messages of the given
+ * partition, and calls for different partitions run in parallel.
+ *
+ * @param {string} topic - Topic of the partition to read
+ * @param {number} partition - Partition to read
+ * @param {number} number - Number of messages to read
+ * @param {KafkaConsumer~readCallback} cb - Callback to return when work is done.
+ */
+KafkaConsumer.prototype.consumePartition = function(topic, partition, number, cb) {
+  var timeoutMs = this._consumeTimeout !== undefined ? this._consumeTimeout : DEFAULT_CONSUME_TIME_OUT;
+  var self = this;
 
-    if (cb) {
-      cb(null, messages);
+  if (cb === undefined) {
+    cb = function() {};
+  } else if (typeof cb !== 'function') {
+    throw new TypeError('Callback must be a function');
+  }
+
+  this._client.consumePartition(topic, partition, timeoutMs, number, this._consumeIsTimeoutOnlyForFirstMessage, function(err, messages, eofEvents) {
+    if (err) {
+      cb(LibrdKafkaError.create(err));
+      return;
     }
 
+    self._emitMessages(messages, eofEvents);
+    cb(null, messages);
   });
+};
 
+/**
+ * Give every partition assigned from now on its own queue, like the
+ * `partition_queues` option does. Must be called before any partition is
+ * assigned.
+ *
+ * @param {boolean} enabled - Whether partitions get their own queues
+ */
+KafkaConsumer.prototype.setPartitionQueues = function(enabled) {
+  this._client.setPartitionQueues(enabled);
+};
+
+/**
+ * Emit a batch of messages and the EOF events that came with it, each EOF
+ * event right after the message it was reached at.
+ *
+ * @private
+ */
+KafkaConsumer.prototype._emitMessages = function(messages, eofEvents, onMessage) {
+  var self = this;
+  var currentEofEventsIndex = 0;
+
+  function emitEofEventsFor(messageIndex) {
+    while (currentEofEventsIndex < eofEvents.length && eofEvents[currentEofEventsIndex].messageIndex === messageIndex) {
+      delete eofEvents[currentEofEventsIndex].messageIndex;
+      self.emit('partition.eof', eofEvents[currentEofEventsIndex])
+      ++currentEofEventsIndex;
+    }
+  }
+
+  emitEofEventsFor(-1);
+
+  for (var i = 0; i < messages.length; i++) {
+    self.emit('data', messages[i]);
+    if (onMessage) {
+      onMessage(messages[i]);
+    }
+    emitEofEventsFor(i);
+  }
+
+  emitEofEventsFor(messages.length);
 };
 
 /**
@@ -671,6 +889,76 @@ KafkaConsumer.prototype.getWatermarkOffsets = function(topic, partition) {
   return this._errorWrap(this._client.getWatermarkOffsets(topic, partition), true);
 };
 
+/**
+ * Lag of the assigned partitions, as parallel arrays with one entry per
+ * partition.
+ *
+ * @typedef {object} KafkaConsumer~lag
+ * @property {string[]} topics - Topics of the assignment.
+ * @property {Int32Array} topicIndex - Index of the topic in topics.
+ * @property {Int32Array} partition - Partition.
+ * @property {Float64Array} position - Offset of the next message to consume.
+ * @property {Float64Array} lowOffset - Low watermark.
+ * @property {Float64Array} highOffset - High watermark, or the last stable
+ * offset for read_committed consumers when queried.
+ * @property {Float64Array} lag - Messages between the position and the high
+ * offset, -1 if either is not known.
+ *
+ * Offsets that are not known are -1001.
+ */
+
+/**
+ * Get the lag of every assigned partition from what the consumer knows.
+ *
+ * Nothing is sent to the brokers. The high offset is updated on each fetched
+ * message set, the low offset only if statistics.interval.ms is set.
+ *
+ * @return {KafkaConsumer~lag} - Lag of each assigned partition.
+ * @throws {LibrdKafkaError} - Throws when the lag cannot be read.
+ * @see KafkaConsumer#queryLag
+ */
+KafkaConsumer.prototype.getLag = function() {
+  if (!this.isConnected()) {
+    throw new Error('Client is disconnected');
+  }
+
+  return this._errorWrap(this._client.getLag(), true);
+};
+
+/**
+ * Get the lag of every assigned partition against queried end offsets.
+ *
+ * The end offsets of all partitions are queried in one request per
+ * partition leader, on a single thread pool thread.
+ *
+ * @param {number} timeout - Number of ms to wait for the end offsets.
+ * @param {function} cb - Callback called with an error or the
+ * {@link KafkaConsumer~lag}.
+ * @return {KafkaConsumer} - Returns itself.
+ * @see KafkaConsumer#getLag
+ */
+KafkaConsumer.prototype.queryLag = function(timeout, cb) {
+  if (typeof timeout === 'function') {
+    cb = timeout;
+    timeout = 1000;
+  }
+
+  if (!this.isConnected()) {
+    cb(new Error('Client is disconnected'));
+    return this;
+  }
+
+  this._client.queryLag(timeout, function(err, lag) {
+    if (err) {
+      cb(LibrdKafkaError.create(err));
+      return;
+    }
+
+    cb(null, lag);
+  });
+  return this;
+};
+
 /**
  * Store offset for topic partition.
  *
@@ -692,6 +980,37 @@ KafkaConsumer.prototype.offsetsStore = function(topicPartitions) {
   return this._errorWrap(this._client.offsetsStore(topicPartitions), true);
 };
 
+/**
+ * Mark a consumed message as processed.
+ *
+ * Only available with offset_tracking. Messages can be resolved in any
+ * order; the offset after a message is only stored once it and every
+ * message consumed before it from the same partition were resolved. Stores
+ * are batched and always happen before a commit, a revoke or a disconnect.
+ *
+ * @param {TopicPartitionOffset} topicPartitionOffset - Topic, partition and offset of the message, not the offset after it.
+ * @throws {LibrdKafkaError} - Throws when offset tracking is not enabled
+ */
+KafkaConsumer.prototype.resolveOffset = function(topicPartitionOffset) {
+  if (!this.isConnected()) {
+    throw new Error('Client is disconnected');
+  }
+
+  return this._errorWrap(this._client.resolveOffset(topicPartitionOffset.topic,
+    topicPartitionOffset.partition, Number(topicPartitionOffset.offset)), true);
+};
+
+/**
+ * Stop waiting for the consumed messages that were not resolved yet.
+ *
+ * For use with offset_tracking when consumed messages are dropped without
+ * being processed, and without seeking back to them. What was resolved
+ * before is still stored.
+ */
+KafkaConsumer.prototype.resetOffsetTracking = function() {
+  this._client.resetOffsetTracking();
+};
+
 /**
  * Resume consumption for the provided list of partitions.
  *
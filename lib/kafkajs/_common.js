@@ -242,8 +242,6 @@ const CompatibilityErrorMessages = Object.freeze({
     createReplacementErrorMessage('consumer', 'run', 'autoCommitInterval', 'autoCommitInterval: <number>', 'autoCommitInterval: <number>', false),
   runOptionsAutoCommitThreshold: () =>
     "The property 'autoCommitThreshold' is not supported by run.\n",
-  runOptionsRunConcurrently: () =>
-    "The property 'partitionsConsumedConcurrently' is not currently supported by run\n",
 });
 
 /**
@@ -557,14 +555,15 @@ function createKafkaJsErrorFromLibRdKafkaError(librdKafkaError) {
 function convertToRdKafkaHeaders(kafkaJSHeaders) {
   if (!kafkaJSHeaders) return null;
 
+  /* Flat [key1, value1, key2, value2] layout, the cheapest for the binding to read. */
   const headers = [];
   for (const [key, value] of Object.entries(kafkaJSHeaders)) {
     if (value.constructor === Array) {
       for (const v of value) {
-        headers.push({ key, value: v });
+        headers.push(key, v);
       }
     } else {
-      headers.push({ key, value });
+      headers.push(key, value);
     }
   }
   return headers;
@@ -626,6 +625,11 @@ class Lock {
     })
   }
 
+  /* Whether anyone is waiting to acquire the lock. */
+  hasWaiters() {
+    return this[LockStates.WAITING].size !== 0;
+  }
+
   async release() {
     this[LockStates.LOCKED] = false;
     const waitingLock = this[LockStates.WAITING].values().next().value;
@@ -219,11 +219,23 @@ class Consumer {
    */
   #messageCache = null;
 
+  /**
+   * The message caches of the partitions read from their own queues, when
+   * partitionsConsumedConcurrently is set. The keys are of the type "<topic>|<partition>".
+   * @type {Map<string, MessageCache>}
+   */
+  #partitionCaches = new Map();
+
   /**
    * Whether the user has enabled manual offset management (stores).
    */
   #userManagedStores = false;
 
+  /**
+   * Whether stores of the messages we process are coalesced natively, which the user opts into with offset_tracking.
+   */
+  #offsetTracking = false;
+
   /**
    * @constructor
    * @param {import("../../types/kafkajs").ConsumerConfig} kJSConfig
@@ -250,33 +262,32 @@ class Consumer {
      * we've gotten further along then they have, we can come back. */
     if (seek) {
       const assignment = this.assignment();
-      const seekPromises = [];
+      const seeks = [];
       for (const topicPartitionOffset of assignment) {
         const key = `${topicPartitionOffset.topic}|${topicPartitionOffset.partition}`;
         if (!this.#lastConsumedOffsets.has(key))
           continue;
 
-        /* Fire off a seek */
-        const seekPromise = new Promise((resolve, reject) => this.#internalClient.seek({
+        seeks.push({
           topic: topicPartitionOffset.topic,
           partition: topicPartitionOffset.partition,
           offset: +this.#lastConsumedOffsets.get(key)
-        }, 10000, err => {
-          if (err) {
-            reject(err);
-          } else {
-            resolve();
-          }
-        }));
-        seekPromises.push(seekPromise);
+        });
       }
 
-      /* TODO: we should cry more about this and render the consumer unusable. */
-      await Promise.all(seekPromises).catch(err => this.#logger.error("Seek error. This is effectively a fatal error:" + err));
+      /* All of them in one go, rather than a thread pool thread for each. */
+      if (seeks.length !== 0) {
+        /* TODO: we should cry more about this and render the consumer unusable. */
+        await this.#seekPartitions(seeks, 10000).catch(err => this.#logger.error("Seek error. This is effectively a fatal error:" + err));
+      }
     }
 
-    /* Clear the cache. */
+    /* Clear the cache. The cached messages are never going to be resolved, so stop waiting for them. */
     this.#messageCache.clear();
+    for (const cache of this.#partitionCaches.values())
+      cache.clear();
+    if (this.#offsetTracking)
+      this.#internalClient.resetOffsetTracking();
     /* Clear the offsets - no need to keep them around. */
     this.#lastConsumedOffsets.clear();
   }
@@ -562,6 +573,8 @@ class Consumer {
     } else {
       this.#userManagedStores = !rdKafkaConfig['enable.auto.offset.store'];
     }
+    /* If asked for, stores for the messages we process are coalesced natively, see #processMessage. */
+    this.#offsetTracking = !this.#userManagedStores && !!rdKafkaConfig['offset_tracking'];
 
     return rdKafkaConfig;
   }
@@ -730,6 +743,54 @@ class Consumer {
     });
   }
 
+  /**
+   * Consumes from the queue of a single partition, see #consumeSingleCached.
+   * @param {import("../../types").TopicPartition} topicPartition
+   * @returns {Promise<import("../..").Message|null>} a promise that resolves to the first message read, if any.
+   *                                                  The rest are kept in the cache of the partition.
+   *                                                  It is rejected if the partition cannot be read, for instance
+   *                                                  because it was revoked in the meantime.
+   * @note requires the partitions to be read from their own queues.
+   */
+  async #consumePartitionCached({ topic, partition }) {
+    const key = `${topic}|${partition}`;
+    let cache = this.#partitionCaches.get(key);
+    if (!cache) {
+      cache = new MessageCache(this.#messageCache.expiryDurationMs);
+      this.#partitionCaches.set(key, cache);
+    }
+
+    return new Promise((resolve, reject) => {
+      this.#internalClient.consumePartition(topic, partition, cache.maxSize, (err, messages) => {
+        if (err) {
+          reject(err);
+          return;
+        }
+        cache.setCache(messages);
+        if (messages.length === cache.maxSize) {
+          cache.increaseMaxSize();
+        } else {
+          cache.decreaseMaxSize(messages.length);
+        }
+        resolve(messages[0] ?? null);
+      });
+    });
+  }
+
+  /**
+   * Calls fn with the given consume timeout set on the internal client.
+   * @param {number|undefined} timeout - the timeout, undefined for the default.
+   * @param {Function} fn - must read its messages synchronously, as the timeout is reset once it returns.
+   */
+  #withConsumeTimeout(timeout, fn) {
+    this.#internalClient.setDefaultConsumeTimeout(timeout);
+    try {
+      return fn();
+    } finally {
+      this.#internalClient.setDefaultConsumeTimeout(undefined);
+    }
+  }
+
   /**
    * Consumes n messages from the internal consumer.
    * @returns {Promise<import("../..").Message[]>} a promise that resolves to a list of messages.
@@ -883,13 +944,27 @@ class Consumer {
       throw new error.KafkaJSError(CompatibilityErrorMessages.runOptionsAutoCommitThreshold(), { code: error.ErrorCodes.ERR__NOT_IMPLEMENTED });
     }
 
+    let partitionsConsumedConcurrently = 1;
     if (Object.hasOwn(config, 'partitionsConsumedConcurrently')) {
-      throw new error.KafkaJSError(CompatibilityErrorMessages.runOptionsPartitionsConsumedConcurrently(), { code: error.ErrorCodes.ERR__NOT_IMPLEMENTED });
+      partitionsConsumedConcurrently = config.partitionsConsumedConcurrently;
+      if (!Number.isInteger(partitionsConsumedConcurrently) || partitionsConsumedConcurrently < 1) {
+        throw new error.KafkaJSError('partitionsConsumedConcurrently must be a positive integer.', { code: error.ErrorCodes.ERR__INVALID_ARG });
+      }
     }
 
     if (this.#running) {
       throw new error.KafkaJSError('Consumer is already running.', { code: error.ErrorCodes.ERR__STATE });
     }
+
+    /* Each partition is then read from its own queue, which needs to be set up as it is assigned.
+     * Partitions are only assigned while consuming, so this is normally before the first assignment. */
+    if (partitionsConsumedConcurrently > 1) {
+      try {
+        this.#internalClient.setPartitionQueues(true);
+      } catch (e) {
+        throw new error.KafkaJSError(e.message, { code: error.ErrorCodes.ERR__STATE });
+      }
+    }
     this.#running = true;
 
     /* Batches are auto resolved by default. */
@@ -898,7 +973,10 @@ class Consumer {
     }
 
     /* We deliberately don't await this. */
-    this.#runInternal(config);
+    if (partitionsConsumedConcurrently > 1)
+      this.#runConcurrentInternal(config, partitionsConsumedConcurrently);
+    else
+      this.#runInternal(config);
   }
 
   /* Internal polling loop. It accepts the same config object that `run` accepts. */
@@ -929,107 +1007,271 @@ class Consumer {
         continue;
       }
 
-      /* TODO: add partitionsConsumedConcurrently-based concurrency here.
-      * If we maintain a map of topic partitions to promises, and a counter,
-      * we can probably achieve it with the correct guarantees of ordering
-      * though to maximize performance, we need to consume only from partitions for which
-      * an eachMessage call is not already going.
-      * It's risky to consume, and then store the message in something like an
-      * array/list until it can be processed, because librdkafka marks it as
-      * 'stored'... but anyway - we can implement something like this.
-      */
-
-      /* Make pending seeks 'concrete'. */
-      if (this.#checkPendingSeeks) {
-        const invalidateMessage = await this.#seekInternal({ topic: m.topic, partition: m.partition });
-        if (invalidateMessage) {
-          /* Don't pass this message on to the user if this topic partition was seeked to. */
-          this.#lock.release();
-          continue;
-        }
+      await this.#processMessage(config, m);
+
+      /* Release the lock so that any pending disconnect can go through. */
+      await this.#lock.release();
+    }
+  }
+
+  /**
+   * Passes a message on to the user, and then stores its offset, or seeks back to it if it was not processed.
+   * The lock must be held.
+   * @param {import("../../types/kafkajs").ConsumerRunConfig} config - the config passed to run.
+   * @param {import("../..").Message} m - the message.
+   */
+  async #processMessage(config, m) {
+    /* Make pending seeks 'concrete'. */
+    if (this.#checkPendingSeeks) {
+      const invalidateMessage = await this.#seekInternal({ topic: m.topic, partition: m.partition });
+      if (invalidateMessage) {
+        /* Don't pass this message on to the user if this topic partition was seeked to. */
+        return;
       }
+    }
 
-      let eachMessageProcessed = false;
-      let payload;
+    let eachMessageProcessed = false;
+    let payload;
+    if (config.eachMessage) {
+      payload = this.#createPayload(m);
+    } else {
+      payload = this.#createBatchPayload(m);
+    }
+    try {
       if (config.eachMessage) {
-        payload = this.#createPayload(m);
+        await config.eachMessage(payload);
+        eachMessageProcessed = true;
       } else {
-        payload = this.#createBatchPayload(m);
-      }
-      try {
-        if (config.eachMessage) {
-          await config.eachMessage(payload);
+        await config.eachBatch(payload);
+        if (config.eachBatchAutoResolve) {
           eachMessageProcessed = true;
         } else {
-          await config.eachBatch(payload);
-          if (config.eachBatchAutoResolve) {
-            eachMessageProcessed = true;
-          } else {
-            eachMessageProcessed = payload._messageResolved;
-          }
+          eachMessageProcessed = payload._messageResolved;
         }
+      }
+    } catch (e) {
+      /* It's not only possible, but expected that an error will be thrown by eachMessage or eachBatch.
+       * This is especially true since the pattern of pause() followed by throwing an error
+       * is encouraged. To meet the API contract, we seek one offset backward (which
+       * means seeking to the message offset).
+       * However, we don't do this inside the catch, but just outside it. This is because throwing an
+       * error is not the only case where we might want to seek back. We might want to seek back
+       * if the user has not called `resolveOffset` manually in case of using eachBatch without
+       * eachBatchAutoResolve being set.
+       *
+       * So - do nothing but a debug log, but at this point eachMessageProcessed needs to be false unless
+       * the user has explicitly marked it as true.
+       */
+      this.#logger.debug(`Consumer encountered error while processing message. Error details: ${JSON.stringify(e)}. The same message may be reprocessed.`);
+
+      /* The value of eachBatchAutoResolve is not important. The only place where a message is marked processed
+       * despite an error is if the user says so, and the user can use resolveOffsets for both the possible
+       * values eachBatchAutoResolve can take. */
+      if (config.eachBatch)
+        eachMessageProcessed = payload._messageResolved
+    }
+
+    /* If the message is unprocessed, due to an error, or because the user has not resolved it, we seek back. */
+    if (!eachMessageProcessed) {
+      await this.seek({
+        topic: m.topic,
+        partition: m.partition,
+        offset: m.offset,
+      });
+    }
+
+    /* Store the offsets we need to store, or at least record them for cache invalidation reasons. */
+    if (eachMessageProcessed) {
+      try {
+        if (this.#offsetTracking) {
+          /* Cheap, the store itself is batched by the internal client. */
+          this.#internalClient.resolveOffset({ topic: m.topic, partition: m.partition, offset: m.offset });
+        } else if (!this.#userManagedStores) {
+          this.#internalClient.offsetsStore([{ topic: m.topic, partition: m.partition, offset: Number(m.offset) + 1 }]);
+        }
+        this.#lastConsumedOffsets.set(`${m.topic}|${m.partition}`, Number(m.offset) + 1);
       } catch (e) {
-        /* It's not only possible, but expected that an error will be thrown by eachMessage or eachBatch.
-         * This is especially true since the pattern of pause() followed by throwing an error
-         * is encouraged. To meet the API contract, we seek one offset backward (which
-         * means seeking to the message offset).
-         * However, we don't do this inside the catch, but just outside it. This is because throwing an
-         * error is not the only case where we might want to seek back. We might want to seek back
-         * if the user has not called `resolveOffset` manually in case of using eachBatch without
-         * eachBatchAutoResolve being set.
-         *
-         * So - do nothing but a debug log, but at this point eachMessageProcessed needs to be false unless
-         * the user has explicitly marked it as true.
-         */
-        this.#logger.debug(`Consumer encountered error while processing message. Error details: ${JSON.stringify(e)}. The same message may be reprocessed.`);
+        /* Not much we can do, except log the error. */
+        if (this.#logger)
+          this.#logger.error(`Consumer encountered error while storing offset. Error details: ${JSON.stringify(e)}`);
+      }
+    }
+
+    /* Force a immediate seek here. It's possible that there are no more messages to be passed to the user,
+     * but the user seeked in the call to eachMessage, or else we encountered the error catch block.
+     * In that case, the results of that seek will never be reflected unless we do this. */
+    if (this.#checkPendingSeeks)
+      await this.#seekInternal();
+
+    /* TODO: another check we need to do here is to see how kafkaJS is handling
+     * commits. Are they commmitting after a message is _processed_?
+     * In that case we need to turn off librdkafka's auto-commit, and commit
+     * inside this function.
+     */
+  }
 
-        /* The value of eachBatchAutoResolve is not important. The only place where a message is marked processed
-         * despite an error is if the user says so, and the user can use resolveOffsets for both the possible
-         * values eachBatchAutoResolve can take. */
-        if (config.eachBatch)
-          eachMessageProcessed = payload._messageResolved
+  /* Internal polling loop for partitionsConsumedConcurrently, reading every partition from its own queue.
+   * Up to `concurrency` partitions at a time are read by a loop of their own, which passes their messages on in order.
+   * When there are more partitions than that, a loop hands its slot on to the next partition after every read, so a
+   * slow handler only ever holds up its own partition. Meanwhile, rebalances, errors, and the messages of any
+   * partition without a queue of its own arrive through the consumer queue, which is served here. */
+  async #runConcurrentInternal(config, concurrency) {
+    /* How often the consumer queue is served while the partition loops are running. */
+    const consumerQueueIntervalMs = 100;
+    /* The key of the loop passing on the messages of the consumer queue. */
+    const consumerQueueKey = '';
+    let nextPartition = 0;
+
+    while (this.#state === ConsumerState.CONNECTED) {
+
+      /* The lock is held while the partition loops run, so a disconnect waits for all messages in processing. */
+      if (!(await acquireOrLog(this.#lock, this.#logger)))
+        continue;
+
+      /* Paused partitions, or loops stopped early, may have left messages unprocessed. */
+      if (this.#messageCache.stale) {
+        await this.#clearCacheAndResetPositions(true);
       }
 
-      /* If the message is unprocessed, due to an error, or because the user has not resolved it, we seek back. */
-      if (!eachMessageProcessed) {
-        await this.seek({
-          topic: m.topic,
-          partition: m.partition,
-          offset: m.offset,
+      /* The loops run until the lock is wanted, a partition is paused, or the consumer stops. */
+      const epoch = {
+        running: true,
+        /* Keys are JSON.stringify'd topic partitions, as for #pausedPartitions. */
+        assigned: new Set(),
+        /* Whether other partitions are waiting for a slot. */
+        contended: false,
+      };
+      const loops = new Map();
+      /* Partitions that could not be read, until they are revoked. */
+      const failed = new Set();
+      /* Number of loops in a row that found nothing to read. */
+      let idleLoops = 0;
+
+      while (this.#state === ConsumerState.CONNECTED && !this.#messageCache.stale && !this.#lock.hasWaiters()) {
+        const assignment = this.assignment();
+        const assigned = new Set(assignment.map(topicPartition => JSON.stringify(topicPartition)));
+        for (const key of failed) {
+          if (!assigned.has(key))
+            failed.delete(key);
+        }
+        const partitions = assignment.filter(topicPartition => {
+          const key = JSON.stringify(topicPartition);
+          return !this.#pausedPartitions.has(key) && !failed.has(key);
         });
-      }
+        epoch.assigned = new Set(partitions.map(topicPartition => JSON.stringify(topicPartition)));
+        /* The partitions that could not be read share the slot of the consumer queue. */
+        epoch.contended = partitions.length + (failed.size !== 0 ? 1 : 0) > concurrency;
+
+        /* Fill the free slots, round robin. Once every partition came up empty, the next loops wait for messages. */
+        const wait = idleLoops >= partitions.length;
+        let started = nextPartition;
+        for (let i = 0; i < partitions.length && loops.size < concurrency; i++) {
+          const index = (nextPartition + i) % partitions.length;
+          const topicPartition = partitions[index];
+          const key = JSON.stringify(topicPartition);
+          if (loops.has(key))
+            continue;
+
+          started = index + 1;
+          loops.set(key, this.#runPartitionLoop(config, topicPartition, epoch, wait)
+            .then(consumed => {
+              idleLoops = consumed ? 0 : idleLoops + 1;
+            }, e => {
+              /* The partition may have been revoked in the meantime, or it has no queue of its own, in which case its
+               * messages arrive through the consumer queue. Nothing is lost, so just log and go on without it. */
+              this.#logger.warn(`Consumer encountered error while consuming ${key}. Error details: ${JSON.stringify(e)}`);
+              failed.add(key);
+            })
+            .finally(() => loops.delete(key)));
+        }
+        nextPartition = partitions.length === 0 ? 0 : started % partitions.length;
+
+        /* Its messages are passed on one at a time, so only read it again once the last one is processed.
+         * Without any partitions to read, this waits for an assignment instead. */
+        let messages = [];
+        if (!loops.has(consumerQueueKey)) {
+          messages = await this.#withConsumeTimeout(partitions.length === 0 ? undefined : 0, () => this.#consumeN(1))
+            .catch(e => {
+              if (this.#logger)
+                this.#logger.error(`Consumer encountered error while consuming. Retrying. Error details: ${JSON.stringify(e)}`);
+              return [];
+            });
+        }
 
-      /* Store the offsets we need to store, or at least record them for cache invalidation reasons. */
-      if (eachMessageProcessed) {
-        try {
-          if (!this.#userManagedStores) {
-            this.#internalClient.offsetsStore([{ topic: m.topic, partition: m.partition, offset: Number(m.offset) + 1 }]);
-          }
-          this.#lastConsumedOffsets.set(`${m.topic}|${m.partition}`, Number(m.offset) + 1);
-        } catch (e) {
-          /* Not much we can do, except log the error. */
-          if (this.#logger)
-            this.#logger.error(`Consumer encountered error while storing offset. Error details: ${JSON.stringify(e)}`);
+        if (messages.length !== 0) {
+          /* These take a slot like any partition. */
+          while (loops.size >= concurrency)
+            await Promise.race(loops.values());
+          loops.set(consumerQueueKey, (async () => {
+            for (const m of messages)
+              await this.#processMessage(config, m);
+          })().finally(() => loops.delete(consumerQueueKey)));
+        } else if (loops.size !== 0) {
+          let timeoutId;
+          await Promise.race([
+            ...loops.values(),
+            new Promise(resolve => { timeoutId = setTimeout(resolve, consumerQueueIntervalMs); }),
+          ]);
+          clearTimeout(timeoutId);
         }
       }
 
-      /* Force a immediate seek here. It's possible that there are no more messages to be passed to the user,
-       * but the user seeked in the call to eachMessage, or else we encountered the error catch block.
-       * In that case, the results of that seek will never be reflected unless we do this. */
-      if (this.#checkPendingSeeks)
-        await this.#seekInternal();
-
-      /* TODO: another check we need to do here is to see how kafkaJS is handling
-       * commits. Are they commmitting after a message is _processed_?
-       * In that case we need to turn off librdkafka's auto-commit, and commit
-       * inside this function.
-       */
+      epoch.running = false;
+      await Promise.all(loops.values());
 
       /* Release the lock so that any pending disconnect can go through. */
       await this.#lock.release();
     }
   }
 
+  /**
+   * Reads a partition from its own queue and passes its messages on in order, for #runConcurrentInternal.
+   * The lock must be held until the returned promise settles.
+   * @param {import("../../types/kafkajs").ConsumerRunConfig} config - the config passed to run.
+   * @param {import("../../types").TopicPartition} topicPartition - the partition to read.
+   * @param {{running: boolean, assigned: Set<string>, contended: boolean}} epoch - stops the loop once running is false
+   *                                 or the partition is no longer in assigned, and after a single read while contended.
+   * @param {boolean} wait - whether the first read waits for messages.
+   * @returns {Promise<boolean>} a promise that resolves to whether any messages were read.
+   */
+  async #runPartitionLoop(config, topicPartition, epoch, wait) {
+    const key = `${topicPartition.topic}|${topicPartition.partition}`;
+    const pausedKey = JSON.stringify(topicPartition);
+    let consumed = false;
+
+    while (epoch.running && epoch.assigned.has(pausedKey)) {
+      let m = await this.#withConsumeTimeout(wait ? undefined : 0, () => this.#consumePartitionCached(topicPartition));
+      if (!m) {
+        if (epoch.contended)
+          break;
+        wait = true;
+        continue;
+      }
+      consumed = true;
+      wait = false;
+
+      /* A seek clears the cache, which ends this early. */
+      const cache = this.#partitionCaches.get(key);
+      for (; m; m = cache.next()) {
+        if (!epoch.running || this.#pausedPartitions.has(pausedKey)) {
+          /* Come back to this message later. The positions are reset once the loops have stopped. */
+          this.#lastConsumedOffsets.set(key, Number(m.offset));
+          this.#messageCache.stale = true;
+          cache.clear();
+          break;
+        }
+
+        await this.#processMessage(config, m);
+      }
+
+      /* Give the slot to the next partition. */
+      if (epoch.contended)
+        break;
+    }
+
+    return consumed;
+  }
+
   /**
    * Consumes a single message from the consumer within the given timeout.
    * THIS METHOD IS NOT IMPLEMENTED.
@@ -1150,6 +1392,28 @@ class Consumer {
     return assignment;
   }
 
+  /**
+   * Seeks several topic partitions with a single call to the internal client.
+   * @param {{topic: string, partition: number, offset: number}[]} topicPartitionOffsets
+   * @param {number} timeout Time to wait for the seeks, 0 to seek in the background.
+   * @returns {Promise<void>} rejected with the first error, if any.
+   */
+  #seekPartitions(topicPartitionOffsets, timeout) {
+    return new Promise((resolve, reject) => this.#internalClient.seekPartitions(topicPartitionOffsets, timeout, (err, partitions) => {
+      if (err) {
+        reject(err);
+        return;
+      }
+
+      const failed = partitions.find(partition => partition.error);
+      if (failed) {
+        reject(failed.error);
+      } else {
+        resolve();
+      }
+    }));
+  }
+
   /**
    * This method processes any pending seeks on partitions that are assigned to this consumer.
    * @param {{topic: string, partition: number}} messageTopicPartition If this method was triggered by a message, pass the topic partition of the message, else it's optional.
@@ -1158,6 +1422,7 @@ class Consumer {
   async #seekInternal(messageTopicPartition) {
     this.#checkPendingSeeks = false;
     const assignment = this.assignment();
+    const seeks = [];
     const offsetsToCommit = [];
     let invalidateMessage = false;
 
@@ -1169,21 +1434,11 @@ class Consumer {
       const offset = this.#pendingSeeks.get(key);
       this.#pendingSeeks.delete(key);
 
-      const topicPartitionOffset = {
+      seeks.push({
         topic: topicPartition.topic,
         partition: topicPartition.partition,
         offset
-      };
-
-      /* We need a complete reset of the cache if we're seeking to a different offset even for one partition.
-       * At a later point, this may be improved at the cost of added complexity of maintaining message generation,
-       * or else purging the cache of just those partitions which are seeked. */
-      await this.#clearCacheAndResetPositions(true);
-
-      /* It's assumed that topicPartition is already assigned, and thus can be seeked to and committed to.
-       * Errors are logged to detect bugs in the internal code. */
-      /* TODO: is it work awaiting seeks to finish? */
-      this.#internalClient.seek(topicPartitionOffset, 0, err => err ? this.#logger.error(err) : null);
+      });
       offsetsToCommit.push({
         topic: topicPartition.topic,
         partition: topicPartition.partition,
@@ -1197,6 +1452,17 @@ class Consumer {
       }
     }
 
+    if (seeks.length !== 0) {
+      /* We need a complete reset of the cache if we're seeking to a different offset even for one partition.
+       * At a later point, this may be improved at the cost of added complexity of maintaining message generation,
+       * or else purging the cache of just those partitions which are seeked. */
+      await this.#clearCacheAndResetPositions(true);
+
+      /* It's assumed that the partitions are already assigned, and thus can be seeked to and committed to.
+       * They are seeked with one call, in the background. Errors are logged to detect bugs in the internal code. */
+      this.#seekPartitions(seeks, 0).catch(err => this.#logger.error(err));
+    }
+
     /* Offsets are committed on seek only when in compatibility mode. */
     if (offsetsToCommit.length !== 0 && this.#internalConfig['enable.auto.commit']) {
       await this.#commitOffsetsUntilNoStateErr(offsetsToCommit);
@@ -12,8 +12,8 @@ const { kafkaJSToRdKafkaConfig,
 } = require('./_common');
 const { Consumer } = require('./_consumer');
 const error = require('./_error');
+const LibrdKafkaError = require('../error');
 const { Buffer } = require('buffer');
-const { hrtime } = require('process');
 
 const ProducerState = Object.freeze({
   INIT: 0,
@@ -33,7 +33,8 @@ const CompressionTypes = Object.freeze({
   ZSTD: 'zstd',
 });
 
-const producerPollIntervalMs = 500;
+/* Maximum number of delivery reports handed to JS at once. */
+const producerDeliveryReportBatchSize = 1024;
 
 class Producer {
   /**
@@ -79,12 +80,23 @@ class Producer {
   #logger = new DefaultLogger();
 
   /**
-   * Stores the time of the last poll.
-   * In case we are producing in a tight loop, the interval timer will not
-   * fire, and we won't poll. By maintaining the last poll time, we can
-   * poll at the end of send() and sendBatch().
+   * Promise functions of the messages waiting for a delivery report, by the
+   * integer id the message was produced with as its opaque.
+   * @type {Map<number, {resolve: Function, reject: Function}>}
    */
-  #lastPollTime = hrtime();
+  #pendingDeliveries = new Map();
+
+  /**
+   * Id of the next message sent.
+   * @type {number}
+   */
+  #nextDeliveryId = 0;
+
+  /**
+   * Whether messages are produced with integer ids as their opaques.
+   * @type {boolean}
+   */
+  #opaqueIds = false;
 
   /**
    * @constructor
@@ -199,6 +211,17 @@ class Producer {
     /* TODO: Add a warning if dr_cb is set? Or else, create a trampoline for it. */
     rdKafkaConfig.dr_cb = true;
 
+    /* Delivery reports are handed over in batches, and all the promises of a batch are settled in one go. */
+    if (!Object.hasOwn(rdKafkaConfig, 'dr_batch_size')) {
+      rdKafkaConfig.dr_batch_size = producerDeliveryReportBatchSize;
+    }
+
+    /* Messages carry an integer id rather than their promise functions, which
+     * would otherwise need a global handle natively for every message. */
+    if (!Object.hasOwn(rdKafkaConfig, 'dr_opaque_ids')) {
+      rdKafkaConfig.dr_opaque_ids = true;
+    }
+
     return rdKafkaConfig;
   }
 
@@ -231,13 +254,27 @@ class Producer {
     this.#readyCb();
   }
 
+  /**
+   * Returns the promise functions of a message given its opaque, and forgets them.
+   * @param {number|{resolve: Function, reject: Function}} opaque
+   * @returns {{resolve: Function, reject: Function}|undefined}
+   */
+  #takeDelivery(opaque) {
+    if (typeof opaque !== 'number') {
+      return opaque;
+    }
+    const promise = this.#pendingDeliveries.get(opaque);
+    this.#pendingDeliveries.delete(opaque);
+    return promise;
+  }
+
   /**
    * Processes a delivery report, converting it to the type that the promisified API uses.
    * @param {import('../..').LibrdKafkaError} err
    * @param {import('../..').DeliveryReport} report
    */
   #deliveryCallback(err, report) {
-    const opaque = report.opaque;
+    const opaque = this.#takeDelivery(report.opaque);
     if (!opaque || (typeof opaque.resolve !== 'function' && typeof opaque.reject !== 'function')) {
       // not sure how to handle this.
       throw new error.KafkaJSError("Internal error: deliveryCallback called without opaque set properly", { code: error.ErrorCodes.ERR__STATE });
@@ -262,6 +299,39 @@ class Producer {
     opaque.resolve(recordMetadata);
   }
 
+  /**
+   * Processes a batch of delivery reports, settling the promise of each of the messages.
+   * A report that cannot be settled is logged, the rest of the batch is still settled.
+   * @param {import('../producer').DeliveryReportBatch} batch
+   */
+  #deliveryBatchCallback(batch) {
+    const { topic, partition, offset, error: errorCode, opaque } = batch;
+    for (let i = 0; i < opaque.length; i++) {
+      try {
+        const promise = this.#takeDelivery(opaque[i]);
+        if (!promise || (typeof promise.resolve !== 'function' && typeof promise.reject !== 'function')) {
+          throw new error.KafkaJSError("Internal error: deliveryCallback called without opaque set properly", { code: error.ErrorCodes.ERR__STATE });
+        }
+
+        if (errorCode[i] !== error.ErrorCodes.ERR_NO_ERROR) {
+          promise.reject(createKafkaJsErrorFromLibRdKafkaError(LibrdKafkaError.create(errorCode[i])));
+          continue;
+        }
+
+        promise.resolve({
+          topicName: topic[i],
+          partition: partition[i],
+          errorCode: 0,
+          baseOffset: offset[i],
+          logAppendTime: '-1',
+          logStartOffset: '0',
+        });
+      } catch (e) {
+        this.#logger.error(e);
+      }
+    }
+  }
+
   async #readyCb() {
     if (this.#state !== ProducerState.CONNECTING && this.#state !== ProducerState.INITIALIZED_TRANSACTIONS) {
       /* The connectPromiseFunc might not be set, so we throw such an error. It's a state error that we can't recover from. Probably a bug. */
@@ -276,18 +346,17 @@ class Producer {
     }
 
     this.#state = ProducerState.CONNECTED;
+    this.#opaqueIds = !!rdKafkaConfig.dr_opaque_ids;
 
-    /* Start a loop to poll. the queues. */
-    const pollInterval = setInterval(() => {
-      if (this.#state >= ProducerState.DISCONNECTING) {
-        clearInterval(pollInterval);
-        return;
-      }
-      this.#internalClient.poll();
-      this.#lastPollTime = hrtime();
-    }, producerPollIntervalMs);
+    /* Serve the queues from a native thread, delivery reports are then
+     * picked up as soon as they arrive rather than on the next tick of a timer. */
+    this.#internalClient.setPollInBackground(true);
 
-    this.#internalClient.on('delivery-report', this.#deliveryCallback.bind(this));
+    if (rdKafkaConfig.dr_batch_size) {
+      this.#internalClient.on('delivery-report-batch', this.#deliveryBatchCallback.bind(this));
+    } else {
+      this.#internalClient.on('delivery-report', this.#deliveryCallback.bind(this));
+    }
 
     // Resolve the promise.
     this.#connectPromiseFunc["resolve"]();
@@ -537,6 +606,7 @@ class Producer {
     }
 
     const msgPromises = [];
+    const batch = [];
     for (let i = 0; i < sendOptions.messages.length; i++) {
       const msg = sendOptions.messages[i];
 
@@ -544,10 +614,6 @@ class Producer {
         msg.partition = -1;
       }
 
-      if (typeof msg.value === 'string') {
-        msg.value = Buffer.from(msg.value);
-      }
-
       if (Object.hasOwn(msg, "timestamp") && msg.timestamp) {
         msg.timestamp = Number(msg.timestamp);
       } else {
@@ -557,23 +623,36 @@ class Producer {
       msg.headers = convertToRdKafkaHeaders(msg.headers);
 
       msgPromises.push(new Promise((resolve, reject) => {
-        const opaque = { resolve, reject };
-        try {
-          this.#internalClient.produce(sendOptions.topic, msg.partition, msg.value, msg.key, msg.timestamp, opaque, msg.headers);
-        } catch (err) {
-          reject(err);
+        let opaque = { resolve, reject };
+        if (this.#opaqueIds) {
+          const id = this.#nextDeliveryId++;
+          this.#pendingDeliveries.set(id, opaque);
+          opaque = id;
         }
+        batch.push({
+          value: msg.value,
+          key: msg.key,
+          partition: msg.partition,
+          timestamp: msg.timestamp,
+          headers: msg.headers,
+          opaque,
+        });
       }));
+    }
 
-      /* Poll if we haven't polled in a while. This can be the case if we're producing
-      * in a tight loop without awaiting the produce. */
-      const elapsed = hrtime(this.#lastPollTime);
-      const elapsedInNanos = elapsed[0] * 1e9 + elapsed[1];
-      if (elapsedInNanos > producerPollIntervalMs * 1000) {
-        this.#lastPollTime = hrtime();
-        this.#internalClient.poll();
+    /* The whole send is handed to librdkafka at once, messages which couldn't be
+     * enqueued will never get a delivery report, so they are rejected here. */
+    try {
+      const errorCodes = this.#internalClient.produceBatch(sendOptions.topic, batch);
+      for (let i = 0; i < errorCodes.length; i++) {
+        if (errorCodes[i] !== error.ErrorCodes.ERR_NO_ERROR) {
+          this.#takeDelivery(batch[i].opaque).reject(createKafkaJsErrorFromLibRdKafkaError(LibrdKafkaError.create(errorCodes[i])));
+        }
+      }
+    } catch (err) {
+      for (const msg of batch) {
+        this.#takeDelivery(msg.opaque).reject(err);
       }
-
     }
 
     /* The delivery report will be handled by the delivery-report event handler, and we can simply wait for it here. */
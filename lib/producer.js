@@ -15,6 +15,7 @@ var Client = require('./client');
 var util = require('util');
 var Kafka = require('../librdkafka.js');
 var ProducerStream = require('./producer-stream');
+var ProduceChannel = require('./producer/produce-channel');
 var LibrdKafkaError = require('./error');
 var shallowCopy = require('./util').shallowCopy;
 
@@ -63,6 +64,12 @@ function Producer(conf, topicConf) {
   var gPart = conf.partition || null;
   var dr_cb = conf.dr_cb || null;
   var dr_msg_cb = conf.dr_msg_cb || null;
+  var zero_copy = conf.zero_copy_produce || false;
+  var dr_batch_size = conf.dr_batch_size || 0;
+  var dr_backlog_max = conf.dr_backlog_max || 0;
+  var dr_backlog_max_bytes = conf.dr_backlog_max_bytes || 0;
+  var dr_opaque_ids = conf.dr_opaque_ids || false;
+  var shared_handle = conf.shared_handle || false;
 
   // delete keys we don't want to pass on
   delete conf.topic;
@@ -70,6 +77,12 @@ function Producer(conf, topicConf) {
 
   delete conf.dr_cb;
   delete conf.dr_msg_cb;
+  delete conf.zero_copy_produce;
+  delete conf.dr_batch_size;
+  delete conf.dr_backlog_max;
+  delete conf.dr_backlog_max_bytes;
+  delete conf.dr_opaque_ids;
+  delete conf.shared_handle;
 
   // client is an initialized producer object
   // @see NodeKafka::Producer::Init
@@ -85,14 +98,42 @@ function Producer(conf, topicConf) {
 
   this.pollInterval = undefined;
 
-  if (dr_msg_cb || dr_cb) {
-    this._cb_configs.event.delivery_cb =  function(err, report) {
-      if (err) {
-        err = LibrdKafkaError.create(err);
-      }
-      this.emit('delivery-report', err, report);
-    }.bind(this);
+  // Producers of the thread with the same configuration connect through
+  // one librdkafka instance, each with its own delivery reports.
+  if (shared_handle) {
+    this._client.setSharedHandle(true);
+  }
+
+  // Zero copy mode needs delivery reports even without listeners, because
+  // that is where the payload buffers are released.
+  if (dr_msg_cb || dr_cb || zero_copy || dr_batch_size) {
+    if (dr_batch_size) {
+      this._cb_configs.event.delivery_cb = this._onDeliveryReportBatch.bind(this);
+    } else {
+      this._cb_configs.event.delivery_cb =  function(err, report) {
+        if (err) {
+          err = LibrdKafkaError.create(err);
+        }
+        this.emit('delivery-report', err, report);
+      }.bind(this);
+    }
     this._cb_configs.event.delivery_cb.dr_msg_cb = !!dr_msg_cb;
+    this._cb_configs.event.delivery_cb.zero_copy = !!zero_copy;
+    this._cb_configs.event.delivery_cb.dr_batch_size = dr_batch_size;
+    // Opaques are integer ids handed back as is, rather than arbitrary
+    // values that need a handle kept alive natively for every message.
+    this._cb_configs.event.delivery_cb.opaque_ids = !!dr_opaque_ids;
+
+    // Once dr_backlog_max reports or dr_backlog_max_bytes of them wait for
+    // the event loop, produce fails with ERR__QUEUE_FULL until the backlog
+    // is down to half, which is signalled with a 'drain' event.
+    if (dr_backlog_max || dr_backlog_max_bytes) {
+      this._cb_configs.event.delivery_cb.dr_backlog_max = dr_backlog_max;
+      this._cb_configs.event.delivery_cb.dr_backlog_max_bytes = dr_backlog_max_bytes;
+      this._cb_configs.event.drain_cb = function() {
+        this.emit('drain');
+      }.bind(this);
+    }
 
     if (typeof dr_cb === 'function') {
       this.on('delivery-report', dr_cb);
@@ -101,6 +142,61 @@ function Producer(conf, topicConf) {
   }
 }
 
+/**
+ * Batch of delivery reports, emitted with 'delivery-report-batch' when the
+ * producer is configured with dr_batch_size. Entry i of every array belongs
+ * to the same report.
+ *
+ * @typedef {object} Producer~DeliveryReportBatch
+ * @property {string[]} topic - Topic of each report.
+ * @property {Int32Array} partition - Partition of each report.
+ * @property {Float64Array} offset - Offset of each report.
+ * @property {Int32Array} error - Error code of each report, 0 if delivered.
+ * @property {Float64Array} timestamp - Timestamp of each report, or -1.
+ * @property {Array} opaque - Opaque of each report.
+ * @property {Array|undefined} key - Key of each report, with dr_msg_cb.
+ * @property {Array|undefined} value - Value of each report, with dr_msg_cb.
+ */
+
+/**
+ * Handles a batch of delivery reports from the native layer.
+ *
+ * The batch is emitted as is, and only split into individual
+ * 'delivery-report' events when someone listens for those.
+ *
+ * @param {null} err - Always null, errors are reported per message.
+ * @param {Producer~DeliveryReportBatch} batch - The delivery reports.
+ * @private
+ */
+Producer.prototype._onDeliveryReportBatch = function(err, batch) {
+  this.emit('delivery-report-batch', batch);
+
+  if (this.listenerCount('delivery-report') === 0) {
+    return;
+  }
+
+  for (var i = 0; i < batch.topic.length; i++) {
+    var report = {
+      topic: batch.topic[i],
+      partition: batch.partition[i],
+      offset: batch.offset[i],
+      key: batch.key ? batch.key[i] : null,
+    };
+    if (batch.opaque[i] !== undefined) {
+      report.opaque = batch.opaque[i];
+    }
+    if (batch.timestamp[i] > -1) {
+      report.timestamp = batch.timestamp[i];
+    }
+    if (batch.value) {
+      report.value = batch.value[i];
+    }
+
+    var reportErr = batch.error[i] ? LibrdKafkaError.create(batch.error[i]) : null;
+    this.emit('delivery-report', reportErr, report);
+  }
+};
+
 /**
  * Produce a message to Kafka synchronously.
  *
@@ -110,13 +206,26 @@ function Producer(conf, topicConf) {
  * When this is sent off, there is no guarantee it is delivered. If you need
  * guaranteed delivery, change your *acks* settings, or use delivery reports.
  *
+ * If the producer was created with zero_copy_produce, the message buffer is
+ * not copied. It is referenced until its delivery report has been emitted,
+ * and must not be modified until then.
+ *
+ * If the producer was created with dr_opaque_ids, the opaque must be a
+ * non-negative integer, which is handed back in the delivery report without
+ * keeping anything alive for the message in between. Null or undefined
+ * produce the message without an opaque.
+ *
  * @param {string} topic - The topic name to produce to.
  * @param {number|null} partition - The partition number to produce to.
- * @param {Buffer|null} message - The message to produce.
+ * @param {Buffer|string|null} message - The message to produce. Strings are
+ * encoded as UTF-8 natively, straight into memory handed over to librdkafka.
  * @param {string} key - The key associated with the message.
  * @param {number|null} timestamp - Timestamp to send with the message.
  * @param {object} opaque - An object you want passed along with this message, if provided.
  * @param {object} headers - A list of custom key value pairs that provide message metadata.
+ * Either an array of single key objects, `[{ k1: v1 }, { k2: v2 }]`, or a flat
+ * array of alternating keys and values, `[k1, v1, k2, v2]`, which is faster.
+ * Buffer values are sent as they are, other values as UTF-8 strings.
  * @throws {LibrdKafkaError} - Throws a librdkafka error if it failed.
  * @return {boolean} - returns an error if it failed, or true if not
  * @see Producer#produce
@@ -141,6 +250,120 @@ Producer.prototype.produce = function(topic, partition, message, key, timestamp,
 
 };
 
+/**
+ * Produce a batch of messages to a single topic synchronously.
+ *
+ * This is equivalent to calling produce once for every message, but the
+ * whole batch is handed to the native layer in one call. Errors enqueueing
+ * individual messages do not throw, they are reported in the returned array,
+ * and messages which could not be enqueued will not get a delivery report.
+ *
+ * @param {string} topic - The topic name to produce to.
+ * @param {Producer~BatchMessage[]} messages - The messages to produce. Each
+ * message is an object with the optional keys value, key, partition,
+ * timestamp, opaque and headers, taking the same values as the arguments
+ * of produce.
+ * @throws {Error} - Throws if the producer is not connected.
+ * @return {Int32Array} - The error code for each message, in order. An error
+ * code of 0 means the message was enqueued.
+ * @see Producer#produce
+ */
+Producer.prototype.produceBatch = function(topic, messages) {
+  if (!this._isConnected) {
+    throw new Error('Producer not connected');
+  }
+
+  if (!topic || typeof topic !== 'string') {
+    throw new TypeError('"topic" must be a string');
+  }
+
+  if (!Array.isArray(messages)) {
+    throw new TypeError('"messages" must be an array');
+  }
+
+  // The native layer already treats a missing partition as unassigned, so
+  // messages only need to be touched when a default partition is configured.
+  if (this.defaultPartition !== -1) {
+    for (var i = 0; i < messages.length; i++) {
+      var message = messages[i];
+      if (message && message.partition == null) {
+        message.partition = this.defaultPartition;
+      }
+    }
+  }
+
+  this.sentMessages += messages.length;
+
+  return this._client.produceBatch(topic, messages);
+};
+
+/**
+ * Open a produce channel.
+ *
+ * Records written to the channel are framed into shared memory and produced
+ * by a native thread, without a call into the binding per message. Their
+ * delivery reports come back in batches, as 'delivery-reports' events of the
+ * channel, instead of 'delivery-report' events of the producer.
+ *
+ * A producer has at most one channel, which is freed on disconnect. Records
+ * still in it then, because there were no free delivery slots for them, are
+ * not produced.
+ *
+ * @param {object} options - Options of the channel.
+ * @param {string[]} options.topics - Topics records are produced to.
+ * @param {number} [options.bufferSize=4194304] - Bytes in the record ring,
+ * a power of two.
+ * @param {number} [options.deliverySlots=65536] - Number of delivery slots,
+ * a power of two. Bounds the records in flight.
+ * @throws {Error} - Throws if the producer is not connected or already has
+ * a channel.
+ * @return {ProduceChannel} - The channel.
+ * @see ProduceChannel
+ */
+Producer.prototype.openProduceChannel = function(options) {
+  if (!this._isConnected) {
+    throw new Error('Producer not connected');
+  }
+
+  var channel = new ProduceChannel(this._client, options);
+  channel._open();
+
+  this.once('disconnected', function() {
+    channel._disconnected();
+  });
+
+  return channel;
+};
+
+/**
+ * Compute the partition a key is hashed to.
+ *
+ * Uses the same native hashing as the `partitioner` configuration property,
+ * so `murmur2` matches the default partitioner of the Java client. Setting
+ * `partitioner` (and `sticky.partitioning.linger.ms` for keyless messages)
+ * is all that is needed to partition produced messages this way; this is
+ * for when the partition has to be known up front.
+ *
+ * @param {buffer|string} key - The message key.
+ * @param {number} partitionCount - Number of partitions of the topic.
+ * @param {string} [partitioner='murmur2'] - One of `consistent`,
+ * `consistent_random`, `murmur2`, `murmur2_random`, `fnv1a` or
+ * `fnv1a_random`. The `_random` variants only differ for empty or missing keys.
+ * @throws When the key cannot be hashed by the partitioner.
+ * @return {number} - The partition.
+ */
+Producer.partitionForKey = function(key, partitionCount, partitioner) {
+  if (!Buffer.isBuffer(key) && typeof key !== 'string') {
+    throw new TypeError('Key must be a buffer or a string');
+  }
+
+  if (!Number.isInteger(partitionCount) || partitionCount <= 0) {
+    throw new TypeError('Partition count must be a positive integer');
+  }
+
+  return Kafka.partitionForKey(partitioner || 'murmur2', key, partitionCount);
+};
+
 /**
  * Create a write stream interface for a producer.
  *
@@ -230,6 +453,47 @@ Producer.prototype.setPollInterval = function(interval) {
   return this;
 };
 
+/**
+ * Poll for events on a background thread.
+ *
+ * Delivery reports and events are served by a native thread as soon as they
+ * are available, and the event loop is only woken up when there is something
+ * to emit. Unlike setPollInterval this adds no latency and does not wake the
+ * event loop while the producer is idle. Any poll interval is cleared.
+ *
+ * The thread is stopped on disconnect; call this again after reconnecting.
+ *
+ * @param {boolean} set - Whether to poll in the background.
+ *
+ * @return {Producer} - returns itself.
+ */
+Producer.prototype.setPollInBackground = function(set) {
+  if (set) {
+    this.setPollInterval(0);
+  }
+
+  // Only the last call before connecting counts
+  if (this._pollInBackgroundOnReady) {
+    this.removeListener('ready', this._pollInBackgroundOnReady);
+    this._pollInBackgroundOnReady = undefined;
+  }
+
+  if (!this._isConnected) {
+    if (set) {
+      var self = this;
+      this._pollInBackgroundOnReady = function() {
+        self._pollInBackgroundOnReady = undefined;
+        self.setPollInBackground(set);
+      };
+      this.once('ready', this._pollInBackgroundOnReady);
+    }
+    return this;
+  }
+
+  this._client.setPollInBackground(!!set);
+  return this;
+};
+
 /**
  * Flush the producer
  *
@@ -0,0 +1,349 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+module.exports = ProduceChannel;
+
+var util = require('util');
+var os = require('os');
+var EventEmitter = require('events').EventEmitter;
+var LibrdKafkaError = require('../error');
+
+util.inherits(ProduceChannel, EventEmitter);
+
+// Must match src/produce-channel.h
+var HEADER_SIZE = 128;
+var RECORD_HEADER_SIZE = 32;
+var DELIVERY_SIZE = 32;
+var WRAP_MARKER = 0xFFFFFFFF;
+// Indices of the counters in the ring headers, as 32 bit words
+var HEAD = 0;
+var TAIL = 16;
+var PARKED = 17;
+var STATE = 18;
+
+var STATE_FAILED = 2;
+
+var DEFAULT_BUFFER_SIZE = 4 * 1024 * 1024;
+var DEFAULT_DELIVERY_SLOTS = 65536;
+
+var littleEndian = os.endianness() === 'LE';
+
+function isPowerOfTwo(n) {
+  return Number.isInteger(n) && n > 0 && (n & (n - 1)) === 0;
+}
+
+function byteLength(data) {
+  if (data === null || data === undefined) {
+    return -1;
+  }
+  if (Buffer.isBuffer(data)) {
+    return data.length;
+  }
+  if (typeof data === 'string') {
+    return Buffer.byteLength(data);
+  }
+  throw new TypeError('Keys, values and headers must be buffers or strings');
+}
+
+/**
+ * Header names and values as a flat array of alternating entries.
+ */
+function flattenHeaders(headers) {
+  if (headers.length === 0 || typeof headers[0] === 'string') {
+    return headers;
+  }
+
+  var flat = [];
+  for (var i = 0; i < headers.length; i++) {
+    var names = Object.keys(headers[i]);
+    for (var j = 0; j < names.length; j++) {
+      var value = headers[i][names[j]];
+      flat.push(names[j], Buffer.isBuffer(value) || value === null ||
+        value === undefined ? value : String(value));
+    }
+  }
+  return flat;
+}
+
+/**
+ * Produce channel, for producing without calling into the binding.
+ *
+ * Records are framed into a ring buffer shared with a native thread, which
+ * produces them as they come in. Delivery reports come back through a second
+ * ring and are emitted in batches. The binding is only called when the
+ * native thread went to sleep for lack of work.
+ *
+ * Records are keyed by the id produce returns rather than an opaque. At most
+ * as many records are in flight as there are delivery slots; records
+ * written while all of them are taken wait in the ring.
+ *
+ * Create it with Producer#openProduceChannel.
+ *
+ * @param {Client} client - Native producer it produces through.
+ * @param {object} options - Options.
+ * @param {string[]} options.topics - Topics records are produced to.
+ * @param {number} [options.bufferSize=4194304] - Bytes in the record ring,
+ * a power of two. No record may take more than half of it.
+ * @param {number} [options.deliverySlots=65536] - Number of delivery slots,
+ * a power of two.
+ * @extends EventEmitter
+ * @constructor
+ * @see Producer#openProduceChannel
+ */
+function ProduceChannel(client, options) {
+  if (!(this instanceof ProduceChannel)) {
+    return new ProduceChannel(client, options);
+  }
+
+  EventEmitter.call(this);
+
+  options = options || {};
+
+  if (!Array.isArray(options.topics) || options.topics.length === 0) {
+    throw new TypeError('"topics" must be a non-empty array of topic names');
+  }
+
+  var bufferSize = options.bufferSize || DEFAULT_BUFFER_SIZE;
+  var deliverySlots = options.deliverySlots || DEFAULT_DELIVERY_SLOTS;
+
+  if (!isPowerOfTwo(bufferSize) || bufferSize < 1024) {
+    throw new TypeError('"bufferSize" must be a power of two of at least 1024');
+  }
+  if (!isPowerOfTwo(deliverySlots)) {
+    throw new TypeError('"deliverySlots" must be a power of two');
+  }
+
+  this.topics = options.topics.slice();
+  this._topicIndex = new Map();
+  for (var i = 0; i < this.topics.length; i++) {
+    this._topicIndex.set(this.topics[i], i);
+  }
+
+  this._client = client;
+  this._closed = false;
+  this._nextId = 0;
+
+  this._records = new SharedArrayBuffer(HEADER_SIZE + bufferSize);
+  this._recordsHeader = new Int32Array(this._records, 0, HEADER_SIZE / 4);
+  this._recordsView = new DataView(this._records, HEADER_SIZE, bufferSize);
+  this._recordsBuffer = Buffer.from(this._records, HEADER_SIZE, bufferSize);
+  this._capacity = bufferSize;
+  this._head = 0;
+
+  this._deliveries = new SharedArrayBuffer(HEADER_SIZE +
+    deliverySlots * DELIVERY_SIZE);
+  this._deliveriesHeader = new Int32Array(this._deliveries, 0,
+    HEADER_SIZE / 4);
+  this._deliveriesView = new DataView(this._deliveries, HEADER_SIZE);
+  this._deliverySlots = deliverySlots;
+  this._deliveryTail = 0;
+}
+
+/**
+ * Hand the rings to the native thread.
+ *
+ * @private
+ */
+ProduceChannel.prototype._open = function() {
+  var self = this;
+  this._client.openProduceChannel(this._records, this._deliveries,
+    this.topics, function() {
+      self._drain();
+    });
+};
+
+/**
+ * Write a record for the native thread to produce.
+ *
+ * @param {string} topic - One of the topics of the channel.
+ * @param {number|null} partition - Partition, null or -1 to let the
+ * partitioner pick.
+ * @param {Buffer|string|null} value - The message value.
+ * @param {Buffer|string|null} [key] - The message key.
+ * @param {number|null} [timestamp] - Timestamp in milliseconds.
+ * @param {Array} [headers] - Either an array of single key objects,
+ * `[{ k1: v1 }, { k2: v2 }]`, or a flat array of alternating keys and values.
+ * @throws {LibrdKafkaError} - With ERR__QUEUE_FULL when the ring has no room
+ * for the record; wait for delivery reports and try again.
+ * @return {number} - Id of the record, handed back in its delivery report.
+ */
+ProduceChannel.prototype.produce = function(topic, partition, value, key, timestamp, headers) {
+  if (this._closed) {
+    throw new Error('Produce channel is closed');
+  }
+  if (Atomics.load(this._recordsHeader, STATE) === STATE_FAILED) {
+    throw new Error('Produce channel stopped on a malformed record');
+  }
+
+  var topicIndex = this._topicIndex.get(topic);
+  if (topicIndex === undefined) {
+    throw new TypeError('"topic" is not one of the topics of the channel');
+  }
+
+  var keyLength = byteLength(key);
+  var valueLength = byteLength(value);
+  var size = RECORD_HEADER_SIZE + Math.max(keyLength, 0) +
+    Math.max(valueLength, 0);
+
+  var headerCount = 0;
+  if (headers) {
+    headers = flattenHeaders(headers);
+    headerCount = headers.length / 2;
+    if (headerCount > 0xFFFF) {
+      throw new TypeError('A record takes at most 65535 headers');
+    }
+    for (var i = 0; i < headers.length; i += 2) {
+      size += 8 + Buffer.byteLength(headers[i]) +
+        Math.max(byteLength(headers[i + 1]), 0);
+    }
+  }
+
+  var aligned = (size + 7) & ~7;
+  if (aligned > this._capacity / 2) {
+    throw new RangeError('Record is larger than half of the ring');
+  }
+
+  var tail = Atomics.load(this._recordsHeader, TAIL) >>> 0;
+  var free = this._capacity - ((this._head - tail) >>> 0);
+  var position = this._head & (this._capacity - 1);
+  var contiguous = this._capacity - position;
+  // Records never wrap around the end, the rest of it is skipped
+  var skip = contiguous < aligned ? contiguous : 0;
+
+  if (free < skip + aligned) {
+    throw LibrdKafkaError.create(LibrdKafkaError.codes.ERR__QUEUE_FULL);
+  }
+
+  var view = this._recordsView;
+  if (skip > 0) {
+    view.setUint32(position, WRAP_MARKER, littleEndian);
+    position = 0;
+  }
+
+  var id = this._nextId;
+  this._nextId = (id + 1) >>> 0;
+
+  view.setUint32(position, size, littleEndian);
+  view.setUint32(position + 4, id, littleEndian);
+  view.setUint16(position + 8, topicIndex, littleEndian);
+  view.setUint16(position + 10, headerCount, littleEndian);
+  view.setInt32(position + 12, partition == null ? -1 : partition,
+    littleEndian);
+  view.setInt32(position + 16, keyLength, littleEndian);
+  view.setInt32(position + 20, valueLength, littleEndian);
+  view.setFloat64(position + 24, timestamp || 0, littleEndian);
+
+  var offset = position + RECORD_HEADER_SIZE;
+  offset = this._writeData(offset, key, keyLength);
+  offset = this._writeData(offset, value, valueLength);
+
+  for (var j = 0; j < headerCount * 2; j += 2) {
+    var nameLength = Buffer.byteLength(headers[j]);
+    var headerLength = byteLength(headers[j + 1]);
+    view.setUint32(offset, nameLength, littleEndian);
+    view.setInt32(offset + 4, headerLength, littleEndian);
+    offset = this._writeData(offset + 8, headers[j], nameLength);
+    offset = this._writeData(offset, headers[j + 1], headerLength);
+  }
+
+  this._head = (this._head + skip + aligned) >>> 0;
+  this._publish(this._recordsHeader, HEAD, this._head);
+
+  return id;
+};
+
+ProduceChannel.prototype._writeData = function(offset, data, length) {
+  if (length <= 0) {
+    return offset;
+  }
+  if (typeof data === 'string') {
+    this._recordsBuffer.write(data, offset, length, 'utf8');
+  } else {
+    data.copy(this._recordsBuffer, offset);
+  }
+  return offset + length;
+};
+
+/**
+ * Publish a counter, and wake the native thread if it waits for one.
+ *
+ * @private
+ */
+ProduceChannel.prototype._publish = function(header, index, value) {
+  Atomics.store(header, index, value | 0);
+  if (Atomics.load(this._recordsHeader, PARKED) === 1) {
+    this._client.wakeProduceChannel();
+  }
+};
+
+/**
+ * Emit the deliveries written since the last call.
+ *
+ * @private
+ */
+ProduceChannel.prototype._drain = function() {
+  var head = Atomics.load(this._deliveriesHeader, HEAD) >>> 0;
+  if (head === this._deliveryTail) {
+    return;
+  }
+
+  var view = this._deliveriesView;
+  var reports = [];
+  var tail = this._deliveryTail;
+
+  while (tail !== head) {
+    var slot = (tail & (this._deliverySlots - 1)) * DELIVERY_SIZE;
+    var err = view.getInt32(slot + 4, littleEndian);
+    reports.push({
+      id: view.getUint32(slot, littleEndian),
+      topic: this.topics[view.getUint32(slot + 12, littleEndian)],
+      partition: view.getInt32(slot + 8, littleEndian),
+      offset: view.getFloat64(slot + 16, littleEndian),
+      timestamp: view.getFloat64(slot + 24, littleEndian),
+      error: err ? LibrdKafkaError.create(err) : null
+    });
+    tail = (tail + 1) >>> 0;
+  }
+
+  this._deliveryTail = tail;
+  // The native thread may be waiting for free slots
+  this._publish(this._deliveriesHeader, TAIL, tail);
+
+  this.emit('delivery-reports', reports);
+};
+
+/**
+ * Stop producing from the channel.
+ *
+ * Blocks until the native thread produced what was written before, as far
+ * as there are delivery slots for it. Delivery reports keep coming until the
+ * producer disconnects.
+ *
+ * @return {boolean} - Whether every record written was produced.
+ */
+ProduceChannel.prototype.close = function() {
+  if (!this._closed) {
+    this._closed = true;
+    this._client.closeProduceChannel();
+  }
+  this._drain();
+
+  return (Atomics.load(this._recordsHeader, TAIL) >>> 0) === this._head;
+};
+
+/**
+ * Called once the producer disconnected. Nothing is produced anymore.
+ *
+ * @private
+ */
+ProduceChannel.prototype._disconnected = function() {
+  this._closed = true;
+  this._drain();
+};
@@ -17,6 +17,22 @@ var Topic = require('./topic');
 var Admin = require('./admin');
 var features = lib.features().split(',');
 
+/**
+ * Set the number of native threads that run the blocking operations of all
+ * clients, like `consume(n)`, `flush`, `getMetadata` or the transaction
+ * calls. They get their own threads so they do not starve the libuv
+ * threadpool used by `fs`, `dns` and `crypto`.
+ *
+ * @param {number} size - Number of threads, 4 by default. 0 runs the
+ * operations on the libuv threadpool instead.
+ */
+function setWorkerPoolSize(size) {
+  if (typeof size !== 'number' || size < 0 || Math.floor(size) !== size) {
+    throw new TypeError('"size" must be a non-negative integer');
+  }
+  lib.setWorkerPoolSize(size);
+}
+
 module.exports = {
   Consumer: util.deprecate(KafkaConsumer, 'Use KafkaConsumer instead. This may be changed in a later version'),
   Producer: Producer,
@@ -31,4 +47,5 @@ module.exports = {
   Topic: Topic,
   features: features,
   librdkafkaVersion: lib.librdkafkaVersion,
+  setWorkerPoolSize: setWorkerPoolSize,
 }
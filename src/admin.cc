@@ -9,10 +9,12 @@
  */
 
 #include <string>
+#include <unordered_set>
 #include <vector>
 #include <math.h>
 
 #include "src/workers.h"
+#include "src/worker-pool.h"
 #include "src/admin.h"
 
 using Nan::FunctionCallbackInfo;
@@ -30,12 +32,46 @@ namespace NodeKafka {
  */
 
 AdminClient::AdminClient(Conf* gconfig):
-  Connection(gconfig, NULL) {
+  Connection(gconfig, NULL),
+  m_shared_queue(false),
+  m_dispatcher_running(false),
+  m_in_flight(0) {
     rkqu = NULL;
+
+    uv_mutex_init(&m_results_lock);
+    m_results_async = new uv_async_t;
+    uv_async_init(Nan::GetCurrentEventLoop(), m_results_async,
+      CompleteResults);
+    m_results_async->data = this;
+    uv_unref(reinterpret_cast<uv_handle_t*>(m_results_async));
 }
 
 AdminClient::~AdminClient() {
   Disconnect();
+  CloseResults();
+
+  uv_mutex_destroy(&m_results_lock);
+}
+
+void AdminClient::Teardown() {
+  Disconnect();
+  CloseResults();
+}
+
+void AdminClient::CloseResults() {
+  if (m_results_async == NULL) {
+    return;
+  }
+
+  uv_close(reinterpret_cast<uv_handle_t*>(m_results_async),
+           ResultsAsyncCloseCallback);
+  m_results_async = NULL;
+
+  // Nothing can be called back anymore, just let go of what is left
+  for (size_t i = 0; i < m_completed.size(); i++) {
+    delete m_completed[i];
+  }
+  m_completed.clear();
 }
 
 Baton AdminClient::Connect() {
@@ -68,6 +104,10 @@ Baton AdminClient::Connect() {
     rkqu = rd_kafka_queue_new(m_client->c_ptr());
   }
 
+  if (m_shared_queue) {
+    StartDispatcher();
+  }
+
   baton = setupSaslOAuthBearerBackgroundQueue();
   if (baton.err() != RdKafka::ERR_NO_ERROR) {
     DeactivateDispatchers();
@@ -80,6 +120,8 @@ Baton AdminClient::Disconnect() {
   if (IsConnected()) {
     scoped_shared_write_lock lock(m_connection_lock);
 
+    StopDispatcher();
+
     if (rkqu != NULL) {
       rd_kafka_queue_destroy(rkqu);
       rkqu = NULL;
@@ -87,6 +129,9 @@ Baton AdminClient::Disconnect() {
 
     DeactivateDispatchers();
 
+    ClearTopicCache();
+    // Stale once disconnected, the next refresh must not diff against it
+    m_metadata_cache.Clear();
     delete m_client;
     m_client = NULL;
   }
@@ -94,7 +139,7 @@ Baton AdminClient::Disconnect() {
   return Baton(RdKafka::ERR_NO_ERROR);
 }
 
-Nan::Persistent<v8::Function> AdminClient::constructor;
+PerIsolateFunction AdminClient::constructor;
 
 void AdminClient::Init(v8::Local<v8::Object> exports) {
   Nan::HandleScope scope;
@@ -105,6 +150,11 @@ void AdminClient::Init(v8::Local<v8::Object> exports) {
 
   // Inherited from NodeKafka::Connection
   Nan::SetPrototypeMethod(tpl, "configureCallbacks", NodeConfigureCallbacks);
+  Nan::SetPrototypeMethod(tpl, "setStatsFields", NodeSetStatsFields);
+  Nan::SetPrototypeMethod(tpl, "getNativeMetrics", NodeGetNativeMetrics);
+  Nan::SetPrototypeMethod(tpl, "setLatencyHistograms", NodeSetLatencyHistograms);  // NOLINT
+  Nan::SetPrototypeMethod(tpl, "getLatencyHistograms", NodeGetLatencyHistograms);  // NOLINT
+  Nan::SetPrototypeMethod(tpl, "resetLatencyHistograms", NodeResetLatencyHistograms);  // NOLINT
   Nan::SetPrototypeMethod(tpl, "name", NodeName);
 
   // Admin client operations
@@ -117,10 +167,13 @@ void AdminClient::Init(v8::Local<v8::Object> exports) {
   Nan::SetPrototypeMethod(tpl, "describeGroups", NodeDescribeGroups);
   Nan::SetPrototypeMethod(tpl, "deleteGroups", NodeDeleteGroups);
 
+  Nan::SetPrototypeMethod(tpl, "setSharedQueue", NodeSetSharedQueue);
   Nan::SetPrototypeMethod(tpl, "connect", NodeConnect);
   Nan::SetPrototypeMethod(tpl, "disconnect", NodeDisconnect);
   Nan::SetPrototypeMethod(tpl, "setSaslCredentials", NodeSetSaslCredentials);
   Nan::SetPrototypeMethod(tpl, "getMetadata", NodeGetMetadata);
+  Nan::SetPrototypeMethod(tpl, "refreshMetadataCache", NodeRefreshMetadataCache);  // NOLINT
+  Nan::SetPrototypeMethod(tpl, "getCachedTopicMetadata", NodeGetCachedTopicMetadata);  // NOLINT
   Nan::SetPrototypeMethod(tpl, "setOAuthBearerToken", NodeSetOAuthBearerToken);
   Nan::SetPrototypeMethod(tpl, "setOAuthBearerTokenFailure",
                           NodeSetOAuthBearerTokenFailure);
@@ -172,7 +225,7 @@ v8::Local<v8::Object> AdminClient::NewInstance(v8::Local<v8::Value> arg) {
   const unsigned argc = 1;
 
   v8::Local<v8::Value> argv[argc] = { arg };
-  v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+  v8::Local<v8::Function> cons = constructor.Get();
   v8::Local<v8::Object> instance =
     Nan::NewInstance(cons, argc, argv).ToLocalChecked();
 
@@ -227,153 +280,256 @@ rd_kafka_event_t* PollForEvent(
   return event_response;
 }
 
-Baton AdminClient::CreateTopic(rd_kafka_NewTopic_t* topic, int timeout_ms) {
-  if (!IsConnected()) {
-    return Baton(RdKafka::ERR__STATE);
-  }
+/**
+ * Run a request on a queue of its own and wait for its result.
+ *
+ * @param start - Issues the request on the queue it is given.
+ */
+template <typename Start>
+static Baton RunOnPrivateQueue(rd_kafka_t* rk, rd_kafka_event_type_t type,
+                               int timeout_ms, Start start,
+                               rd_kafka_event_t** event_response) {
+  rd_kafka_queue_t* queue = rd_kafka_queue_new(rk);
 
-  {
-    scoped_shared_write_lock lock(m_connection_lock);
-    if (!IsConnected()) {
-      return Baton(RdKafka::ERR__STATE);
+  Baton b = start(queue);
+  if (b.err() == RdKafka::ERR_NO_ERROR) {
+    *event_response = PollForEvent(queue, type, timeout_ms);
+
+    // If we got no response from that operation, this is a failure
+    // likely due to time out
+    if (*event_response == NULL) {
+      b = Baton(RdKafka::ERR__TIMED_OUT);
     }
+  }
 
-    // Make admin options to establish that we are creating topics
-    rd_kafka_AdminOptions_t *options = rd_kafka_AdminOptions_new(
-      m_client->c_ptr(), RD_KAFKA_ADMIN_OP_CREATETOPICS);
+  rd_kafka_queue_destroy(queue);
+  return b;
+}
 
-    // Create queue just for this operation
-    rd_kafka_queue_t * topic_rkqu = rd_kafka_queue_new(m_client->c_ptr());
+/**
+ * Make admin options for op, with the request timeout set so librdkafka
+ * always delivers a result, even on the shared result queue which is never
+ * polled with a deadline.
+ */
+static Baton NewAdminOptions(rd_kafka_t* rk, rd_kafka_admin_op_t op,
+                             int timeout_ms, void* opaque,
+                             rd_kafka_AdminOptions_t** options) {
+  *options = rd_kafka_AdminOptions_new(rk, op);
+
+  char errstr[512];
+  rd_kafka_resp_err_t err = rd_kafka_AdminOptions_set_request_timeout(
+      *options, timeout_ms, errstr, sizeof(errstr));
+  if (err != RD_KAFKA_RESP_ERR_NO_ERROR) {
+    rd_kafka_AdminOptions_destroy(*options);
+    *options = NULL;
+    return Baton(static_cast<RdKafka::ErrorCode>(err), errstr);
+  }
 
-    rd_kafka_CreateTopics(m_client->c_ptr(), &topic, 1, options, topic_rkqu);
+  rd_kafka_AdminOptions_set_opaque(*options, opaque);
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
 
-    // Poll for an event by type in that queue
-    rd_kafka_event_t * event_response = PollForEvent(
-      topic_rkqu,
-      RD_KAFKA_EVENT_CREATETOPICS_RESULT,
-      timeout_ms);
+/**
+ * Check that event is a result of the given type that did not fail.
+ */
+static Baton EventToBaton(rd_kafka_event_t* event,
+                          rd_kafka_event_type_t type) {
+  if (event == NULL) {
+    return Baton(RdKafka::ERR__TIMED_OUT);
+  }
 
-    // Destroy the queue since we are done with it.
-    rd_kafka_queue_destroy(topic_rkqu);
+  if (rd_kafka_event_type(event) != type) {
+    return Baton(RdKafka::ERR__INVALID_TYPE);
+  }
 
-    // Destroy the options we just made because we polled already
-    rd_kafka_AdminOptions_destroy(options);
+  // Now we can get the error code from the event
+  if (rd_kafka_event_error(event)) {
+    // If we had a special error code, get out of here with it
+    const rd_kafka_resp_err_t errcode = rd_kafka_event_error(event);
+    return Baton(static_cast<RdKafka::ErrorCode>(errcode));
+  }
 
-    // If we got no response from that operation, this is a failure
-    // likely due to time out
-    if (event_response == NULL) {
-      return Baton(RdKafka::ERR__TIMED_OUT);
-    }
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
 
-    // Now we can get the error code from the event
-    if (rd_kafka_event_error(event_response)) {
-      // If we had a special error code, get out of here with it
-      const rd_kafka_resp_err_t errcode = rd_kafka_event_error(event_response);
-      rd_kafka_event_destroy(event_response);
+/**
+ * Turn the first failed topic of a topic operation into a baton.
+ */
+static Baton TopicResultsToBaton(const rd_kafka_topic_result_t** restopics,
+                                 size_t topic_count) {
+  for (size_t i = 0 ; i < topic_count ; i++) {
+    const rd_kafka_topic_result_t *terr = restopics[i];
+    const rd_kafka_resp_err_t errcode = rd_kafka_topic_result_error(terr);
+    const char *errmsg = rd_kafka_topic_result_error_string(terr);
+
+    if (errcode != RD_KAFKA_RESP_ERR_NO_ERROR) {
+      if (errmsg) {
+        return Baton(static_cast<RdKafka::ErrorCode>(errcode),
+                     std::string(errmsg));
+      }
       return Baton(static_cast<RdKafka::ErrorCode>(errcode));
     }
+  }
 
-    // get the created results
-    const rd_kafka_CreateTopics_result_t * create_topic_results =
-      rd_kafka_event_CreateTopics_result(event_response);
-
-    size_t created_topic_count;
-    const rd_kafka_topic_result_t **restopics = rd_kafka_CreateTopics_result_topics(  // NOLINT
-      create_topic_results,
-      &created_topic_count);
-
-    for (int i = 0 ; i < static_cast<int>(created_topic_count) ; i++) {
-      const rd_kafka_topic_result_t *terr = restopics[i];
-      const rd_kafka_resp_err_t errcode = rd_kafka_topic_result_error(terr);
-      const char *errmsg = rd_kafka_topic_result_error_string(terr);
-
-      if (errcode != RD_KAFKA_RESP_ERR_NO_ERROR) {
-        if (errmsg) {
-          const std::string errormsg = std::string(errmsg);
-          rd_kafka_event_destroy(event_response);
-          return Baton(static_cast<RdKafka::ErrorCode>(errcode), errormsg); // NOLINT
-        } else {
-          rd_kafka_event_destroy(event_response);
-          return Baton(static_cast<RdKafka::ErrorCode>(errcode));
-        }
-      }
-    }
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
 
-    rd_kafka_event_destroy(event_response);
-    return Baton(RdKafka::ERR_NO_ERROR);
+Baton AdminClient::StartCreateTopic(rd_kafka_NewTopic_t* topic, int timeout_ms,
+                                    rd_kafka_queue_t* queue, void* opaque) {
+  // Make admin options to establish that we are creating topics
+  rd_kafka_AdminOptions_t *options;
+  Baton b = NewAdminOptions(m_client->c_ptr(), RD_KAFKA_ADMIN_OP_CREATETOPICS,
+                            timeout_ms, opaque, &options);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return b;
   }
+
+  rd_kafka_CreateTopics(m_client->c_ptr(), &topic, 1, options, queue);
+
+  // librdkafka keeps a copy of the options for the request
+  rd_kafka_AdminOptions_destroy(options);
+  return Baton(RdKafka::ERR_NO_ERROR);
 }
 
-Baton AdminClient::DeleteTopic(rd_kafka_DeleteTopic_t* topic, int timeout_ms) {
+Baton AdminClient::CreateTopicResult(rd_kafka_event_t* event) {
+  Baton b = EventToBaton(event, RD_KAFKA_EVENT_CREATETOPICS_RESULT);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return b;
+  }
+
+  // get the created results
+  const rd_kafka_CreateTopics_result_t * create_topic_results =
+    rd_kafka_event_CreateTopics_result(event);
+
+  size_t created_topic_count;
+  const rd_kafka_topic_result_t **restopics = rd_kafka_CreateTopics_result_topics(  // NOLINT
+    create_topic_results,
+    &created_topic_count);
+
+  return TopicResultsToBaton(restopics, created_topic_count);
+}
+
+Baton AdminClient::CreateTopic(rd_kafka_NewTopic_t* topic, int timeout_ms) {
   if (!IsConnected()) {
     return Baton(RdKafka::ERR__STATE);
   }
 
-  {
-    scoped_shared_write_lock lock(m_connection_lock);
-    if (!IsConnected()) {
-      return Baton(RdKafka::ERR__STATE);
-    }
+  scoped_shared_write_lock lock(m_connection_lock);
+  if (!IsConnected()) {
+    return Baton(RdKafka::ERR__STATE);
+  }
 
-    // Make admin options to establish that we are deleting topics
-    rd_kafka_AdminOptions_t *options = rd_kafka_AdminOptions_new(
-      m_client->c_ptr(), RD_KAFKA_ADMIN_OP_DELETETOPICS);
+  rd_kafka_event_t* event_response = NULL;
+  Baton b = RunOnPrivateQueue(m_client->c_ptr(),
+    RD_KAFKA_EVENT_CREATETOPICS_RESULT, timeout_ms,
+    [&](rd_kafka_queue_t* queue) {
+      return StartCreateTopic(topic, timeout_ms, queue, NULL);
+    }, &event_response);
 
-    // Create queue just for this operation.
-    // May be worth making a "scoped queue" class or something like a lock
-    // for RAII
-    rd_kafka_queue_t * topic_rkqu = rd_kafka_queue_new(m_client->c_ptr());
+  if (b.err() == RdKafka::ERR_NO_ERROR) {
+    b = CreateTopicResult(event_response);
+  }
 
-    rd_kafka_DeleteTopics(m_client->c_ptr(), &topic, 1, options, topic_rkqu);
+  rd_kafka_event_destroy(event_response);
+  return b;
+}
 
-    // Poll for an event by type in that queue
-    rd_kafka_event_t * event_response = PollForEvent(
-      topic_rkqu,
-      RD_KAFKA_EVENT_DELETETOPICS_RESULT,
-      timeout_ms);
+Baton AdminClient::StartDeleteTopic(rd_kafka_DeleteTopic_t* topic,
+                                    int timeout_ms, rd_kafka_queue_t* queue,
+                                    void* opaque) {
+  // Make admin options to establish that we are deleting topics
+  rd_kafka_AdminOptions_t *options;
+  Baton b = NewAdminOptions(m_client->c_ptr(), RD_KAFKA_ADMIN_OP_DELETETOPICS,
+                            timeout_ms, opaque, &options);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return b;
+  }
 
-    // Destroy the queue since we are done with it.
-    rd_kafka_queue_destroy(topic_rkqu);
+  rd_kafka_DeleteTopics(m_client->c_ptr(), &topic, 1, options, queue);
 
-    // Destroy the options we just made because we polled already
-    rd_kafka_AdminOptions_destroy(options);
+  rd_kafka_AdminOptions_destroy(options);
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
 
-    // If we got no response from that operation, this is a failure
-    // likely due to time out
-    if (event_response == NULL) {
-      return Baton(RdKafka::ERR__TIMED_OUT);
-    }
+Baton AdminClient::DeleteTopicResult(rd_kafka_event_t* event) {
+  Baton b = EventToBaton(event, RD_KAFKA_EVENT_DELETETOPICS_RESULT);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return b;
+  }
 
-    // Now we can get the error code from the event
-    if (rd_kafka_event_error(event_response)) {
-      // If we had a special error code, get out of here with it
-      const rd_kafka_resp_err_t errcode = rd_kafka_event_error(event_response);
-      rd_kafka_event_destroy(event_response);
-      return Baton(static_cast<RdKafka::ErrorCode>(errcode));
-    }
+  // get the deleted results
+  const rd_kafka_DeleteTopics_result_t * delete_topic_results =
+    rd_kafka_event_DeleteTopics_result(event);
+
+  size_t deleted_topic_count;
+  const rd_kafka_topic_result_t **restopics = rd_kafka_DeleteTopics_result_topics(  // NOLINT
+    delete_topic_results,
+    &deleted_topic_count);
 
-    // get the created results
-    const rd_kafka_DeleteTopics_result_t * delete_topic_results =
-      rd_kafka_event_DeleteTopics_result(event_response);
+  return TopicResultsToBaton(restopics, deleted_topic_count);
+}
 
-    size_t deleted_topic_count;
-    const rd_kafka_topic_result_t **restopics = rd_kafka_DeleteTopics_result_topics(  // NOLINT
-      delete_topic_results,
-      &deleted_topic_count);
+Baton AdminClient::DeleteTopic(rd_kafka_DeleteTopic_t* topic, int timeout_ms) {
+  if (!IsConnected()) {
+    return Baton(RdKafka::ERR__STATE);
+  }
 
-    for (int i = 0 ; i < static_cast<int>(deleted_topic_count) ; i++) {
-      const rd_kafka_topic_result_t *terr = restopics[i];
-      const rd_kafka_resp_err_t errcode = rd_kafka_topic_result_error(terr);
+  scoped_shared_write_lock lock(m_connection_lock);
+  if (!IsConnected()) {
+    return Baton(RdKafka::ERR__STATE);
+  }
 
-      if (errcode != RD_KAFKA_RESP_ERR_NO_ERROR) {
-        rd_kafka_event_destroy(event_response);
-        return Baton(static_cast<RdKafka::ErrorCode>(errcode));
-      }
-    }
+  rd_kafka_event_t* event_response = NULL;
+  Baton b = RunOnPrivateQueue(m_client->c_ptr(),
+    RD_KAFKA_EVENT_DELETETOPICS_RESULT, timeout_ms,
+    [&](rd_kafka_queue_t* queue) {
+      return StartDeleteTopic(topic, timeout_ms, queue, NULL);
+    }, &event_response);
 
-    rd_kafka_event_destroy(event_response);
-    return Baton(RdKafka::ERR_NO_ERROR);
+  if (b.err() == RdKafka::ERR_NO_ERROR) {
+    b = DeleteTopicResult(event_response);
   }
+
+  rd_kafka_event_destroy(event_response);
+  return b;
+}
+
+Baton AdminClient::StartCreatePartitions(rd_kafka_NewPartitions_t* partitions,
+                                         int timeout_ms,
+                                         rd_kafka_queue_t* queue,
+                                         void* opaque) {
+  // Make admin options to establish that we are creating partitions
+  rd_kafka_AdminOptions_t *options;
+  Baton b = NewAdminOptions(m_client->c_ptr(),
+                            RD_KAFKA_ADMIN_OP_CREATEPARTITIONS, timeout_ms,
+                            opaque, &options);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return b;
+  }
+
+  rd_kafka_CreatePartitions(m_client->c_ptr(),
+    &partitions, 1, options, queue);
+
+  rd_kafka_AdminOptions_destroy(options);
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
+
+Baton AdminClient::CreatePartitionsResult(rd_kafka_event_t* event) {
+  Baton b = EventToBaton(event, RD_KAFKA_EVENT_CREATEPARTITIONS_RESULT);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return b;
+  }
+
+  // get the created results
+  const rd_kafka_CreatePartitions_result_t * create_partitions_results =
+    rd_kafka_event_CreatePartitions_result(event);
+
+  size_t created_partitions_topic_count;
+  const rd_kafka_topic_result_t **restopics = rd_kafka_CreatePartitions_result_topics(  // NOLINT
+    create_partitions_results,
+    &created_partitions_topic_count);
+
+  return TopicResultsToBaton(restopics, created_partitions_topic_count);
 }
 
 Baton AdminClient::CreatePartitions(
@@ -383,79 +539,59 @@ Baton AdminClient::CreatePartitions(
     return Baton(RdKafka::ERR__STATE);
   }
 
-  {
-    scoped_shared_write_lock lock(m_connection_lock);
-    if (!IsConnected()) {
-      return Baton(RdKafka::ERR__STATE);
-    }
-
-    // Make admin options to establish that we are deleting topics
-    rd_kafka_AdminOptions_t *options = rd_kafka_AdminOptions_new(
-      m_client->c_ptr(), RD_KAFKA_ADMIN_OP_CREATEPARTITIONS);
-
-    // Create queue just for this operation.
-    // May be worth making a "scoped queue" class or something like a lock
-    // for RAII
-    rd_kafka_queue_t * topic_rkqu = rd_kafka_queue_new(m_client->c_ptr());
+  scoped_shared_write_lock lock(m_connection_lock);
+  if (!IsConnected()) {
+    return Baton(RdKafka::ERR__STATE);
+  }
 
-    rd_kafka_CreatePartitions(m_client->c_ptr(),
-      &partitions, 1, options, topic_rkqu);
+  rd_kafka_event_t* event_response = NULL;
+  Baton b = RunOnPrivateQueue(m_client->c_ptr(),
+    RD_KAFKA_EVENT_CREATEPARTITIONS_RESULT, timeout_ms,
+    [&](rd_kafka_queue_t* queue) {
+      return StartCreatePartitions(partitions, timeout_ms, queue, NULL);
+    }, &event_response);
 
-    // Poll for an event by type in that queue
-    rd_kafka_event_t * event_response = PollForEvent(
-      topic_rkqu,
-      RD_KAFKA_EVENT_CREATEPARTITIONS_RESULT,
-      timeout_ms);
+  if (b.err() == RdKafka::ERR_NO_ERROR) {
+    b = CreatePartitionsResult(event_response);
+  }
 
-    // Destroy the queue since we are done with it.
-    rd_kafka_queue_destroy(topic_rkqu);
+  rd_kafka_event_destroy(event_response);
+  return b;
+}
 
-    // Destroy the options we just made because we polled already
-    rd_kafka_AdminOptions_destroy(options);
+Baton AdminClient::StartListGroups(
+    bool is_match_states_set,
+    std::vector<rd_kafka_consumer_group_state_t> &match_states, int timeout_ms,
+    rd_kafka_queue_t* queue, void* opaque) {
+  // Make admin options to establish that we are listing groups
+  rd_kafka_AdminOptions_t *options;
+  Baton b = NewAdminOptions(m_client->c_ptr(),
+                            RD_KAFKA_ADMIN_OP_LISTCONSUMERGROUPS, timeout_ms,
+                            opaque, &options);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return b;
+  }
 
-    // If we got no response from that operation, this is a failure
-    // likely due to time out
-    if (event_response == NULL) {
-      return Baton(RdKafka::ERR__TIMED_OUT);
+  if (is_match_states_set) {
+    rd_kafka_error_t *error =
+        rd_kafka_AdminOptions_set_match_consumer_group_states(
+            options, &match_states[0], match_states.size());
+    if (error) {
+      rd_kafka_AdminOptions_destroy(options);
+      return Baton::BatonFromErrorAndDestroy(error);
     }
+  }
 
-    // Now we can get the error code from the event
-    if (rd_kafka_event_error(event_response)) {
-      // If we had a special error code, get out of here with it
-      const rd_kafka_resp_err_t errcode = rd_kafka_event_error(event_response);
-      rd_kafka_event_destroy(event_response);
-      return Baton(static_cast<RdKafka::ErrorCode>(errcode));
-    }
+  rd_kafka_ListConsumerGroups(m_client->c_ptr(), options, queue);
 
-    // get the created results
-    const rd_kafka_CreatePartitions_result_t * create_partitions_results =
-      rd_kafka_event_CreatePartitions_result(event_response);
-
-    size_t created_partitions_topic_count;
-    const rd_kafka_topic_result_t **restopics = rd_kafka_CreatePartitions_result_topics(  // NOLINT
-      create_partitions_results,
-      &created_partitions_topic_count);
-
-    for (int i = 0 ; i < static_cast<int>(created_partitions_topic_count) ; i++) {  // NOLINT
-      const rd_kafka_topic_result_t *terr = restopics[i];
-      const rd_kafka_resp_err_t errcode = rd_kafka_topic_result_error(terr);
-      const char *errmsg = rd_kafka_topic_result_error_string(terr);
-
-      if (errcode != RD_KAFKA_RESP_ERR_NO_ERROR) {
-        if (errmsg) {
-          const std::string errormsg = std::string(errmsg);
-          rd_kafka_event_destroy(event_response);
-          return Baton(static_cast<RdKafka::ErrorCode>(errcode), errormsg); // NOLINT
-        } else {
-          rd_kafka_event_destroy(event_response);
-          return Baton(static_cast<RdKafka::ErrorCode>(errcode));
-        }
-      }
-    }
+  rd_kafka_AdminOptions_destroy(options);
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
 
-    rd_kafka_event_destroy(event_response);
-    return Baton(RdKafka::ERR_NO_ERROR);
-  }
+Baton AdminClient::ListGroupsResult(rd_kafka_event_t* event) {
+  // The event contains the result, which needs to be parsed/converted by
+  // the caller.
+  return EventToBaton(event, RD_KAFKA_EVENT_LISTCONSUMERGROUPS_RESULT);
 }
 
 Baton AdminClient::ListGroups(
@@ -466,66 +602,64 @@ Baton AdminClient::ListGroups(
     return Baton(RdKafka::ERR__STATE);
   }
 
-  {
-    scoped_shared_write_lock lock(m_connection_lock);
-    if (!IsConnected()) {
-      return Baton(RdKafka::ERR__STATE);
-    }
+  scoped_shared_write_lock lock(m_connection_lock);
+  if (!IsConnected()) {
+    return Baton(RdKafka::ERR__STATE);
+  }
 
-    // Make admin options to establish that we are listing groups
-    rd_kafka_AdminOptions_t *options = rd_kafka_AdminOptions_new(
-        m_client->c_ptr(), RD_KAFKA_ADMIN_OP_LISTCONSUMERGROUPS);
+  // DON'T destroy the event. It is the out parameter, and ownership is
+  // the caller's.
+  Baton b = RunOnPrivateQueue(m_client->c_ptr(),
+    RD_KAFKA_EVENT_LISTCONSUMERGROUPS_RESULT, timeout_ms,
+    [&](rd_kafka_queue_t* queue) {
+      return StartListGroups(is_match_states_set, match_states, timeout_ms,
+                             queue, NULL);
+    }, event_response);
+
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return b;
+  }
+  return ListGroupsResult(*event_response);
+}
 
-    char errstr[512];
-    rd_kafka_resp_err_t err = rd_kafka_AdminOptions_set_request_timeout(
-        options, timeout_ms, errstr, sizeof(errstr));
-    if (err != RD_KAFKA_RESP_ERR_NO_ERROR) {
-      return Baton(static_cast<RdKafka::ErrorCode>(err), errstr);
-    }
+Baton AdminClient::StartDescribeGroups(std::vector<std::string> &groups,
+                                       bool include_authorized_operations,
+                                       int timeout_ms,
+                                       rd_kafka_queue_t* queue, void* opaque) {
+  // Make admin options to establish that we are describing groups
+  rd_kafka_AdminOptions_t *options;
+  Baton b = NewAdminOptions(m_client->c_ptr(),
+                            RD_KAFKA_ADMIN_OP_DESCRIBECONSUMERGROUPS,
+                            timeout_ms, opaque, &options);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return b;
+  }
 
-    if (is_match_states_set) {
-      rd_kafka_error_t *error =
-          rd_kafka_AdminOptions_set_match_consumer_group_states(
-              options, &match_states[0], match_states.size());
-      if (error) {
-        return Baton::BatonFromErrorAndDestroy(error);
-      }
+  if (include_authorized_operations) {
+    rd_kafka_error_t *error =
+        rd_kafka_AdminOptions_set_include_authorized_operations(
+            options, include_authorized_operations);
+    if (error) {
+      rd_kafka_AdminOptions_destroy(options);
+      return Baton::BatonFromErrorAndDestroy(error);
     }
+  }
 
-    // Create queue just for this operation.
-    rd_kafka_queue_t *rkqu = rd_kafka_queue_new(m_client->c_ptr());
-
-    rd_kafka_ListConsumerGroups(m_client->c_ptr(), options, rkqu);
-
-    // Poll for an event by type in that queue
-    // DON'T destroy the event. It is the out parameter, and ownership is
-    // the caller's.
-    *event_response = PollForEvent(
-        rkqu, RD_KAFKA_EVENT_LISTCONSUMERGROUPS_RESULT, timeout_ms);
-
-    // Destroy the queue since we are done with it.
-    rd_kafka_queue_destroy(rkqu);
-
-    // Destroy the options we just made because we polled already
-    rd_kafka_AdminOptions_destroy(options);
+  // Construct a char** to pass to librdkafka. Avoid too many allocations.
+  std::vector<const char *> c_groups(groups.size());
+  for (size_t i = 0; i < groups.size(); i++) {
+    c_groups[i] = groups[i].c_str();
+  }
 
-    // If we got no response from that operation, this is a failure
-    // likely due to time out
-    if (*event_response == NULL) {
-      return Baton(RdKafka::ERR__TIMED_OUT);
-    }
+  rd_kafka_DescribeConsumerGroups(m_client->c_ptr(), &c_groups[0],
+                                  groups.size(), options, queue);
 
-    // Now we can get the error code from the event
-    if (rd_kafka_event_error(*event_response)) {
-      // If we had a special error code, get out of here with it
-      const rd_kafka_resp_err_t errcode = rd_kafka_event_error(*event_response);
-      return Baton(static_cast<RdKafka::ErrorCode>(errcode));
-    }
+  rd_kafka_AdminOptions_destroy(options);
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
 
-    // At this point, event_response contains the result, which needs
-    // to be parsed/converted by the caller.
-    return Baton(RdKafka::ERR_NO_ERROR);
-  }
+Baton AdminClient::DescribeGroupsResult(rd_kafka_event_t* event) {
+  return EventToBaton(event, RD_KAFKA_EVENT_DESCRIBECONSUMERGROUPS_RESULT);
 }
 
 Baton AdminClient::DescribeGroups(std::vector<std::string> &groups,
@@ -536,134 +670,215 @@ Baton AdminClient::DescribeGroups(std::vector<std::string> &groups,
     return Baton(RdKafka::ERR__STATE);
   }
 
-  {
-    scoped_shared_write_lock lock(m_connection_lock);
-    if (!IsConnected()) {
-      return Baton(RdKafka::ERR__STATE);
-    }
+  scoped_shared_write_lock lock(m_connection_lock);
+  if (!IsConnected()) {
+    return Baton(RdKafka::ERR__STATE);
+  }
 
-    // Make admin options to establish that we are describing groups
-    rd_kafka_AdminOptions_t *options = rd_kafka_AdminOptions_new(
-        m_client->c_ptr(), RD_KAFKA_ADMIN_OP_DESCRIBECONSUMERGROUPS);
+  // DON'T destroy the event. It is the out parameter, and ownership is
+  // the caller's.
+  Baton b = RunOnPrivateQueue(m_client->c_ptr(),
+    RD_KAFKA_EVENT_DESCRIBECONSUMERGROUPS_RESULT, timeout_ms,
+    [&](rd_kafka_queue_t* queue) {
+      return StartDescribeGroups(groups, include_authorized_operations,
+                                 timeout_ms, queue, NULL);
+    }, event_response);
+
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return b;
+  }
+  return DescribeGroupsResult(*event_response);
+}
 
-    char errstr[512];
-    rd_kafka_resp_err_t err = rd_kafka_AdminOptions_set_request_timeout(
-        options, timeout_ms, errstr, sizeof(errstr));
-    if (err != RD_KAFKA_RESP_ERR_NO_ERROR) {
-      return Baton(static_cast<RdKafka::ErrorCode>(err), errstr);
-    }
+Baton AdminClient::StartDeleteGroups(rd_kafka_DeleteGroup_t **group_list,
+                                     size_t group_cnt, int timeout_ms,
+                                     rd_kafka_queue_t* queue, void* opaque) {
+  // Make admin options to establish that we are deleting groups
+  rd_kafka_AdminOptions_t *options;
+  Baton b = NewAdminOptions(m_client->c_ptr(), RD_KAFKA_ADMIN_OP_DELETEGROUPS,
+                            timeout_ms, opaque, &options);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return b;
+  }
 
-    if (include_authorized_operations) {
-      rd_kafka_error_t *error =
-          rd_kafka_AdminOptions_set_include_authorized_operations(
-              options, include_authorized_operations);
-      if (error) {
-        return Baton::BatonFromErrorAndDestroy(error);
-      }
-    }
+  rd_kafka_DeleteGroups(m_client->c_ptr(), group_list, group_cnt, options,
+                        queue);
 
-    // Create queue just for this operation.
-    rd_kafka_queue_t *rkqu = rd_kafka_queue_new(m_client->c_ptr());
+  rd_kafka_AdminOptions_destroy(options);
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
 
-    // Construct a char** to pass to librdkafka. Avoid too many allocations.
-    std::vector<const char *> c_groups(groups.size());
-    for (size_t i = 0; i < groups.size(); i++) {
-      c_groups[i] = groups[i].c_str();
-    }
+Baton AdminClient::DeleteGroupsResult(rd_kafka_event_t* event) {
+  return EventToBaton(event, RD_KAFKA_EVENT_DELETEGROUPS_RESULT);
+}
 
-    rd_kafka_DescribeConsumerGroups(m_client->c_ptr(), &c_groups[0],
-                                    groups.size(), options, rkqu);
+Baton AdminClient::DeleteGroups(rd_kafka_DeleteGroup_t **group_list,
+                                size_t group_cnt, int timeout_ms,
+                                /* out */ rd_kafka_event_t **event_response) {
+  if (!IsConnected()) {
+    return Baton(RdKafka::ERR__STATE);
+  }
 
-    // Poll for an event by type in that queue
-    // DON'T destroy the event. It is the out parameter, and ownership is
-    // the caller's.
-    *event_response = PollForEvent(
-        rkqu, RD_KAFKA_EVENT_DESCRIBECONSUMERGROUPS_RESULT, timeout_ms);
+  scoped_shared_write_lock lock(m_connection_lock);
+  if (!IsConnected()) {
+    return Baton(RdKafka::ERR__STATE);
+  }
 
-    // Destroy the queue since we are done with it.
-    rd_kafka_queue_destroy(rkqu);
+  // DON'T destroy the event. It is the out parameter, and ownership is
+  // the caller's.
+  Baton b = RunOnPrivateQueue(m_client->c_ptr(),
+    RD_KAFKA_EVENT_DELETEGROUPS_RESULT, timeout_ms,
+    [&](rd_kafka_queue_t* queue) {
+      return StartDeleteGroups(group_list, group_cnt, timeout_ms, queue, NULL);
+    }, event_response);
 
-    // Destroy the options we just made because we polled already
-    rd_kafka_AdminOptions_destroy(options);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return b;
+  }
+  return DeleteGroupsResult(*event_response);
+}
 
-    // If we got no response from that operation, this is a failure
-    // likely due to time out
-    if (*event_response == NULL) {
-      return Baton(RdKafka::ERR__TIMED_OUT);
-    }
+/**
+ * @brief Hand a worker either to the thread pool or, in shared queue mode,
+ * to the shared result queue.
+ *
+ * In shared queue mode the request is issued right away and the worker's
+ * callbacks run once the dispatcher thread has matched the result to it,
+ * so no thread pool thread is held while the request is in flight.
+ */
+void AdminClient::QueueWorker(Workers::AdminClientWorker* worker) {
+  if (!m_shared_queue) {
+    WorkerPool::Queue(worker);
+    return;
+  }
 
-    // Now we can get the error code from the event
-    if (rd_kafka_event_error(*event_response)) {
-      // If we had a special error code, get out of here with it
-      const rd_kafka_resp_err_t errcode = rd_kafka_event_error(*event_response);
-      return Baton(static_cast<RdKafka::ErrorCode>(errcode));
+  if (m_in_flight++ == 0) {
+    uv_ref(reinterpret_cast<uv_handle_t*>(m_results_async));
+  }
+
+  Baton b(RdKafka::ERR_NO_ERROR);
+  {
+    scoped_shared_read_lock lock(m_connection_lock);
+    if (!IsConnected() || !m_dispatcher_running) {
+      b = Baton(RdKafka::ERR__STATE);
+    } else {
+      // Register first, the result may arrive before Start returns
+      {
+        scoped_mutex_lock pending_lock(m_results_lock);
+        m_pending.insert(worker);
+      }
+
+      b = worker->Start(rkqu);
+
+      if (b.err() != RdKafka::ERR_NO_ERROR) {
+        scoped_mutex_lock pending_lock(m_results_lock);
+        m_pending.erase(worker);
+      }
     }
+  }
 
-    // At this point, event_response contains the result, which needs
-    // to be parsed/converted by the caller.
-    return Baton(RdKafka::ERR_NO_ERROR);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    // Still complete asynchronously, like the thread pool would
+    worker->Fail(b);
+    scoped_mutex_lock lock(m_results_lock);
+    m_completed.push_back(worker);
+    uv_async_send(m_results_async);
   }
 }
 
-Baton AdminClient::DeleteGroups(rd_kafka_DeleteGroup_t **group_list,
-                                size_t group_cnt, int timeout_ms,
-                                /* out */ rd_kafka_event_t **event_response) {
-  if (!IsConnected()) {
-    return Baton(RdKafka::ERR__STATE);
+/**
+ * Dispatcher thread of the shared result queue: matches every result to the
+ * worker it was issued for through the request opaque.
+ */
+void AdminClient::DispatchResults(void* arg) {
+  AdminClient* client = static_cast<AdminClient*>(arg);
+
+  while (client->m_dispatcher_running) {
+    rd_kafka_event_t* event = rd_kafka_queue_poll(client->rkqu, 100);
+    if (event != NULL) {
+      client->DispatchResult(event);
+    }
   }
+}
+
+void AdminClient::DispatchResult(rd_kafka_event_t* event) {
+  Workers::AdminClientWorker* worker =
+    static_cast<Workers::AdminClientWorker*>(rd_kafka_event_opaque(event));
 
   {
-    scoped_shared_write_lock lock(m_connection_lock);
-    if (!IsConnected()) {
-      return Baton(RdKafka::ERR__STATE);
+    scoped_mutex_lock lock(m_results_lock);
+    if (m_pending.erase(worker) == 0) {
+      // Not ours, or already failed on disconnect
+      rd_kafka_event_destroy(event);
+      return;
     }
+  }
 
-    // Make admin options to establish that we are deleting groups
-    rd_kafka_AdminOptions_t *options = rd_kafka_AdminOptions_new(
-        m_client->c_ptr(), RD_KAFKA_ADMIN_OP_DELETEGROUPS);
+  worker->Finish(event);
 
-    char errstr[512];
-    rd_kafka_resp_err_t err = rd_kafka_AdminOptions_set_request_timeout(
-        options, timeout_ms, errstr, sizeof(errstr));
-    if (err != RD_KAFKA_RESP_ERR_NO_ERROR) {
-      return Baton(static_cast<RdKafka::ErrorCode>(err), errstr);
-    }
+  scoped_mutex_lock lock(m_results_lock);
+  m_completed.push_back(worker);
+  uv_async_send(m_results_async);
+}
+
+void AdminClient::CompleteResults(uv_async_t* handle) {
+  AdminClient* client = static_cast<AdminClient*>(handle->data);
 
-    // Create queue just for this operation.
-    rd_kafka_queue_t *rkqu = rd_kafka_queue_new(m_client->c_ptr());
+  std::vector<Workers::AdminClientWorker*> completed;
+  {
+    scoped_mutex_lock lock(client->m_results_lock);
+    client->m_completed.swap(completed);
+  }
 
-    rd_kafka_DeleteGroups(m_client->c_ptr(), group_list, group_cnt, options,
-                          rkqu);
+  for (size_t i = 0; i < completed.size(); i++) {
+    completed[i]->Complete();
+  }
 
-    // Poll for an event by type in that queue
-    // DON'T destroy the event. It is the out parameter, and ownership is
-    // the caller's.
-    *event_response =
-        PollForEvent(rkqu, RD_KAFKA_EVENT_DELETEGROUPS_RESULT, timeout_ms);
+  client->m_in_flight -= completed.size();
+  if (client->m_in_flight == 0) {
+    uv_unref(reinterpret_cast<uv_handle_t*>(handle));
+  }
+}
 
-    // Destroy the queue since we are done with it.
-    rd_kafka_queue_destroy(rkqu);
+void AdminClient::ResultsAsyncCloseCallback(uv_handle_t* handle) {
+  delete reinterpret_cast<uv_async_t*>(handle);
+}
 
-    // Destroy the options we just made because we polled already
-    rd_kafka_AdminOptions_destroy(options);
+void AdminClient::StartDispatcher() {
+  m_dispatcher_running = true;
+  uv_thread_create(&m_dispatcher_thread, DispatchResults, this);
+}
 
-    // If we got no response from that operation, this is a failure
-    // likely due to time out
-    if (*event_response == NULL) {
-      return Baton(RdKafka::ERR__TIMED_OUT);
-    }
+/**
+ * Stop the dispatcher thread, then complete whatever is left: results still
+ * in the queue, and requests librdkafka will no longer answer once the
+ * client is gone, which fail with ERR__DESTROY.
+ *
+ * Must be called with m_connection_lock held for writing.
+ */
+void AdminClient::StopDispatcher() {
+  if (!m_dispatcher_running) {
+    return;
+  }
 
-    // Now we can get the error code from the event
-    if (rd_kafka_event_error(*event_response)) {
-      // If we had a special error code, get out of here with it
-      const rd_kafka_resp_err_t errcode = rd_kafka_event_error(*event_response);
-      return Baton(static_cast<RdKafka::ErrorCode>(errcode));
-    }
+  m_dispatcher_running = false;
+  // Wake the dispatcher up rather than waiting for its poll to time out
+  rd_kafka_queue_yield(rkqu);
+  uv_thread_join(&m_dispatcher_thread);
 
-    // At this point, event_response contains the result, which needs
-    // to be parsed/converted by the caller.
-    return Baton(RdKafka::ERR_NO_ERROR);
+  rd_kafka_event_t* event;
+  while ((event = rd_kafka_queue_poll(rkqu, 0)) != NULL) {
+    DispatchResult(event);
+  }
+
+  scoped_mutex_lock lock(m_results_lock);
+  for (std::unordered_set<Workers::AdminClientWorker*>::iterator it =
+         m_pending.begin(); it != m_pending.end(); ++it) {
+    (*it)->Fail(Baton(RdKafka::ERR__DESTROY));
+    m_completed.push_back(*it);
   }
+  m_pending.clear();
+  uv_async_send(m_results_async);
 }
 
 void AdminClient::ActivateDispatchers() {
@@ -689,6 +904,24 @@ void AdminClient::DeactivateDispatchers() {
  * C++ Exported prototype functions
  */
 
+NAN_METHOD(AdminClient::NodeSetSharedQueue) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 1 || !info[0]->IsBoolean()) {
+    return Nan::ThrowError("Need to specify a boolean");
+  }
+
+  AdminClient* client = ObjectWrap::Unwrap<AdminClient>(info.This());
+
+  if (client->IsConnected()) {
+    return Nan::ThrowError("Cannot change the result queue when connected");
+  }
+
+  client->m_shared_queue = Nan::To<bool>(info[0]).FromJust();
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
 NAN_METHOD(AdminClient::NodeConnect) {
   Nan::HandleScope scope;
 
@@ -745,7 +978,7 @@ NAN_METHOD(AdminClient::NodeCreateTopic) {
   }
 
   // Queue up dat work
-  Nan::AsyncQueueWorker(
+  client->QueueWorker(
     new Workers::AdminClientCreateTopic(callback, client, topic, timeout));
 
   return info.GetReturnValue().Set(Nan::Null());
@@ -783,7 +1016,7 @@ NAN_METHOD(AdminClient::NodeDeleteTopic) {
     topic_name.c_str());
 
   // Queue up dat work
-  Nan::AsyncQueueWorker(
+  client->QueueWorker(
     new Workers::AdminClientDeleteTopic(callback, client, topic, timeout));
 
   return info.GetReturnValue().Set(Nan::Null());
@@ -839,7 +1072,7 @@ NAN_METHOD(AdminClient::NodeCreatePartitions) {
   }
 
   // Queue up dat work
-  Nan::AsyncQueueWorker(new Workers::AdminClientCreatePartitions(
+  client->QueueWorker(new Workers::AdminClientCreatePartitions(
     callback, client, new_partitions, timeout));
 
   return info.GetReturnValue().Set(Nan::Null());
@@ -885,7 +1118,7 @@ NAN_METHOD(AdminClient::NodeListGroups) {
   }
 
   // Queue the work.
-  Nan::AsyncQueueWorker(new Workers::AdminClientListGroups(
+  client->QueueWorker(new Workers::AdminClientListGroups(
       callback, client, is_match_states_set, match_states, timeout_ms));
 }
 
@@ -931,7 +1164,7 @@ NAN_METHOD(AdminClient::NodeDescribeGroups) {
   AdminClient *client = ObjectWrap::Unwrap<AdminClient>(info.This());
 
   // Queue the work.
-  Nan::AsyncQueueWorker(new Workers::AdminClientDescribeGroups(
+  client->QueueWorker(new Workers::AdminClientDescribeGroups(
       callback, client, group_names_vector, include_authorized_operations,
       timeout_ms));
 }
@@ -982,7 +1215,7 @@ NAN_METHOD(AdminClient::NodeDeleteGroups) {
   AdminClient *client = ObjectWrap::Unwrap<AdminClient>(info.This());
 
   // Queue the work.
-  Nan::AsyncQueueWorker(new Workers::AdminClientDeleteGroups(
+  client->QueueWorker(new Workers::AdminClientDeleteGroups(
       callback, client, group_list, group_names_vector.size(), timeout_ms));
 }
 
@@ -13,8 +13,10 @@
 
 #include <nan.h>
 #include <uv.h>
+#include <atomic>
 #include <iostream>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "rdkafkacpp.h"
@@ -26,6 +28,10 @@
 
 namespace NodeKafka {
 
+namespace Workers {
+class AdminClientWorker;
+}
+
 /**
  * @brief KafkaConsumer v8 wrapped object.
  *
@@ -43,6 +49,7 @@ class AdminClient : public Connection {
 
   void ActivateDispatchers();
   void DeactivateDispatchers();
+  void Teardown();
 
   Baton Connect();
   Baton Disconnect();
@@ -62,8 +69,38 @@ class AdminClient : public Connection {
   Baton DeleteGroups(rd_kafka_DeleteGroup_t** group_list, size_t group_cnt,
                      int timeout_ms, rd_kafka_event_t** event_response);
 
+  // Issue a request on queue without waiting for it. The result event
+  // carries opaque. Must be called with m_connection_lock held.
+  Baton StartCreateTopic(rd_kafka_NewTopic_t* topic, int timeout_ms,
+                         rd_kafka_queue_t* queue, void* opaque);
+  Baton StartDeleteTopic(rd_kafka_DeleteTopic_t* topic, int timeout_ms,
+                         rd_kafka_queue_t* queue, void* opaque);
+  Baton StartCreatePartitions(rd_kafka_NewPartitions_t* topic, int timeout_ms,
+                              rd_kafka_queue_t* queue, void* opaque);
+  Baton StartListGroups(
+    bool is_match_states_set,
+    std::vector<rd_kafka_consumer_group_state_t>& match_states,
+    int timeout_ms, rd_kafka_queue_t* queue, void* opaque);
+  Baton StartDescribeGroups(std::vector<std::string>& groups,
+                            bool include_authorized_operations,
+                            int timeout_ms, rd_kafka_queue_t* queue,
+                            void* opaque);
+  Baton StartDeleteGroups(rd_kafka_DeleteGroup_t** group_list,
+                          size_t group_cnt, int timeout_ms,
+                          rd_kafka_queue_t* queue, void* opaque);
+
+  // Check the result event of a request
+  static Baton CreateTopicResult(rd_kafka_event_t* event);
+  static Baton DeleteTopicResult(rd_kafka_event_t* event);
+  static Baton CreatePartitionsResult(rd_kafka_event_t* event);
+  static Baton ListGroupsResult(rd_kafka_event_t* event);
+  static Baton DescribeGroupsResult(rd_kafka_event_t* event);
+  static Baton DeleteGroupsResult(rd_kafka_event_t* event);
+
+  void QueueWorker(Workers::AdminClientWorker* worker);
+
  protected:
-  static Nan::Persistent<v8::Function> constructor;
+  static PerIsolateFunction constructor;
   static void New(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
   explicit AdminClient(Conf* globalConfig);
@@ -72,6 +109,30 @@ class AdminClient : public Connection {
   rd_kafka_queue_t* rkqu;
 
  private:
+  static void DispatchResults(void* arg);
+  static void CompleteResults(uv_async_t* handle);
+  static void ResultsAsyncCloseCallback(uv_handle_t* handle);
+  void CloseResults();
+  void DispatchResult(rd_kafka_event_t* event);
+  void StartDispatcher();
+  void StopDispatcher();
+
+  // Whether requests share rkqu instead of each blocking a thread pool
+  // thread on a queue of their own
+  bool m_shared_queue;
+
+  uv_thread_t m_dispatcher_thread;
+  std::atomic<bool> m_dispatcher_running;
+
+  // Completes the workers whose results came in on the main thread
+  uv_async_t* m_results_async;
+  uv_mutex_t m_results_lock;
+  std::unordered_set<Workers::AdminClientWorker*> m_pending;
+  std::vector<Workers::AdminClientWorker*> m_completed;
+  // Requests not completed yet, the handle keeps the loop alive while
+  // there are any. Only used on the main thread.
+  size_t m_in_flight;
+
   // Node methods
   // static NAN_METHOD(NodeValidateTopic);
   static NAN_METHOD(NodeCreateTopic);
@@ -83,6 +144,7 @@ class AdminClient : public Connection {
   static NAN_METHOD(NodeDescribeGroups);
   static NAN_METHOD(NodeDeleteGroups);
 
+  static NAN_METHOD(NodeSetSharedQueue);
   static NAN_METHOD(NodeConnect);
   static NAN_METHOD(NodeDisconnect);
 };
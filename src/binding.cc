@@ -9,6 +9,7 @@
 
 #include <iostream>
 #include "src/binding.h"
+#include "src/worker-pool.h"
 
 using NodeKafka::Producer;
 using NodeKafka::KafkaConsumer;
@@ -41,6 +42,74 @@ NAN_METHOD(NodeRdKafkaBuildInFeatures) {
   delete config;
 }
 
+/**
+ * @brief Compute the partition librdkafka's built-in partitioner would pick
+ * for a key.
+ *
+ * Only key hashing is supported, so the purely random partitioners, which
+ * need the topic's partition availability, are rejected.
+ */
+NAN_METHOD(NodePartitionForKey) {
+  if (info.Length() < 3 || !info[0]->IsString()) {
+    return Nan::ThrowError("Need to specify a partitioner");
+  }
+
+  if (!node::Buffer::HasInstance(info[1]) && !info[1]->IsString()) {
+    return Nan::ThrowError("Key must be a buffer or a string");
+  }
+
+  if (!info[2]->IsNumber()) {
+    return Nan::ThrowError("Need to specify a partition count");
+  }
+
+  Nan::Utf8String name_utf8(info[0]);
+  std::string name(*name_utf8, name_utf8.length());
+  NodeKafka::Callbacks::NativePartitioner partitioner =
+    NodeKafka::Callbacks::Partitioner::GetNative(name);
+
+  if (partitioner == NULL) {
+    return Nan::ThrowError("Unknown partitioner");
+  }
+
+  int32_t partition_cnt = Nan::To<int32_t>(info[2]).FromJust();
+  if (partition_cnt <= 0) {
+    return Nan::ThrowError("Partition count must be positive");
+  }
+
+  std::string key;
+  if (info[1]->IsString()) {
+    Nan::Utf8String utf8(info[1]);
+    key.assign(*utf8, utf8.length());
+  } else {
+    v8::Local<v8::Object> buffer = info[1].As<v8::Object>();
+    key.assign(node::Buffer::Data(buffer), node::Buffer::Length(buffer));
+  }
+
+  // Empty keys are randomly partitioned by consistent_random
+  if (name == "random" || (name == "consistent_random" && key.empty())) {
+    return Nan::ThrowError("Partitioner does not hash this key");
+  }
+
+  int32_t partition = partitioner(NULL, key.data(), key.size(),
+    partition_cnt, NULL, NULL);
+
+  info.GetReturnValue().Set(Nan::New<v8::Int32>(partition));
+}
+
+/**
+ * @brief Set the number of threads running the blocking workers of all
+ * clients. 0 runs them on the libuv threadpool instead.
+ */
+NAN_METHOD(NodeSetWorkerPoolSize) {
+  if (info.Length() < 1 || !info[0]->IsUint32()) {
+    return Nan::ThrowError("Need to specify a pool size");
+  }
+
+  NodeKafka::WorkerPool::SetSize(Nan::To<uint32_t>(info[0]).FromJust());
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
 void ConstantsInit(v8::Local<v8::Object> exports) {
   v8::Local<v8::Object> topicConstants = Nan::New<v8::Object>();
 
@@ -58,9 +127,17 @@ void ConstantsInit(v8::Local<v8::Object> exports) {
 
   Nan::Set(exports, Nan::New("features").ToLocalChecked(),
     Nan::GetFunction(Nan::New<v8::FunctionTemplate>(NodeRdKafkaBuildInFeatures)).ToLocalChecked());  // NOLINT
+
+  Nan::Set(exports, Nan::New("partitionForKey").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<v8::FunctionTemplate>(NodePartitionForKey)).ToLocalChecked());  // NOLINT
+
+  Nan::Set(exports, Nan::New("setWorkerPoolSize").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<v8::FunctionTemplate>(NodeSetWorkerPoolSize)).ToLocalChecked());  // NOLINT
 }
 
-void Init(v8::Local<v8::Object> exports, v8::Local<v8::Value> m_, void* v_) {
+// Run for every environment that loads the binding, the main thread and each
+// worker thread
+void Init(v8::Local<v8::Object> exports) {
   KafkaConsumer::Init(exports);
   Producer::Init(exports);
   AdminClient::Init(exports);
@@ -71,4 +148,4 @@ void Init(v8::Local<v8::Object> exports, v8::Local<v8::Value> m_, void* v_) {
       Nan::New(RdKafka::version_str().c_str()).ToLocalChecked());
 }
 
-NODE_MODULE(kafka, Init)
+NAN_MODULE_WORKER_ENABLED(kafka, Init)
@@ -12,6 +12,8 @@
 #include <vector>
 
 #include "src/kafka-consumer.h"
+#include "src/produce-channel.h"
+#include "src/latency-histogram.h"
 
 using v8::Local;
 using v8::Value;
@@ -47,8 +49,17 @@ v8::Local<v8::Array> TopicPartitionListToV8Array(
   return tp_array;
 }
 
-Dispatcher::Dispatcher() {
+Dispatcher::Dispatcher():
+  m_wakeups(0),
+  m_items(0),
+  m_depth(0),
+  m_depth_high_water(0),
+  m_bytes(0),
+  m_dropped(0) {
   async = NULL;
+  // Activate may be called from a worker, so take the loop of the thread the
+  // dispatcher is created on
+  loop = Nan::GetCurrentEventLoop();
   uv_mutex_init(&async_lock);
 }
 
@@ -66,7 +77,7 @@ Dispatcher::~Dispatcher() {
 void Dispatcher::Activate() {
   if (!async) {
     async = new uv_async_t;
-    uv_async_init(uv_default_loop(), async, AsyncMessage_);
+    uv_async_init(loop, async, AsyncMessage_);
 
     async->data = this;
   }
@@ -109,6 +120,41 @@ void Dispatcher::Dispatch(const int _argc, Local<Value> _argv[]) {
   }
 }
 
+void Dispatcher::RecordFlush(size_t items) {
+  Metrics::Increment(m_items, items);
+}
+
+void Dispatcher::RecordDepth(size_t depth) {
+  m_depth.store(depth, std::memory_order_relaxed);
+  Metrics::RaiseTo(m_depth_high_water, depth);
+}
+
+void Dispatcher::RecordBytes(size_t bytes) {
+  m_bytes.store(bytes, std::memory_order_relaxed);
+}
+
+void Dispatcher::RecordDropped() {
+  Metrics::Increment(m_dropped);
+}
+
+v8::Local<v8::Object> Dispatcher::GetMetrics() {
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("wakeups").ToLocalChecked(), Nan::New<v8::Number>(
+    static_cast<double>(m_wakeups.load(std::memory_order_relaxed))));
+  Nan::Set(obj, Nan::New("items").ToLocalChecked(), Nan::New<v8::Number>(
+    static_cast<double>(m_items.load(std::memory_order_relaxed))));
+  Nan::Set(obj, Nan::New("depth").ToLocalChecked(), Nan::New<v8::Number>(
+    static_cast<double>(m_depth.load(std::memory_order_relaxed))));
+  Nan::Set(obj, Nan::New("depthHighWater").ToLocalChecked(),
+    Nan::New<v8::Number>(static_cast<double>(
+      m_depth_high_water.load(std::memory_order_relaxed))));
+  Nan::Set(obj, Nan::New("bytes").ToLocalChecked(), Nan::New<v8::Number>(
+    static_cast<double>(m_bytes.load(std::memory_order_relaxed))));
+  Nan::Set(obj, Nan::New("dropped").ToLocalChecked(), Nan::New<v8::Number>(
+    static_cast<double>(m_dropped.load(std::memory_order_relaxed))));
+  return obj;
+}
+
 void Dispatcher::AddCallback(const v8::Local<v8::Function> &cb) {
   Nan::Persistent<v8::Function,
                   Nan::CopyablePersistentTraits<v8::Function> > value(cb);
@@ -159,9 +205,24 @@ event_t::~event_t() {}
 
 // Event callback
 Event::Event():
-  dispatcher() {}
+  dispatcher() {
+  uv_mutex_init(&m_stats_filter_lock);
+}
 
-Event::~Event() {}
+Event::~Event() {
+  uv_mutex_destroy(&m_stats_filter_lock);
+}
+
+/**
+ * Statistics are parsed on the librdkafka thread emitting them, so only the
+ * selected fields have to be turned into JS values on the main thread.
+ *
+ * @param filter - Fields to keep, or null to dispatch the raw JSON.
+ */
+void Event::SetStatsFilter(std::shared_ptr<const Stats::Filter> filter) {
+  scoped_mutex_lock lock(m_stats_filter_lock);
+  m_stats_filter = filter;
+}
 
 void Event::event_cb(RdKafka::Event &event) {
   // Second parameter is going to be an object with properties to
@@ -173,16 +234,56 @@ void Event::event_cb(RdKafka::Event &event) {
 
   event_t e(event);
 
+  if (e.type == RdKafka::Event::EVENT_STATS) {
+    std::shared_ptr<const Stats::Filter> filter;
+    {
+      scoped_mutex_lock lock(m_stats_filter_lock);
+      filter = m_stats_filter;
+    }
+
+    // Fall back to the raw JSON if it can't be parsed
+    if (filter) {
+      e.stats = Stats::Parse(e.message, *filter);
+      if (e.stats) {
+        e.message.clear();
+      }
+    }
+  }
+
   dispatcher.Add(e);
   dispatcher.Execute();
 }
 
-EventDispatcher::EventDispatcher() {}
+size_t event_t::Footprint() const {
+  return sizeof(event_t) + message.size() + fac.size() + broker_name.size();
+}
+
+EventDispatcher::EventDispatcher():
+  m_max_queued(kDefaultMaxQueued),
+  m_queued_bytes(0) {}
 EventDispatcher::~EventDispatcher() {}
 
+/**
+ * @param max_queued - Number of queued events past which log and statistics
+ * events are dropped, 0 to never drop any.
+ */
+void EventDispatcher::SetMaxQueued(size_t max_queued) {
+  scoped_mutex_lock lock(async_lock);
+  m_max_queued = max_queued;
+}
+
 void EventDispatcher::Add(const event_t &e) {
   scoped_mutex_lock lock(async_lock);
+  if (m_max_queued > 0 && events.size() >= m_max_queued &&
+      (e.type == RdKafka::Event::EVENT_LOG ||
+       e.type == RdKafka::Event::EVENT_STATS)) {
+    RecordDropped();
+    return;
+  }
   events.push_back(e);
+  m_queued_bytes += e.Footprint();
+  RecordDepth(events.size());
+  RecordBytes(m_queued_bytes);
 }
 
 void EventDispatcher::Flush() {
@@ -198,7 +299,11 @@ void EventDispatcher::Flush() {
   {
     scoped_mutex_lock lock(async_lock);
     events.swap(_events);
+    m_queued_bytes = 0;
+    RecordDepth(0);
+    RecordBytes(0);
   }
+  RecordFlush(_events.size());
 
   for (size_t i=0; i < _events.size(); i++) {
     Local<Value> argv[argc] = {};
@@ -215,8 +320,13 @@ void EventDispatcher::Flush() {
       case RdKafka::Event::EVENT_STATS:
         argv[0] = Nan::New("stats").ToLocalChecked();
 
-        Nan::Set(jsobj, Nan::New("message").ToLocalChecked(),
-          Nan::New<String>(_events[i].message.c_str()).ToLocalChecked());
+        if (_events[i].stats) {
+          Nan::Set(jsobj, Nan::New("stats").ToLocalChecked(),
+            Stats::ToV8Value(*_events[i].stats));
+        } else {
+          Nan::Set(jsobj, Nan::New("message").ToLocalChecked(),
+            Nan::New<String>(_events[i].message.c_str()).ToLocalChecked());
+        }
 
         break;
       case RdKafka::Event::EVENT_LOG:
@@ -262,33 +372,129 @@ void EventDispatcher::Flush() {
   }
 }
 
-DeliveryReportDispatcher::DeliveryReportDispatcher() {}
-DeliveryReportDispatcher::~DeliveryReportDispatcher() {}
+DeliveryReportDispatcher::DeliveryReportDispatcher():
+  m_full(false) {
+  m_events_bytes = 0;
+  m_batch_size = 0;
+  m_backlog_max = 0;
+  m_backlog_max_bytes = 0;
+}
+DeliveryReportDispatcher::~DeliveryReportDispatcher() {
+  m_drain_callback.Reset();
+}
+
+/**
+ * @param max - Number of queued reports at which the backlog is full,
+ * 0 for no limit.
+ * @param max_bytes - Memory held by queued reports at which the backlog is
+ * full, 0 for no limit.
+ */
+void DeliveryReportDispatcher::SetBacklogLimits(size_t max, size_t max_bytes) {
+  scoped_mutex_lock lock(async_lock);
+  m_backlog_max = max;
+  m_backlog_max_bytes = max_bytes;
+}
+
+bool DeliveryReportDispatcher::IsFull() {
+  return m_full.load(std::memory_order_relaxed);
+}
+
+void DeliveryReportDispatcher::SetDrainCallback(
+  const v8::Local<v8::Function> &cb) {
+  m_drain_callback.Reset(cb);
+}
+
+void DeliveryReportDispatcher::ClearDrainCallback() {
+  m_drain_callback.Reset();
+}
+
+/**
+ * Whether the backlog is at or past a limit divided by divisor. Limits that
+ * are not set are never exceeded.
+ */
+bool DeliveryReportDispatcher::BacklogExceeds(size_t divisor) {
+  return (m_backlog_max > 0 && events.size() * divisor >= m_backlog_max) ||
+    (m_backlog_max_bytes > 0 &&
+     m_events_bytes * divisor >= m_backlog_max_bytes);
+}
+
+/**
+ * In batch mode every wake-up hands up to batch_size reports to the callbacks
+ * in a single call, instead of making one call per report.
+ *
+ * @param batch_size - Maximum number of reports per call, 0 to disable.
+ */
+void DeliveryReportDispatcher::SetBatchSize(size_t batch_size) {
+  scoped_mutex_lock lock(async_lock);
+  m_batch_size = batch_size;
+}
 
 size_t DeliveryReportDispatcher::Add(const DeliveryReport &e) {
   scoped_mutex_lock lock(async_lock);
   events.push_back(e);
+  m_events_bytes += e.Footprint();
+  if (BacklogExceeds(1)) {
+    m_full.store(true, std::memory_order_relaxed);
+  }
+  RecordDepth(events.size());
+  RecordBytes(m_events_bytes);
   return events.size();
 }
 
 void DeliveryReportDispatcher::Flush() {
   Nan::HandleScope scope;
 
-  const unsigned int argc = 2;
-
   size_t outstanding_event_count = 0;
+  size_t batch_size = 0;
+  bool drained = false;
   std::vector<DeliveryReport> events_list;
   {
     scoped_mutex_lock lock(async_lock);
     outstanding_event_count = events.size();
-    const size_t flush_count = std::min<size_t>(outstanding_event_count, 100UL);
+    batch_size = m_batch_size;
+    const size_t flush_count = std::min<size_t>(outstanding_event_count,
+      batch_size > 0 ? batch_size : 100UL);
     events_list.reserve(flush_count);
     for (size_t i = 0; i < flush_count; i++) {
+      m_events_bytes -= events.front().Footprint();
       events_list.emplace_back(std::move(events.front()));
       events.pop_front();
     }
+
+    // Half way down, so a producer waiting for the drain does not refill
+    // the backlog in a single report.
+    if (IsFull() && !BacklogExceeds(2)) {
+      m_full.store(false, std::memory_order_relaxed);
+      drained = true;
+    }
+    RecordDepth(events.size());
+    RecordBytes(m_events_bytes);
+  }
+  RecordFlush(events_list.size());
+
+  if (batch_size > 0) {
+    DispatchBatch(events_list);
+  } else {
+    DispatchEach(events_list);
   }
 
+  if (drained && !m_drain_callback.IsEmpty()) {
+    Nan::Callback cb(Nan::New(m_drain_callback));
+    cb.Call(0, NULL);
+  }
+
+  if (outstanding_event_count > events_list.size()) {
+    Execute();
+  }
+}
+
+/**
+ * @brief Dispatch every report with its own call.
+ */
+void DeliveryReportDispatcher::DispatchEach(
+  const std::vector<DeliveryReport> &events_list) {
+  const unsigned int argc = 2;
+
   for (size_t i = 0; i < events_list.size(); i++) {
     v8::Local<v8::Value> argv[argc] = {};
 
@@ -320,7 +526,10 @@ void DeliveryReportDispatcher::Flush() {
       Nan::Set(jsobj, Nan::New("key").ToLocalChecked(), Nan::Null());
     }
 
-    if (event.opaque) {
+    if (event.opaque && event.m_opaque_id) {
+      Nan::Set(jsobj, Nan::New("opaque").ToLocalChecked(),
+        Nan::New<v8::Number>(static_cast<double>(OpaqueToId(event.opaque))));
+    } else if (event.opaque) {
       Nan::Persistent<v8::Value> * persistent =
         static_cast<Nan::Persistent<v8::Value> *>(event.opaque);
       v8::Local<v8::Value> object = Nan::New(*persistent);
@@ -339,7 +548,12 @@ void DeliveryReportDispatcher::Flush() {
     }
 
     if (event.m_include_payload) {
-      if (event.payload) {
+      if (event.buffer) {
+        // The payload was never copied, so hand back the Buffer it was
+        // produced from.
+        Nan::Set(jsobj, Nan::New<v8::String>("value").ToLocalChecked(),
+          Nan::New(*event.buffer));
+      } else if (event.payload) {
         Nan::MaybeLocal<v8::Object> buff = Nan::NewBuffer(
           static_cast<char*>(event.payload),
           static_cast<int>(event.len));
@@ -355,13 +569,146 @@ void DeliveryReportDispatcher::Flush() {
     Nan::Set(jsobj, Nan::New<v8::String>("size").ToLocalChecked(),
             Nan::New<v8::Number>(event.len));
 
+    if (event.buffer) {
+      // librdkafka is done with the memory, so the Buffer can be collected.
+      event.buffer->Reset();
+      delete event.buffer;
+    }
+
     argv[1] = jsobj;
 
     Dispatch(argc, argv);
   }
-  if (outstanding_event_count > events_list.size()) {
-    Execute();
+}
+
+/**
+ * @brief Dispatch a list of delivery reports with a single call.
+ *
+ * The callbacks are called with (null, batch), where batch holds one entry
+ * per report in parallel arrays:
+ *
+ * {
+ *   topic: string[],
+ *   partition: Int32Array,
+ *   offset: Float64Array,
+ *   error: Int32Array,        0 for reports that are not errors
+ *   timestamp: Float64Array,  -1 if not available
+ *   opaque: any[],
+ *   key: (Buffer|null)[],     only if the payload is included
+ *   value: (Buffer|null)[],   only if the payload is included
+ * }
+ */
+void DeliveryReportDispatcher::DispatchBatch(
+  const std::vector<DeliveryReport> &events_list) {
+  const unsigned int argc = 2;
+  const uint32_t count = static_cast<uint32_t>(events_list.size());
+
+  if (count == 0) {
+    return;
+  }
+
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+
+  v8::Local<v8::ArrayBuffer> partition_buffer =
+    v8::ArrayBuffer::New(isolate, count * sizeof(int32_t));
+  v8::Local<v8::ArrayBuffer> offset_buffer =
+    v8::ArrayBuffer::New(isolate, count * sizeof(double));
+  v8::Local<v8::ArrayBuffer> error_buffer =
+    v8::ArrayBuffer::New(isolate, count * sizeof(int32_t));
+  v8::Local<v8::ArrayBuffer> timestamp_buffer =
+    v8::ArrayBuffer::New(isolate, count * sizeof(double));
+
+  int32_t* partitions =
+    static_cast<int32_t*>(partition_buffer->GetBackingStore()->Data());
+  double* offsets =
+    static_cast<double*>(offset_buffer->GetBackingStore()->Data());
+  int32_t* errors =
+    static_cast<int32_t*>(error_buffer->GetBackingStore()->Data());
+  double* timestamps =
+    static_cast<double*>(timestamp_buffer->GetBackingStore()->Data());
+
+  v8::Local<v8::Array> topics = Nan::New<v8::Array>(count);
+  v8::Local<v8::Array> opaques = Nan::New<v8::Array>(count);
+  v8::Local<v8::Array> keys;
+  v8::Local<v8::Array> values;
+
+  // The payload setting is the same for every report of a producer.
+  const bool include_payload = events_list[0].m_include_payload;
+  if (include_payload) {
+    keys = Nan::New<v8::Array>(count);
+    values = Nan::New<v8::Array>(count);
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    const DeliveryReport& event = events_list[i];
+
+    partitions[i] = event.partition;
+    offsets[i] = static_cast<double>(event.offset);
+    errors[i] = event.is_error ? static_cast<int32_t>(event.error_code) : 0;
+    timestamps[i] = static_cast<double>(event.timestamp);
+
+    Nan::Set(topics, i, Nan::New(event.topic_name).ToLocalChecked());
+
+    if (event.opaque && event.m_opaque_id) {
+      Nan::Set(opaques, i,
+        Nan::New<v8::Number>(static_cast<double>(OpaqueToId(event.opaque))));
+    } else if (event.opaque) {
+      Nan::Persistent<v8::Value> * persistent =
+        static_cast<Nan::Persistent<v8::Value> *>(event.opaque);
+      Nan::Set(opaques, i, Nan::New(*persistent));
+
+      persistent->Reset();
+      delete persistent;
+    } else {
+      Nan::Set(opaques, i, Nan::Undefined());
+    }
+
+    if (include_payload) {
+      if (event.key) {
+        Nan::Set(keys, i, Nan::NewBuffer(static_cast<char*>(event.key),
+          static_cast<int>(event.key_len)).ToLocalChecked());
+      } else {
+        Nan::Set(keys, i, Nan::Null());
+      }
+
+      if (event.buffer) {
+        Nan::Set(values, i, Nan::New(*event.buffer));
+      } else if (event.payload) {
+        Nan::Set(values, i, Nan::NewBuffer(static_cast<char*>(event.payload),
+          static_cast<int>(event.len)).ToLocalChecked());
+      } else {
+        Nan::Set(values, i, Nan::Null());
+      }
+    } else if (event.key) {
+      // Nothing took ownership of the key copy.
+      free(event.key);
+    }
+
+    if (event.buffer) {
+      event.buffer->Reset();
+      delete event.buffer;
+    }
   }
+
+  Local<Object> jsobj(Nan::New<Object>());
+  Nan::Set(jsobj, Nan::New("topic").ToLocalChecked(), topics);
+  Nan::Set(jsobj, Nan::New("partition").ToLocalChecked(),
+    v8::Int32Array::New(partition_buffer, 0, count));
+  Nan::Set(jsobj, Nan::New("offset").ToLocalChecked(),
+    v8::Float64Array::New(offset_buffer, 0, count));
+  Nan::Set(jsobj, Nan::New("error").ToLocalChecked(),
+    v8::Int32Array::New(error_buffer, 0, count));
+  Nan::Set(jsobj, Nan::New("timestamp").ToLocalChecked(),
+    v8::Float64Array::New(timestamp_buffer, 0, count));
+  Nan::Set(jsobj, Nan::New("opaque").ToLocalChecked(), opaques);
+
+  if (include_payload) {
+    Nan::Set(jsobj, Nan::New("key").ToLocalChecked(), keys);
+    Nan::Set(jsobj, Nan::New("value").ToLocalChecked(), values);
+  }
+
+  v8::Local<v8::Value> argv[argc] = { Nan::Null(), jsobj };
+  Dispatch(argc, argv);
 }
 
 // This only exists to circumvent the problem with not being able to execute JS
@@ -369,8 +716,9 @@ void DeliveryReportDispatcher::Flush() {
 
 // I still think there may be better alternatives, because there is a lot of
 // duplication here
-DeliveryReport::DeliveryReport(RdKafka::Message &message, bool include_payload) :  // NOLINT
-  m_include_payload(include_payload) {
+DeliveryReport::DeliveryReport(RdKafka::Message &message, void* message_opaque, bool include_payload, bool zero_copy, bool opaque_id) :  // NOLINT
+  m_include_payload(include_payload),
+  m_opaque_id(opaque_id) {
   if (message.err() == RdKafka::ERR_NO_ERROR) {
     is_error = false;
   } else {
@@ -402,15 +750,26 @@ DeliveryReport::DeliveryReport(RdKafka::Message &message, bool include_payload)
     key = NULL;
   }
 
-  if (message.msg_opaque()) {
-    opaque = message.msg_opaque();
-  } else {
-    opaque = NULL;
+  opaque = NULL;
+  buffer = NULL;
+
+  if (zero_copy) {
+    // Every message is produced with a wrapper in zero copy mode. Unwrap it
+    // here, the handles themselves may only be touched on the main thread.
+    ZeroCopyOpaque* zero_copy_opaque =
+      static_cast<ZeroCopyOpaque*>(message_opaque);
+    if (zero_copy_opaque) {
+      opaque = zero_copy_opaque->opaque;
+      buffer = zero_copy_opaque->buffer;
+      delete zero_copy_opaque;
+    }
+  } else if (message_opaque) {
+    opaque = message_opaque;
   }
 
   len = message.len();
 
-  if (m_include_payload && message.payload()) {
+  if (m_include_payload && message.payload() && !buffer) {
     // this pointer will be owned and freed by the Nan::NewBuffer
     // created in DeliveryReportDispatcher::Flush()
     payload = malloc(len);
@@ -422,11 +781,48 @@ DeliveryReport::DeliveryReport(RdKafka::Message &message, bool include_payload)
 
 DeliveryReport::~DeliveryReport() {}
 
+size_t DeliveryReport::Footprint() const {
+  return sizeof(DeliveryReport) + topic_name.size() + error_string.size() +
+    (key ? key_len : 0) + (payload ? len : 0);
+}
+
+void FreeOpaque(void* opaque, bool zero_copy, bool opaque_id) {
+  if (!opaque) {
+    return;
+  }
+
+  void* message_opaque;
+
+  if (zero_copy) {
+    ZeroCopyOpaque* zero_copy_opaque = static_cast<ZeroCopyOpaque*>(opaque);
+    if (zero_copy_opaque->buffer) {
+      zero_copy_opaque->buffer->Reset();
+      delete zero_copy_opaque->buffer;
+    }
+    message_opaque = zero_copy_opaque->opaque;
+    delete zero_copy_opaque;
+  } else {
+    message_opaque = opaque;
+  }
+
+  // Ids own nothing
+  if (message_opaque && !opaque_id) {
+    Nan::Persistent<v8::Value>* persistent =
+      static_cast<Nan::Persistent<v8::Value>*>(message_opaque);
+    persistent->Reset();
+    delete persistent;
+  }
+}
+
 // Delivery Report
 
 Delivery::Delivery():
-  dispatcher() {
+  dispatcher(),
+  m_channel(NULL),
+  m_latency_histograms(NULL) {
     m_dr_msg_cb = false;
+    m_zero_copy = false;
+    m_opaque_ids = false;
   }
 Delivery::~Delivery() {}
 
@@ -435,12 +831,76 @@ void Delivery::SendMessageBuffer(bool send_dr_msg) {
   m_dr_msg_cb = true;
 }
 
+/**
+ * In zero copy mode messages are produced without a copy of their payload,
+ * and their opaque is always a ZeroCopyOpaque. This must be set before the
+ * producer is connected.
+ */
+void Delivery::SetZeroCopy(bool zero_copy) {
+  m_zero_copy = zero_copy;
+}
+
+bool Delivery::IsZeroCopy() {
+  return m_zero_copy;
+}
+
+/**
+ * In opaque id mode the opaque of every message is an integer id, see
+ * OpaqueFromId, and is handed back as a number in its delivery report. This
+ * must be set before the producer is connected.
+ */
+void Delivery::SetOpaqueIds(bool opaque_ids) {
+  m_opaque_ids = opaque_ids;
+}
+
+bool Delivery::UsesOpaqueIds() {
+  return m_opaque_ids;
+}
+
+void Delivery::SetChannel(ProduceChannel* channel) {
+  // Paired with dr_cb, the channel is fully set up before reports see it
+  m_channel.store(channel, std::memory_order_release);
+}
+
+void Delivery::SetLatencyHistograms(LatencyHistograms* histograms) {
+  m_latency_histograms = histograms;
+}
+
+void Delivery::RecordLatency(RdKafka::Message &message) {
+  // librdkafka measures the time since produce itself
+  if (m_latency_histograms && m_latency_histograms->IsEnabled() &&
+      message.err() == RdKafka::ERR_NO_ERROR && message.latency() >= 0) {
+    m_latency_histograms->Record(message, message.latency());
+  }
+}
+
 void Delivery::dr_cb(RdKafka::Message &message) {
-  if (!dispatcher.HasCallbacks()) {
+  // The opaque of a channel message is one of its slots, nothing else may
+  // read it
+  ProduceChannel* channel = m_channel.load(std::memory_order_acquire);
+  if (channel && channel->Owns(message.msg_opaque())) {
+    RecordLatency(message);
+    channel->Delivered(message);
+    return;
+  }
+
+  Deliver(message, message.msg_opaque());
+}
+
+/**
+ * Shared producer handles unwrap the opaque of the message before they hand
+ * the report to the producer of the message.
+ */
+void Delivery::Deliver(RdKafka::Message &message, void* opaque) {
+  RecordLatency(message);
+
+  // Pinned buffers have to be released on the main thread even if nobody
+  // listens for the report.
+  if (!dispatcher.HasCallbacks() && !m_zero_copy) {
     return;
   }
 
-  DeliveryReport msg(message, m_dr_msg_cb);
+  DeliveryReport msg(message, opaque, m_dr_msg_cb, m_zero_copy, m_opaque_ids);
   if (dispatcher.Add(msg) == 1) {
     dispatcher.Execute();
   }
@@ -454,6 +914,7 @@ RebalanceDispatcher::~RebalanceDispatcher() {}
 void RebalanceDispatcher::Add(const rebalance_event_t &e) {
   scoped_mutex_lock lock(async_lock);
   m_events.push_back(e);
+  RecordDepth(m_events.size());
 }
 
 void RebalanceDispatcher::Flush() {
@@ -470,7 +931,9 @@ void RebalanceDispatcher::Flush() {
   {
     scoped_mutex_lock lock(async_lock);
     m_events.swap(events);
+    RecordDepth(0);
   }
+  RecordFlush(events.size());
 
   for (size_t i=0; i < events.size(); i++) {
     v8::Local<v8::Value> argv[argc] = {};
@@ -505,6 +968,7 @@ OffsetCommitDispatcher::~OffsetCommitDispatcher() {}
 void OffsetCommitDispatcher::Add(const offset_commit_event_t &e) {
   scoped_mutex_lock lock(async_lock);
   m_events.push_back(e);
+  RecordDepth(m_events.size());
 }
 
 void OffsetCommitDispatcher::Flush() {
@@ -521,7 +985,9 @@ void OffsetCommitDispatcher::Flush() {
   {
     scoped_mutex_lock lock(async_lock);
     m_events.swap(events);
+    RecordDepth(0);
   }
+  RecordFlush(events.size());
 
   for (size_t i = 0; i < events.size(); i++) {
     v8::Local<v8::Value> argv[argc] = {};
@@ -563,6 +1029,7 @@ void OAuthBearerTokenRefreshDispatcher::Flush() {
     oauthbearer_config = m_oauthbearer_config;
     m_oauthbearer_config.clear();
   }
+  RecordFlush(1);
 
   v8::Local<v8::Value> argv[argc] = {};
   argv[0] = Nan::New<v8::String>(oauthbearer_config.c_str()).ToLocalChecked();
@@ -588,7 +1055,8 @@ int32_t Partitioner::partitioner_cb(const RdKafka::Topic *topic,
   // Send this and get the callback and parse the int
   if (callback.IsEmpty()) {
     // default behavior
-    return random(topic, partition_cnt);
+    return rd_kafka_msg_partitioner_random(topic->c_ptr(), key->data(),
+      key->size(), partition_cnt, NULL, msg_opaque);
   }
 
   Local<Value> argv[3] = {};
@@ -621,21 +1089,30 @@ int32_t Partitioner::partitioner_cb(const RdKafka::Topic *topic,
   return chosen_partition;
 }
 
-unsigned int Partitioner::djb_hash(const char *str, size_t len) {
-  unsigned int hash = 5381;
-  for (size_t i = 0 ; i < len ; i++)
-    hash = ((hash << 5) + hash) + str[i];
-  return hash;
-}
-
-unsigned int Partitioner::random(const RdKafka::Topic *topic, int32_t max) {
-  int32_t random_partition = rand() % max;  // NOLINT
-
-  if (topic->partition_available(random_partition)) {
-    return random_partition;
-  } else {
-    return RdKafka::Topic::PARTITION_UA;
+/**
+ * @brief Look up one of librdkafka's built-in partitioners by the name used
+ * for the `partitioner` configuration property.
+ *
+ * @returns NULL if there is no partitioner with that name.
+ */
+NativePartitioner Partitioner::GetNative(const std::string& name) {
+  if (name == "random") {
+    return rd_kafka_msg_partitioner_random;
+  } else if (name == "consistent") {
+    return rd_kafka_msg_partitioner_consistent;
+  } else if (name == "consistent_random") {
+    return rd_kafka_msg_partitioner_consistent_random;
+  } else if (name == "murmur2") {
+    return rd_kafka_msg_partitioner_murmur2;
+  } else if (name == "murmur2_random") {
+    return rd_kafka_msg_partitioner_murmur2_random;
+  } else if (name == "fnv1a") {
+    return rd_kafka_msg_partitioner_fnv1a;
+  } else if (name == "fnv1a_random") {
+    return rd_kafka_msg_partitioner_fnv1a_random;
   }
+
+  return NULL;
 }
 
 void Partitioner::SetCallback(v8::Local<v8::Function> cb) {
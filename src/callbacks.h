@@ -13,11 +13,16 @@
 #include <uv.h>
 #include <nan.h>
 
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <deque>
+#include <memory>
+#include <string>
 
 #include "rdkafkacpp.h"
 #include "src/common.h"
+#include "src/stats.h"
 
 typedef Nan::Persistent<v8::Function,
   Nan::CopyablePersistentTraits<v8::Function> > PersistentCopyableFunction;
@@ -26,6 +31,8 @@ typedef std::vector<PersistentCopyableFunction> CopyableFunctionList;
 namespace NodeKafka {
 
 class KafkaConsumer;
+class LatencyHistograms;
+class ProduceChannel;
 
 namespace Callbacks {
 
@@ -41,21 +48,39 @@ class Dispatcher {
   void Execute();
   void Activate();
   void Deactivate();
+  v8::Local<v8::Object> GetMetrics();
 
  protected:
   std::vector<v8::Persistent<v8::Function, v8::CopyablePersistentTraits<v8::Function> > > callbacks;  // NOLINT
 
   uv_mutex_t async_lock;
 
+  void RecordFlush(size_t items);
+  void RecordDepth(size_t depth);
+  void RecordBytes(size_t bytes);
+  void RecordDropped();
+
  private:
   NAN_INLINE static NAUV_WORK_CB(AsyncMessage_) {
      Dispatcher *dispatcher =
             static_cast<Dispatcher*>(async->data);
+     Metrics::Increment(dispatcher->m_wakeups);
      dispatcher->Flush();
   }
   static void AsyncHandleCloseCallback(uv_handle_t *);
 
   uv_async_t *async;
+  // Loop of the thread the client was created on
+  uv_loop_t *loop;
+
+  // Wake-ups, items handed to JS, queue depth and the memory it holds, and
+  // items dropped because the queue was full
+  std::atomic<uint64_t> m_wakeups;
+  std::atomic<uint64_t> m_items;
+  std::atomic<uint64_t> m_depth;
+  std::atomic<uint64_t> m_depth_high_water;
+  std::atomic<uint64_t> m_bytes;
+  std::atomic<uint64_t> m_dropped;
 };
 
 struct event_t {
@@ -69,18 +94,38 @@ struct event_t {
   int throttle_time;
   int broker_id;
 
+  // Filtered statistics, replaces message when set
+  std::shared_ptr<Stats::Value> stats;
+
   explicit event_t(const RdKafka::Event &);
   ~event_t();
+
+  // Approximate memory held while queued
+  size_t Footprint() const;
 };
 
+/**
+ * Queues events for the main thread.
+ *
+ * Once max_queued events are waiting, log and statistics events are dropped
+ * until the main thread catches up. Errors and throttle events are always
+ * queued, there are few of them and they matter.
+ */
 class EventDispatcher : public Dispatcher {
  public:
+  // Default for max_queued
+  static const size_t kDefaultMaxQueued = 10000;
+
   EventDispatcher();
   ~EventDispatcher();
   void Add(const event_t &);
   void Flush();
+  void SetMaxQueued(size_t);
  protected:
   std::vector<event_t> events;
+  // 0 if unbounded
+  size_t m_max_queued;
+  size_t m_queued_bytes;
 };
 
 class Event : public RdKafka::EventCb {
@@ -88,9 +133,50 @@ class Event : public RdKafka::EventCb {
   Event();
   ~Event();
   void event_cb(RdKafka::Event&);
+  void SetStatsFilter(std::shared_ptr<const Stats::Filter>);
   EventDispatcher dispatcher;
+ private:
+  // When set, statistics are parsed and filtered before being dispatched
+  std::shared_ptr<const Stats::Filter> m_stats_filter;
+  uv_mutex_t m_stats_filter_lock;
 };
 
+/**
+ * Opaque of a message produced without a copy of its payload.
+ *
+ * librdkafka points straight into the memory of the Buffer, so the Buffer
+ * has to be kept alive until the delivery report for the message has been
+ * handled on the main thread. Both members are separately allocated handles
+ * so the struct itself can be freed from any thread.
+ */
+struct ZeroCopyOpaque {
+  // Opaque the message was produced with, encoded the same way as for a
+  // message produced with a copy. Can be null.
+  void* opaque;
+  // Buffer of the payload, null for a null payload
+  Nan::Persistent<v8::Object>* buffer;
+};
+
+/**
+ * In opaque id mode the opaque of a message is a non-negative integer id
+ * carried in the opaque pointer itself, instead of a persistent handle. The
+ * id is stored plus one, so a message without an opaque keeps a null one.
+ * Nothing has to be allocated or freed for it on either side.
+ */
+inline void* OpaqueFromId(uint64_t id) {
+  return reinterpret_cast<void*>(static_cast<uintptr_t>(id + 1));
+}
+
+inline uint64_t OpaqueToId(void* opaque) {
+  return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(opaque)) - 1;
+}
+
+/**
+ * Free the opaque of a message that will never be reported, with what its
+ * report would have released. Must be called on the main thread.
+ */
+void FreeOpaque(void* opaque, bool zero_copy, bool opaque_id);
+
 /**
  * Delivery report class
  *
@@ -99,11 +185,13 @@ class Event : public RdKafka::EventCb {
  */
 class DeliveryReport {
  public:
-  DeliveryReport(RdKafka::Message &, bool);
+  DeliveryReport(RdKafka::Message &, void* opaque, bool, bool, bool);
   ~DeliveryReport();
 
-  // Whether we include the payload. Is the second parameter to the constructor
+  // Whether we include the payload. Is the third parameter to the constructor
   bool m_include_payload;
+  // Whether the opaque is an id rather than a handle. Is the last parameter
+  bool m_opaque_id;
 
   // If it is an error these will be set
   bool is_error;
@@ -116,7 +204,7 @@ class DeliveryReport {
   int64_t offset;
   int64_t timestamp;
 
-  // Opaque token used. Local value
+  // Opaque token used. A persistent handle, or an id in opaque id mode
   void* opaque;
 
   // Key. It is a pointer to avoid corrupted values
@@ -126,16 +214,49 @@ class DeliveryReport {
 
   size_t len;
   void* payload;
+
+  // Buffer pinned for a message produced without a copy. It is released,
+  // or used as the payload, once the report reaches the main thread.
+  Nan::Persistent<v8::Object>* buffer;
+
+  // Approximate memory held while queued
+  size_t Footprint() const;
 };
 
+/**
+ * Queues delivery reports for the main thread.
+ *
+ * Reports are never dropped. Instead the backlog can be limited: once it
+ * holds max reports or max_bytes, IsFull is set until the main thread has
+ * worked it down to half of both, and then the drain callback is called.
+ * The producer refuses new messages while the backlog is full.
+ */
 class DeliveryReportDispatcher : public Dispatcher {
  public:
   DeliveryReportDispatcher();
   ~DeliveryReportDispatcher();
   void Flush();
   size_t Add(const DeliveryReport &);
+  void SetBatchSize(size_t);
+  void SetBacklogLimits(size_t max, size_t max_bytes);
+  bool IsFull();
+  void SetDrainCallback(const v8::Local<v8::Function>&);
+  void ClearDrainCallback();
  protected:
+  void DispatchEach(const std::vector<DeliveryReport> &);
+  void DispatchBatch(const std::vector<DeliveryReport> &);
+  // Must be called with async_lock held
+  bool BacklogExceeds(size_t divisor);
+
   std::deque<DeliveryReport> events;
+  size_t m_events_bytes;
+  // Maximum number of reports per callback in batch mode, 0 if disabled
+  size_t m_batch_size;
+  // Backlog limits, 0 if unbounded
+  size_t m_backlog_max;
+  size_t m_backlog_max_bytes;
+  std::atomic<bool> m_full;
+  Nan::Persistent<v8::Function> m_drain_callback;
 };
 
 class Delivery : public RdKafka::DeliveryReportCb {
@@ -143,10 +264,29 @@ class Delivery : public RdKafka::DeliveryReportCb {
   Delivery();
   ~Delivery();
   void dr_cb(RdKafka::Message&);
+  // Report a message that was produced with the given opaque
+  void Deliver(RdKafka::Message&, void* opaque);
   DeliveryReportDispatcher dispatcher;
   void SendMessageBuffer(bool dr_copy_payload);
+  void SetZeroCopy(bool zero_copy);
+  bool IsZeroCopy();
+  void SetOpaqueIds(bool opaque_ids);
+  bool UsesOpaqueIds();
+  // Reports of messages the channel produced go to it instead of JS
+  void SetChannel(ProduceChannel* channel);
+  // Where the produce latencies of delivered messages are recorded
+  void SetLatencyHistograms(LatencyHistograms* histograms);
  protected:
+  void RecordLatency(RdKafka::Message&);
+
   bool m_dr_msg_cb;
+  bool m_zero_copy;
+  bool m_opaque_ids;
+  // Set on the main thread, read by whichever thread serves a report. The
+  // channel is only freed once the client is gone and no report can reach
+  // it anymore.
+  std::atomic<ProduceChannel*> m_channel;
+  LatencyHistograms* m_latency_histograms;
 };
 
 // Rebalance dispatcher
@@ -265,6 +405,10 @@ class OAuthBearerTokenRefresh : public RdKafka::OAuthBearerTokenRefreshCb {
   OAuthBearerTokenRefreshDispatcher dispatcher;
 };
 
+// Signature of the partitioners built into librdkafka
+typedef int32_t (*NativePartitioner)(const rd_kafka_topic_t*, const void*,
+  size_t, int32_t, void*, void*);
+
 class Partitioner : public RdKafka::PartitionerCb {
  public:
   Partitioner();
@@ -272,9 +416,8 @@ class Partitioner : public RdKafka::PartitionerCb {
   int32_t partitioner_cb( const RdKafka::Topic*, const std::string*, int32_t, void*);  // NOLINT
   Nan::Callback callback;  // NOLINT
   void SetCallback(v8::Local<v8::Function>);
- private:
-  static unsigned int djb_hash(const char*, size_t);
-  static unsigned int random(const RdKafka::Topic*, int32_t);
+
+  static NativePartitioner GetNative(const std::string&);
 };
 
 }  // namespace Callbacks
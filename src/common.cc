@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "src/common.h"
+#include "src/zero-copy-messages.h"
 
 namespace NodeKafka {
 
@@ -19,6 +20,26 @@ void Log(std::string str) {
   std::cerr << "% " << str.c_str() << std::endl;
 }
 
+unsigned int ConnectionGate::SlotIndex() {
+  // Threads are spread over the slots in the order they first enter a gate
+  static std::atomic<unsigned int> next_slot(0);
+  thread_local unsigned int slot =
+    next_slot.fetch_add(1, std::memory_order_relaxed) % kSlots;
+  return slot;
+}
+
+void ConnectionGate::Close() {
+  m_open.store(false);
+
+  // Threads inside may be blocked in a consume or flush for up to their
+  // timeout, like they would have held the read lock
+  for (unsigned int i = 0; i < kSlots; i++) {
+    while (m_slots[i].readers.load() != 0) {
+      uv_sleep(1);
+    }
+  }
+}
+
 template<typename T>
 T GetParameter(v8::Local<v8::Object> object, std::string field_name, T def) {
   v8::Local<v8::String> field = Nan::New(field_name.c_str()).ToLocalChecked();
@@ -178,6 +199,56 @@ template<> v8::Local<v8::Array> GetParameter<v8::Local<v8::Array> >(
   return def;
 }
 
+PerIsolateFunction::PerIsolateFunction() {
+  // Static, so the lock lives as long as the process
+  uv_mutex_init(&m_lock);
+}
+
+void PerIsolateFunction::Reset(v8::Local<v8::Function> function) {
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+
+  scoped_mutex_lock lock(m_lock);
+  std::map<v8::Isolate*, Entry*>::iterator it = m_entries.find(isolate);
+  if (it != m_entries.end()) {
+    it->second->function.Reset(function);
+    return;
+  }
+
+  Entry* entry = new Entry();
+  entry->owner = this;
+  entry->isolate = isolate;
+  entry->function.Reset(function);
+  m_entries[isolate] = entry;
+
+  node::AddEnvironmentCleanupHook(isolate, PerIsolateFunction::Cleanup, entry);
+}
+
+v8::Local<v8::Function> PerIsolateFunction::Get() {
+  Entry* entry = NULL;
+  {
+    scoped_mutex_lock lock(m_lock);
+    std::map<v8::Isolate*, Entry*>::iterator it =
+      m_entries.find(v8::Isolate::GetCurrent());
+    if (it != m_entries.end()) {
+      entry = it->second;
+    }
+  }
+
+  // Only this thread removes the entry of its isolate
+  return entry ? Nan::New(entry->function) : v8::Local<v8::Function>();
+}
+
+void PerIsolateFunction::Cleanup(void* arg) {
+  Entry* entry = static_cast<Entry*>(arg);
+  {
+    scoped_mutex_lock lock(entry->owner->m_lock);
+    entry->owner->m_entries.erase(entry->isolate);
+  }
+
+  entry->function.Reset();
+  delete entry;
+}
+
 namespace Conversion {
 
 namespace Util {
@@ -411,6 +482,35 @@ std::vector<RdKafka::TopicPartition*> FromV8Array(
   return array;
 }
 
+/**
+ * @brief RdKafka::TopicPartition vector to rd_kafka_topic_partition_list_t,
+ * for the calls only the C API has.
+ *
+ * Keeps the topics, partitions and offsets, in the same order.
+ *
+ * @note Destroy the list with rd_kafka_topic_partition_list_destroy.
+ */
+rd_kafka_topic_partition_list_t* ToTopicPartitionList(
+    const std::vector<RdKafka::TopicPartition*>& topic_partition_list) {
+  rd_kafka_topic_partition_list_t* list =
+    rd_kafka_topic_partition_list_new(topic_partition_list.size());
+
+  for (size_t topic_partition_i = 0;
+       topic_partition_i < topic_partition_list.size(); topic_partition_i++) {
+    const RdKafka::TopicPartition* topic_partition =
+      topic_partition_list[topic_partition_i];
+    if (topic_partition == NULL) {
+      continue;
+    }
+
+    rd_kafka_topic_partition_t* element = rd_kafka_topic_partition_list_add(
+      list, topic_partition->topic().c_str(), topic_partition->partition());
+    element->offset = topic_partition->offset();
+  }
+
+  return list;
+}
+
 /**
  * @brief v8::Object to RdKafka::TopicPartition
  *
@@ -552,6 +652,126 @@ v8::Local<v8::Object> ToV8Object(RdKafka::Metadata* metadata) {
 
 namespace Message {
 
+// The isolate of a thread never changes, so this is one cache per isolate.
+static thread_local Shapes* shapes_instance = NULL;
+
+static v8::Local<v8::String> InternalizedString(v8::Isolate* isolate,
+                                                const char* str) {
+  return v8::String::NewFromUtf8(isolate, str,
+    v8::NewStringType::kInternalized).ToLocalChecked();
+}
+
+Shapes::Shapes(v8::Isolate* isolate) {
+  Nan::HandleScope scope;
+
+  v8::Local<v8::String> value_key = InternalizedString(isolate, "value");
+  v8::Local<v8::String> headers_key = InternalizedString(isolate, "headers");
+  v8::Local<v8::String> size_key = InternalizedString(isolate, "size");
+  v8::Local<v8::String> key_key = InternalizedString(isolate, "key");
+  v8::Local<v8::String> topic_key = InternalizedString(isolate, "topic");
+  v8::Local<v8::String> offset_key = InternalizedString(isolate, "offset");
+  v8::Local<v8::String> partition_key =
+    InternalizedString(isolate, "partition");
+  v8::Local<v8::String> timestamp_key =
+    InternalizedString(isolate, "timestamp");
+  v8::Local<v8::String> message_index_key =
+    InternalizedString(isolate, "messageIndex");
+
+  value.Reset(value_key);
+  headers.Reset(headers_key);
+  size.Reset(size_key);
+  key.Reset(key_key);
+  topic.Reset(topic_key);
+  offset.Reset(offset_key);
+  partition.Reset(partition_key);
+  timestamp.Reset(timestamp_key);
+  message_index.Reset(message_index_key);
+
+  // Property order matches what ToV8Object has always produced.
+  v8::Local<v8::ObjectTemplate> message_tpl = Nan::New<v8::ObjectTemplate>();
+  v8::Local<v8::ObjectTemplate> message_with_headers_tpl =
+    Nan::New<v8::ObjectTemplate>();
+
+  message_tpl->Set(value_key, Nan::Undefined());
+  message_with_headers_tpl->Set(value_key, Nan::Undefined());
+  message_with_headers_tpl->Set(headers_key, Nan::Undefined());
+
+  v8::Local<v8::String> message_keys[] = {
+    size_key, key_key, topic_key, offset_key, partition_key, timestamp_key
+  };
+  for (size_t i = 0; i < sizeof(message_keys) / sizeof(message_keys[0]); i++) {
+    message_tpl->Set(message_keys[i], Nan::Undefined());
+    message_with_headers_tpl->Set(message_keys[i], Nan::Undefined());
+  }
+
+  v8::Local<v8::ObjectTemplate> eof_tpl = Nan::New<v8::ObjectTemplate>();
+  v8::Local<v8::ObjectTemplate> eof_with_index_tpl =
+    Nan::New<v8::ObjectTemplate>();
+
+  v8::Local<v8::String> eof_keys[] = { topic_key, offset_key, partition_key };
+  for (size_t i = 0; i < sizeof(eof_keys) / sizeof(eof_keys[0]); i++) {
+    eof_tpl->Set(eof_keys[i], Nan::Undefined());
+    eof_with_index_tpl->Set(eof_keys[i], Nan::Undefined());
+  }
+  eof_with_index_tpl->Set(message_index_key, Nan::Undefined());
+
+  m_message.Reset(message_tpl);
+  m_message_with_headers.Reset(message_with_headers_tpl);
+  m_eof_event.Reset(eof_tpl);
+  m_eof_event_with_index.Reset(eof_with_index_tpl);
+
+  // Worker threads tear down their isolate, so do not outlive it.
+  node::AddEnvironmentCleanupHook(isolate, Shapes::Cleanup, this);
+}
+
+Shapes::~Shapes() {
+  value.Reset();
+  headers.Reset();
+  size.Reset();
+  key.Reset();
+  topic.Reset();
+  offset.Reset();
+  partition.Reset();
+  timestamp.Reset();
+  message_index.Reset();
+
+  m_message.Reset();
+  m_message_with_headers.Reset();
+  m_eof_event.Reset();
+  m_eof_event_with_index.Reset();
+}
+
+void Shapes::Cleanup(void* arg) {
+  Shapes* shapes = static_cast<Shapes*>(arg);
+  if (shapes_instance == shapes) {
+    shapes_instance = NULL;
+  }
+  delete shapes;
+}
+
+/**
+ * @brief Get the shapes of the current isolate, creating them if needed.
+ *
+ * Must be called on the main thread of an isolate.
+ */
+Shapes* Shapes::Get() {
+  if (!shapes_instance) {
+    shapes_instance = new Shapes(v8::Isolate::GetCurrent());
+  }
+  return shapes_instance;
+}
+
+v8::Local<v8::Object> Shapes::NewMessage(bool with_headers) {
+  return Nan::NewInstance(Nan::New(
+    with_headers ? m_message_with_headers : m_message)).ToLocalChecked();
+}
+
+v8::Local<v8::Object> Shapes::NewEofEvent(bool with_message_index) {
+  return Nan::NewInstance(Nan::New(
+    with_message_index ? m_eof_event_with_index : m_eof_event))
+    .ToLocalChecked();
+}
+
 // Overload for all use cases except delivery reports
 v8::Local<v8::Object> ToV8Object(RdKafka::Message *message) {
   return ToV8Object(message, true, true);
@@ -560,24 +780,47 @@ v8::Local<v8::Object> ToV8Object(RdKafka::Message *message) {
 v8::Local<v8::Object> ToV8Object(RdKafka::Message *message,
                                 bool include_payload,
                                 bool include_headers) {
+  return ToV8Object(message, include_payload, include_headers, NULL);
+}
+
+/**
+ * @brief Convert a message to its v8 representation.
+ *
+ * When zero_copy is set the message is owned by this function from here on:
+ * the value buffer references the payload directly and keeps the message
+ * alive until it is garbage collected or the consumer releases it before
+ * disconnecting, and messages that cannot be pinned
+ * (errors, empty payloads) are deleted before returning. Callers must not
+ * touch the message afterwards.
+ */
+v8::Local<v8::Object> ToV8Object(RdKafka::Message *message,
+                                bool include_payload,
+                                bool include_headers,
+                                ZeroCopyMessages* zero_copy) {
+  Metrics::Increment(Metrics::messages_converted);
+
   if (message->err() == RdKafka::ERR_NO_ERROR) {
-    v8::Local<v8::Object> pack = Nan::New<v8::Object>();
+    Shapes* shapes = Shapes::Get();
+
+    RdKafka::Headers* headers = include_headers ? message->headers() : NULL;
+    v8::Local<v8::Object> pack = shapes->NewMessage(headers != NULL);
 
     const void* message_payload = message->payload();
+    bool pin_payload = zero_copy && include_payload &&
+      message_payload && message->len() > 0;
 
     if (!include_payload) {
-      Nan::Set(pack, Nan::New<v8::String>("value").ToLocalChecked(),
-        Nan::Undefined());
+      // The template already has value set to undefined
+    } else if (pin_payload) {
+      // Set below, once nothing else needs to read from the message
     } else if (message_payload) {
-      Nan::Set(pack, Nan::New<v8::String>("value").ToLocalChecked(),
+      Nan::Set(pack, Nan::New(shapes->value),
         Nan::Encode(message_payload, message->len(), Nan::Encoding::BUFFER));
     } else {
-      Nan::Set(pack, Nan::New<v8::String>("value").ToLocalChecked(),
-        Nan::Null());
+      Nan::Set(pack, Nan::New(shapes->value), Nan::Null());
     }
 
-    RdKafka::Headers* headers;
-    if (((headers = message->headers()) != 0) && include_headers) {
+    if (headers) {
       v8::Local<v8::Array> v8headers = Nan::New<v8::Array>();
       int index = 0;
       std::vector<RdKafka::Headers::Header> all = headers->get_all();
@@ -590,11 +833,10 @@ v8::Local<v8::Object> ToV8Object(RdKafka::Message *message,
         Nan::Set(v8headers, index, v8header);
         index++;
       }
-      Nan::Set(pack,
-        Nan::New<v8::String>("headers").ToLocalChecked(), v8headers);
+      Nan::Set(pack, Nan::New(shapes->headers), v8headers);
     }
 
-    Nan::Set(pack, Nan::New<v8::String>("size").ToLocalChecked(),
+    Nan::Set(pack, Nan::New(shapes->size),
       Nan::New<v8::Number>(message->len()));
 
     const void* key_payload = message->key_pointer();
@@ -602,25 +844,116 @@ v8::Local<v8::Object> ToV8Object(RdKafka::Message *message,
     if (key_payload) {
       // We want this to also be a buffer to avoid corruption
       // https://github.com/confluentinc/confluent-kafka-javascript/issues/208
-      Nan::Set(pack, Nan::New<v8::String>("key").ToLocalChecked(),
+      Nan::Set(pack, Nan::New(shapes->key),
         Nan::Encode(key_payload, message->key_len(), Nan::Encoding::BUFFER));
     } else {
-      Nan::Set(pack, Nan::New<v8::String>("key").ToLocalChecked(),
-        Nan::Null());
+      Nan::Set(pack, Nan::New(shapes->key), Nan::Null());
     }
 
-    Nan::Set(pack, Nan::New<v8::String>("topic").ToLocalChecked(),
+    Nan::Set(pack, Nan::New(shapes->topic),
       Nan::New<v8::String>(message->topic_name()).ToLocalChecked());
-    Nan::Set(pack, Nan::New<v8::String>("offset").ToLocalChecked(),
+    Nan::Set(pack, Nan::New(shapes->offset),
       Nan::New<v8::Number>(message->offset()));
-    Nan::Set(pack, Nan::New<v8::String>("partition").ToLocalChecked(),
+    Nan::Set(pack, Nan::New(shapes->partition),
       Nan::New<v8::Number>(message->partition()));
-    Nan::Set(pack, Nan::New<v8::String>("timestamp").ToLocalChecked(),
+    Nan::Set(pack, Nan::New(shapes->timestamp),
       Nan::New<v8::Number>(message->timestamp().timestamp));
 
+    if (pin_payload) {
+      Nan::MaybeLocal<v8::Object> buffer = zero_copy->NewBuffer(message);
+      if (buffer.IsEmpty()) {
+        // Released, or the buffer could not be created
+        Nan::Set(pack, Nan::New(shapes->value),
+          Nan::Encode(message_payload, message->len(), Nan::Encoding::BUFFER));
+        delete message;
+      } else {
+        Nan::Set(pack, Nan::New(shapes->value), buffer.ToLocalChecked());
+      }
+    } else if (zero_copy) {
+      delete message;
+    }
+
     return pack;
   } else {
-    return RdKafkaError(message->err());
+    v8::Local<v8::Object> err = RdKafkaError(message->err());
+    if (zero_copy) {
+      delete message;
+    }
+    return err;
+  }
+}
+
+/**
+ * @brief Create the partition EOF event for an ERR__PARTITION_EOF message.
+ */
+v8::Local<v8::Object> ToV8EofEvent(RdKafka::Message *message) {
+  Shapes* shapes = Shapes::Get();
+  v8::Local<v8::Object> eofEvent = shapes->NewEofEvent(false);
+
+  Nan::Set(eofEvent, Nan::New(shapes->topic),
+    Nan::New<v8::String>(message->topic_name()).ToLocalChecked());
+  Nan::Set(eofEvent, Nan::New(shapes->offset),
+    Nan::New<v8::Number>(message->offset()));
+  Nan::Set(eofEvent, Nan::New(shapes->partition),
+    Nan::New<v8::Number>(message->partition()));
+
+  return eofEvent;
+}
+
+/**
+ * @brief Convert consumed messages into message and EOF event arrays.
+ *
+ * Every EOF event records the index of the message it follows so it can be
+ * emitted at the right point in time. The messages are freed, or handed over
+ * to their value buffers in zero copy mode.
+ */
+void ToV8Arrays(const std::vector<RdKafka::Message*>& messages,
+                ZeroCopyMessages* zero_copy,
+                v8::Local<v8::Array> returnArray,
+                v8::Local<v8::Array> eofEventsArray) {
+  if (messages.empty()) {
+    return;
+  }
+
+  Shapes* shapes = Shapes::Get();
+  int returnArrayIndex = -1;
+  int eofEventsArrayIndex = -1;
+  for (std::vector<RdKafka::Message*>::const_iterator it = messages.begin();
+      it != messages.end(); ++it) {
+    RdKafka::Message* message = *it;
+
+    switch (message->err()) {
+      case RdKafka::ERR_NO_ERROR:
+        ++returnArrayIndex;
+        Nan::Set(returnArray, returnArrayIndex,
+          ToV8Object(message, true, true, zero_copy));
+        if (zero_copy) {
+          // Ownership of the message moved to the value buffer
+          message = NULL;
+        }
+        break;
+      case RdKafka::ERR__PARTITION_EOF:
+        ++eofEventsArrayIndex;
+
+        // create EOF event
+        v8::Local<v8::Object> eofEvent = shapes->NewEofEvent(true);
+
+        Nan::Set(eofEvent, Nan::New(shapes->topic),
+          Nan::New<v8::String>(message->topic_name()).ToLocalChecked());
+        Nan::Set(eofEvent, Nan::New(shapes->offset),
+          Nan::New<v8::Number>(message->offset()));
+        Nan::Set(eofEvent, Nan::New(shapes->partition),
+          Nan::New<v8::Number>(message->partition()));
+
+        // also store index at which position in the message array this event was emitted
+        // this way, we can later emit it at the right point in time
+        Nan::Set(eofEvent, Nan::New(shapes->message_index),
+          Nan::New<v8::Number>(returnArrayIndex));
+
+        Nan::Set(eofEventsArray, eofEventsArrayIndex, eofEvent);
+    }
+
+    delete message;
   }
 }
 
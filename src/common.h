@@ -12,8 +12,11 @@
 #define SRC_COMMON_H_
 
 #include <nan.h>
+#include <uv.h>
 
+#include <atomic>
 #include <iostream>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -21,6 +24,7 @@
 #include "rdkafka.h"  // NOLINT
 
 #include "src/errors.h"
+#include "src/metrics.h"
 
 typedef std::vector<const RdKafka::BrokerMetadata*> BrokerMetadataList;
 typedef std::vector<const RdKafka::PartitionMetadata*> PartitionMetadataList;
@@ -62,11 +66,17 @@ int uv_rwlock_tryrdlock(uv_rwlock_t* rwlock)
 int uv_rwlock_trywrlock(uv_rwlock_t* rwlock)
  */
 
+// Connection locks only pay for timing when they are contended
 class scoped_shared_write_lock {
  public:
   explicit scoped_shared_write_lock(uv_rwlock_t& lock_) :  // NOLINT
     async_lock(lock_) {
-      uv_rwlock_wrlock(&async_lock);
+      if (uv_rwlock_trywrlock(&async_lock) != 0) {
+        uint64_t start = uv_hrtime();
+        uv_rwlock_wrlock(&async_lock);
+        Metrics::Increment(Metrics::lock_waits);
+        Metrics::Increment(Metrics::lock_wait_ns, uv_hrtime() - start);
+      }
     }
 
   ~scoped_shared_write_lock() {
@@ -81,7 +91,12 @@ class scoped_shared_read_lock {
  public:
   explicit scoped_shared_read_lock(uv_rwlock_t& lock_) :  // NOLINT
     async_lock(lock_) {
-      uv_rwlock_rdlock(&async_lock);
+      if (uv_rwlock_tryrdlock(&async_lock) != 0) {
+        uint64_t start = uv_hrtime();
+        uv_rwlock_rdlock(&async_lock);
+        Metrics::Increment(Metrics::lock_waits);
+        Metrics::Increment(Metrics::lock_wait_ns, uv_hrtime() - start);
+      }
     }
 
   ~scoped_shared_read_lock() {
@@ -92,6 +107,113 @@ class scoped_shared_read_lock {
   uv_rwlock_t &async_lock;
 };
 
+/**
+ * @brief Connection state for the produce and consume hot paths.
+ *
+ * Entering the gate stands in for read locking m_connection_lock: it bumps
+ * a reader count kept on a cache line of the calling thread's own and
+ * checks that the gate is open, so the main thread and the consume or poll
+ * threads don't bounce a shared lock word on every call. Closing the gate
+ * waits for the threads inside to leave, after which the handle may be
+ * destroyed.
+ */
+class ConnectionGate {
+ public:
+  ConnectionGate() : m_open(false) {}
+
+  // Open once the handle is usable
+  void Open() {
+    m_open.store(true);
+  }
+
+  // Close and wait for every thread inside to leave
+  void Close();
+
+  // Only Leave the slot if the gate was entered
+  bool Enter(unsigned int* slot) {
+    *slot = SlotIndex();
+    m_slots[*slot].readers.fetch_add(1);
+    // Paired with Close, which clears m_open before it reads the counts
+    if (m_open.load()) {
+      return true;
+    }
+    m_slots[*slot].readers.fetch_sub(1);
+    return false;
+  }
+
+  void Leave(unsigned int slot) {
+    m_slots[slot].readers.fetch_sub(1, std::memory_order_release);
+  }
+
+ private:
+  static const unsigned int kSlots = 8;
+
+  struct alignas(64) Slot {
+    std::atomic<int64_t> readers{0};
+  };
+
+  static unsigned int SlotIndex();
+
+  Slot m_slots[kSlots];
+  alignas(64) std::atomic<bool> m_open;
+};
+
+class scoped_gate_entry {
+ public:
+  explicit scoped_gate_entry(ConnectionGate& gate_) :  // NOLINT
+    gate(gate_) {
+      entered = gate.Enter(&slot);
+  }
+
+  ~scoped_gate_entry() {
+    if (entered) {
+      gate.Leave(slot);
+    }
+  }
+
+  // Whether the connection can be used for the lifetime of this entry
+  bool connected() const {
+    return entered;
+  }
+
+ private:
+  ConnectionGate &gate;
+  unsigned int slot;
+  bool entered;
+};
+
+/**
+ * @brief A function kept per isolate, for the constructors of the wrapped
+ * classes.
+ *
+ * Every worker thread that loads the binding runs it in an isolate of its
+ * own, and a handle of one isolate cannot be used in another. The function
+ * of an isolate is let go of when its environment is torn down.
+ *
+ * Reset and Get must be called on the thread the isolate runs on.
+ */
+class PerIsolateFunction {
+ public:
+  PerIsolateFunction();
+
+  void Reset(v8::Local<v8::Function>);
+  v8::Local<v8::Function> Get();
+
+ private:
+  struct Entry {
+    PerIsolateFunction* owner;
+    v8::Isolate* isolate;
+    Nan::Persistent<v8::Function> function;
+  };
+
+  static void Cleanup(void*);
+
+  std::map<v8::Isolate*, Entry*> m_entries;
+  uv_mutex_t m_lock;
+};
+
+class ZeroCopyMessages;
+
 namespace Conversion {
 
 namespace Util {
@@ -138,6 +260,8 @@ v8::Local<v8::Array> ToTopicPartitionV8Array(
     const rd_kafka_topic_partition_list_t *, bool include_offset);
 RdKafka::TopicPartition *FromV8Object(v8::Local<v8::Object>);
 std::vector<RdKafka::TopicPartition *> FromV8Array(const v8::Local<v8::Array> &);  // NOLINT
+rd_kafka_topic_partition_list_t *ToTopicPartitionList(
+    const std::vector<RdKafka::TopicPartition *> &);
 
 }  // namespace TopicPartition
 
@@ -149,8 +273,49 @@ v8::Local<v8::Object> ToV8Object(RdKafka::Metadata*);
 
 namespace Message {
 
+/**
+ * @brief Internalized keys and object templates for message objects.
+ *
+ * There is one instance per isolate, created on first use on the thread the
+ * isolate runs on. Building every message from the same template gives all
+ * of them the same hidden class, and saves creating and looking up the
+ * property keys for every single message.
+ */
+class Shapes {
+ public:
+  static Shapes* Get();
+
+  v8::Local<v8::Object> NewMessage(bool with_headers);
+  v8::Local<v8::Object> NewEofEvent(bool with_message_index);
+
+  Nan::Persistent<v8::String> value;
+  Nan::Persistent<v8::String> headers;
+  Nan::Persistent<v8::String> size;
+  Nan::Persistent<v8::String> key;
+  Nan::Persistent<v8::String> topic;
+  Nan::Persistent<v8::String> offset;
+  Nan::Persistent<v8::String> partition;
+  Nan::Persistent<v8::String> timestamp;
+  Nan::Persistent<v8::String> message_index;
+
+ private:
+  explicit Shapes(v8::Isolate*);
+  ~Shapes();
+  static void Cleanup(void*);
+
+  Nan::Persistent<v8::ObjectTemplate> m_message;
+  Nan::Persistent<v8::ObjectTemplate> m_message_with_headers;
+  Nan::Persistent<v8::ObjectTemplate> m_eof_event;
+  Nan::Persistent<v8::ObjectTemplate> m_eof_event_with_index;
+};
+
 v8::Local<v8::Object> ToV8Object(RdKafka::Message*);
 v8::Local<v8::Object> ToV8Object(RdKafka::Message*, bool, bool);
+v8::Local<v8::Object> ToV8Object(RdKafka::Message*, bool, bool,
+  ZeroCopyMessages*);
+v8::Local<v8::Object> ToV8EofEvent(RdKafka::Message*);
+void ToV8Arrays(const std::vector<RdKafka::Message*>&, ZeroCopyMessages*,
+  v8::Local<v8::Array>, v8::Local<v8::Array>);
 
 }
 
@@ -180,6 +180,28 @@ Conf::~Conf() {
   delete rdconf;
 }
 
+// Adds the metrics of the dispatchers of the callbacks set on this config
+void Conf::AddDispatcherMetrics(v8::Local<v8::Object> obj) const {
+  NodeKafka::Callbacks::Rebalance *rebalance = rebalance_cb();
+  if (rebalance) {
+    Nan::Set(obj, Nan::New("rebalance").ToLocalChecked(),
+      rebalance->dispatcher.GetMetrics());
+  }
+
+  NodeKafka::Callbacks::OffsetCommit *offset_commit = offset_commit_cb();
+  if (offset_commit) {
+    Nan::Set(obj, Nan::New("offsetCommit").ToLocalChecked(),
+      offset_commit->dispatcher.GetMetrics());
+  }
+
+  NodeKafka::Callbacks::OAuthBearerTokenRefresh *oauthbearer_token_refresh =
+      oauthbearer_token_refresh_cb();
+  if (oauthbearer_token_refresh) {
+    Nan::Set(obj, Nan::New("oauthBearerTokenRefresh").ToLocalChecked(),
+      oauthbearer_token_refresh->dispatcher.GetMetrics());
+  }
+}
+
 NodeKafka::Callbacks::Rebalance* Conf::rebalance_cb() const {
   RdKafka::RebalanceCb *cb = NULL;
   if (this->get(cb) != RdKafka::Conf::CONF_OK) {
@@ -36,6 +36,8 @@ class Conf : public RdKafka::Conf {
 
   bool is_sasl_oauthbearer() const;
 
+  void AddDispatcherMetrics(v8::Local<v8::Object>) const;
+
  private:
   NodeKafka::Callbacks::Rebalance *rebalance_cb() const;
   NodeKafka::Callbacks::OffsetCommit *offset_commit_cb() const;
@@ -8,11 +8,13 @@
  * of the MIT license.  See the LICENSE.txt file for details.
  */
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "src/connection.h"
 #include "src/workers.h"
+#include "src/worker-pool.h"
 
 using RdKafka::Conf;
 
@@ -41,12 +43,14 @@ namespace NodeKafka {
 Connection::Connection(Conf* gconfig, Conf* tconfig):
   m_event_cb(),
   m_gconfig(gconfig),
-  m_tconfig(tconfig) {
+  m_tconfig(tconfig),
+  m_isolate(v8::Isolate::GetCurrent()) {
     std::string errstr;
 
     m_client = NULL;
     m_is_closing = false;
     uv_rwlock_init(&m_connection_lock);
+    uv_mutex_init(&m_topic_cache_lock);
 
     // Try to set the event cb. Shouldn't be an error here, but if there
     // is, it doesn't get reported.
@@ -54,10 +58,17 @@ Connection::Connection(Conf* gconfig, Conf* tconfig):
     // Perhaps node new methods should report this as an error? But there
     // isn't anything the user can do about it.
     m_gconfig->set("event_cb", &m_event_cb, errstr);
+
+    node::AddEnvironmentCleanupHook(m_isolate, Connection::EnvironmentCleanup,
+      this);
   }
 
 Connection::~Connection() {
+  node::RemoveEnvironmentCleanupHook(m_isolate,
+    Connection::EnvironmentCleanup, this);
+
   uv_rwlock_destroy(&m_connection_lock);
+  uv_mutex_destroy(&m_topic_cache_lock);
 
   if (m_tconfig) {
     delete m_tconfig;
@@ -68,6 +79,10 @@ Connection::~Connection() {
   }
 }
 
+void Connection::EnvironmentCleanup(void* arg) {
+  static_cast<Connection*>(arg)->Teardown();
+}
+
 Baton Connection::rdkafkaErrorToBaton(RdKafka::Error* error) {
   if ( NULL == error) {
     return Baton(RdKafka::ERR_NO_ERROR);
@@ -164,6 +179,63 @@ Baton Connection::CreateTopic(std::string topic_name, RdKafka::Conf* conf) {
   return Baton(topic);
 }
 
+/**
+ * @brief Get the topic handle for a topic, creating it on first use.
+ *
+ * Handles are kept for the lifetime of the connection, so producing to a
+ * topic does not create and destroy one every time. librdkafka keeps a
+ * single topic object per name and only applies a topic configuration when
+ * that object is first created, so handles are cached by name and the
+ * configuration of later lookups is ignored, same as it would be by
+ * librdkafka.
+ *
+ * The caller must hold m_connection_lock, for reading or writing, and must
+ * not use the handle after releasing it: the cache is cleared when the
+ * client is destroyed.
+ *
+ * @param topic_name - Name of the topic.
+ * @param conf - Topic configuration to create the handle with, or NULL for
+ * the default topic configuration.
+ * @param errstr - Set to the reason when the handle cannot be created.
+ * @return The cached handle, or NULL on failure.
+ */
+RdKafka::Topic* Connection::GetCachedTopic(const std::string& topic_name,
+                                           RdKafka::Conf* conf,
+                                           std::string& errstr) {
+  scoped_mutex_lock lock(m_topic_cache_lock);
+
+  std::unordered_map<std::string, RdKafka::Topic*>::iterator it =
+    m_topic_cache.find(topic_name);
+  if (it != m_topic_cache.end()) {
+    return it->second;
+  }
+
+  RdKafka::Topic* topic =
+    RdKafka::Topic::create(m_client, topic_name, conf, errstr);
+  if (topic != NULL) {
+    m_topic_cache[topic_name] = topic;
+  }
+
+  return topic;
+}
+
+/**
+ * @brief Destroy all cached topic handles.
+ *
+ * Has to run before the client is destroyed, with m_connection_lock held
+ * for writing.
+ */
+void Connection::ClearTopicCache() {
+  scoped_mutex_lock lock(m_topic_cache_lock);
+
+  for (std::unordered_map<std::string, RdKafka::Topic*>::iterator it =
+       m_topic_cache.begin(); it != m_topic_cache.end(); ++it) {
+    delete it->second;
+  }
+
+  m_topic_cache.clear();
+}
+
 Baton Connection::QueryWatermarkOffsets(
   std::string topic_name, int32_t partition,
   int64_t* low_offset, int64_t* high_offset,
@@ -263,6 +335,25 @@ Baton Connection::GetMetadata(
   }
 }
 
+/**
+ * @brief Fetch the metadata of all topics into the metadata cache.
+ *
+ * @param changes - Set to what changed since the previous refresh.
+ */
+Baton Connection::RefreshMetadataCache(int timeout_ms,
+    std::vector<MetadataCache::Change>* changes) {
+  Baton b = GetMetadata(true, std::string(), timeout_ms);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return b;
+  }
+
+  RdKafka::Metadata* metadata = b.data<RdKafka::Metadata*>();
+  *changes = m_metadata_cache.Update(metadata);
+  delete metadata;
+
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
+
 Baton Connection::SetSaslCredentials(
   std::string username, std::string password) {
   RdKafka::Error *error;
@@ -328,6 +419,16 @@ Baton Connection::SetOAuthBearerTokenFailure(const std::string& errstr) {
 void Connection::ConfigureCallback(const std::string &string_key, const v8::Local<v8::Function> &cb, bool add) {
   if (string_key.compare("event_cb") == 0) {
     if (add) {
+      v8::Local<v8::String> max_queued_key =
+        Nan::New("max_queued").ToLocalChecked();
+      if (Nan::Has(cb, max_queued_key).FromMaybe(false)) {
+        v8::Local<v8::Value> v = Nan::Get(cb, max_queued_key).ToLocalChecked();
+        if (v->IsNumber()) {
+          int64_t max_queued = Nan::To<int64_t>(v).FromJust();
+          this->m_event_cb.dispatcher.SetMaxQueued(
+            max_queued > 0 ? static_cast<size_t>(max_queued) : 0);
+        }
+      }
       this->m_event_cb.dispatcher.AddCallback(cb);
     } else {
       this->m_event_cb.dispatcher.RemoveCallback(cb);
@@ -362,12 +463,49 @@ NAN_METHOD(Connection::NodeGetMetadata) {
 
   Nan::Callback *callback = new Nan::Callback(cb);
 
-  Nan::AsyncQueueWorker(new Workers::ConnectionMetadata(
+  WorkerPool::Queue(new Workers::ConnectionMetadata(
     callback, obj, topic, timeout_ms, allTopics));
 
   info.GetReturnValue().Set(Nan::Null());
 }
 
+NAN_METHOD(Connection::NodeRefreshMetadataCache) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 2 || !info[0]->IsNumber()) {
+    return Nan::ThrowError("Need to specify a timeout");
+  }
+
+  if (!info[1]->IsFunction()) {
+    return Nan::ThrowError("Need to specify a callback");
+  }
+
+  Connection* obj = ObjectWrap::Unwrap<Connection>(info.This());
+
+  int timeout_ms = Nan::To<int32_t>(info[0]).FromJust();
+  Nan::Callback *callback = new Nan::Callback(info[1].As<v8::Function>());
+
+  WorkerPool::Queue(new Workers::ConnectionRefreshMetadataCache(
+    callback, obj, timeout_ms));
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
+NAN_METHOD(Connection::NodeGetCachedTopicMetadata) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 1 || !info[0]->IsString()) {
+    return Nan::ThrowError("Topic must be a string");
+  }
+
+  Connection* obj = ObjectWrap::Unwrap<Connection>(info.This());
+
+  Nan::Utf8String topicUTF8(info[0]);
+  std::string topic(*topicUTF8, topicUTF8.length());
+
+  info.GetReturnValue().Set(obj->m_metadata_cache.TopicToV8Object(topic));
+}
+
 NAN_METHOD(Connection::NodeOffsetsForTimes) {
   Nan::HandleScope scope;
 
@@ -394,7 +532,7 @@ NAN_METHOD(Connection::NodeOffsetsForTimes) {
 
   Connection* handle = ObjectWrap::Unwrap<Connection>(info.This());
 
-  Nan::AsyncQueueWorker(
+  WorkerPool::Queue(
     new Workers::Handle::OffsetsForTimes(callback, handle,
       toppars, timeout_ms));
 
@@ -441,7 +579,7 @@ NAN_METHOD(Connection::NodeQueryWatermarkOffsets) {
   v8::Local<v8::Function> cb = info[3].As<v8::Function>();
   Nan::Callback *callback = new Nan::Callback(cb);
 
-  Nan::AsyncQueueWorker(new Workers::ConnectionQueryWatermarkOffsets(
+  WorkerPool::Queue(new Workers::ConnectionQueryWatermarkOffsets(
     callback, obj, topic_name, partition, timeout_ms));
 
   info.GetReturnValue().Set(Nan::Null());
@@ -636,6 +774,92 @@ NAN_METHOD(Connection::NodeSetOAuthBearerTokenFailure) {
   info.GetReturnValue().Set(Nan::Null());
 }
 
+NAN_METHOD(Connection::NodeSetStatsFields) {
+  Nan::HandleScope scope;
+
+  Connection* obj = ObjectWrap::Unwrap<Connection>(info.This());
+
+  if (info.Length() < 1 || info[0]->IsNull() || info[0]->IsUndefined()) {
+    obj->m_event_cb.SetStatsFilter(std::shared_ptr<const Stats::Filter>());
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  if (!info[0]->IsArray()) {
+    return Nan::ThrowError("Stats fields must be an array of strings");
+  }
+
+  std::vector<std::string> fields =
+    v8ArrayToStringVector(info[0].As<v8::Array>());
+
+  obj->m_event_cb.SetStatsFilter(std::make_shared<Stats::Filter>(fields));
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
+void Connection::AddDispatcherMetrics(v8::Local<v8::Object> obj) {
+  Nan::Set(obj, Nan::New("event").ToLocalChecked(),
+    m_event_cb.dispatcher.GetMetrics());
+  m_gconfig->AddDispatcherMetrics(obj);
+}
+
+/**
+ * Counters of the Node side of the client: its dispatchers, plus the
+ * process wide message conversion, connection lock and worker metrics.
+ */
+NAN_METHOD(Connection::NodeGetNativeMetrics) {
+  Nan::HandleScope scope;
+
+  Connection* obj = ObjectWrap::Unwrap<Connection>(info.This());
+
+  v8::Local<v8::Object> metrics = Nan::New<v8::Object>();
+  v8::Local<v8::Object> dispatchers = Nan::New<v8::Object>();
+  obj->AddDispatcherMetrics(dispatchers);
+  Nan::Set(metrics, Nan::New("dispatchers").ToLocalChecked(), dispatchers);
+  Metrics::AddProcessMetrics(metrics);
+  WorkerPool::AddMetrics(metrics);
+
+  info.GetReturnValue().Set(metrics);
+}
+
+NAN_METHOD(Connection::NodeSetLatencyHistograms) {
+  Nan::HandleScope scope;
+
+  Connection* obj = ObjectWrap::Unwrap<Connection>(info.This());
+
+  if (info.Length() < 1 || !info[0]->IsBoolean()) {
+    return Nan::ThrowError("Need to specify a boolean");
+  }
+
+  obj->m_latency_histograms.SetEnabled(
+    Nan::To<bool>(info[0]).ToChecked());
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
+/**
+ * Latency percentiles in microseconds per topic, from the time of produce
+ * to the delivery report for producers and from the message timestamp to
+ * the time of consume for consumers.
+ */
+NAN_METHOD(Connection::NodeGetLatencyHistograms) {
+  Nan::HandleScope scope;
+
+  Connection* obj = ObjectWrap::Unwrap<Connection>(info.This());
+
+  info.GetReturnValue().Set(obj->m_latency_histograms.ToV8Object());
+}
+
+NAN_METHOD(Connection::NodeResetLatencyHistograms) {
+  Nan::HandleScope scope;
+
+  Connection* obj = ObjectWrap::Unwrap<Connection>(info.This());
+
+  obj->m_latency_histograms.Reset();
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
 NAN_METHOD(Connection::NodeName) {
   Connection* obj = ObjectWrap::Unwrap<Connection>(info.This());
   std::string name = obj->Name();
@@ -14,6 +14,7 @@
 #include <nan.h>
 #include <iostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "rdkafkacpp.h"
@@ -22,6 +23,8 @@
 #include "src/errors.h"
 #include "src/config.h"
 #include "src/callbacks.h"
+#include "src/metadata-cache.h"
+#include "src/latency-histogram.h"
 
 namespace NodeKafka {
 
@@ -54,6 +57,7 @@ class Connection : public Nan::ObjectWrap {
   Baton CreateTopic(std::string);
   Baton CreateTopic(std::string, RdKafka::Conf*);
   Baton GetMetadata(bool, std::string, int);
+  Baton RefreshMetadataCache(int, std::vector<MetadataCache::Change>*);
   Baton QueryWatermarkOffsets(std::string, int32_t, int64_t*, int64_t*, int);
   Baton OffsetsForTimes(std::vector<RdKafka::TopicPartition*> &, int);
   Baton SetSaslCredentials(std::string, std::string);
@@ -71,21 +75,35 @@ class Connection : public Nan::ObjectWrap {
   virtual void ActivateDispatchers() = 0;
   virtual void DeactivateDispatchers() = 0;
 
+  /**
+   * Disconnect and close the loop handles without calling back into JS.
+   * Run when the environment the client was created in is torn down, as
+   * the wrapper is not collected before a worker thread exits.
+   */
+  virtual void Teardown() = 0;
+
   virtual void ConfigureCallback(const std::string &string_key, const v8::Local<v8::Function> &cb, bool add);
 
+  virtual void AddDispatcherMetrics(v8::Local<v8::Object>);
+
   std::string Name() const;
 
  protected:
   Connection(Conf*, Conf*);
   ~Connection();
 
-  static Nan::Persistent<v8::Function> constructor;
   static void New(const Nan::FunctionCallbackInfo<v8::Value>& info);
+  static void EnvironmentCleanup(void*);
   static Baton rdkafkaErrorToBaton(RdKafka::Error* error);
 
   Baton setupSaslOAuthBearerConfig();
   Baton setupSaslOAuthBearerBackgroundQueue();
 
+  // Must be called with m_connection_lock held or m_gate entered
+  RdKafka::Topic* GetCachedTopic(const std::string&, RdKafka::Conf*,
+    std::string&);
+  void ClearTopicCache();
+
   bool m_has_been_disconnected;
   bool m_is_closing;
 
@@ -93,18 +111,42 @@ class Connection : public Nan::ObjectWrap {
   Conf* m_tconfig;
   std::string m_errstr;
 
+  // The isolate the client was created in, its callbacks run on its thread
+  v8::Isolate* m_isolate;
+
   uv_rwlock_t m_connection_lock;
 
+  // Open while m_client is usable. The produce and consume hot paths enter
+  // it instead of taking m_connection_lock; disconnecting closes it, in
+  // addition to taking the write lock, before the handle is destroyed.
+  ConnectionGate m_gate;
+
   RdKafka::Handle* m_client;
 
+  // Topic handles reused across produce calls, destroyed on disconnect
+  std::unordered_map<std::string, RdKafka::Topic*> m_topic_cache;
+  uv_mutex_t m_topic_cache_lock;
+
+  MetadataCache m_metadata_cache;
+
+  // Produce or consume latencies per topic, off unless enabled from JS
+  LatencyHistograms m_latency_histograms;
+
   static NAN_METHOD(NodeConfigureCallbacks);
   static NAN_METHOD(NodeGetMetadata);
+  static NAN_METHOD(NodeRefreshMetadataCache);
+  static NAN_METHOD(NodeGetCachedTopicMetadata);
   static NAN_METHOD(NodeQueryWatermarkOffsets);
   static NAN_METHOD(NodeOffsetsForTimes);
   static NAN_METHOD(NodeSetSaslCredentials);
   static NAN_METHOD(NodeSetOAuthBearerToken);
   static NAN_METHOD(NodeSetOAuthBearerTokenFailure);
   static NAN_METHOD(NodeName);
+  static NAN_METHOD(NodeSetStatsFields);
+  static NAN_METHOD(NodeGetNativeMetrics);
+  static NAN_METHOD(NodeSetLatencyHistograms);
+  static NAN_METHOD(NodeGetLatencyHistograms);
+  static NAN_METHOD(NodeResetLatencyHistograms);
 };
 
 }  // namespace NodeKafka
@@ -0,0 +1,169 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#include <string>
+#include <vector>
+
+#include "src/consume-watcher.h"
+#include "src/kafka-consumer.h"
+
+namespace NodeKafka {
+
+ConsumeWatcher::ConsumeWatcher(KafkaConsumer* consumer,
+    unsigned int batch_size, v8::Local<v8::Function> callback) :
+  m_consumer(consumer),
+  m_batch_size(batch_size),
+  m_running(false),
+  m_queue(NULL),
+  m_open_handles(2),
+  m_callback(callback) {
+  uv_async_init(Nan::GetCurrentEventLoop(), &m_async, AsyncDrain);
+  m_async.data = this;
+  uv_timer_init(Nan::GetCurrentEventLoop(), &m_timer);
+  m_timer.data = this;
+  // The async handle already keeps the loop alive while watching
+  uv_unref(reinterpret_cast<uv_handle_t*>(&m_timer));
+}
+
+ConsumeWatcher::~ConsumeWatcher() {}
+
+Baton ConsumeWatcher::Start() {
+  m_queue = rd_kafka_queue_get_consumer(m_consumer->m_consumer->c_ptr());
+  if (!m_queue) {
+    return Baton(RdKafka::ERR__STATE, "The consumer has no queue to watch");
+  }
+
+  rd_kafka_queue_cb_event_enable(m_queue, QueueNonEmpty, this);
+  m_running = true;
+
+  uint64_t max_poll_interval_ms = 300000;
+  std::string value;
+  if (m_consumer->m_gconfig->get("max.poll.interval.ms", value) ==
+        RdKafka::Conf::CONF_OK) {
+    max_poll_interval_ms = std::stoull(value);
+  }
+  uint64_t interval_ms = max_poll_interval_ms / 4 > 0 ?
+    max_poll_interval_ms / 4 : 1;
+  uv_timer_start(&m_timer, TimerDrain, interval_ms, interval_ms);
+
+  // The queue is only reported once it stops being empty, so drain whatever
+  // it already holds
+  uv_async_send(&m_async);
+
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
+
+void ConsumeWatcher::Stop() {
+  m_running = false;
+  uv_timer_stop(&m_timer);
+
+  if (!m_queue) {
+    return;
+  }
+
+  rd_kafka_queue_cb_event_enable(m_queue, NULL, NULL);
+  rd_kafka_queue_destroy(m_queue);
+  m_queue = NULL;
+}
+
+void ConsumeWatcher::Close() {
+  uv_close(reinterpret_cast<uv_handle_t*>(&m_async), HandleClosed);
+  uv_close(reinterpret_cast<uv_handle_t*>(&m_timer), HandleClosed);
+}
+
+void ConsumeWatcher::HandleClosed(uv_handle_t* handle) {
+  ConsumeWatcher* watcher = static_cast<ConsumeWatcher*>(handle->data);
+  if (--watcher->m_open_handles == 0) {
+    delete watcher;
+  }
+}
+
+void ConsumeWatcher::QueueNonEmpty(rd_kafka_t* rk, void* opaque) {
+  uv_async_send(&static_cast<ConsumeWatcher*>(opaque)->m_async);
+}
+
+void ConsumeWatcher::AsyncDrain(uv_async_t* handle) {
+  static_cast<ConsumeWatcher*>(handle->data)->Drain();
+}
+
+void ConsumeWatcher::TimerDrain(uv_timer_t* handle) {
+  static_cast<ConsumeWatcher*>(handle->data)->Drain();
+}
+
+void ConsumeWatcher::Drain() {
+  if (!m_running) {
+    return;
+  }
+
+  Nan::HandleScope scope;
+
+  // Any drain polls the consumer, the timer only has to fire when none did
+  uv_timer_again(&m_timer);
+
+  std::vector<RdKafka::Message*> messages;
+  messages.reserve(m_batch_size);
+  bool timed_out;
+  Baton b = m_consumer->ConsumeBatch(messages, m_batch_size, 0, false,
+    &timed_out);
+  RdKafka::ErrorCode ec = b.err();
+
+  // The consumer cannot go on after these
+  bool fatal = ec == RdKafka::ERR__FATAL || ec == RdKafka::ERR__STATE;
+
+  // Nothing but a timeout empties the queue, after anything else there may
+  // be more left that will not be reported again. That includes an error
+  // the batch was cut short by, which is only returned by the next drain.
+  bool drain_again = !timed_out && !fatal;
+
+  const unsigned int argc = 4;
+  v8::Local<v8::Value> argv[argc];
+
+  if (!messages.empty()) {
+    v8::Local<v8::Array> returnArray = Nan::New<v8::Array>();
+    v8::Local<v8::Array> eofEventsArray = Nan::New<v8::Array>();
+    Conversion::Message::ToV8Arrays(messages, m_consumer->ZeroCopy(),
+      returnArray, eofEventsArray);
+
+    argv[0] = Nan::Null();
+    argv[1] = returnArray;
+    argv[2] = eofEventsArray;
+    argv[3] = Nan::Null();
+    m_callback.Call(argc, argv);
+  }
+
+  // The callback may have disconnected
+  if (!m_running) {
+    return;
+  }
+
+  if (fatal) {
+    Stop();
+
+    argv[0] = b.ToObject();
+    argv[1] = Nan::Null();
+    argv[2] = Nan::Null();
+    argv[3] = Nan::Null();
+    m_callback.Call(argc, argv);
+    return;
+  } else if (ec != RdKafka::ERR_NO_ERROR) {
+    // Like a poll interval exceeded, the consumer recovers on its own
+    argv[0] = Nan::Null();
+    argv[1] = Nan::Null();
+    argv[2] = Nan::Null();
+    argv[3] = Nan::New<v8::Number>(ec);
+    m_callback.Call(argc, argv);
+  }
+
+  if (drain_again && m_running) {
+    uv_async_send(&m_async);
+  }
+}
+
+}  // namespace NodeKafka
@@ -0,0 +1,85 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#ifndef SRC_CONSUME_WATCHER_H_
+#define SRC_CONSUME_WATCHER_H_
+
+#include <nan.h>
+#include <uv.h>
+
+#include "rdkafkacpp.h"
+#include "rdkafka.h"  // NOLINT
+
+#include "src/errors.h"
+
+namespace NodeKafka {
+
+class KafkaConsumer;
+
+/**
+ * @brief Consumes on the main thread whenever librdkafka has something for
+ * the consumer, instead of a worker waiting on timeouts.
+ *
+ * librdkafka calls back when its consumer queue stops being empty, which
+ * wakes the event loop through an async handle. The queue is then drained
+ * without blocking, in batches of up to batch size, and the batches are
+ * handed over like those of the batched consume loop. A full batch drains
+ * again on the next turn of the loop, so other work is not starved.
+ *
+ * librdkafka only counts the consumer as alive while it is polled, so a
+ * timer also drains whenever nothing else did for a quarter of
+ * max.poll.interval.ms, even if the queue stayed empty.
+ *
+ * Errors are called back as warnings, the consumer keeps going after them.
+ * Only fatal errors and disconnects stop the watcher after they were called
+ * back.
+ */
+class ConsumeWatcher {
+ public:
+  ConsumeWatcher(KafkaConsumer*, unsigned int batch_size,
+    v8::Local<v8::Function> callback);
+
+  // Must have the connection read locked
+  Baton Start();
+
+  // Stop watching the queue. Must be called before the client is destroyed.
+  void Stop();
+
+  // Close the loop handle and free the watcher. Must be called on the main
+  // thread, after Stop.
+  void Close();
+
+ private:
+  ~ConsumeWatcher();
+
+  static void QueueNonEmpty(rd_kafka_t*, void*);
+  static void AsyncDrain(uv_async_t*);
+  static void TimerDrain(uv_timer_t*);
+  static void HandleClosed(uv_handle_t*);
+
+  void Drain();
+
+  KafkaConsumer* m_consumer;
+  unsigned int m_batch_size;
+
+  // Only used on the main thread
+  bool m_running;
+  rd_kafka_queue_t* m_queue;
+
+  uv_async_t m_async;
+  uv_timer_t m_timer;
+  // Loop handles still to be closed before the watcher can be freed
+  int m_open_handles;
+  Nan::Callback m_callback;
+};
+
+}  // namespace NodeKafka
+
+#endif  // SRC_CONSUME_WATCHER_H_
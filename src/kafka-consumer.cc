@@ -8,11 +8,14 @@
  * of the MIT license.  See the LICENSE.txt file for details.
  */
 
+#include <chrono>
+#include <map>
 #include <string>
 #include <vector>
 
 #include "src/kafka-consumer.h"
 #include "src/workers.h"
+#include "src/worker-pool.h"
 
 using Nan::FunctionCallbackInfo;
 
@@ -36,11 +39,17 @@ KafkaConsumer::KafkaConsumer(Conf* gconfig, Conf* tconfig):
       m_gconfig->set("default_topic_conf", m_tconfig, errstr);
 
     m_consume_loop = nullptr;
+
+    uv_mutex_init(&m_partition_queue_lock);
   }
 
 KafkaConsumer::~KafkaConsumer() {
+  m_zero_copy_messages.Release();
+
   // We only want to run this if it hasn't been run already
   Disconnect();
+
+  uv_mutex_destroy(&m_partition_queue_lock);
 }
 
 Baton KafkaConsumer::Connect() {
@@ -56,13 +65,16 @@ Baton KafkaConsumer::Connect() {
   std::string errstr;
   {
     scoped_shared_write_lock lock(m_connection_lock);
-    m_client = RdKafka::KafkaConsumer::create(m_gconfig, errstr);
+    m_consumer = RdKafka::KafkaConsumer::create(m_gconfig, errstr);
+    m_client = m_consumer;
   }
 
   if (!m_client || !errstr.empty()) {
     return Baton(RdKafka::ERR__STATE, errstr);
   }
 
+  m_gate.Open();
+
   baton = setupSaslOAuthBearerBackgroundQueue();
   if (baton.err() != RdKafka::ERR_NO_ERROR) {
     return baton;
@@ -94,13 +106,21 @@ Baton KafkaConsumer::Disconnect() {
     m_is_closing = true;
     {
       scoped_shared_write_lock lock(m_connection_lock);
+      m_gate.Close();
 
-      RdKafka::KafkaConsumer* consumer =
-        dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-      err = consumer->close();
+      // Store what was resolved while the consumer can still commit it
+      StoreTrackedOffsets();
+      m_offset_tracker.Clear();
 
+      err = m_consumer->close();
+
+      ClearPartitionQueues();
+      ClearTopicCache();
+      // Stale once disconnected, the next refresh must not diff against it
+      m_metadata_cache.Clear();
       delete m_client;
       m_client = NULL;
+      m_consumer = NULL;
     }
   }
 
@@ -117,6 +137,100 @@ void KafkaConsumer::DeactivateDispatchers() {
   m_event_cb.dispatcher.Deactivate();
 }
 
+void KafkaConsumer::Teardown() {
+  Workers::KafkaConsumerConsumeLoop* consumeLoop =
+    static_cast<Workers::KafkaConsumerConsumeLoop*>(m_consume_loop);
+  if (consumeLoop != nullptr) {
+    // Like disconnect, but does not call back with the end of the loop
+    consumeLoop->Close();
+    consumeLoop->Destroy();
+    m_consume_loop = nullptr;
+  }
+
+  if (m_consume_watcher != nullptr) {
+    m_consume_watcher->Stop();
+    m_consume_watcher->Close();
+    m_consume_watcher = nullptr;
+  }
+
+  m_zero_copy_messages.Release();
+
+  Disconnect();
+  DeactivateDispatchers();
+}
+
+ZeroCopyMessages* KafkaConsumer::ZeroCopy() {
+  return m_zero_copy ? &m_zero_copy_messages : NULL;
+}
+
+bool KafkaConsumer::HasPartitionQueues() {
+  return m_partition_queues;
+}
+
+size_t KafkaConsumer::GetConsumeBacklogMax() {
+  return m_consume_backlog_max;
+}
+
+/**
+ * @brief Detach the given partitions from the consumer queue.
+ *
+ * Each partition gets its own queue which is no longer forwarded to the
+ * consumer queue, so its messages are only returned by
+ * ConsumePartitionBatch. Rebalance and error events keep flowing through the
+ * consumer queue. Must be called before the partitions are assigned, as a
+ * fetch may complete as soon as they are, and should be undone with
+ * RemovePartitionQueues if the assign fails.
+ */
+void KafkaConsumer::AddPartitionQueues(
+  const std::vector<RdKafka::TopicPartition*>& partitions) {
+  if (!m_partition_queues) {
+    return;
+  }
+
+  scoped_mutex_lock lock(m_partition_queue_lock);
+  for (unsigned int i = 0; i < partitions.size(); i++) {
+    RdKafka::Queue* queue = m_consumer->get_partition_queue(partitions[i]);
+    if (queue == NULL) {
+      continue;
+    }
+
+    queue->forward(NULL);
+    m_partition_queue_map[PartitionKey(partitions[i]->topic(),
+      partitions[i]->partition())] = std::shared_ptr<RdKafka::Queue>(queue);
+  }
+}
+
+/**
+ * @brief Drop the queues of partitions that are no longer assigned.
+ *
+ * The partition stays detached from the consumer queue inside librdkafka,
+ * which is what we want since a re-assign detaches it again anyway.
+ */
+void KafkaConsumer::RemovePartitionQueues(
+  const std::vector<RdKafka::TopicPartition*>& partitions) {
+  scoped_mutex_lock lock(m_partition_queue_lock);
+  for (unsigned int i = 0; i < partitions.size(); i++) {
+    m_partition_queue_map.erase(PartitionKey(partitions[i]->topic(),
+      partitions[i]->partition()));
+  }
+}
+
+void KafkaConsumer::ClearPartitionQueues() {
+  scoped_mutex_lock lock(m_partition_queue_lock);
+  m_partition_queue_map.clear();
+}
+
+std::shared_ptr<RdKafka::Queue> KafkaConsumer::GetPartitionQueue(
+  const std::string& topic, int32_t partition) {
+  scoped_mutex_lock lock(m_partition_queue_lock);
+  std::map<PartitionKey, std::shared_ptr<RdKafka::Queue>>::iterator it =
+    m_partition_queue_map.find(PartitionKey(topic, partition));
+  if (it == m_partition_queue_map.end()) {
+    return std::shared_ptr<RdKafka::Queue>();
+  }
+  return it->second;
+}
+
 bool KafkaConsumer::IsSubscribed() {
   if (!IsConnected()) {
     return false;
@@ -173,14 +287,24 @@ Baton KafkaConsumer::Assign(std::vector<RdKafka::TopicPartition*> partitions) {
     return Baton(RdKafka::ERR__STATE, "KafkaConsumer is disconnected");
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
+  StoreTrackedOffsets();
+
+  // The assignment is replaced as a whole, only the new partitions keep a
+  // queue
+  ClearPartitionQueues();
+  AddPartitionQueues(partitions);
 
-  RdKafka::ErrorCode errcode = consumer->assign(partitions);
+  RdKafka::ErrorCode errcode = m_consumer->assign(partitions);
 
   if (errcode == RdKafka::ERR_NO_ERROR) {
     m_partition_cnt = partitions.size();
     m_partitions.swap(partitions);
+
+    m_offset_tracker.Clear();
+  } else {
+    // The old partitions are still assigned
+    ClearPartitionQueues();
+    AddPartitionQueues(m_partitions);
   }
 
   // Destroy the partitions: Either we're using them (and partitions
@@ -196,15 +320,18 @@ Baton KafkaConsumer::Unassign() {
     return Baton(RdKafka::ERR__STATE);
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
+  // Offsets can only be stored for assigned partitions
+  StoreTrackedOffsets();
 
-  RdKafka::ErrorCode errcode = consumer->unassign();
+  RdKafka::ErrorCode errcode = m_consumer->unassign();
 
   if (errcode != RdKafka::ERR_NO_ERROR) {
     return Baton(errcode);
   }
 
+  ClearPartitionQueues();
+  m_offset_tracker.Clear();
+
   // Destroy the old list of partitions since we are no longer using it
   RdKafka::TopicPartition::destroy(m_partitions);
 
@@ -218,16 +345,17 @@ Baton KafkaConsumer::IncrementalAssign(std::vector<RdKafka::TopicPartition*> par
     return Baton(RdKafka::ERR__STATE, "KafkaConsumer is disconnected");
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
+  AddPartitionQueues(partitions);
 
-  RdKafka::Error* error = consumer->incremental_assign(partitions);
+  RdKafka::Error* error = m_consumer->incremental_assign(partitions);
 
   if (error == NULL) {
     m_partition_cnt += partitions.size();
     // We assume here that there are no duplicate assigns and just transfer.
     m_partitions.insert(m_partitions.end(), partitions.begin(), partitions.end());
   } else {
+    RemovePartitionQueues(partitions);
+
     // If we're in error, destroy it, otherwise, don't (since we're using them).
     RdKafka::TopicPartition::destroy(partitions);
   }
@@ -240,14 +368,17 @@ Baton KafkaConsumer::IncrementalUnassign(std::vector<RdKafka::TopicPartition*> p
     return Baton(RdKafka::ERR__STATE);
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
+  // Offsets can only be stored for assigned partitions
+  StoreTrackedOffsets();
 
-  RdKafka::Error* error = consumer->incremental_unassign(partitions);
+  RdKafka::Error* error = m_consumer->incremental_unassign(partitions);
 
   std::vector<RdKafka::TopicPartition*> delete_partitions;
 
   if (error == NULL) {
+    RemovePartitionQueues(partitions);
+    m_offset_tracker.Remove(partitions);
+
     // For now, use two for loops. Make more efficient if needed at a later point.
     for (unsigned int i = 0; i < partitions.size(); i++) {
       for (unsigned int j = 0; j < m_partitions.size(); j++) {
@@ -277,10 +408,7 @@ Baton KafkaConsumer::Commit(std::vector<RdKafka::TopicPartition*> toppars) {
     return Baton(RdKafka::ERR__STATE);
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-
-  RdKafka::ErrorCode err = consumer->commitAsync(toppars);
+  RdKafka::ErrorCode err = m_consumer->commitAsync(toppars);
 
   return Baton(err);
 }
@@ -290,12 +418,9 @@ Baton KafkaConsumer::Commit(RdKafka::TopicPartition * toppar) {
     return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-
   // Need to put topic in a vector for it to work
   std::vector<RdKafka::TopicPartition*> offsets = {toppar};
-  RdKafka::ErrorCode err = consumer->commitAsync(offsets);
+  RdKafka::ErrorCode err = m_consumer->commitAsync(offsets);
 
   return Baton(err);
 }
@@ -306,10 +431,8 @@ Baton KafkaConsumer::Commit() {
     return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-
-  RdKafka::ErrorCode err = consumer->commitAsync();
+  StoreTrackedOffsets();
+  RdKafka::ErrorCode err = m_consumer->commitAsync();
 
   return Baton(err);
 }
@@ -320,10 +443,7 @@ Baton KafkaConsumer::CommitSync(std::vector<RdKafka::TopicPartition*> toppars) {
     return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-
-  RdKafka::ErrorCode err = consumer->commitSync(toppars);
+  RdKafka::ErrorCode err = m_consumer->commitSync(toppars);
   // RdKafka::TopicPartition::destroy(toppars);
 
   return Baton(err);
@@ -334,12 +454,9 @@ Baton KafkaConsumer::CommitSync(RdKafka::TopicPartition * toppar) {
     return Baton(RdKafka::ERR__STATE);
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-
   // Need to put topic in a vector for it to work
   std::vector<RdKafka::TopicPartition*> offsets = {toppar};
-  RdKafka::ErrorCode err = consumer->commitSync(offsets);
+  RdKafka::ErrorCode err = m_consumer->commitSync(offsets);
 
   return Baton(err);
 }
@@ -350,10 +467,8 @@ Baton KafkaConsumer::CommitSync() {
     return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-
-  RdKafka::ErrorCode err = consumer->commitSync();
+  StoreTrackedOffsets();
+  RdKafka::ErrorCode err = m_consumer->commitSync();
 
   return Baton(err);
 }
@@ -363,24 +478,50 @@ Baton KafkaConsumer::Seek(const RdKafka::TopicPartition &partition, int timeout_
     return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
+  RdKafka::ErrorCode err = m_consumer->seek(partition, timeout_ms);
 
-  RdKafka::ErrorCode err = consumer->seek(partition, timeout_ms);
+  if (err == RdKafka::ERR_NO_ERROR) {
+    m_offset_tracker.Reset(partition.topic(), partition.partition());
+  }
 
   return Baton(err);
 }
 
+/**
+ * @brief Seek several partitions with one call.
+ *
+ * Only the C API can, so the partitions are a C list, which gets the error
+ * of every partition.
+ */
+Baton KafkaConsumer::SeekPartitions(
+    rd_kafka_topic_partition_list_t* partitions, int timeout_ms) {
+  if (!IsConnected()) {
+    return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
+  }
+
+  rd_kafka_error_t* error = rd_kafka_seek_partitions(m_consumer->c_ptr(),
+    partitions, timeout_ms);
+  if (error) {
+    return Baton::BatonFromErrorAndDestroy(error);
+  }
+
+  for (int i = 0; i < partitions->cnt; i++) {
+    if (partitions->elems[i].err == RD_KAFKA_RESP_ERR_NO_ERROR) {
+      m_offset_tracker.Reset(partitions->elems[i].topic,
+        partitions->elems[i].partition);
+    }
+  }
+
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
+
 Baton KafkaConsumer::Committed(std::vector<RdKafka::TopicPartition*> &toppars,
   int timeout_ms) {
   if (!IsConnected()) {
     return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-
-  RdKafka::ErrorCode err = consumer->committed(toppars, timeout_ms);
+  RdKafka::ErrorCode err = m_consumer->committed(toppars, timeout_ms);
 
   return Baton(err);
 }
@@ -390,26 +531,179 @@ Baton KafkaConsumer::Position(std::vector<RdKafka::TopicPartition*> &toppars) {
     return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-
-  RdKafka::ErrorCode err = consumer->position(toppars);
+  RdKafka::ErrorCode err = m_consumer->position(toppars);
 
   return Baton(err);
 }
 
+/**
+ * @brief Get the offsets needed for the lag of every assigned partition.
+ *
+ * Positions and low offsets are what the consumer knows already, end
+ * offsets are the cached high watermarks unless they are queried. The query
+ * is a single offsetsForTimes call, which librdkafka sends as one ListOffsets
+ * request per partition leader. For read_committed consumers it yields the
+ * last stable offset, which is what they can consume up to.
+ */
+Baton KafkaConsumer::GetLag(ConsumerLag* lag, bool query_end_offsets,
+    int timeout_ms) {
+  scoped_shared_read_lock lock(m_connection_lock);
+
+  if (!IsConnected()) {
+    return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
+  }
+
+  std::vector<RdKafka::TopicPartition*> toppars;
+  RdKafka::ErrorCode err = m_consumer->assignment(toppars);
+  if (err == RdKafka::ERR_NO_ERROR) {
+    err = m_consumer->position(toppars);
+  }
+
+  std::vector<RdKafka::TopicPartition*> end_offsets;
+  if (err == RdKafka::ERR_NO_ERROR && query_end_offsets && !toppars.empty()) {
+    for (size_t i = 0; i < toppars.size(); i++) {
+      end_offsets.push_back(RdKafka::TopicPartition::create(
+        toppars[i]->topic(), toppars[i]->partition(),
+        RdKafka::Topic::OFFSET_END));
+    }
+    err = m_consumer->offsetsForTimes(end_offsets, timeout_ms);
+  }
+
+  if (err != RdKafka::ERR_NO_ERROR) {
+    RdKafka::TopicPartition::destroy(toppars);
+    RdKafka::TopicPartition::destroy(end_offsets);
+    return Baton(err);
+  }
+
+  std::map<std::string, int32_t> topic_indices;
+  for (size_t i = 0; i < toppars.size(); i++) {
+    const std::string& topic = toppars[i]->topic();
+    const int32_t partition = toppars[i]->partition();
+
+    std::map<std::string, int32_t>::iterator it = topic_indices.find(topic);
+    if (it == topic_indices.end()) {
+      it = topic_indices.insert(std::make_pair(topic,
+        static_cast<int32_t>(lag->topics.size()))).first;
+      lag->topics.push_back(topic);
+    }
+
+    int64_t low_offset;
+    int64_t high_offset;
+    if (m_consumer->get_watermark_offsets(topic, partition, &low_offset,
+          &high_offset) != RdKafka::ERR_NO_ERROR) {
+      low_offset = RdKafka::Topic::OFFSET_INVALID;
+      high_offset = RdKafka::Topic::OFFSET_INVALID;
+    }
+
+    if (!end_offsets.empty() &&
+        end_offsets[i]->err() == RdKafka::ERR_NO_ERROR &&
+        end_offsets[i]->offset() >= 0) {
+      high_offset = end_offsets[i]->offset();
+    }
+
+    lag->topic_indices.push_back(it->second);
+    lag->partitions.push_back(partition);
+    lag->positions.push_back(toppars[i]->offset());
+    lag->low_offsets.push_back(low_offset);
+    lag->high_offsets.push_back(high_offset);
+  }
+
+  RdKafka::TopicPartition::destroy(toppars);
+  RdKafka::TopicPartition::destroy(end_offsets);
+
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
+
+/**
+ * @brief Convert to parallel arrays, one entry per partition:
+ *
+ * {
+ *   topics: string[],
+ *   topicIndex: Int32Array,   index into topics
+ *   partition: Int32Array,
+ *   position: Float64Array,
+ *   lowOffset: Float64Array,
+ *   highOffset: Float64Array,
+ *   lag: Float64Array,        -1 if the position or end offset is not known
+ * }
+ *
+ * Unknown offsets are -1001.
+ */
+v8::Local<v8::Object> ConsumerLag::ToV8Object() {
+  Nan::EscapableHandleScope scope;
+
+  const uint32_t count = static_cast<uint32_t>(partitions.size());
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+
+  v8::Local<v8::ArrayBuffer> topic_index_buffer =
+    v8::ArrayBuffer::New(isolate, count * sizeof(int32_t));
+  v8::Local<v8::ArrayBuffer> partition_buffer =
+    v8::ArrayBuffer::New(isolate, count * sizeof(int32_t));
+  v8::Local<v8::ArrayBuffer> position_buffer =
+    v8::ArrayBuffer::New(isolate, count * sizeof(double));
+  v8::Local<v8::ArrayBuffer> low_buffer =
+    v8::ArrayBuffer::New(isolate, count * sizeof(double));
+  v8::Local<v8::ArrayBuffer> high_buffer =
+    v8::ArrayBuffer::New(isolate, count * sizeof(double));
+  v8::Local<v8::ArrayBuffer> lag_buffer =
+    v8::ArrayBuffer::New(isolate, count * sizeof(double));
+
+  int32_t* topic_index_data =
+    static_cast<int32_t*>(topic_index_buffer->GetBackingStore()->Data());
+  int32_t* partition_data =
+    static_cast<int32_t*>(partition_buffer->GetBackingStore()->Data());
+  double* position_data =
+    static_cast<double*>(position_buffer->GetBackingStore()->Data());
+  double* low_data =
+    static_cast<double*>(low_buffer->GetBackingStore()->Data());
+  double* high_data =
+    static_cast<double*>(high_buffer->GetBackingStore()->Data());
+  double* lag_data =
+    static_cast<double*>(lag_buffer->GetBackingStore()->Data());
+
+  for (uint32_t i = 0; i < count; i++) {
+    topic_index_data[i] = topic_indices[i];
+    partition_data[i] = partitions[i];
+    position_data[i] = static_cast<double>(positions[i]);
+    low_data[i] = static_cast<double>(low_offsets[i]);
+    high_data[i] = static_cast<double>(high_offsets[i]);
+
+    if (positions[i] >= 0 && high_offsets[i] >= 0) {
+      lag_data[i] = positions[i] < high_offsets[i] ?
+        static_cast<double>(high_offsets[i] - positions[i]) : 0;
+    } else {
+      lag_data[i] = -1;
+    }
+  }
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("topics").ToLocalChecked(),
+    Conversion::Util::ToV8Array(topics));
+  Nan::Set(obj, Nan::New("topicIndex").ToLocalChecked(),
+    v8::Int32Array::New(topic_index_buffer, 0, count));
+  Nan::Set(obj, Nan::New("partition").ToLocalChecked(),
+    v8::Int32Array::New(partition_buffer, 0, count));
+  Nan::Set(obj, Nan::New("position").ToLocalChecked(),
+    v8::Float64Array::New(position_buffer, 0, count));
+  Nan::Set(obj, Nan::New("lowOffset").ToLocalChecked(),
+    v8::Float64Array::New(low_buffer, 0, count));
+  Nan::Set(obj, Nan::New("highOffset").ToLocalChecked(),
+    v8::Float64Array::New(high_buffer, 0, count));
+  Nan::Set(obj, Nan::New("lag").ToLocalChecked(),
+    v8::Float64Array::New(lag_buffer, 0, count));
+
+  return scope.Escape(obj);
+}
+
 Baton KafkaConsumer::Subscription() {
   if (!IsConnected()) {
     return Baton(RdKafka::ERR__STATE, "Consumer is not connected");
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-
   // Needs to be a pointer since we're returning it through the baton
   std::vector<std::string> * topics = new std::vector<std::string>;
 
-  RdKafka::ErrorCode err = consumer->subscription(*topics);
+  RdKafka::ErrorCode err = m_consumer->subscription(*topics);
 
   if (err == RdKafka::ErrorCode::ERR_NO_ERROR) {
     // Good to go
@@ -421,9 +715,7 @@ Baton KafkaConsumer::Subscription() {
 
 Baton KafkaConsumer::Unsubscribe() {
   if (IsConnected() && IsSubscribed()) {
-    RdKafka::KafkaConsumer* consumer =
-      dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-    consumer->unsubscribe();
+    m_consumer->unsubscribe();
     m_is_subscribed = false;
   }
 
@@ -432,9 +724,7 @@ Baton KafkaConsumer::Unsubscribe() {
 
 Baton KafkaConsumer::Pause(std::vector<RdKafka::TopicPartition*> & toppars) {
   if (IsConnected()) {
-    RdKafka::KafkaConsumer* consumer =
-      dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-    RdKafka::ErrorCode err = consumer->pause(toppars);
+    RdKafka::ErrorCode err = m_consumer->pause(toppars);
 
     return Baton(err);
   }
@@ -444,9 +734,7 @@ Baton KafkaConsumer::Pause(std::vector<RdKafka::TopicPartition*> & toppars) {
 
 Baton KafkaConsumer::Resume(std::vector<RdKafka::TopicPartition*> & toppars) {
   if (IsConnected()) {
-    RdKafka::KafkaConsumer* consumer =
-      dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-    RdKafka::ErrorCode err = consumer->resume(toppars);
+    RdKafka::ErrorCode err = m_consumer->resume(toppars);
 
     return Baton(err);
   }
@@ -456,9 +744,7 @@ Baton KafkaConsumer::Resume(std::vector<RdKafka::TopicPartition*> & toppars) {
 
 Baton KafkaConsumer::OffsetsStore(std::vector<RdKafka::TopicPartition*> & toppars) {  // NOLINT
   if (IsConnected() && IsSubscribed()) {
-    RdKafka::KafkaConsumer* consumer =
-      dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-    RdKafka::ErrorCode err = consumer->offsets_store(toppars);
+    RdKafka::ErrorCode err = m_consumer->offsets_store(toppars);
 
     return Baton(err);
   }
@@ -466,15 +752,80 @@ Baton KafkaConsumer::OffsetsStore(std::vector<RdKafka::TopicPartition*> & toppar
   return Baton(RdKafka::ERR__STATE);
 }
 
+/**
+ * @brief Mark a consumed message as processed.
+ *
+ * Only updates the tracker. The offsets that became safe are stored once
+ * enough messages were resolved or enough time passed, and always before a
+ * commit, a revoke or a disconnect.
+ */
+Baton KafkaConsumer::ResolveOffset(const std::string& topic,
+                                   int32_t partition, int64_t offset) {
+  if (!m_offset_tracking) {
+    return Baton(RdKafka::ERR__STATE, "Offset tracking is not enabled");
+  }
+
+  if (m_offset_tracker.Resolve(topic, partition, offset)) {
+    scoped_shared_read_lock lock(m_connection_lock);
+    if (!IsConnected()) {
+      return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
+    }
+    StoreTrackedOffsets();
+  }
+
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
+
+void KafkaConsumer::TrackConsumed(RdKafka::Message* const* messages,
+                                  std::size_t count) {
+  if (m_latency_histograms.IsEnabled()) {
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+    m_latency_histograms.RecordConsumed(messages, count, now_ms);
+  }
+
+  if (!m_offset_tracking) {
+    return;
+  }
+
+  for (std::size_t i = 0; i < count; i++) {
+    if (messages[i]->err() == RdKafka::ERR_NO_ERROR) {
+      m_offset_tracker.Begin(messages[i]->topic_name(),
+                             messages[i]->partition(), messages[i]->offset());
+    }
+  }
+
+  // Consumers poll all the time, so this doubles as the flush timer
+  if (m_offset_tracker.IsDue()) {
+    StoreTrackedOffsets();
+  }
+}
+
+/**
+ * @brief Store the offsets the tracker found to be safe.
+ *
+ * The caller must make sure the consumer stays connected. Errors for
+ * single partitions, like ones revoked in the meantime, are ignored.
+ */
+void KafkaConsumer::StoreTrackedOffsets() {
+  if (!m_offset_tracking) {
+    return;
+  }
+
+  std::vector<RdKafka::TopicPartition*> offsets =
+    m_offset_tracker.TakeAdvanced();
+  if (!offsets.empty()) {
+    m_consumer->offsets_store(offsets);
+  }
+  RdKafka::TopicPartition::destroy(offsets);
+}
+
 Baton KafkaConsumer::Subscribe(std::vector<std::string> topics) {
   if (!IsConnected()) {
     return Baton(RdKafka::ERR__STATE);
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-
-  RdKafka::ErrorCode errcode = consumer->subscribe(topics);
+  RdKafka::ErrorCode errcode = m_consumer->subscribe(topics);
   if (errcode != RdKafka::ERR_NO_ERROR) {
     return Baton(errcode);
   }
@@ -485,31 +836,188 @@ Baton KafkaConsumer::Subscribe(std::vector<std::string> topics) {
 }
 
 Baton KafkaConsumer::Consume(int timeout_ms) {
-  if (IsConnected()) {
-    scoped_shared_read_lock lock(m_connection_lock);
-    if (!IsConnected()) {
-      return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
-    } else {
-      RdKafka::KafkaConsumer* consumer =
-        dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-
-      RdKafka::Message * message = consumer->consume(timeout_ms);
-      RdKafka::ErrorCode response_code = message->err();
-      // we want to handle these errors at the call site
-      if (response_code != RdKafka::ERR_NO_ERROR &&
-         response_code != RdKafka::ERR__PARTITION_EOF &&
-         response_code != RdKafka::ERR__TIMED_OUT &&
-         response_code != RdKafka::ERR__TIMED_OUT_QUEUE
-       ) {
-        delete message;
-        return Baton(response_code);
+  scoped_gate_entry entry(m_gate);
+  if (!entry.connected()) {
+    return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
+  }
+
+  RdKafka::Message * message = m_consumer->consume(timeout_ms);
+  RdKafka::ErrorCode response_code = message->err();
+  // we want to handle these errors at the call site
+  if (response_code != RdKafka::ERR_NO_ERROR &&
+     response_code != RdKafka::ERR__PARTITION_EOF &&
+     response_code != RdKafka::ERR__TIMED_OUT &&
+     response_code != RdKafka::ERR__TIMED_OUT_QUEUE
+   ) {
+    delete message;
+    return Baton(response_code);
+  }
+
+  TrackConsumed(&message, 1);
+
+  return Baton(message);
+}
+
+/**
+ * @brief Read up to max messages with consume, which reads one message from
+ * either the consumer itself or one of its partition queues and returns NULL
+ * once that cannot be read from anymore, like after a revoke. The caller
+ * has to be in the gate for the whole batch.
+ *
+ * Stops at the first timeout, and before the next message once the consumer
+ * is disconnecting. Partition EOF messages are included in the batch but do
+ * not count towards max. Once a message has been read the remaining polls
+ * only wait 1 ms when timeout_only_for_first_message is set, and after an
+ * EOF.
+ *
+ * An error is only returned when nothing but EOF messages was consumed;
+ * otherwise the messages read so far are returned and the error will show
+ * up again on the next call.
+ *
+ * @param unavailable - Returned when consume returns NULL before anything
+ * was read.
+ * @param timed_out - If not NULL, set to whether the batch ended on a
+ * timeout, which is the only way to tell there is nothing left to read.
+ */
+template <typename Consume>
+static Baton DrainBatch(const KafkaConsumer* consumer, Consume consume,
+                        const Baton& unavailable,
+                        std::vector<RdKafka::Message*>& messages,
+                        std::size_t max, int timeout_ms,
+                        bool timeout_only_for_first_message,
+                        bool* timed_out) {
+  std::size_t eof_event_count = 0;
+  if (timed_out) {
+    *timed_out = false;
+  }
+
+  while (messages.size() - eof_event_count < max) {
+    // Consume may not notice, nothing stops a disconnect from starting while
+    // the caller is in the gate
+    if (!consumer->IsConnected()) {
+      if (messages.empty()) {
+        return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
       }
+      return Baton(RdKafka::ERR_NO_ERROR);
+    }
 
-      return Baton(message);
+    RdKafka::Message* message = consume(timeout_ms);
+    if (!message) {
+      if (messages.empty()) {
+        return unavailable;
+      }
+      return Baton(RdKafka::ERR_NO_ERROR);
     }
-  } else {
+    RdKafka::ErrorCode response_code = message->err();
+
+    switch (response_code) {
+      case RdKafka::ERR__PARTITION_EOF:
+        // If partition EOF and have consumed messages, retry with timeout 1
+        // This allows getting ready messages, while not waiting for new ones
+        if (messages.size() > eof_event_count) {
+          timeout_ms = 1;
+        }
+
+        // Only seen when `enable.partition.eof` is set, in which case the
+        // caller is interested in EOF messages too
+        messages.push_back(message);
+        eof_event_count += 1;
+        break;
+      case RdKafka::ERR__TIMED_OUT:
+      case RdKafka::ERR__TIMED_OUT_QUEUE:
+        delete message;
+        if (timed_out) {
+          *timed_out = true;
+        }
+        return Baton(RdKafka::ERR_NO_ERROR);
+      case RdKafka::ERR_NO_ERROR:
+        messages.push_back(message);
+
+        // Get the messages that are ready without waiting for new ones
+        if (timeout_only_for_first_message) {
+          timeout_ms = 1;
+        }
+        break;
+      default:
+        delete message;
+        if (messages.size() == eof_event_count) {
+          return Baton(response_code);
+        }
+        return Baton(RdKafka::ERR_NO_ERROR);
+    }
+  }
+
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
+
+/**
+ * @brief Consume up to max messages in one go.
+ *
+ * Behaves like calling Consume in a loop, but the connection is entered only
+ * once for the whole batch. A disconnect stops the batch before the next
+ * message, so it never waits for more than one of them.
+ *
+ * @sa DrainBatch
+ */
+Baton KafkaConsumer::ConsumeBatch(std::vector<RdKafka::Message*>& messages,
+                                  std::size_t max, int timeout_ms,
+                                  bool timeout_only_for_first_message,
+                                  bool* timed_out) {
+  scoped_gate_entry entry(m_gate);
+  if (!entry.connected()) {
     return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
   }
+
+  return DrainBatch(this, [this](int timeout_ms) -> RdKafka::Message* {
+    RdKafka::Message* message = m_consumer->consume(timeout_ms);
+    TrackConsumed(&message, 1);
+    return message;
+  }, Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected"),
+    messages, max, timeout_ms, timeout_only_for_first_message, timed_out);
+}
+
+/**
+ * @brief Consume up to max messages from a single assigned partition.
+ *
+ * Only available when partition queues are enabled. Different partitions
+ * can be consumed concurrently from separate workers since each one reads
+ * from its own queue.
+ *
+ * @sa DrainBatch
+ */
+Baton KafkaConsumer::ConsumePartitionBatch(const std::string& topic,
+                                           int32_t partition,
+                                           std::vector<RdKafka::Message*>& messages,  // NOLINT
+                                           std::size_t max, int timeout_ms,
+                                           bool timeout_only_for_first_message) {  // NOLINT
+  scoped_gate_entry entry(m_gate);
+  if (!entry.connected()) {
+    return Baton(RdKafka::ERR__STATE, "KafkaConsumer is not connected");
+  }
+
+  Baton unassigned(RdKafka::ERR__UNKNOWN_PARTITION,
+    "Partition is not assigned or partition queues are not enabled");
+  if (!GetPartitionQueue(topic, partition)) {
+    return unassigned;
+  }
+
+  return DrainBatch(this, [this, &topic, partition](int timeout_ms)
+      -> RdKafka::Message* {
+    // Looked up for every message, the partition may be revoked on the main
+    // thread in the meantime. Hold on to our own reference, a revoke only
+    // drops the one in the map. It must not outlive the entry, the queue
+    // belongs to the handle.
+    std::shared_ptr<RdKafka::Queue> queue =
+      GetPartitionQueue(topic, partition);
+    if (!queue) {
+      return NULL;
+    }
+
+    RdKafka::Message* message = queue->consume(timeout_ms);
+    TrackConsumed(&message, 1);
+    return message;
+  }, unassigned, messages, max, timeout_ms, timeout_only_for_first_message,
+    NULL);
 }
 
 Baton KafkaConsumer::RefreshAssignments() {
@@ -517,11 +1025,8 @@ Baton KafkaConsumer::RefreshAssignments() {
     return Baton(RdKafka::ERR__STATE);
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-
   std::vector<RdKafka::TopicPartition*> partition_list;
-  RdKafka::ErrorCode err = consumer->assignment(partition_list);
+  RdKafka::ErrorCode err = m_consumer->assignment(partition_list);
 
   switch (err) {
     case RdKafka::ERR_NO_ERROR:
@@ -545,13 +1050,10 @@ std::string KafkaConsumer::RebalanceProtocol() {
     return std::string("NONE");
   }
 
-  RdKafka::KafkaConsumer* consumer =
-    dynamic_cast<RdKafka::KafkaConsumer*>(m_client);
-
-  return consumer->rebalance_protocol();
+  return m_consumer->rebalance_protocol();
 }
 
-Nan::Persistent<v8::Function> KafkaConsumer::constructor;
+PerIsolateFunction KafkaConsumer::constructor;
 
 void KafkaConsumer::Init(v8::Local<v8::Object> exports) {
   Nan::HandleScope scope;
@@ -567,6 +1069,11 @@ void KafkaConsumer::Init(v8::Local<v8::Object> exports) {
    */
 
   Nan::SetPrototypeMethod(tpl, "configureCallbacks", NodeConfigureCallbacks);
+  Nan::SetPrototypeMethod(tpl, "setStatsFields", NodeSetStatsFields);
+  Nan::SetPrototypeMethod(tpl, "getNativeMetrics", NodeGetNativeMetrics);
+  Nan::SetPrototypeMethod(tpl, "setLatencyHistograms", NodeSetLatencyHistograms);  // NOLINT
+  Nan::SetPrototypeMethod(tpl, "getLatencyHistograms", NodeGetLatencyHistograms);  // NOLINT
+  Nan::SetPrototypeMethod(tpl, "resetLatencyHistograms", NodeResetLatencyHistograms);  // NOLINT
 
   /*
    * @brief Methods to do with establishing state
@@ -575,9 +1082,13 @@ void KafkaConsumer::Init(v8::Local<v8::Object> exports) {
   Nan::SetPrototypeMethod(tpl, "connect", NodeConnect);
   Nan::SetPrototypeMethod(tpl, "disconnect", NodeDisconnect);
   Nan::SetPrototypeMethod(tpl, "getMetadata", NodeGetMetadata);
+  Nan::SetPrototypeMethod(tpl, "refreshMetadataCache", NodeRefreshMetadataCache);  // NOLINT
+  Nan::SetPrototypeMethod(tpl, "getCachedTopicMetadata", NodeGetCachedTopicMetadata);  // NOLINT
   Nan::SetPrototypeMethod(tpl, "queryWatermarkOffsets", NodeQueryWatermarkOffsets);  // NOLINT
   Nan::SetPrototypeMethod(tpl, "offsetsForTimes", NodeOffsetsForTimes);
   Nan::SetPrototypeMethod(tpl, "getWatermarkOffsets", NodeGetWatermarkOffsets);
+  Nan::SetPrototypeMethod(tpl, "getLag", NodeGetLag);
+  Nan::SetPrototypeMethod(tpl, "queryLag", NodeQueryLag);
   Nan::SetPrototypeMethod(tpl, "setSaslCredentials", NodeSetSaslCredentials);
   Nan::SetPrototypeMethod(tpl, "setOAuthBearerToken", NodeSetOAuthBearerToken);
   Nan::SetPrototypeMethod(tpl, "setOAuthBearerTokenFailure",
@@ -590,8 +1101,15 @@ void KafkaConsumer::Init(v8::Local<v8::Object> exports) {
   Nan::SetPrototypeMethod(tpl, "subscribe", NodeSubscribe);
   Nan::SetPrototypeMethod(tpl, "unsubscribe", NodeUnsubscribe);
   Nan::SetPrototypeMethod(tpl, "consumeLoop", NodeConsumeLoop);
+  Nan::SetPrototypeMethod(tpl, "consumeOnEvents", NodeConsumeOnEvents);
   Nan::SetPrototypeMethod(tpl, "consume", NodeConsume);
+  Nan::SetPrototypeMethod(tpl, "setZeroCopyConsume", NodeSetZeroCopyConsume);
+  Nan::SetPrototypeMethod(tpl, "setPartitionQueues", NodeSetPartitionQueues);
+  Nan::SetPrototypeMethod(tpl, "setConsumeBacklogMax",
+    NodeSetConsumeBacklogMax);
+  Nan::SetPrototypeMethod(tpl, "consumePartition", NodeConsumePartition);
   Nan::SetPrototypeMethod(tpl, "seek", NodeSeek);
+  Nan::SetPrototypeMethod(tpl, "seekPartitions", NodeSeekPartitions);
 
   /**
    * @brief Pausing and resuming
@@ -615,6 +1133,9 @@ void KafkaConsumer::Init(v8::Local<v8::Object> exports) {
   Nan::SetPrototypeMethod(tpl, "commit", NodeCommit);
   Nan::SetPrototypeMethod(tpl, "commitSync", NodeCommitSync);
   Nan::SetPrototypeMethod(tpl, "offsetsStore", NodeOffsetsStore);
+  Nan::SetPrototypeMethod(tpl, "setOffsetTracking", NodeSetOffsetTracking);
+  Nan::SetPrototypeMethod(tpl, "resolveOffset", NodeResolveOffset);
+  Nan::SetPrototypeMethod(tpl, "resetOffsetTracking", NodeResetOffsetTracking);
 
   constructor.Reset((tpl->GetFunction(Nan::GetCurrentContext()))
     .ToLocalChecked());
@@ -676,7 +1197,7 @@ v8::Local<v8::Object> KafkaConsumer::NewInstance(v8::Local<v8::Value> arg) {
   const unsigned argc = 1;
 
   v8::Local<v8::Value> argv[argc] = { arg };
-  v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+  v8::Local<v8::Function> cons = constructor.Get();
   v8::Local<v8::Object> instance =
     Nan::NewInstance(cons, argc, argv).ToLocalChecked();
 
@@ -711,7 +1232,7 @@ NAN_METHOD(KafkaConsumer::NodeCommitted) {
 
   KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
 
-  Nan::AsyncQueueWorker(
+  WorkerPool::Queue(
     new Workers::KafkaConsumerCommitted(callback, consumer,
       toppars, timeout_ms));
 
@@ -1148,12 +1669,58 @@ NAN_METHOD(KafkaConsumer::NodeSeek) {
   }
 
   Nan::Callback *callback = new Nan::Callback(info[2].As<v8::Function>());
-  Nan::AsyncQueueWorker(
+  WorkerPool::Queue(
     new Workers::KafkaConsumerSeek(callback, consumer, toppar, timeout_ms));
 
   info.GetReturnValue().Set(Nan::Null());
 }
 
+NAN_METHOD(KafkaConsumer::NodeSeekPartitions) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 3) {
+    return Nan::ThrowError("Must provide topic partitions, timeout, and callback");  // NOLINT
+  }
+
+  if (!info[0]->IsArray()) {
+    return Nan::ThrowError("Need to specify an array of topic partitions");
+  }
+
+  if (!info[1]->IsNumber() && !info[1]->IsNull()) {
+    return Nan::ThrowError("Timeout must be a number.");
+  }
+
+  if (!info[2]->IsFunction()) {
+    return Nan::ThrowError("Callback must be a function");
+  }
+
+  int timeout_ms;
+  Nan::Maybe<uint32_t> maybeTimeout =
+    Nan::To<uint32_t>(info[1].As<v8::Number>());
+
+  if (maybeTimeout.IsNothing()) {
+    timeout_ms = 1000;
+  } else {
+    // 0 is fine here, rd_kafka_seek_partitions then seeks asynchronously and
+    // reports no errors
+    timeout_ms = static_cast<int>(maybeTimeout.FromJust());
+  }
+
+  KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
+
+  std::vector<RdKafka::TopicPartition*> toppars =
+    Conversion::TopicPartition::FromV8Array(info[0].As<v8::Array>());
+  rd_kafka_topic_partition_list_t* partitions =
+    Conversion::TopicPartition::ToTopicPartitionList(toppars);
+  RdKafka::TopicPartition::destroy(toppars);
+
+  Nan::Callback *callback = new Nan::Callback(info[2].As<v8::Function>());
+  WorkerPool::Queue(new Workers::KafkaConsumerSeekPartitions(
+    callback, consumer, partitions, timeout_ms));
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
 NAN_METHOD(KafkaConsumer::NodeOffsetsStore) {
   Nan::HandleScope scope;
 
@@ -1179,6 +1746,62 @@ NAN_METHOD(KafkaConsumer::NodeOffsetsStore) {
   info.GetReturnValue().Set(Nan::New<v8::Number>(error_code));
 }
 
+NAN_METHOD(KafkaConsumer::NodeSetOffsetTracking) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 3 || !info[0]->IsBoolean() || !info[1]->IsNumber() ||
+      !info[2]->IsNumber()) {
+    return Nan::ThrowError(
+      "Need to specify a boolean, an interval and a threshold");
+  }
+
+  KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
+
+  // Messages consumed before tracking was enabled would never be resolved,
+  // holding back their partitions forever.
+  if (consumer->IsConnected()) {
+    return Nan::ThrowError(
+      "Offset tracking must be set before the consumer is connected");
+  }
+
+  uint32_t interval_ms = Nan::To<uint32_t>(info[1]).FromJust();
+  uint32_t threshold = Nan::To<uint32_t>(info[2]).FromJust();
+
+  consumer->m_offset_tracker.SetThresholds(threshold, interval_ms);
+  consumer->m_offset_tracking = Nan::To<bool>(info[0]).FromJust();
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
+NAN_METHOD(KafkaConsumer::NodeResolveOffset) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 3 || !info[0]->IsString() || !info[1]->IsNumber() ||
+      !info[2]->IsNumber()) {
+    return Nan::ThrowError("Need to specify a topic, partition and offset");
+  }
+
+  KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
+
+  Nan::Utf8String topic(info[0]);
+  int32_t partition = Nan::To<int32_t>(info[1]).FromJust();
+  int64_t offset = Nan::To<int64_t>(info[2]).FromJust();
+
+  Baton b = consumer->ResolveOffset(*topic, partition, offset);
+
+  int error_code = static_cast<int>(b.err());
+  info.GetReturnValue().Set(Nan::New<v8::Number>(error_code));
+}
+
+NAN_METHOD(KafkaConsumer::NodeResetOffsetTracking) {
+  Nan::HandleScope scope;
+
+  KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
+  consumer->m_offset_tracker.Reset();
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
 NAN_METHOD(KafkaConsumer::NodePause) {
   Nan::HandleScope scope;
 
@@ -1268,7 +1891,15 @@ NAN_METHOD(KafkaConsumer::NodeConsumeLoop) {
     return Nan::ThrowError("Need to specify a sleep delay");
   }
 
-  if (!info[2]->IsFunction()) {
+  // consumeLoop(timeout, sleepDelay, [batchSize, batchTimeout,] cb)
+  bool batched = info.Length() >= 5;
+  int callback_index = batched ? 4 : 2;
+
+  if (batched && (!info[2]->IsNumber() || !info[3]->IsNumber())) {
+    return Nan::ThrowError("Need to specify a batch size and timeout");
+  }
+
+  if (!info[callback_index]->IsFunction()) {
     return Nan::ThrowError("Need to specify a callback");
   }
 
@@ -1292,9 +1923,19 @@ NAN_METHOD(KafkaConsumer::NodeConsumeLoop) {
     timeout_sleep_delay_ms = static_cast<int>(maybeSleep.FromJust());
   }
 
+  unsigned int batch_size = 0;
+  int batch_timeout_ms = 0;
+
+  if (batched) {
+    batch_size = Nan::To<uint32_t>(info[2]).FromMaybe(0);
+    batch_timeout_ms =
+      static_cast<int>(Nan::To<uint32_t>(info[3]).FromMaybe(0));
+  }
+
   KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
 
-  if (consumer->m_consume_loop != nullptr) {
+  if (consumer->m_consume_loop != nullptr ||
+      consumer->m_consume_watcher != nullptr) {
     return Nan::ThrowError("Consume was already called");
   }
 
@@ -1302,11 +1943,63 @@ NAN_METHOD(KafkaConsumer::NodeConsumeLoop) {
     return Nan::ThrowError("Connect must be called before consume");
   }
 
-  v8::Local<v8::Function> cb = info[2].As<v8::Function>();
+  v8::Local<v8::Function> cb = info[callback_index].As<v8::Function>();
 
   Nan::Callback *callback = new Nan::Callback(cb);
 
-  consumer->m_consume_loop = new Workers::KafkaConsumerConsumeLoop(callback, consumer, timeout_ms, timeout_sleep_delay_ms);
+  consumer->m_consume_loop = new Workers::KafkaConsumerConsumeLoop(callback,
+    consumer, timeout_ms, timeout_sleep_delay_ms, batch_size,
+    batch_timeout_ms);
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
+NAN_METHOD(KafkaConsumer::NodeConsumeOnEvents) {
+  Nan::HandleScope scope;
+
+  // consumeOnEvents(batchSize, cb)
+  if (info.Length() < 2 || !info[0]->IsNumber()) {
+    return Nan::ThrowError("Need to specify a batch size");
+  }
+
+  if (!info[1]->IsFunction()) {
+    return Nan::ThrowError("Need to specify a callback");
+  }
+
+  unsigned int batch_size = Nan::To<uint32_t>(info[0]).FromMaybe(0);
+  if (batch_size == 0) {
+    return Nan::ThrowError("Batch size must be greater than 0");
+  }
+
+  KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
+
+  if (consumer->m_consume_loop != nullptr ||
+      consumer->m_consume_watcher != nullptr) {
+    return Nan::ThrowError("Consume was already called");
+  }
+
+  // Messages of detached partitions never reach the consumer queue
+  if (consumer->m_partition_queues) {
+    return Nan::ThrowError(
+      "Partition queues are consumed with consumePartition");
+  }
+
+  scoped_shared_read_lock lock(consumer->m_connection_lock);
+
+  if (!consumer->IsConnected()) {
+    return Nan::ThrowError("Connect must be called before consume");
+  }
+
+  ConsumeWatcher* watcher = new ConsumeWatcher(consumer, batch_size,
+    info[1].As<v8::Function>());
+
+  Baton b = watcher->Start();
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    watcher->Close();
+    return Nan::ThrowError(b.errstr().c_str());
+  }
+
+  consumer->m_consume_watcher = watcher;
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -1362,7 +2055,7 @@ NAN_METHOD(KafkaConsumer::NodeConsume) {
 
     v8::Local<v8::Function> cb = info[3].As<v8::Function>();
     Nan::Callback *callback = new Nan::Callback(cb);
-    Nan::AsyncQueueWorker(
+    WorkerPool::Queue(
       new Workers::KafkaConsumerConsumeNum(callback, consumer, numMessages, timeout_ms, isTimeoutOnlyForFirstMessage));  // NOLINT
 
   } else {
@@ -1374,13 +2067,112 @@ NAN_METHOD(KafkaConsumer::NodeConsume) {
 
     v8::Local<v8::Function> cb = info[1].As<v8::Function>();
     Nan::Callback *callback = new Nan::Callback(cb);
-    Nan::AsyncQueueWorker(
+    WorkerPool::Queue(
       new Workers::KafkaConsumerConsume(callback, consumer, timeout_ms));
   }
 
   info.GetReturnValue().Set(Nan::Null());
 }
 
+NAN_METHOD(KafkaConsumer::NodeSetZeroCopyConsume) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 1 || !info[0]->IsBoolean()) {
+    return Nan::ThrowError("Need to specify a boolean");
+  }
+
+  KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
+
+  // Workers read the flag from the main thread when converting messages,
+  // so flipping it mid-stream only affects messages converted afterwards.
+  consumer->m_zero_copy = Nan::To<bool>(info[0]).FromJust();
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
+NAN_METHOD(KafkaConsumer::NodeSetPartitionQueues) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 1 || !info[0]->IsBoolean()) {
+    return Nan::ThrowError("Need to specify a boolean");
+  }
+
+  KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
+
+  // Queues are set up when partitions are assigned, so switching the mode
+  // with an active assignment would leave some partitions behind.
+  if (consumer->IsConnected() && consumer->HasAssignedPartitions()) {
+    return Nan::ThrowError(
+      "Partition queues must be set before partitions are assigned");
+  }
+
+  consumer->m_partition_queues = Nan::To<bool>(info[0]).FromJust();
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
+NAN_METHOD(KafkaConsumer::NodeSetConsumeBacklogMax) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 1 || !info[0]->IsNumber()) {
+    return Nan::ThrowError("Need to specify a number");
+  }
+
+  KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
+
+  // Read once when the consume loop starts
+  int64_t backlog_max = Nan::To<int64_t>(info[0]).FromJust();
+  consumer->m_consume_backlog_max =
+    backlog_max > 0 ? static_cast<size_t>(backlog_max) : 0;
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
+NAN_METHOD(KafkaConsumer::NodeConsumePartition) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 6) {
+    return Nan::ThrowError("Invalid number of parameters");
+  }
+
+  if (!info[0]->IsString()) {
+    return Nan::ThrowError("Topic must be a string");
+  }
+
+  if (!info[1]->IsNumber()) {
+    return Nan::ThrowError("Partition must be a number");
+  }
+
+  if (!info[2]->IsNumber() || !info[3]->IsNumber()) {
+    return Nan::ThrowError("Timeout and number of messages must be numbers");
+  }
+
+  if (!info[4]->IsBoolean()) {
+    return Nan::ThrowError("Need to specify a boolean");
+  }
+
+  if (!info[5]->IsFunction()) {
+    return Nan::ThrowError("Need to specify a callback");
+  }
+
+  Nan::Utf8String topicUTF8(info[0]);
+  std::string topic(*topicUTF8);
+  int32_t partition = Nan::To<int32_t>(info[1]).FromJust();
+  int timeout_ms = static_cast<int>(Nan::To<uint32_t>(info[2]).FromJust());
+  uint32_t numMessages = Nan::To<uint32_t>(info[3]).FromJust();
+  bool isTimeoutOnlyForFirstMessage = Nan::To<bool>(info[4]).FromJust();
+
+  KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
+
+  v8::Local<v8::Function> cb = info[5].As<v8::Function>();
+  Nan::Callback *callback = new Nan::Callback(cb);
+  WorkerPool::Queue(
+    new Workers::KafkaConsumerConsumeNum(callback, consumer, topic, partition,
+      numMessages, timeout_ms, isTimeoutOnlyForFirstMessage));
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
 NAN_METHOD(KafkaConsumer::NodeConnect) {
   Nan::HandleScope scope;
 
@@ -1390,9 +2182,10 @@ NAN_METHOD(KafkaConsumer::NodeConnect) {
   }
 
   KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
+  consumer->m_zero_copy_messages.Open();
 
   Nan::Callback *callback = new Nan::Callback(info[0].As<v8::Function>());
-  Nan::AsyncQueueWorker(new Workers::KafkaConsumerConnect(callback, consumer));
+  WorkerPool::Queue(new Workers::KafkaConsumerConnect(callback, consumer));
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -1421,7 +2214,16 @@ NAN_METHOD(KafkaConsumer::NodeDisconnect) {
     consumer->m_consume_loop = nullptr;
   }
 
-  Nan::AsyncQueueWorker(
+  if (consumer->m_consume_watcher != nullptr) {
+    consumer->m_consume_watcher->Stop();
+    consumer->m_consume_watcher->Close();
+    consumer->m_consume_watcher = nullptr;
+  }
+
+  // Buffers that are still alive would keep the handle from being destroyed
+  consumer->m_zero_copy_messages.Release();
+
+  WorkerPool::Queue(
     new Workers::KafkaConsumerDisconnect(callback, consumer));
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -1471,4 +2273,45 @@ NAN_METHOD(KafkaConsumer::NodeGetWatermarkOffsets) {
   }
 }
 
+NAN_METHOD(KafkaConsumer::NodeGetLag) {
+  Nan::HandleScope scope;
+
+  KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
+
+  ConsumerLag lag;
+  Baton b = consumer->GetLag(&lag, false, 0);
+
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    // Let the JS library throw if we need to so the error can be more rich
+    int error_code = static_cast<int>(b.err());
+    return info.GetReturnValue().Set(Nan::New<v8::Number>(error_code));
+  }
+
+  info.GetReturnValue().Set(lag.ToV8Object());
+}
+
+NAN_METHOD(KafkaConsumer::NodeQueryLag) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 2 || !info[0]->IsNumber()) {
+    return Nan::ThrowError("Need to specify a timeout");
+  }
+
+  if (!info[1]->IsFunction()) {
+    return Nan::ThrowError("Need to specify a callback");
+  }
+
+  KafkaConsumer* consumer = ObjectWrap::Unwrap<KafkaConsumer>(info.This());
+
+  int timeout_ms = Nan::To<int>(info[0]).FromJust();
+
+  v8::Local<v8::Function> cb = info[1].As<v8::Function>();
+  Nan::Callback *callback = new Nan::Callback(cb);
+
+  WorkerPool::Queue(
+    new Workers::KafkaConsumerQueryLag(callback, consumer, timeout_ms));
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
 }  // namespace NodeKafka
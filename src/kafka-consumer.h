@@ -14,7 +14,10 @@
 #include <nan.h>
 #include <uv.h>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "rdkafkacpp.h"
@@ -22,9 +25,28 @@
 #include "src/common.h"
 #include "src/connection.h"
 #include "src/callbacks.h"
+#include "src/consume-watcher.h"
+#include "src/offset-tracker.h"
+#include "src/zero-copy-messages.h"
 
 namespace NodeKafka {
 
+/**
+ * @brief Offsets of the assigned partitions of a consumer, in parallel
+ * arrays. Offsets that are not known are RdKafka::Topic::OFFSET_INVALID.
+ */
+struct ConsumerLag {
+  std::vector<std::string> topics;
+  // Per partition, index into topics
+  std::vector<int32_t> topic_indices;
+  std::vector<int32_t> partitions;
+  std::vector<int64_t> positions;
+  std::vector<int64_t> low_offsets;
+  std::vector<int64_t> high_offsets;
+
+  v8::Local<v8::Object> ToV8Object();
+};
+
 /**
  * @brief KafkaConsumer v8 wrapped object.
  *
@@ -37,6 +59,7 @@ namespace NodeKafka {
 
 class KafkaConsumer : public Connection {
   friend class Producer;
+  friend class ConsumeWatcher;
  public:
   static void Init(v8::Local<v8::Object>);
   static v8::Local<v8::Object> NewInstance(v8::Local<v8::Value>);
@@ -66,6 +89,7 @@ class KafkaConsumer : public Connection {
 
   Baton Committed(std::vector<RdKafka::TopicPartition*> &, int timeout_ms);
   Baton Position(std::vector<RdKafka::TopicPartition*> &);
+  Baton GetLag(ConsumerLag*, bool query_end_offsets, int timeout_ms);
 
   Baton RefreshAssignments();
 
@@ -81,15 +105,35 @@ class KafkaConsumer : public Connection {
   std::string RebalanceProtocol();
 
   Baton Seek(const RdKafka::TopicPartition &partition, int timeout_ms);
+  Baton SeekPartitions(rd_kafka_topic_partition_list_t*, int timeout_ms);
 
   Baton Subscribe(std::vector<std::string>);
   Baton Consume(int timeout_ms);
+  Baton ConsumeBatch(std::vector<RdKafka::Message*>&, std::size_t max,
+                     int timeout_ms, bool timeout_only_for_first_message,
+                     bool* timed_out);
+  Baton ConsumePartitionBatch(const std::string& topic, int32_t partition,
+                              std::vector<RdKafka::Message*>&, std::size_t max,
+                              int timeout_ms,
+                              bool timeout_only_for_first_message);
 
   void ActivateDispatchers();
   void DeactivateDispatchers();
+  void Teardown();
+
+  // Where consumed payloads are pinned, or NULL to copy them
+  ZeroCopyMessages* ZeroCopy();
+  bool HasPartitionQueues();
+  size_t GetConsumeBacklogMax();
+
+  // Default for the consume loop backlog
+  static const size_t kDefaultConsumeBacklogMax = 10000;
+
+  Baton ResolveOffset(const std::string& topic, int32_t partition,
+                      int64_t offset);
 
  protected:
-  static Nan::Persistent<v8::Function> constructor;
+  static PerIsolateFunction constructor;
   static void New(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
   KafkaConsumer(Conf *, Conf *);
@@ -98,11 +142,48 @@ class KafkaConsumer : public Connection {
  private:
   static void part_list_print(const std::vector<RdKafka::TopicPartition*>&);
 
+  typedef std::pair<std::string, int32_t> PartitionKey;
+
+  void AddPartitionQueues(const std::vector<RdKafka::TopicPartition*>&);
+  void RemovePartitionQueues(const std::vector<RdKafka::TopicPartition*>&);
+  void ClearPartitionQueues();
+  std::shared_ptr<RdKafka::Queue> GetPartitionQueue(const std::string&,
+                                                    int32_t);
+
+  // Offset tracking and consume latencies of the messages handed out
+  void TrackConsumed(RdKafka::Message* const*, std::size_t count);
+  void StoreTrackedOffsets();
+
+  // m_client, cast once on connect
+  RdKafka::KafkaConsumer* m_consumer = NULL;
+
   std::vector<RdKafka::TopicPartition*> m_partitions;
   int m_partition_cnt;
   bool m_is_subscribed = false;
 
   void* m_consume_loop = nullptr;
+  // Consumes on queue events instead, never set along with the loop
+  ConsumeWatcher* m_consume_watcher = nullptr;
+
+  // Whether consumed payloads are handed to JS without copying
+  bool m_zero_copy = false;
+  ZeroCopyMessages m_zero_copy_messages;
+
+  // Whether every assigned partition is detached onto its own queue so it
+  // can be consumed with ConsumePartitionBatch. Queues are shared with the
+  // workers consuming from them, so a revoke never frees one mid-consume.
+  bool m_partition_queues = false;
+  std::map<PartitionKey, std::shared_ptr<RdKafka::Queue>> m_partition_queue_map;
+  uv_mutex_t m_partition_queue_lock;
+
+  // Whether consumed messages are tracked until they are resolved, with
+  // the offsets that are safe to store stored in batches
+  bool m_offset_tracking = false;
+  OffsetTracker m_offset_tracker;
+
+  // Messages a consume loop lets wait for the main thread before it stops
+  // consuming, 0 for no limit
+  size_t m_consume_backlog_max = kDefaultConsumeBacklogMax;
 
   // Node methods
   static NAN_METHOD(NodeConnect);
@@ -118,13 +199,24 @@ class KafkaConsumer : public Connection {
   static NAN_METHOD(NodeCommit);
   static NAN_METHOD(NodeCommitSync);
   static NAN_METHOD(NodeOffsetsStore);
+  static NAN_METHOD(NodeSetOffsetTracking);
+  static NAN_METHOD(NodeResolveOffset);
+  static NAN_METHOD(NodeResetOffsetTracking);
   static NAN_METHOD(NodeCommitted);
   static NAN_METHOD(NodePosition);
   static NAN_METHOD(NodeSubscription);
   static NAN_METHOD(NodeSeek);
+  static NAN_METHOD(NodeSeekPartitions);
   static NAN_METHOD(NodeGetWatermarkOffsets);
+  static NAN_METHOD(NodeGetLag);
+  static NAN_METHOD(NodeQueryLag);
   static NAN_METHOD(NodeConsumeLoop);
+  static NAN_METHOD(NodeConsumeOnEvents);
   static NAN_METHOD(NodeConsume);
+  static NAN_METHOD(NodeSetZeroCopyConsume);
+  static NAN_METHOD(NodeSetPartitionQueues);
+  static NAN_METHOD(NodeSetConsumeBacklogMax);
+  static NAN_METHOD(NodeConsumePartition);
 
   static NAN_METHOD(NodePause);
   static NAN_METHOD(NodeResume);
@@ -0,0 +1,264 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#include <limits>
+#include <string>
+
+#include "rdkafka.h"  // NOLINT
+
+#include "src/latency-histogram.h"
+#include "src/common.h"
+
+namespace NodeKafka {
+
+namespace {
+
+int HighestBit(uint64_t value) {
+  int bit = 0;
+  while (value >>= 1) {
+    bit++;
+  }
+  return bit;
+}
+
+// Without the copy Message::topic_name returns
+const char* TopicName(RdKafka::Message* message) {
+  rd_kafka_topic_t* topic = message->c_ptr()->rkt;
+  return topic ? rd_kafka_topic_name(topic) : NULL;
+}
+
+}  // namespace
+
+LatencyHistogram::LatencyHistogram() {
+  Reset();
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t value) {
+  if (value < kSubBuckets) {
+    return value;
+  }
+
+  // The top kSubBucketBits + 1 bits select the bucket
+  int shift = HighestBit(value) - kSubBucketBits;
+  return kSubBuckets + shift * kSubBuckets +
+    ((value >> shift) - kSubBuckets);
+}
+
+uint64_t LatencyHistogram::BucketHighestValue(size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+
+  size_t shift = (index - kSubBuckets) / kSubBuckets;
+  uint64_t sub = kSubBuckets + (index - kSubBuckets) % kSubBuckets;
+  return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(int64_t micros) {
+  static const uint64_t max_value = (uint64_t(1) << kMaxValueBits) - 1;
+
+  uint64_t value = micros < 0 ? 0 : static_cast<uint64_t>(micros);
+  if (value > max_value) {
+    value = max_value;
+  }
+
+  m_buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(value, std::memory_order_relaxed);
+
+  uint64_t current = m_min.load(std::memory_order_relaxed);
+  while (value < current &&
+         !m_min.compare_exchange_weak(current, value,
+                                      std::memory_order_relaxed)) {}
+  current = m_max.load(std::memory_order_relaxed);
+  while (value > current &&
+         !m_max.compare_exchange_weak(current, value,
+                                      std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::Reset() {
+  for (size_t i = 0; i < kBucketCount; i++) {
+    m_buckets[i].store(0, std::memory_order_relaxed);
+  }
+  m_count.store(0, std::memory_order_relaxed);
+  m_sum.store(0, std::memory_order_relaxed);
+  m_min.store(std::numeric_limits<uint64_t>::max(),
+    std::memory_order_relaxed);
+  m_max.store(0, std::memory_order_relaxed);
+}
+
+v8::Local<v8::Object> LatencyHistogram::ToV8Object() {
+  static const double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+  static const char* names[] = { "p50", "p90", "p99", "p999" };
+  static const size_t percentile_count = 4;
+
+  // Counted from the buckets, so the percentiles agree with each other
+  // even while values are recorded
+  uint64_t buckets[kBucketCount];
+  uint64_t count = 0;
+  for (size_t i = 0; i < kBucketCount; i++) {
+    buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+    count += buckets[i];
+  }
+
+  uint64_t min = m_min.load(std::memory_order_relaxed);
+  uint64_t max = m_max.load(std::memory_order_relaxed);
+  uint64_t sum = m_sum.load(std::memory_order_relaxed);
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("count").ToLocalChecked(),
+    Nan::New<v8::Number>(static_cast<double>(count)));
+  Nan::Set(obj, Nan::New("min").ToLocalChecked(),
+    Nan::New<v8::Number>(count ? static_cast<double>(min) : 0));
+  Nan::Set(obj, Nan::New("max").ToLocalChecked(),
+    Nan::New<v8::Number>(static_cast<double>(max)));
+  Nan::Set(obj, Nan::New("mean").ToLocalChecked(),
+    Nan::New<v8::Number>(count ?
+      static_cast<double>(sum) / static_cast<double>(count) : 0));
+
+  size_t bucket = 0;
+  uint64_t seen = 0;
+  for (size_t p = 0; p < percentile_count; p++) {
+    uint64_t value = 0;
+    if (count > 0) {
+      uint64_t rank = static_cast<uint64_t>(
+        percentiles[p] * static_cast<double>(count) + 0.999999);
+      if (rank < 1) {
+        rank = 1;
+      }
+      // Percentiles only grow, so the walk carries on where it stopped
+      while (bucket < kBucketCount && seen + buckets[bucket] < rank) {
+        seen += buckets[bucket];
+        bucket++;
+      }
+      value = bucket < kBucketCount ? BucketHighestValue(bucket) : max;
+      if (value > max) {
+        value = max;
+      }
+    }
+    Nan::Set(obj, Nan::New(names[p]).ToLocalChecked(),
+      Nan::New<v8::Number>(static_cast<double>(value)));
+  }
+
+  return obj;
+}
+
+LatencyHistograms::LatencyHistograms():
+  m_enabled(false),
+  m_topics(new TopicMap()) {
+  uv_mutex_init(&m_lock);
+}
+
+LatencyHistograms::~LatencyHistograms() {
+  const TopicMap* topics = m_topics.load(std::memory_order_relaxed);
+  for (TopicMap::const_iterator it = topics->begin(); it != topics->end();
+       ++it) {
+    delete it->second;
+  }
+  delete topics;
+
+  for (size_t i = 0; i < m_replaced_topics.size(); i++) {
+    delete m_replaced_topics[i];
+  }
+  uv_mutex_destroy(&m_lock);
+}
+
+void LatencyHistograms::SetEnabled(bool enabled) {
+  m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool LatencyHistograms::IsEnabled() const {
+  return m_enabled.load(std::memory_order_relaxed);
+}
+
+LatencyHistogram* LatencyHistograms::Get(const char* topic) {
+  const TopicMap* topics = m_topics.load(std::memory_order_acquire);
+  TopicMap::const_iterator it = topics->find(topic);
+  if (it != topics->end()) {
+    return it->second;
+  }
+
+  scoped_mutex_lock lock(m_lock);
+
+  // Another thread may have added it meanwhile
+  topics = m_topics.load(std::memory_order_acquire);
+  it = topics->find(topic);
+  if (it != topics->end()) {
+    return it->second;
+  }
+
+  TopicMap* added = new TopicMap(*topics);
+  LatencyHistogram* histogram = new LatencyHistogram();
+  added->insert(std::make_pair(std::string(topic), histogram));
+
+  m_replaced_topics.push_back(topics);
+  m_topics.store(added, std::memory_order_release);
+  return histogram;
+}
+
+void LatencyHistograms::Record(RdKafka::Message& message, int64_t micros) {
+  const char* topic = TopicName(&message);
+  if (topic) {
+    Get(topic)->Record(micros);
+  }
+}
+
+void LatencyHistograms::RecordConsumed(RdKafka::Message* const* messages,
+    size_t count, int64_t now_ms) {
+  // Batches are mostly of one topic, so look it up once per run of them
+  const char* topic = NULL;
+  LatencyHistogram* histogram = NULL;
+
+  for (size_t i = 0; i < count; i++) {
+    RdKafka::Message* message = messages[i];
+    if (message->err() != RdKafka::ERR_NO_ERROR) {
+      continue;
+    }
+
+    RdKafka::MessageTimestamp timestamp = message->timestamp();
+    if (timestamp.type == RdKafka::MessageTimestamp::MSG_TIMESTAMP_NOT_AVAILABLE) {  // NOLINT
+      continue;
+    }
+
+    const char* name = TopicName(message);
+    if (name == NULL) {
+      continue;
+    }
+    // Messages of a topic share its name
+    if (histogram == NULL || name != topic) {
+      histogram = Get(name);
+      topic = name;
+    }
+    histogram->Record((now_ms - timestamp.timestamp) * 1000);
+  }
+}
+
+void LatencyHistograms::Reset() {
+  const TopicMap* topics = m_topics.load(std::memory_order_acquire);
+  for (TopicMap::const_iterator it = topics->begin(); it != topics->end();
+       ++it) {
+    it->second->Reset();
+  }
+}
+
+v8::Local<v8::Object> LatencyHistograms::ToV8Object() {
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+  const TopicMap* topics = m_topics.load(std::memory_order_acquire);
+  for (TopicMap::const_iterator it = topics->begin(); it != topics->end();
+       ++it) {
+    Nan::Set(obj, Nan::New(it->first).ToLocalChecked(),
+      it->second->ToV8Object());
+  }
+
+  return obj;
+}
+
+}  // namespace NodeKafka
@@ -0,0 +1,117 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#ifndef SRC_LATENCY_HISTOGRAM_H_
+#define SRC_LATENCY_HISTOGRAM_H_
+
+#include <nan.h>
+#include <uv.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "rdkafkacpp.h"
+
+namespace NodeKafka {
+
+/**
+ * @brief Histogram of latencies in microseconds, with a fixed layout in the
+ * style of HdrHistogram.
+ *
+ * Values below kSubBuckets are counted exactly. Above that, every power of
+ * two is split into kSubBuckets buckets, so a value is off by at most about
+ * 3%. Recording is a few relaxed atomic increments and can happen on any
+ * thread; snapshots taken meanwhile are only approximately consistent.
+ */
+class LatencyHistogram {
+ public:
+  static const int kSubBucketBits = 5;
+  static const uint64_t kSubBuckets = 1 << kSubBucketBits;
+  // Larger values are counted as this, about 12 days
+  static const int kMaxValueBits = 40;
+  static const size_t kBucketCount =
+    kSubBuckets * (kMaxValueBits - kSubBucketBits + 1);
+
+  LatencyHistogram();
+
+  void Record(int64_t micros);
+  void Reset();
+
+  /**
+   * @returns count, min, max and mean, and the p50, p90, p99 and p999
+   * percentiles as the highest value of their bucket.
+   */
+  v8::Local<v8::Object> ToV8Object();
+
+ private:
+  static size_t BucketIndex(uint64_t value);
+  static uint64_t BucketHighestValue(size_t index);
+
+  std::atomic<uint64_t> m_buckets[kBucketCount];
+  std::atomic<uint64_t> m_count;
+  std::atomic<uint64_t> m_sum;
+  std::atomic<uint64_t> m_min;
+  std::atomic<uint64_t> m_max;
+};
+
+/**
+ * @brief Latency histograms of a client, one for each topic.
+ *
+ * Off until enabled. Producers record the time from produce to the delivery
+ * report of each message, consumers the time from the message timestamp to
+ * the message being consumed.
+ *
+ * Recording takes no lock once a topic has been seen. The topics are kept in
+ * a map that is never changed, only replaced by a copy with the new topic
+ * added, and replaced maps are kept until destruction since threads may
+ * still be reading them.
+ */
+class LatencyHistograms {
+ public:
+  LatencyHistograms();
+  ~LatencyHistograms();
+
+  void SetEnabled(bool);
+  bool IsEnabled() const;
+
+  // Delivery latency of a produced message
+  void Record(RdKafka::Message&, int64_t micros);
+  // Consume latencies of messages read at now_ms, in milliseconds since the
+  // epoch. Messages without a timestamp are skipped.
+  void RecordConsumed(RdKafka::Message* const* messages, size_t count,
+    int64_t now_ms);
+
+  void Reset();
+
+  // @returns An object with the histogram of every topic by name
+  v8::Local<v8::Object> ToV8Object();
+
+ private:
+  // Compares with plain C strings, so topic names need no copy to look up
+  typedef std::map<std::string, LatencyHistogram*, std::less<>> TopicMap;
+
+  LatencyHistogram* Get(const char* topic);
+
+  std::atomic<bool> m_enabled;
+  // Histograms are never removed, only reset, so they can be recorded to
+  // without the lock
+  std::atomic<const TopicMap*> m_topics;
+  std::vector<const TopicMap*> m_replaced_topics;
+  // Held to add a topic
+  uv_mutex_t m_lock;
+};
+
+}  // namespace NodeKafka
+
+#endif  // SRC_LATENCY_HISTOGRAM_H_
@@ -0,0 +1,260 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "src/metadata-cache.h"
+
+namespace NodeKafka {
+
+namespace {
+
+bool PartitionIdLess(const MetadataCache::Partition& a,
+    const MetadataCache::Partition& b) {
+  return a.id < b.id;
+}
+
+MetadataCache::Change NewChange(MetadataCache::Change::Type type,
+    const std::string& topic, int32_t partition, int32_t from, int32_t to) {
+  MetadataCache::Change change;
+  change.type = type;
+  change.topic = topic;
+  change.partition = partition;
+  change.from = from;
+  change.to = to;
+  return change;
+}
+
+const char* ChangeTypeName(MetadataCache::Change::Type type) {
+  switch (type) {
+    case MetadataCache::Change::TOPIC_ADDED:
+      return "topic_added";
+    case MetadataCache::Change::TOPIC_REMOVED:
+      return "topic_removed";
+    case MetadataCache::Change::PARTITIONS_CHANGED:
+      return "partitions_changed";
+    case MetadataCache::Change::LEADER_CHANGED:
+      return "leader_changed";
+    case MetadataCache::Change::REPLICAS_CHANGED:
+      return "replicas_changed";
+  }
+  return "unknown";
+}
+
+v8::Local<v8::Array> Int32Array(const std::vector<int32_t>& values) {
+  v8::Local<v8::Array> array = Nan::New<v8::Array>(values.size());
+  for (size_t i = 0; i < values.size(); i++) {
+    Nan::Set(array, i, Nan::New<v8::Int32>(values[i]));
+  }
+  return array;
+}
+
+}  // namespace
+
+MetadataCache::MetadataCache() : m_populated(false) {
+  uv_mutex_init(&m_lock);
+}
+
+MetadataCache::~MetadataCache() {
+  uv_mutex_destroy(&m_lock);
+}
+
+std::vector<MetadataCache::Change> MetadataCache::Update(
+    const RdKafka::Metadata* metadata) {
+  std::map<std::string, Topic> topics;
+  std::vector<Change> changes;
+
+  const RdKafka::Metadata::TopicMetadataVector* topic_list =
+    metadata->topics();
+
+  uv_mutex_lock(&m_lock);
+
+  for (size_t i = 0; i < topic_list->size(); i++) {
+    const RdKafka::TopicMetadata* topic = (*topic_list)[i];
+    std::map<std::string, Topic>::iterator previous =
+      m_topics.find(topic->topic());
+
+    if (topic->err() != RdKafka::ERR_NO_ERROR) {
+      // Usually transient, keep what was known rather than reporting the
+      // topic as removed and added again
+      if (previous != m_topics.end()) {
+        topics[topic->topic()].swap(previous->second);
+      }
+      continue;
+    }
+
+    const RdKafka::TopicMetadata::PartitionMetadataVector* partition_list =
+      topic->partitions();
+    Topic& current = topics[topic->topic()];
+    current.resize(partition_list->size());
+
+    for (size_t j = 0; j < partition_list->size(); j++) {
+      const RdKafka::PartitionMetadata* partition = (*partition_list)[j];
+      current[j].id = partition->id();
+      current[j].leader = partition->leader();
+      current[j].replicas = *partition->replicas();
+      current[j].isrs = *partition->isrs();
+    }
+    std::sort(current.begin(), current.end(), PartitionIdLess);
+
+    if (!m_populated) {
+      continue;
+    }
+
+    if (previous == m_topics.end()) {
+      changes.push_back(NewChange(Change::TOPIC_ADDED, topic->topic(), -1,
+        0, static_cast<int32_t>(current.size())));
+    } else {
+      Diff(topic->topic(), previous->second, current, &changes);
+    }
+  }
+
+  if (m_populated) {
+    for (std::map<std::string, Topic>::const_iterator it = m_topics.begin();
+         it != m_topics.end(); ++it) {
+      if (topics.find(it->first) == topics.end()) {
+        changes.push_back(NewChange(Change::TOPIC_REMOVED, it->first, -1,
+          static_cast<int32_t>(it->second.size()), 0));
+      }
+    }
+  }
+
+  m_topics.swap(topics);
+  m_populated = true;
+
+  uv_mutex_unlock(&m_lock);
+
+  return changes;
+}
+
+void MetadataCache::Diff(const std::string& name, const Topic& previous,
+    const Topic& current, std::vector<Change>* changes) {
+  if (previous.size() != current.size()) {
+    changes->push_back(NewChange(Change::PARTITIONS_CHANGED, name, -1,
+      static_cast<int32_t>(previous.size()),
+      static_cast<int32_t>(current.size())));
+  }
+
+  // Both are sorted by partition id, compare the partitions in both
+  Topic::const_iterator p = previous.begin();
+  Topic::const_iterator c = current.begin();
+  while (p != previous.end() && c != current.end()) {
+    if (p->id < c->id) {
+      ++p;
+    } else if (c->id < p->id) {
+      ++c;
+    } else {
+      if (p->leader != c->leader) {
+        changes->push_back(NewChange(Change::LEADER_CHANGED, name, c->id,
+          p->leader, c->leader));
+      } else if (p->replicas != c->replicas || p->isrs != c->isrs) {
+        changes->push_back(NewChange(Change::REPLICAS_CHANGED, name, c->id,
+          p->leader, c->leader));
+      }
+      ++p;
+      ++c;
+    }
+  }
+}
+
+void MetadataCache::Clear() {
+  uv_mutex_lock(&m_lock);
+  m_topics.clear();
+  m_populated = false;
+  uv_mutex_unlock(&m_lock);
+}
+
+v8::Local<v8::Value> MetadataCache::TopicToV8Object(const std::string& name) {
+  Nan::EscapableHandleScope scope;
+
+  uv_mutex_lock(&m_lock);
+
+  std::map<std::string, Topic>::const_iterator it = m_topics.find(name);
+  if (it == m_topics.end()) {
+    uv_mutex_unlock(&m_lock);
+    return scope.Escape(Nan::Null());
+  }
+
+  const Topic& topic = it->second;
+  v8::Local<v8::Array> partitions = Nan::New<v8::Array>(topic.size());
+
+  for (size_t i = 0; i < topic.size(); i++) {
+    v8::Local<v8::Object> partition = Nan::New<v8::Object>();
+    Nan::Set(partition, Nan::New("id").ToLocalChecked(),
+      Nan::New<v8::Number>(topic[i].id));
+    Nan::Set(partition, Nan::New("leader").ToLocalChecked(),
+      Nan::New<v8::Number>(topic[i].leader));
+    Nan::Set(partition, Nan::New("replicas").ToLocalChecked(),
+      Int32Array(topic[i].replicas));
+    Nan::Set(partition, Nan::New("isrs").ToLocalChecked(),
+      Int32Array(topic[i].isrs));
+    Nan::Set(partitions, i, partition);
+  }
+
+  uv_mutex_unlock(&m_lock);
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("name").ToLocalChecked(),
+    Nan::New<v8::String>(name).ToLocalChecked());
+  Nan::Set(obj, Nan::New("partitions").ToLocalChecked(), partitions);
+
+  return scope.Escape(obj);
+}
+
+v8::Local<v8::Array> MetadataCache::ChangesToV8Array(
+    const std::vector<Change>& changes) {
+  Nan::EscapableHandleScope scope;
+
+  v8::Local<v8::Array> array = Nan::New<v8::Array>(changes.size());
+
+  for (size_t i = 0; i < changes.size(); i++) {
+    const Change& change = changes[i];
+    v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+    Nan::Set(obj, Nan::New("type").ToLocalChecked(),
+      Nan::New(ChangeTypeName(change.type)).ToLocalChecked());
+    Nan::Set(obj, Nan::New("topic").ToLocalChecked(),
+      Nan::New<v8::String>(change.topic).ToLocalChecked());
+
+    switch (change.type) {
+      case Change::TOPIC_ADDED:
+      case Change::TOPIC_REMOVED:
+      case Change::PARTITIONS_CHANGED:
+        Nan::Set(obj, Nan::New("previousPartitionCount").ToLocalChecked(),
+          Nan::New<v8::Number>(change.from));
+        Nan::Set(obj, Nan::New("partitionCount").ToLocalChecked(),
+          Nan::New<v8::Number>(change.to));
+        break;
+      case Change::LEADER_CHANGED:
+        Nan::Set(obj, Nan::New("partition").ToLocalChecked(),
+          Nan::New<v8::Number>(change.partition));
+        Nan::Set(obj, Nan::New("previousLeader").ToLocalChecked(),
+          Nan::New<v8::Number>(change.from));
+        Nan::Set(obj, Nan::New("leader").ToLocalChecked(),
+          Nan::New<v8::Number>(change.to));
+        break;
+      case Change::REPLICAS_CHANGED:
+        Nan::Set(obj, Nan::New("partition").ToLocalChecked(),
+          Nan::New<v8::Number>(change.partition));
+        Nan::Set(obj, Nan::New("leader").ToLocalChecked(),
+          Nan::New<v8::Number>(change.to));
+        break;
+    }
+
+    Nan::Set(array, i, obj);
+  }
+
+  return scope.Escape(array);
+}
+
+}  // namespace NodeKafka
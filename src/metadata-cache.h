@@ -0,0 +1,97 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#ifndef SRC_METADATA_CACHE_H_
+#define SRC_METADATA_CACHE_H_
+
+#include <nan.h>
+#include <uv.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "rdkafkacpp.h"
+
+namespace NodeKafka {
+
+/**
+ * @brief Last known cluster metadata of a connection, kept natively.
+ *
+ * Refreshing it fetches the metadata of the whole cluster, but nothing of it
+ * is turned into JS objects. Topics are looked up one at a time, and each
+ * refresh yields only what changed since the previous one.
+ *
+ * Thread safe. The V8 conversions must be called on the main thread.
+ */
+class MetadataCache {
+ public:
+  struct Partition {
+    int32_t id;
+    int32_t leader;
+    std::vector<int32_t> replicas;
+    std::vector<int32_t> isrs;
+  };
+
+  struct Change {
+    enum Type {
+      TOPIC_ADDED,
+      TOPIC_REMOVED,
+      // from and to are the partition counts
+      PARTITIONS_CHANGED,
+      // from and to are the leader ids
+      LEADER_CHANGED,
+      // The replicas or the in-sync replicas of the partition changed
+      REPLICAS_CHANGED
+    };
+
+    Type type;
+    std::string topic;
+    int32_t partition;
+    int32_t from;
+    int32_t to;
+  };
+
+  MetadataCache();
+  ~MetadataCache();
+
+  /**
+   * Replace the cached metadata.
+   *
+   * @returns What changed since the previous update. Nothing is reported for
+   * the first one, which only populates the cache.
+   */
+  std::vector<Change> Update(const RdKafka::Metadata*);
+
+  void Clear();
+
+  /**
+   * @returns The topic in the layout of getMetadata, or null if it was not
+   * in the last update.
+   */
+  v8::Local<v8::Value> TopicToV8Object(const std::string& topic);
+
+  static v8::Local<v8::Array> ChangesToV8Array(const std::vector<Change>&);
+
+ private:
+  typedef std::vector<Partition> Topic;
+
+  static void Diff(const std::string& name, const Topic& previous,
+    const Topic& current, std::vector<Change>* changes);
+
+  std::map<std::string, Topic> m_topics;
+  bool m_populated;
+  uv_mutex_t m_lock;
+};
+
+}  // namespace NodeKafka
+
+#endif  // SRC_METADATA_CACHE_H_
@@ -0,0 +1,87 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#include <uv.h>
+
+#include <map>
+#include <string>
+
+#include "src/metrics.h"
+
+namespace NodeKafka {
+namespace Metrics {
+
+std::atomic<uint64_t> messages_converted(0);
+std::atomic<uint64_t> lock_waits(0);
+std::atomic<uint64_t> lock_wait_ns(0);
+std::atomic<int64_t> consume_backlog_messages(0);
+std::atomic<int64_t> consume_backlog_bytes(0);
+
+namespace {
+
+// Gauges are only ever added, so pointers to them stay valid
+std::map<std::string, std::atomic<int64_t>>* worker_gauges;
+uv_mutex_t worker_gauges_lock;
+uv_once_t worker_gauges_once = UV_ONCE_INIT;
+
+template <typename T>
+v8::Local<v8::Number> Load(const std::atomic<T>& value) {
+  return Nan::New<v8::Number>(
+    static_cast<double>(value.load(std::memory_order_relaxed)));
+}
+
+void InitWorkerGauges() {
+  worker_gauges = new std::map<std::string, std::atomic<int64_t>>();
+  uv_mutex_init(&worker_gauges_lock);
+}
+
+}  // namespace
+
+std::atomic<int64_t>* WorkerGauge(const char* name) {
+  uv_once(&worker_gauges_once, InitWorkerGauges);
+
+  uv_mutex_lock(&worker_gauges_lock);
+  std::atomic<int64_t>* gauge = &(*worker_gauges)[name];
+  uv_mutex_unlock(&worker_gauges_lock);
+
+  return gauge;
+}
+
+void AddProcessMetrics(v8::Local<v8::Object> obj) {
+  Nan::Set(obj, Nan::New("messagesConverted").ToLocalChecked(),
+    Load(messages_converted));
+
+  v8::Local<v8::Object> lock = Nan::New<v8::Object>();
+  Nan::Set(lock, Nan::New("waits").ToLocalChecked(),
+    Load(lock_waits));
+  Nan::Set(lock, Nan::New("waitNs").ToLocalChecked(),
+    Load(lock_wait_ns));
+  Nan::Set(obj, Nan::New("connectionLock").ToLocalChecked(), lock);
+
+  v8::Local<v8::Object> consume_backlog = Nan::New<v8::Object>();
+  Nan::Set(consume_backlog, Nan::New("messages").ToLocalChecked(),
+    Load(consume_backlog_messages));
+  Nan::Set(consume_backlog, Nan::New("bytes").ToLocalChecked(),
+    Load(consume_backlog_bytes));
+  Nan::Set(obj, Nan::New("consumeBacklog").ToLocalChecked(), consume_backlog);
+
+  v8::Local<v8::Object> workers = Nan::New<v8::Object>();
+  uv_once(&worker_gauges_once, InitWorkerGauges);
+  uv_mutex_lock(&worker_gauges_lock);
+  for (std::map<std::string, std::atomic<int64_t>>::iterator it =
+         worker_gauges->begin(); it != worker_gauges->end(); ++it) {
+    Nan::Set(workers, Nan::New(it->first).ToLocalChecked(), Load(it->second));
+  }
+  uv_mutex_unlock(&worker_gauges_lock);
+  Nan::Set(obj, Nan::New("workersInFlight").ToLocalChecked(), workers);
+}
+
+}  // namespace Metrics
+}  // namespace NodeKafka
@@ -0,0 +1,63 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#ifndef SRC_METRICS_H_
+#define SRC_METRICS_H_
+
+#include <nan.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace NodeKafka {
+
+/**
+ * @brief Process wide counters of the binding's hot paths.
+ *
+ * All updates are relaxed atomics: the values are only read to be reported
+ * by getNativeMetrics, never to synchronize anything.
+ */
+namespace Metrics {
+
+inline void Increment(std::atomic<uint64_t>& counter, uint64_t value = 1) {
+  counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+inline void RaiseTo(std::atomic<uint64_t>& high_water, uint64_t value) {
+  uint64_t current = high_water.load(std::memory_order_relaxed);
+  while (current < value &&
+         !high_water.compare_exchange_weak(current, value,
+                                           std::memory_order_relaxed)) {}
+}
+
+// Messages converted by Conversion::Message::ToV8Object
+extern std::atomic<uint64_t> messages_converted;
+
+// Connection lock acquisitions that had to wait, and the total wait
+extern std::atomic<uint64_t> lock_waits;
+extern std::atomic<uint64_t> lock_wait_ns;
+
+/**
+ * @returns The gauge of in-flight jobs of the given worker type. The
+ * pointer stays valid for the lifetime of the process.
+ */
+std::atomic<int64_t>* WorkerGauge(const char* name);
+
+// Messages consumed by consume loops that wait for the main thread, and
+// the payload bytes they hold
+extern std::atomic<int64_t> consume_backlog_messages;
+extern std::atomic<int64_t> consume_backlog_bytes;
+
+void AddProcessMetrics(v8::Local<v8::Object>);
+
+}  // namespace Metrics
+}  // namespace NodeKafka
+
+#endif  // SRC_METRICS_H_
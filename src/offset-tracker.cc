@@ -0,0 +1,171 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "src/offset-tracker.h"
+
+namespace NodeKafka {
+
+namespace {
+
+const uint32_t kDefaultResolvedThreshold = 1000;
+const uint32_t kDefaultIntervalMs = 500;
+
+bool OffsetLess(const std::pair<int64_t, bool>& entry, int64_t offset) {
+  return entry.first < offset;
+}
+
+}  // namespace
+
+OffsetTracker::OffsetTracker() :
+  m_resolved_threshold(kDefaultResolvedThreshold),
+  m_interval_ns(static_cast<uint64_t>(kDefaultIntervalMs) * 1000000),
+  m_resolved_since_take(0),
+  m_last_take_ns(uv_hrtime()) {
+  uv_mutex_init(&m_lock);
+}
+
+OffsetTracker::~OffsetTracker() {
+  uv_mutex_destroy(&m_lock);
+}
+
+void OffsetTracker::Begin(const std::string& topic, int32_t partition,
+    int64_t offset) {
+  uv_mutex_lock(&m_lock);
+
+  Partition& p = m_partitions[PartitionKey(topic, partition)];
+  if (!p.in_flight.empty() && offset <= p.in_flight.back().first) {
+    // Rewound, whatever is handed out again has to be resolved again
+    p.in_flight.erase(
+      std::lower_bound(p.in_flight.begin(), p.in_flight.end(), offset,
+        OffsetLess),
+      p.in_flight.end());
+  }
+  p.in_flight.push_back(std::make_pair(offset, false));
+
+  uv_mutex_unlock(&m_lock);
+}
+
+bool OffsetTracker::Resolve(const std::string& topic, int32_t partition,
+    int64_t offset) {
+  uv_mutex_lock(&m_lock);
+
+  Partition& p = m_partitions[PartitionKey(topic, partition)];
+  std::deque<std::pair<int64_t, bool>>::iterator it =
+    std::lower_bound(p.in_flight.begin(), p.in_flight.end(), offset,
+      OffsetLess);
+
+  if (it != p.in_flight.end() && it->first == offset) {
+    it->second = true;
+    while (!p.in_flight.empty() && p.in_flight.front().second) {
+      p.safe = p.in_flight.front().first + 1;
+      p.advanced = true;
+      p.in_flight.pop_front();
+    }
+  } else if (it == p.in_flight.begin() && offset + 1 > p.safe) {
+    // Not handed out by us, but nothing we track comes before it
+    p.safe = offset + 1;
+    p.advanced = true;
+  }
+
+  m_resolved_since_take++;
+  bool due = m_resolved_since_take >= m_resolved_threshold || IsDueLocked();
+
+  uv_mutex_unlock(&m_lock);
+  return due;
+}
+
+void OffsetTracker::Reset(const std::string& topic, int32_t partition) {
+  uv_mutex_lock(&m_lock);
+
+  std::map<PartitionKey, Partition>::iterator it =
+    m_partitions.find(PartitionKey(topic, partition));
+  if (it != m_partitions.end()) {
+    // What was resolved before the seek can still be stored
+    it->second.in_flight.clear();
+  }
+
+  uv_mutex_unlock(&m_lock);
+}
+
+void OffsetTracker::Reset() {
+  uv_mutex_lock(&m_lock);
+
+  for (std::map<PartitionKey, Partition>::iterator it = m_partitions.begin();
+       it != m_partitions.end(); ++it) {
+    it->second.in_flight.clear();
+  }
+
+  uv_mutex_unlock(&m_lock);
+}
+
+std::vector<RdKafka::TopicPartition*> OffsetTracker::TakeAdvanced() {
+  std::vector<RdKafka::TopicPartition*> offsets;
+
+  uv_mutex_lock(&m_lock);
+
+  for (std::map<PartitionKey, Partition>::iterator it = m_partitions.begin();
+       it != m_partitions.end(); ++it) {
+    if (!it->second.advanced) {
+      continue;
+    }
+    offsets.push_back(RdKafka::TopicPartition::create(
+      it->first.first, it->first.second, it->second.safe));
+    it->second.advanced = false;
+  }
+
+  m_resolved_since_take = 0;
+  m_last_take_ns = uv_hrtime();
+
+  uv_mutex_unlock(&m_lock);
+  return offsets;
+}
+
+void OffsetTracker::Remove(
+    const std::vector<RdKafka::TopicPartition*>& partitions) {
+  uv_mutex_lock(&m_lock);
+
+  for (size_t i = 0; i < partitions.size(); i++) {
+    m_partitions.erase(
+      PartitionKey(partitions[i]->topic(), partitions[i]->partition()));
+  }
+
+  uv_mutex_unlock(&m_lock);
+}
+
+void OffsetTracker::Clear() {
+  uv_mutex_lock(&m_lock);
+  m_partitions.clear();
+  m_resolved_since_take = 0;
+  uv_mutex_unlock(&m_lock);
+}
+
+void OffsetTracker::SetThresholds(uint32_t resolved, uint32_t interval_ms) {
+  uv_mutex_lock(&m_lock);
+  m_resolved_threshold = resolved;
+  m_interval_ns = static_cast<uint64_t>(interval_ms) * 1000000;
+  uv_mutex_unlock(&m_lock);
+}
+
+bool OffsetTracker::IsDue() {
+  uv_mutex_lock(&m_lock);
+  bool due = m_resolved_since_take > 0 && IsDueLocked();
+  uv_mutex_unlock(&m_lock);
+  return due;
+}
+
+bool OffsetTracker::IsDueLocked() {
+  return uv_hrtime() - m_last_take_ns >= m_interval_ns;
+}
+
+}  // namespace NodeKafka
@@ -0,0 +1,105 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#ifndef SRC_OFFSET_TRACKER_H_
+#define SRC_OFFSET_TRACKER_H_
+
+#include <uv.h>
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rdkafkacpp.h"
+
+namespace NodeKafka {
+
+/**
+ * @brief Tracks the messages handed out by a consumer until they are
+ * resolved, and works out the offset that is safe to store per partition.
+ *
+ * Messages may be resolved in any order. The safe offset of a partition only
+ * moves past a message once it and every message handed out before it were
+ * resolved, so storing it never skips unprocessed messages. Offsets are
+ * taken from the messages themselves, so gaps left by compaction or
+ * transaction markers are no problem.
+ *
+ * Thread safe.
+ */
+class OffsetTracker {
+ public:
+  OffsetTracker();
+  ~OffsetTracker();
+
+  /**
+   * A message was handed out. An offset that is not past the last one
+   * handed out for the partition means it was rewound, and everything from
+   * that offset on is handed out again.
+   */
+  void Begin(const std::string& topic, int32_t partition, int64_t offset);
+
+  /**
+   * A message was processed.
+   *
+   * @returns Whether the pending safe offsets should be stored now, because
+   * enough messages were resolved or enough time passed since the last
+   * call to TakeAdvanced.
+   */
+  bool Resolve(const std::string& topic, int32_t partition, int64_t offset);
+
+  // Forget what was in flight for a partition that was seeked, or for all
+  // of them when messages were dropped without being resolved
+  void Reset(const std::string& topic, int32_t partition);
+  void Reset();
+
+  /**
+   * @returns The safe offsets of every partition that advanced since the
+   * last call. Ownership is the caller's.
+   */
+  std::vector<RdKafka::TopicPartition*> TakeAdvanced();
+
+  // Stop tracking the given partitions, or all of them
+  void Remove(const std::vector<RdKafka::TopicPartition*>&);
+  void Clear();
+
+  void SetThresholds(uint32_t resolved, uint32_t interval_ms);
+
+  // Whether the safe offsets should be stored because of their age
+  bool IsDue();
+
+ private:
+  typedef std::pair<std::string, int32_t> PartitionKey;
+
+  struct Partition {
+    // Offsets handed out and not yet safe, ascending, with whether each one
+    // was resolved
+    std::deque<std::pair<int64_t, bool>> in_flight;
+    // Next offset to store
+    int64_t safe = RdKafka::Topic::OFFSET_INVALID;
+    bool advanced = false;
+  };
+
+  // Must be called with m_lock held
+  bool IsDueLocked();
+
+  std::map<PartitionKey, Partition> m_partitions;
+  uint32_t m_resolved_threshold;
+  uint64_t m_interval_ns;
+  uint32_t m_resolved_since_take;
+  uint64_t m_last_take_ns;
+  uv_mutex_t m_lock;
+};
+
+}  // namespace NodeKafka
+
+#endif  // SRC_OFFSET_TRACKER_H_
@@ -0,0 +1,476 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/produce-channel.h"
+#include "src/producer.h"
+
+namespace NodeKafka {
+
+namespace {
+
+// How long a parked thread waits for work before it looks again
+const uint64_t kParkTimeoutNs = 100 * 1000000ULL;
+// How long to serve delivery reports before retrying a full queue
+const int kQueueFullWaitMs = 10;
+// Records produced before the tail is published, so JS gets room back
+// while the thread works through a long run of them
+const size_t kTailPublishInterval = 64;
+
+bool IsPowerOfTwo(size_t n) {
+  return n != 0 && (n & (n - 1)) == 0;
+}
+
+uint32_t Align8(uint32_t n) {
+  return (n + 7) & ~static_cast<uint32_t>(7);
+}
+
+template<typename T> T Read(const uint8_t* p) {
+  T value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+template<typename T> void Write(uint8_t* p, T value) {
+  memcpy(p, &value, sizeof(value));
+}
+
+}  // namespace
+
+std::string ProduceChannel::CheckRings(size_t records_length,
+    size_t deliveries_length) {
+  if (records_length <= kHeaderSize ||
+      records_length - kHeaderSize < kMinRecordsSize ||
+      !IsPowerOfTwo(records_length - kHeaderSize) ||
+      records_length - kHeaderSize > 0x80000000) {
+    return "The record ring must be a header and a power of two of at least 1024 bytes";  // NOLINT
+  }
+
+  if (deliveries_length <= kHeaderSize ||
+      (deliveries_length - kHeaderSize) % kDeliverySize != 0 ||
+      !IsPowerOfTwo((deliveries_length - kHeaderSize) / kDeliverySize)) {
+    return "The delivery ring must be a header and a power of two of slots";
+  }
+
+  return std::string();
+}
+
+ProduceChannel::ProduceChannel(Producer* producer,
+    std::shared_ptr<v8::BackingStore> records,
+    std::shared_ptr<v8::BackingStore> deliveries,
+    const std::vector<std::string>& topics,
+    v8::Local<v8::Function> callback) :
+  m_producer(producer),
+  m_records(records),
+  m_deliveries(deliveries),
+  m_topics(topics),
+  m_topic_handles(topics.size(), NULL),
+  m_produced(0),
+  m_delivery_head(0),
+  m_running(false),
+  m_started(false),
+  m_main_queue(NULL),
+  m_signalled(false),
+  m_callback(callback) {
+  m_records_data = static_cast<uint8_t*>(m_records->Data());
+  m_records_mask =
+    static_cast<uint32_t>(m_records->ByteLength() - kHeaderSize - 1);
+  m_deliveries_data = static_cast<uint8_t*>(m_deliveries->Data());
+  m_delivery_slots = static_cast<uint32_t>(
+    (m_deliveries->ByteLength() - kHeaderSize) / kDeliverySize);
+
+  // Carry on from wherever a previous channel on the same rings stopped
+  m_tail = RecordsWord(kTailOffset)->load();
+  m_delivery_head = DeliveriesWord(kHeadOffset)->load();
+  m_produced = m_delivery_head;
+
+  m_slots.resize(m_delivery_slots);
+  m_free_slots.reserve(m_delivery_slots);
+  for (uint32_t i = m_delivery_slots; i > 0; i--) {
+    m_free_slots.push_back(i - 1);
+  }
+
+  uv_mutex_init(&m_slots_lock);
+  uv_mutex_init(&m_deliveries_lock);
+  uv_mutex_init(&m_lock);
+  uv_mutex_init(&m_park_lock);
+  uv_cond_init(&m_park_cond);
+
+  uv_async_init(Nan::GetCurrentEventLoop(), &m_async, AsyncDeliveries);
+  m_async.data = this;
+}
+
+ProduceChannel::~ProduceChannel() {
+  uv_cond_destroy(&m_park_cond);
+  uv_mutex_destroy(&m_park_lock);
+  uv_mutex_destroy(&m_lock);
+  uv_mutex_destroy(&m_deliveries_lock);
+  uv_mutex_destroy(&m_slots_lock);
+}
+
+std::atomic<uint32_t>* ProduceChannel::RecordsWord(size_t offset) {
+  return reinterpret_cast<std::atomic<uint32_t>*>(m_records_data + offset);
+}
+
+std::atomic<uint32_t>* ProduceChannel::DeliveriesWord(size_t offset) {
+  return reinterpret_cast<std::atomic<uint32_t>*>(m_deliveries_data + offset);
+}
+
+Baton ProduceChannel::Start() {
+  scoped_mutex_lock lock(m_lock);
+
+  if (m_started) {
+    return Baton(RdKafka::ERR__STATE, "Produce channel is already open");
+  }
+
+  m_main_queue = rd_kafka_queue_get_main(m_producer->m_client->c_ptr());
+  rd_kafka_queue_cb_event_enable(m_main_queue, QueueNonEmpty, this);
+
+  RecordsWord(kStateOffset)->store(STATE_OPEN);
+  m_running = true;
+  if (uv_thread_create(&m_thread, Run, this) != 0) {
+    m_running = false;
+    rd_kafka_queue_cb_event_enable(m_main_queue, NULL, NULL);
+    rd_kafka_queue_destroy(m_main_queue);
+    m_main_queue = NULL;
+    return Baton(RdKafka::ERR__FAIL, "Could not start the produce channel");
+  }
+  m_started = true;
+
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
+
+void ProduceChannel::Stop() {
+  scoped_mutex_lock lock(m_lock);
+
+  if (!m_started) {
+    return;
+  }
+
+  m_running = false;
+  Wake();
+  uv_thread_join(&m_thread);
+  m_started = false;
+
+  rd_kafka_queue_cb_event_enable(m_main_queue, NULL, NULL);
+  rd_kafka_queue_destroy(m_main_queue);
+  m_main_queue = NULL;
+}
+
+void ProduceChannel::Wake() {
+  scoped_mutex_lock lock(m_park_lock);
+  m_signalled = true;
+  uv_cond_signal(&m_park_cond);
+}
+
+void ProduceChannel::Close() {
+  uv_close(reinterpret_cast<uv_handle_t*>(&m_async), AsyncClosed);
+}
+
+void ProduceChannel::AsyncClosed(uv_handle_t* handle) {
+  delete static_cast<ProduceChannel*>(handle->data);
+}
+
+void ProduceChannel::QueueNonEmpty(rd_kafka_t* rk, void* opaque) {
+  static_cast<ProduceChannel*>(opaque)->Wake();
+}
+
+void ProduceChannel::Run(void* arg) {
+  ProduceChannel* channel = static_cast<ProduceChannel*>(arg);
+
+  while (channel->m_running) {
+    if (channel->Drain() == 0) {
+      channel->Park();
+    }
+  }
+
+  // What was written before the channel was stopped
+  while (channel->Drain() > 0) {}
+
+  std::atomic<uint32_t>* state = channel->RecordsWord(kStateOffset);
+  uint32_t open = STATE_OPEN;
+  state->compare_exchange_strong(open, STATE_CLOSED);
+}
+
+/**
+ * Produce the records written since the last call, as far as there are
+ * delivery slots for them.
+ *
+ * @returns The number of records produced.
+ */
+size_t ProduceChannel::Drain() {
+  scoped_gate_entry entry(m_producer->m_gate);
+  if (!entry.connected()) {
+    m_running = false;
+    return 0;
+  }
+
+  const uint32_t capacity = m_records_mask + 1;
+  const uint32_t head = RecordsWord(kHeadOffset)->load();
+  std::atomic<uint32_t>* delivery_tail = DeliveriesWord(kTailOffset);
+  size_t produced = 0;
+
+  while (m_tail != head &&
+         m_produced - delivery_tail->load() < m_delivery_slots) {
+    const uint32_t position = m_tail & m_records_mask;
+    const uint8_t* record = m_records_data + kHeaderSize + position;
+    const uint32_t size = Read<uint32_t>(record);
+
+    if (size == kWrapMarker && position != 0) {
+      m_tail += capacity - position;
+      continue;
+    }
+
+    if (size < kRecordHeaderSize || size > capacity - position) {
+      // Nothing after it can be trusted
+      RecordsWord(kStateOffset)->store(STATE_FAILED);
+      m_running = false;
+      m_tail = head;
+      break;
+    }
+
+    ProduceRecord(record, size);
+    m_tail += Align8(size);
+    produced++;
+
+    if (produced % kTailPublishInterval == 0) {
+      RecordsWord(kTailOffset)->store(m_tail);
+    }
+  }
+
+  RecordsWord(kTailOffset)->store(m_tail);
+
+  if (produced > 0) {
+    m_producer->m_client->poll(0);
+  }
+
+  return produced;
+}
+
+bool ProduceChannel::HasWork() {
+  return RecordsWord(kHeadOffset)->load() != m_tail &&
+    m_produced - DeliveriesWord(kTailOffset)->load() < m_delivery_slots;
+}
+
+/**
+ * Wait until JS writes records or reads deliveries, or delivery reports are
+ * queued. JS only wakes the thread while the parked flag is set, which is
+ * set before looking for work the same way JS publishes work before it
+ * looks at the flag, so no wake-up is lost.
+ */
+void ProduceChannel::Park() {
+  std::atomic<uint32_t>* parked = RecordsWord(kParkedOffset);
+
+  uv_mutex_lock(&m_park_lock);
+  parked->store(1);
+  if (!m_signalled && m_running && !HasWork()) {
+    uv_cond_timedwait(&m_park_cond, &m_park_lock, kParkTimeoutNs);
+  }
+  m_signalled = false;
+  parked->store(0);
+  uv_mutex_unlock(&m_park_lock);
+
+  scoped_gate_entry entry(m_producer->m_gate);
+  if (entry.connected()) {
+    m_producer->m_client->poll(0);
+  }
+}
+
+void ProduceChannel::ProduceRecord(const uint8_t* record, uint32_t size) {
+  const uint32_t id = Read<uint32_t>(record + 4);
+  const uint16_t topic = Read<uint16_t>(record + 8);
+  const uint16_t header_count = Read<uint16_t>(record + 10);
+  const int32_t partition = Read<int32_t>(record + 12);
+  const int32_t key_len = Read<int32_t>(record + 16);
+  const int32_t value_len = Read<int32_t>(record + 20);
+  const int64_t timestamp = static_cast<int64_t>(Read<double>(record + 24));
+
+  // Counted whatever happens, every record gets a delivery
+  m_produced++;
+
+  const uint8_t* p = record + kRecordHeaderSize;
+  const uint8_t* end = record + size;
+
+  const uint8_t* key = NULL;
+  if (key_len >= 0) {
+    if (end - p < key_len) {
+      WriteDelivery(id, RdKafka::ERR__BAD_MSG, partition, topic,
+        RdKafka::Topic::OFFSET_INVALID, timestamp);
+      return;
+    }
+    key = p;
+    p += key_len;
+  }
+
+  const uint8_t* value = NULL;
+  if (value_len >= 0) {
+    if (end - p < value_len) {
+      WriteDelivery(id, RdKafka::ERR__BAD_MSG, partition, topic,
+        RdKafka::Topic::OFFSET_INVALID, timestamp);
+      return;
+    }
+    value = p;
+    p += value_len;
+  }
+
+  rd_kafka_headers_t* headers = NULL;
+  if (header_count > 0) {
+    bool complete = true;
+    headers = rd_kafka_headers_new(header_count);
+    for (uint16_t i = 0; i < header_count && complete; i++) {
+      if (end - p < 8) {
+        complete = false;
+        break;
+      }
+      uint32_t name_len = Read<uint32_t>(p);
+      int32_t header_value_len = Read<int32_t>(p + 4);
+      p += 8;
+      size_t needed = static_cast<size_t>(name_len) +
+        (header_value_len > 0 ? header_value_len : 0);
+      if (static_cast<size_t>(end - p) < needed) {
+        complete = false;
+        break;
+      }
+      rd_kafka_header_add(headers, reinterpret_cast<const char*>(p),
+        name_len, header_value_len >= 0 ? p + name_len : NULL,
+        header_value_len >= 0 ? header_value_len : 0);
+      p += needed;
+    }
+
+    if (!complete) {
+      rd_kafka_headers_destroy(headers);
+      WriteDelivery(id, RdKafka::ERR__BAD_MSG, partition, topic,
+        RdKafka::Topic::OFFSET_INVALID, timestamp);
+      return;
+    }
+  }
+
+  if (topic >= m_topic_handles.size()) {
+    if (headers) {
+      rd_kafka_headers_destroy(headers);
+    }
+    WriteDelivery(id, RdKafka::ERR__UNKNOWN_TOPIC, partition, topic,
+      RdKafka::Topic::OFFSET_INVALID, timestamp);
+    return;
+  }
+
+  if (m_topic_handles[topic] == NULL) {
+    std::string errstr;
+    m_topic_handles[topic] =
+      m_producer->GetCachedTopic(m_topics[topic], NULL, errstr);
+    if (m_topic_handles[topic] == NULL) {
+      if (headers) {
+        rd_kafka_headers_destroy(headers);
+      }
+      WriteDelivery(id, RdKafka::ERR_TOPIC_EXCEPTION, partition,
+        topic, RdKafka::Topic::OFFSET_INVALID, timestamp);
+      return;
+    }
+  }
+
+  Slot* slot = TakeSlot();
+  slot->id = id;
+  slot->topic = topic;
+
+  rd_kafka_resp_err_t err;
+  for (;;) {
+    // The ring is reused as soon as the tail moves on, so always copy
+    err = rd_kafka_producev(m_producer->m_client->c_ptr(),
+      RD_KAFKA_V_RKT(m_topic_handles[topic]->c_ptr()),
+      RD_KAFKA_V_PARTITION(partition),
+      RD_KAFKA_V_MSGFLAGS(RD_KAFKA_MSG_F_COPY),
+      RD_KAFKA_V_VALUE(const_cast<uint8_t*>(value),
+        value ? static_cast<size_t>(value_len) : 0),
+      RD_KAFKA_V_KEY(key, key ? static_cast<size_t>(key_len) : 0),
+      RD_KAFKA_V_TIMESTAMP(timestamp),
+      RD_KAFKA_V_OPAQUE(slot),
+      RD_KAFKA_V_HEADERS(headers),
+      RD_KAFKA_V_END);
+
+    if (err != RD_KAFKA_RESP_ERR__QUEUE_FULL || !m_running) {
+      break;
+    }
+
+    // Wait for room like a blocking producer, the records stay in the ring
+    m_producer->m_client->poll(kQueueFullWaitMs);
+  }
+
+  if (err != RD_KAFKA_RESP_ERR_NO_ERROR) {
+    if (headers) {
+      rd_kafka_headers_destroy(headers);
+    }
+    ReleaseSlot(slot);
+    WriteDelivery(id, static_cast<RdKafka::ErrorCode>(err), partition, topic,
+      RdKafka::Topic::OFFSET_INVALID, timestamp);
+  }
+}
+
+ProduceChannel::Slot* ProduceChannel::TakeSlot() {
+  scoped_mutex_lock lock(m_slots_lock);
+  // Never empty, there are no more records in flight than slots
+  Slot* slot = &m_slots[m_free_slots.back()];
+  m_free_slots.pop_back();
+  return slot;
+}
+
+void ProduceChannel::ReleaseSlot(Slot* slot) {
+  scoped_mutex_lock lock(m_slots_lock);
+  m_free_slots.push_back(static_cast<uint32_t>(slot - &m_slots[0]));
+}
+
+bool ProduceChannel::Owns(void* opaque) const {
+  uintptr_t p = reinterpret_cast<uintptr_t>(opaque);
+  uintptr_t begin = reinterpret_cast<uintptr_t>(m_slots.data());
+  return p >= begin && p < begin + m_slots.size() * sizeof(Slot);
+}
+
+void ProduceChannel::Delivered(RdKafka::Message& message) {
+  Slot* slot = static_cast<Slot*>(message.msg_opaque());
+  uint32_t id = slot->id;
+  uint32_t topic = slot->topic;
+  ReleaseSlot(slot);
+
+  WriteDelivery(id, message.err(), message.partition(), topic,
+    message.offset(), message.timestamp().timestamp);
+}
+
+void ProduceChannel::WriteDelivery(uint32_t id, RdKafka::ErrorCode err,
+    int32_t partition, uint32_t topic, int64_t offset, int64_t timestamp) {
+  {
+    scoped_mutex_lock lock(m_deliveries_lock);
+
+    uint8_t* slot = m_deliveries_data + kHeaderSize +
+      (m_delivery_head & (m_delivery_slots - 1)) * kDeliverySize;
+    Write<uint32_t>(slot, id);
+    Write<int32_t>(slot + 4, err);
+    Write<int32_t>(slot + 8, partition);
+    Write<uint32_t>(slot + 12, topic);
+    Write<double>(slot + 16, static_cast<double>(offset));
+    Write<double>(slot + 24, static_cast<double>(timestamp));
+
+    m_delivery_head++;
+    DeliveriesWord(kHeadOffset)->store(m_delivery_head);
+  }
+
+  uv_async_send(&m_async);
+}
+
+void ProduceChannel::AsyncDeliveries(uv_async_t* handle) {
+  Nan::HandleScope scope;
+  ProduceChannel* channel = static_cast<ProduceChannel*>(handle->data);
+  // The deliveries are read from the ring
+  channel->m_callback.Call(0, NULL);
+}
+
+}  // namespace NodeKafka
@@ -0,0 +1,188 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#ifndef SRC_PRODUCE_CHANNEL_H_
+#define SRC_PRODUCE_CHANNEL_H_
+
+#include <nan.h>
+#include <uv.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rdkafkacpp.h"
+#include "rdkafka.h"  // NOLINT
+
+#include "src/errors.h"
+
+namespace NodeKafka {
+
+class Producer;
+
+/**
+ * @brief Produces the records JS writes into a shared memory ring, on a
+ * thread of its own, and reports their delivery through a second ring.
+ *
+ * JS only calls into the binding to wake the thread up when it found it
+ * parked. Both rings start with a header of kHeaderSize bytes holding
+ * 32 bit counters, the writer of a ring owns its head and the reader its
+ * tail. The layout is shared with lib/producer/produce-channel.js, fields
+ * are in host byte order.
+ *
+ * Records follow the header of their ring, which is a power of two in size.
+ * Every record starts at a multiple of 8 and never wraps around the end,
+ * a size of kWrapMarker skips to the start instead:
+ *
+ *   u32 size, including this header    u32 id
+ *   u16 topic index    u16 header count
+ *   i32 partition      i32 key length     i32 value length (-1 for null)
+ *   f64 timestamp (0 for now)
+ *   key, value, then per header u32 name length, i32 value length,
+ *   name and value
+ *
+ * Deliveries are kDeliverySize slots, a power of two of them:
+ *
+ *   u32 id    i32 error code    i32 partition    u32 topic index
+ *   f64 offset    f64 timestamp
+ *
+ * No more records are produced than there are delivery slots JS has not
+ * read yet, so the delivery ring can never overflow.
+ */
+class ProduceChannel {
+ public:
+  static const size_t kHeaderSize = 128;
+  // Byte offsets of the counters in the ring headers
+  static const size_t kHeadOffset = 0;
+  static const size_t kTailOffset = 64;
+  // Records ring only, set by the thread before it waits for work
+  static const size_t kParkedOffset = 68;
+  static const size_t kStateOffset = 72;
+
+  enum State {
+    STATE_OPEN = 0,
+    STATE_CLOSED = 1,
+    // A malformed record was found, the thread stopped
+    STATE_FAILED = 2
+  };
+
+  static const size_t kRecordHeaderSize = 32;
+  static const uint32_t kWrapMarker = 0xFFFFFFFF;
+  static const size_t kMinRecordsSize = 1024;
+  static const size_t kDeliverySize = 32;
+
+  /**
+   * @returns An error message if the rings do not have a valid layout,
+   * otherwise an empty string.
+   */
+  static std::string CheckRings(size_t records_length,
+    size_t deliveries_length);
+
+  ProduceChannel(Producer*, std::shared_ptr<v8::BackingStore> records,
+    std::shared_ptr<v8::BackingStore> deliveries,
+    const std::vector<std::string>& topics, v8::Local<v8::Function> callback);
+
+  // Must have the connection read locked
+  Baton Start();
+
+  /**
+   * Stop the thread. Records written before are still produced, as long as
+   * there are delivery slots for them. Must be called before the client is
+   * destroyed.
+   */
+  void Stop();
+
+  // Wake the thread if it is parked, without waiting for its timeout
+  void Wake();
+
+  // Close the loop handle and free the channel. Must be called on the main
+  // thread, once the client is gone.
+  void Close();
+
+  // Whether a delivered message was produced by this channel
+  bool Owns(void* opaque) const;
+
+  // Called by whichever thread serves the delivery report
+  void Delivered(RdKafka::Message&);
+
+ private:
+  // Where the delivery of a message in flight goes
+  struct Slot {
+    uint32_t id;
+    uint32_t topic;
+  };
+
+  ~ProduceChannel();
+
+  static void Run(void*);
+  static void QueueNonEmpty(rd_kafka_t*, void*);
+  static void AsyncDeliveries(uv_async_t*);
+  static void AsyncClosed(uv_handle_t*);
+
+  size_t Drain();
+  bool HasWork();
+  void Park();
+  void ProduceRecord(const uint8_t* record, uint32_t size);
+  void WriteDelivery(uint32_t id, RdKafka::ErrorCode err, int32_t partition,
+    uint32_t topic, int64_t offset, int64_t timestamp);
+  Slot* TakeSlot();
+  void ReleaseSlot(Slot*);
+
+  std::atomic<uint32_t>* RecordsWord(size_t offset);
+  std::atomic<uint32_t>* DeliveriesWord(size_t offset);
+
+  Producer* m_producer;
+
+  // Kept alive for as long as the thread or the callbacks use them
+  std::shared_ptr<v8::BackingStore> m_records;
+  std::shared_ptr<v8::BackingStore> m_deliveries;
+  uint8_t* m_records_data;
+  uint32_t m_records_mask;
+  uint8_t* m_deliveries_data;
+  uint32_t m_delivery_slots;
+
+  std::vector<std::string> m_topics;
+  // Resolved on first use, owned by the topic cache of the producer
+  std::vector<RdKafka::Topic*> m_topic_handles;
+
+  // Only used on the channel thread
+  uint32_t m_tail;
+  uint32_t m_produced;
+
+  std::vector<Slot> m_slots;
+  std::vector<uint32_t> m_free_slots;
+  uv_mutex_t m_slots_lock;
+
+  // Serializes the deliveries of all polling threads
+  uint32_t m_delivery_head;
+  uv_mutex_t m_deliveries_lock;
+
+  uv_thread_t m_thread;
+  std::atomic<bool> m_running;
+  // Guards m_started, Stop may be called from a worker
+  bool m_started;
+  uv_mutex_t m_lock;
+
+  // Wakes the thread when delivery reports are queued while it is parked
+  rd_kafka_queue_t* m_main_queue;
+
+  bool m_signalled;
+  uv_mutex_t m_park_lock;
+  uv_cond_t m_park_cond;
+
+  uv_async_t m_async;
+  Nan::Callback m_callback;
+};
+
+}  // namespace NodeKafka
+
+#endif  // SRC_PRODUCE_CHANNEL_H_
@@ -8,12 +8,17 @@
  * of the MIT license.  See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <string>
 #include <vector>
 
 #include "src/producer.h"
 #include "src/kafka-consumer.h"
 #include "src/workers.h"
+#include "src/worker-pool.h"
 
 namespace NodeKafka {
 
@@ -33,20 +38,23 @@ namespace NodeKafka {
 Producer::Producer(Conf* gconfig, Conf* tconfig):
   Connection(gconfig, tconfig),
   m_dr_cb(),
-  m_partitioner_cb() {
+  m_partitioner_cb(),
+  m_background_poll(false),
+  m_background_poll_started(false) {
     std::string errstr;
 
     if (m_tconfig)
       m_gconfig->set("default_topic_conf", m_tconfig, errstr);
 
     m_gconfig->set("dr_cb", &m_dr_cb, errstr);
+    m_dr_cb.SetLatencyHistograms(&m_latency_histograms);
   }
 
 Producer::~Producer() {
   Disconnect();
 }
 
-Nan::Persistent<v8::Function> Producer::constructor;
+PerIsolateFunction Producer::constructor;
 
 void Producer::Init(v8::Local<v8::Object> exports) {
   Nan::HandleScope scope;
@@ -62,6 +70,11 @@ void Producer::Init(v8::Local<v8::Object> exports) {
    */
 
   Nan::SetPrototypeMethod(tpl, "configureCallbacks", NodeConfigureCallbacks);
+  Nan::SetPrototypeMethod(tpl, "setStatsFields", NodeSetStatsFields);
+  Nan::SetPrototypeMethod(tpl, "getNativeMetrics", NodeGetNativeMetrics);
+  Nan::SetPrototypeMethod(tpl, "setLatencyHistograms", NodeSetLatencyHistograms);  // NOLINT
+  Nan::SetPrototypeMethod(tpl, "getLatencyHistograms", NodeGetLatencyHistograms);  // NOLINT
+  Nan::SetPrototypeMethod(tpl, "resetLatencyHistograms", NodeResetLatencyHistograms);  // NOLINT
 
   /*
    * @brief Methods to do with establishing state
@@ -70,8 +83,11 @@ void Producer::Init(v8::Local<v8::Object> exports) {
   Nan::SetPrototypeMethod(tpl, "connect", NodeConnect);
   Nan::SetPrototypeMethod(tpl, "disconnect", NodeDisconnect);
   Nan::SetPrototypeMethod(tpl, "getMetadata", NodeGetMetadata);
+  Nan::SetPrototypeMethod(tpl, "refreshMetadataCache", NodeRefreshMetadataCache);  // NOLINT
+  Nan::SetPrototypeMethod(tpl, "getCachedTopicMetadata", NodeGetCachedTopicMetadata);  // NOLINT
   Nan::SetPrototypeMethod(tpl, "queryWatermarkOffsets", NodeQueryWatermarkOffsets);  // NOLINT
   Nan::SetPrototypeMethod(tpl, "poll", NodePoll);
+  Nan::SetPrototypeMethod(tpl, "setPollInBackground", NodeSetPollInBackground);
   Nan::SetPrototypeMethod(tpl, "setSaslCredentials", NodeSetSaslCredentials);
   Nan::SetPrototypeMethod(tpl, "setOAuthBearerToken", NodeSetOAuthBearerToken);
   Nan::SetPrototypeMethod(tpl, "setOAuthBearerTokenFailure",
@@ -83,9 +99,15 @@ void Producer::Init(v8::Local<v8::Object> exports) {
 
   Nan::SetPrototypeMethod(tpl, "setPartitioner", NodeSetPartitioner);
   Nan::SetPrototypeMethod(tpl, "produce", NodeProduce);
+  Nan::SetPrototypeMethod(tpl, "produceBatch", NodeProduceBatch);
 
   Nan::SetPrototypeMethod(tpl, "flush", NodeFlush);
 
+  Nan::SetPrototypeMethod(tpl, "openProduceChannel", NodeOpenProduceChannel);
+  Nan::SetPrototypeMethod(tpl, "wakeProduceChannel", NodeWakeProduceChannel);
+  Nan::SetPrototypeMethod(tpl, "closeProduceChannel", NodeCloseProduceChannel);
+  Nan::SetPrototypeMethod(tpl, "setSharedHandle", NodeSetSharedHandle);
+
   /*
    * @brief Methods exposed to do with transactions
    */
@@ -158,7 +180,7 @@ v8::Local<v8::Object> Producer::NewInstance(v8::Local<v8::Value> arg) {
   const unsigned argc = 1;
 
   v8::Local<v8::Value> argv[argc] = { arg };
-  v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+  v8::Local<v8::Function> cons = constructor.Get();
   v8::Local<v8::Object> instance =
     Nan::NewInstance(cons, argc, argv).ToLocalChecked();
 
@@ -170,6 +192,22 @@ Baton Producer::Connect() {
     return Baton(RdKafka::ERR_NO_ERROR);
   }
 
+  if (m_share_handle) {
+    {
+      scoped_shared_write_lock lock(m_connection_lock);
+      Baton baton = SharedProducer::Acquire(m_shared_loop, m_gconfig,
+        m_tconfig, &m_event_cb, &m_dr_cb, &m_shared, &m_shared_member);
+      if (baton.err() != RdKafka::ERR_NO_ERROR) {
+        return baton;
+      }
+      m_producer = m_shared->Handle();
+      m_client = m_producer;
+    }
+
+    m_gate.Open();
+    return Baton(RdKafka::ERR_NO_ERROR);
+  }
+
   std::string errstr;
 
   Baton baton = setupSaslOAuthBearerConfig();
@@ -178,14 +216,17 @@ Baton Producer::Connect() {
   }
 
   {
-    scoped_shared_read_lock lock(m_connection_lock);
-    m_client = RdKafka::Producer::create(m_gconfig, errstr);
+    scoped_shared_write_lock lock(m_connection_lock);
+    m_producer = RdKafka::Producer::create(m_gconfig, errstr);
+    m_client = m_producer;
   }
 
   if (!m_client) {
     return Baton(RdKafka::ERR__STATE, errstr);
   }
 
+  m_gate.Open();
+
   baton = setupSaslOAuthBearerBackgroundQueue();
   return baton;
 }
@@ -200,20 +241,52 @@ void Producer::DeactivateDispatchers() {
   m_gconfig->stop();                   // From global config.
   m_event_cb.dispatcher.Deactivate();  // From connection
   m_dr_cb.dispatcher.Deactivate();
+
+  // Nothing can be delivered to the channel once the client is gone
+  if (m_channel && !IsConnected()) {
+    m_dr_cb.SetChannel(NULL);
+    m_channel->Close();
+    m_channel = NULL;
+  }
+}
+
+void Producer::Teardown() {
+  Disconnect();
+  DeactivateDispatchers();
 }
 
 void Producer::Disconnect() {
+  // The channel produces through the gate, let it finish what JS wrote.
+  if (m_channel) {
+    m_channel->Stop();
+  }
+
+  // The poll thread polls from inside the gate, which Close would wait on
+  // for up to a poll timeout. Join it first so it is not left running.
+  StopBackgroundPoll();
+
   if (IsConnected()) {
     scoped_shared_write_lock lock(m_connection_lock);
-    delete m_client;
+    m_gate.Close();
+    ClearTopicCache();
+    // Stale once disconnected, the next refresh must not diff against it
+    m_metadata_cache.Clear();
+    if (m_shared) {
+      m_shared->Release(m_shared_member);
+      m_shared = NULL;
+    } else {
+      delete m_client;
+    }
     m_client = NULL;
+    m_producer = NULL;
   }
 }
 
 /**
  * [Producer::Produce description]
  * @param message - pointer to the message we are sending. This method will
- * create a copy of it, so you are still required to free it when done.
+ * create a copy of it, so you are still required to free it when done,
+ * unless the producer is in zero copy mode.
  * @param size - size of the message. We are copying the memory so we need
  * the size
  * @param topic - RdKafka::Topic* object to send the message to. Generally
@@ -227,18 +300,18 @@ Baton Producer::Produce(void* message, size_t size, RdKafka::Topic* topic,
   int32_t partition, const void *key, size_t key_len, void* opaque) {
   RdKafka::ErrorCode response_code;
 
-  if (IsConnected()) {
-    scoped_shared_read_lock lock(m_connection_lock);
-    if (IsConnected()) {
-      RdKafka::Producer* producer = dynamic_cast<RdKafka::Producer*>(m_client);
-      response_code = producer->produce(topic, partition,
-            RdKafka::Producer::RK_MSG_COPY,
-            message, size, key, key_len, opaque);
+  if (m_dr_cb.dispatcher.IsFull()) {
+    return Baton(RdKafka::ERR__QUEUE_FULL, "Delivery report backlog is full");
+  }
+
+  {
+    scoped_gate_entry entry(m_gate);
+    if (entry.connected()) {
+      response_code = m_producer->produce(topic, partition,
+            MessageFlags(false), message, size, key, key_len, opaque);
     } else {
       response_code = RdKafka::ERR__STATE;
     }
-  } else {
-    response_code = RdKafka::ERR__STATE;
   }
 
   // These topics actually link to the configuration
@@ -260,7 +333,8 @@ Baton Producer::Produce(void* message, size_t size, RdKafka::Topic* topic,
 /**
  * [Producer::Produce description]
  * @param message - pointer to the message we are sending. This method will
- * create a copy of it, so you are still required to free it when done.
+ * create a copy of it, so you are still required to free it when done,
+ * unless the producer is in zero copy mode.
  * @param size - size of the message. We are copying the memory so we need
  * the size
  * @param topic - String topic to use so we do not need to create
@@ -272,7 +346,7 @@ Baton Producer::Produce(void* message, size_t size, RdKafka::Topic* topic,
  */
 Baton Producer::Produce(void* message, size_t size, std::string topic,
   int32_t partition, std::string *key, int64_t timestamp, void* opaque,
-  RdKafka::Headers* headers) {
+  rd_kafka_headers_t* headers) {
   return Produce(message, size, topic, partition,
     key ? key->data() : NULL, key ? key->size() : 0,
     timestamp, opaque, headers);
@@ -281,7 +355,8 @@ Baton Producer::Produce(void* message, size_t size, std::string topic,
 /**
  * [Producer::Produce description]
  * @param message - pointer to the message we are sending. This method will
- * create a copy of it, so you are still required to free it when done.
+ * create a copy of it, so you are still required to free it when done,
+ * unless the producer is in zero copy mode.
  * @param size - size of the message. We are copying the memory so we need
  * the size
  * @param topic - String topic to use so we do not need to create
@@ -293,35 +368,68 @@ Baton Producer::Produce(void* message, size_t size, std::string topic,
  */
 Baton Producer::Produce(void* message, size_t size, std::string topic,
   int32_t partition, const void *key, size_t key_len,
-  int64_t timestamp, void* opaque, RdKafka::Headers* headers) {
+  int64_t timestamp, void* opaque, rd_kafka_headers_t* headers) {
+  return Produce(message, size, topic, NULL, partition, key, key_len,
+    timestamp, opaque, headers, false);
+}
+
+/**
+ * [Producer::Produce description]
+ * @param message - pointer to the message we are sending. This method will
+ * create a copy of it, so you are still required to free it when done,
+ * unless the producer is in zero copy mode.
+ * @param size - size of the message. We are copying the memory so we need
+ * the size
+ * @param topic - Name of the topic. The topic handle is looked up in the
+ * connection's topic cache, so it is only created once.
+ * @param topic_conf - Topic configuration to create the topic handle with
+ * if it does not exist yet, or NULL for the default topic configuration.
+ * @param partition - partition to send it to. Send in
+ * RdKafka::Topic::PARTITION_UA to send to an unassigned topic
+ * @param key - a pointer to the key, or null if there is none.
+ * @param headers - headers for the message, or null. librdkafka takes
+ * ownership of them if the message is enqueued, otherwise they still need to
+ * be destroyed by the caller.
+ * @param free_payload - whether message is memory from malloc that
+ * librdkafka takes ownership of if the message is enqueued, instead of
+ * copying it.
+ * @return - A baton object with error code set if it failed.
+ */
+Baton Producer::Produce(void* message, size_t size, std::string topic,
+  RdKafka::Conf* topic_conf, int32_t partition, const void *key,
+  size_t key_len, int64_t timestamp, void* opaque,
+  rd_kafka_headers_t* headers, bool free_payload) {
   RdKafka::ErrorCode response_code;
 
-  if (IsConnected()) {
-    scoped_shared_read_lock lock(m_connection_lock);
-    if (IsConnected()) {
-      RdKafka::Producer* producer = dynamic_cast<RdKafka::Producer*>(m_client);
-      // This one is a bit different
-      response_code = producer->produce(topic, partition,
-            RdKafka::Producer::RK_MSG_COPY,
-            message, size,
-            key, key_len,
-            timestamp, headers, opaque);
+  if (m_dr_cb.dispatcher.IsFull()) {
+    return Baton(RdKafka::ERR__QUEUE_FULL, "Delivery report backlog is full");
+  }
+
+  {
+    scoped_gate_entry entry(m_gate);
+    if (entry.connected()) {
+      std::string errstr;
+      RdKafka::Topic* rd_topic = GetCachedTopic(topic, topic_conf, errstr);
+      if (rd_topic == NULL) {
+        return Baton(RdKafka::ERR_TOPIC_EXCEPTION, errstr);
+      }
+
+      response_code = static_cast<RdKafka::ErrorCode>(
+        rd_kafka_producev(m_client->c_ptr(),
+          RD_KAFKA_V_RKT(rd_topic->c_ptr()),
+          RD_KAFKA_V_PARTITION(partition),
+          RD_KAFKA_V_MSGFLAGS(MessageFlags(free_payload)),
+          RD_KAFKA_V_VALUE(message, size),
+          RD_KAFKA_V_KEY(key, key_len),
+          RD_KAFKA_V_TIMESTAMP(timestamp),
+          RD_KAFKA_V_OPAQUE(opaque),
+          RD_KAFKA_V_HEADERS(headers),
+          RD_KAFKA_V_END));
     } else {
       response_code = RdKafka::ERR__STATE;
     }
-  } else {
-    response_code = RdKafka::ERR__STATE;
   }
 
-  // These topics actually link to the configuration
-  // they are made from. It's so we can reuse topic configurations
-  // That means if we delete it here and librd thinks its still linked,
-  // producing to the same topic will try to reuse it and it will die.
-  //
-  // Honestly, we may need to make configuration a first class object
-  // @todo(Conf needs to be a first class object that is passed around)
-  // delete topic;
-
   if (response_code != RdKafka::ERR_NO_ERROR) {
     return Baton(response_code);
   }
@@ -329,10 +437,258 @@ Baton Producer::Produce(void* message, size_t size, std::string topic,
   return Baton(RdKafka::ERR_NO_ERROR);
 }
 
+/**
+ * @brief Produce a batch of messages to a single topic.
+ *
+ * The topic handle is resolved once and the connection is entered once
+ * for the whole batch, instead of once per message. The result of each
+ * enqueue is written back into the err field of its message. Messages that
+ * already carry an error (because they could not be unpacked) are skipped.
+ *
+ * Ownership of the headers, and of payloads marked free_payload, of every
+ * message that was enqueued is passed to librdkafka, and those fields are
+ * cleared.
+ *
+ * @param topic_name - Name of the topic all of the messages are sent to.
+ * @param messages - The unpacked messages.
+ */
+void Producer::ProduceBatch(std::string topic_name,
+  std::vector<ProducerBatchMessage> &messages) {
+  RdKafka::ErrorCode response_code = RdKafka::ERR_NO_ERROR;
+
+  // The backlog is only worked down on the main thread, so it stays full
+  // for the whole batch
+  if (m_dr_cb.dispatcher.IsFull()) {
+    response_code = RdKafka::ERR__QUEUE_FULL;
+  } else {
+    scoped_gate_entry entry(m_gate);
+    if (entry.connected()) {
+      rd_kafka_t* rk = m_client->c_ptr();
+
+      std::string errstr;
+      RdKafka::Topic* rd_topic = GetCachedTopic(topic_name, NULL, errstr);
+
+      if (rd_topic) {
+        rd_kafka_topic_t* rkt = rd_topic->c_ptr();
+
+        for (size_t i = 0; i < messages.size(); i++) {
+          ProducerBatchMessage &message = messages[i];
+          if (message.err != RdKafka::ERR_NO_ERROR) {
+            continue;
+          }
+
+          rd_kafka_resp_err_t err = rd_kafka_producev(rk,
+            RD_KAFKA_V_RKT(rkt),
+            RD_KAFKA_V_PARTITION(message.partition),
+            RD_KAFKA_V_MSGFLAGS(MessageFlags(message.free_payload)),
+            RD_KAFKA_V_VALUE(message.payload, message.payload_len),
+            RD_KAFKA_V_KEY(message.key, message.key_len),
+            RD_KAFKA_V_TIMESTAMP(message.timestamp),
+            RD_KAFKA_V_OPAQUE(message.opaque),
+            RD_KAFKA_V_HEADERS(message.headers),
+            RD_KAFKA_V_END);
+
+          if (err == RD_KAFKA_RESP_ERR_NO_ERROR) {
+            // librdkafka destroys the headers along with the message.
+            message.headers = NULL;
+            message.free_payload = false;
+          }
+
+          message.err = static_cast<RdKafka::ErrorCode>(err);
+        }
+
+        return;
+      }
+
+      response_code = RdKafka::ERR_TOPIC_EXCEPTION;
+    } else {
+      response_code = RdKafka::ERR__STATE;
+    }
+  }
+
+  for (size_t i = 0; i < messages.size(); i++) {
+    if (messages[i].err == RdKafka::ERR_NO_ERROR) {
+      messages[i].err = response_code;
+    }
+  }
+}
+
+/**
+ * @brief Flags to produce messages with.
+ *
+ * Payloads are copied by librdkafka unless the producer is in zero copy
+ * mode, in which case the Buffer is pinned through the message opaque until
+ * its delivery report is handled. Payloads encoded from strings are handed
+ * over to librdkafka instead, with free_payload.
+ */
+int Producer::MessageFlags(bool free_payload) {
+  if (free_payload) {
+    return RdKafka::Producer::RK_MSG_FREE;
+  }
+  return m_dr_cb.IsZeroCopy() ? 0 : RdKafka::Producer::RK_MSG_COPY;
+}
+
+/**
+ * @brief Whether a JS opaque can be produced with.
+ *
+ * Anything can, unless the producer is in opaque id mode, where the opaque
+ * must be null, undefined or a non-negative integer that fits in a pointer.
+ * Null and undefined both mean no opaque there, see IsNoOpaque.
+ */
+bool Producer::IsValidOpaque(v8::Local<v8::Value> opaque) {
+  if (!m_dr_cb.UsesOpaqueIds() || IsNoOpaque(opaque)) {
+    return true;
+  }
+  if (!opaque->IsNumber()) {
+    return false;
+  }
+
+  // Ids are carried in the opaque pointer plus one
+  const double max_id = std::min(9007199254740991.0,
+    static_cast<double>(UINTPTR_MAX - 1));
+  double id = Nan::To<double>(opaque).FromJust();
+  return id >= 0 && id <= max_id && std::floor(id) == id;
+}
+
+/**
+ * @brief Whether a message is produced without an opaque.
+ *
+ * Only undefined is no opaque, except in opaque id mode where null is too,
+ * as there is nothing else null could be carried as.
+ */
+bool Producer::IsNoOpaque(v8::Local<v8::Value> opaque) {
+  return opaque->IsUndefined() ||
+    (m_dr_cb.UsesOpaqueIds() && opaque->IsNull());
+}
+
+/**
+ * @brief Create the opaque a message is produced with.
+ *
+ * @param opaque - The JS opaque of the message, or an empty handle. In opaque
+ * id mode it must have passed IsValidOpaque.
+ * @param buffer - The payload Buffer, or an empty handle for no payload.
+ * It is only referenced in zero copy mode.
+ */
+void* Producer::NewOpaque(v8::Local<v8::Value> opaque,
+  v8::Local<v8::Object> buffer) {
+  void* message_opaque = NULL;
+  if (!opaque.IsEmpty()) {
+    if (m_dr_cb.UsesOpaqueIds()) {
+      message_opaque = Callbacks::OpaqueFromId(
+        static_cast<uint64_t>(Nan::To<double>(opaque).FromJust()));
+    } else {
+      message_opaque = new Nan::Persistent<v8::Value>(opaque);
+    }
+  }
+
+  if (m_dr_cb.IsZeroCopy()) {
+    Callbacks::ZeroCopyOpaque* zero_copy_opaque =
+      new Callbacks::ZeroCopyOpaque();
+    zero_copy_opaque->opaque = message_opaque;
+    zero_copy_opaque->buffer = buffer.IsEmpty() ?
+      NULL : new Nan::Persistent<v8::Object>(buffer);
+    message_opaque = zero_copy_opaque;
+  }
+
+  // The shared handle routes the report by the member
+  if (m_share_handle) {
+    SharedProducer::Opaque* shared_opaque = new SharedProducer::Opaque();
+    shared_opaque->member = m_shared_member;
+    shared_opaque->opaque = message_opaque;
+    shared_opaque->zero_copy = m_dr_cb.IsZeroCopy();
+    shared_opaque->opaque_id = m_dr_cb.UsesOpaqueIds();
+    message_opaque = shared_opaque;
+  }
+
+  return message_opaque;
+}
+
+/**
+ * @brief Free the opaque of a message librdkafka did not accept.
+ *
+ * There will never be a delivery report for such a message, so everything
+ * the report would have released has to be released now.
+ */
+void Producer::FreeOpaque(void* opaque) {
+  if (m_share_handle && opaque) {
+    SharedProducer::Opaque* shared_opaque =
+      static_cast<SharedProducer::Opaque*>(opaque);
+    opaque = shared_opaque->opaque;
+    delete shared_opaque;
+  }
+
+  Callbacks::FreeOpaque(opaque, m_dr_cb.IsZeroCopy(), m_dr_cb.UsesOpaqueIds());
+}
+
 void Producer::Poll() {
   m_client->poll(0);
 }
 
+/**
+ * @brief Serve the producer's queue from a dedicated thread.
+ *
+ * Delivery reports and events are then handled as soon as librdkafka has
+ * them, and the dispatchers only wake up the event loop when there is
+ * something to deliver, instead of JS having to poll on a timer.
+ *
+ * @param enable - Start the thread if true, stop it if false.
+ */
+Baton Producer::SetPollInBackground(bool enable) {
+  if (!enable) {
+    StopBackgroundPoll();
+    return Baton(RdKafka::ERR_NO_ERROR);
+  }
+
+  if (!IsConnected()) {
+    return Baton(RdKafka::ERR__STATE, "Producer is disconnected");
+  }
+
+  if (m_background_poll_started) {
+    return Baton(RdKafka::ERR_NO_ERROR);
+  }
+
+  m_background_poll = true;
+  if (uv_thread_create(&m_background_poll_thread, BackgroundPoll, this) != 0) {
+    m_background_poll = false;
+    return Baton(RdKafka::ERR__FAIL, "Could not start the poll thread");
+  }
+  m_background_poll_started = true;
+
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
+
+void Producer::BackgroundPoll(void* arg) {
+  Producer* producer = static_cast<Producer*>(arg);
+
+  // Returns as soon as there is something to serve, so the timeout only
+  // bounds how long stopping the thread can take.
+  const int timeout_ms = 100;
+
+  while (producer->m_background_poll) {
+    scoped_gate_entry entry(producer->m_gate);
+    if (!entry.connected()) {
+      break;
+    }
+    producer->m_client->poll(timeout_ms);
+  }
+}
+
+void Producer::StopBackgroundPoll() {
+  if (!m_background_poll_started) {
+    return;
+  }
+
+  m_background_poll = false;
+  uv_thread_join(&m_background_poll_thread);
+  m_background_poll_started = false;
+}
+
+void Producer::AddDispatcherMetrics(v8::Local<v8::Object> obj) {
+  Connection::AddDispatcherMetrics(obj);
+  Nan::Set(obj, Nan::New("deliveryReport").ToLocalChecked(),
+    m_dr_cb.dispatcher.GetMetrics());
+}
+
 void Producer::ConfigureCallback(const std::string &string_key, const v8::Local<v8::Function> &cb, bool add) {
   if (string_key.compare("delivery_cb") == 0) {
     if (add) {
@@ -347,10 +703,65 @@ void Producer::ConfigureCallback(const std::string &string_key, const v8::Local<
       if (dr_msg_cb) {
         this->m_dr_cb.SendMessageBuffer(true);
       }
+
+      v8::Local<v8::String> zero_copy_key =
+        Nan::New("zero_copy").ToLocalChecked();
+      if (Nan::Has(cb, zero_copy_key).FromMaybe(false)) {
+        v8::Local<v8::Value> v = Nan::Get(cb, zero_copy_key).ToLocalChecked();
+        if (v->IsBoolean() && !IsConnected()) {
+          this->m_dr_cb.SetZeroCopy(Nan::To<bool>(v).ToChecked());
+        }
+      }
+
+      v8::Local<v8::String> opaque_ids_key =
+        Nan::New("opaque_ids").ToLocalChecked();
+      if (Nan::Has(cb, opaque_ids_key).FromMaybe(false)) {
+        v8::Local<v8::Value> v = Nan::Get(cb, opaque_ids_key).ToLocalChecked();
+        if (v->IsBoolean() && !IsConnected()) {
+          this->m_dr_cb.SetOpaqueIds(Nan::To<bool>(v).ToChecked());
+        }
+      }
+
+      v8::Local<v8::String> dr_batch_size_key =
+        Nan::New("dr_batch_size").ToLocalChecked();
+      if (Nan::Has(cb, dr_batch_size_key).FromMaybe(false)) {
+        v8::Local<v8::Value> v =
+          Nan::Get(cb, dr_batch_size_key).ToLocalChecked();
+        if (v->IsNumber()) {
+          int64_t batch_size = Nan::To<int64_t>(v).FromJust();
+          this->m_dr_cb.dispatcher.SetBatchSize(
+            batch_size > 0 ? static_cast<size_t>(batch_size) : 0);
+        }
+      }
+
+      v8::Local<v8::String> backlog_max_key =
+        Nan::New("dr_backlog_max").ToLocalChecked();
+      v8::Local<v8::String> backlog_max_bytes_key =
+        Nan::New("dr_backlog_max_bytes").ToLocalChecked();
+      int64_t backlog_max = 0;
+      int64_t backlog_max_bytes = 0;
+      if (Nan::Has(cb, backlog_max_key).FromMaybe(false)) {
+        backlog_max = Nan::To<int64_t>(
+          Nan::Get(cb, backlog_max_key).ToLocalChecked()).FromMaybe(0);
+      }
+      if (Nan::Has(cb, backlog_max_bytes_key).FromMaybe(false)) {
+        backlog_max_bytes = Nan::To<int64_t>(
+          Nan::Get(cb, backlog_max_bytes_key).ToLocalChecked()).FromMaybe(0);
+      }
+      this->m_dr_cb.dispatcher.SetBacklogLimits(
+        backlog_max > 0 ? static_cast<size_t>(backlog_max) : 0,
+        backlog_max_bytes > 0 ? static_cast<size_t>(backlog_max_bytes) : 0);
+
       this->m_dr_cb.dispatcher.AddCallback(cb);
     } else {
       this->m_dr_cb.dispatcher.RemoveCallback(cb);
     }
+  } else if (string_key.compare("drain_cb") == 0) {
+    if (add) {
+      this->m_dr_cb.dispatcher.SetDrainCallback(cb);
+    } else {
+      this->m_dr_cb.dispatcher.ClearDrainCallback();
+    }
   } else {
     Connection::ConfigureCallback(string_key, cb, add);
   }
@@ -361,8 +772,7 @@ Baton Producer::InitTransactions(int32_t timeout_ms) {
     return Baton(RdKafka::ERR__STATE);
   }
 
-  RdKafka::Producer* producer = dynamic_cast<RdKafka::Producer*>(m_client);
-  RdKafka::Error* error = producer->init_transactions(timeout_ms);
+  RdKafka::Error* error = m_producer->init_transactions(timeout_ms);
 
   return rdkafkaErrorToBaton( error);
 }
@@ -372,8 +782,7 @@ Baton Producer::BeginTransaction() {
     return Baton(RdKafka::ERR__STATE);
   }
 
-  RdKafka::Producer* producer = dynamic_cast<RdKafka::Producer*>(m_client);
-  RdKafka::Error* error = producer->begin_transaction();
+  RdKafka::Error* error = m_producer->begin_transaction();
 
   return rdkafkaErrorToBaton( error);
 }
@@ -383,8 +792,7 @@ Baton Producer::CommitTransaction(int32_t timeout_ms) {
     return Baton(RdKafka::ERR__STATE);
   }
 
-  RdKafka::Producer* producer = dynamic_cast<RdKafka::Producer*>(m_client);
-  RdKafka::Error* error = producer->commit_transaction(timeout_ms);
+  RdKafka::Error* error = m_producer->commit_transaction(timeout_ms);
 
   return rdkafkaErrorToBaton( error);
 }
@@ -394,8 +802,7 @@ Baton Producer::AbortTransaction(int32_t timeout_ms) {
     return Baton(RdKafka::ERR__STATE);
   }
 
-  RdKafka::Producer* producer = dynamic_cast<RdKafka::Producer*>(m_client);
-  RdKafka::Error* error = producer->abort_transaction(timeout_ms);
+  RdKafka::Error* error = m_producer->abort_transaction(timeout_ms);
 
   return rdkafkaErrorToBaton( error);
 }
@@ -408,15 +815,118 @@ Baton Producer::SendOffsetsToTransaction(
     return Baton(RdKafka::ERR__STATE);
   }
 
-  RdKafka::ConsumerGroupMetadata* group_metadata = dynamic_cast<RdKafka::KafkaConsumer*>(consumer->m_client)->groupMetadata();
+  RdKafka::ConsumerGroupMetadata* group_metadata = consumer->m_consumer->groupMetadata();
 
-  RdKafka::Producer* producer = dynamic_cast<RdKafka::Producer*>(m_client);
-  RdKafka::Error* error = producer->send_offsets_to_transaction(offsets, group_metadata, timeout_ms);
+  RdKafka::Error* error = m_producer->send_offsets_to_transaction(offsets, group_metadata, timeout_ms);
   delete group_metadata;
 
   return rdkafkaErrorToBaton( error);
 }
 
+/**
+ * @brief Encode a string payload as UTF-8, straight into memory from malloc.
+ *
+ * The memory is produced with RK_MSG_FREE, so librdkafka frees it once it
+ * is done with the message and the payload is never copied again. It stays
+ * owned by the caller if the message is not enqueued.
+ *
+ * @param payload - Set to the payload, or to NULL for an empty string.
+ * @return An error if the memory could not be allocated.
+ */
+static Baton NewUtf8Payload(v8::Local<v8::String> str, char** payload,
+  size_t* len) {
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  *payload = NULL;
+  *len = str->Utf8Length(isolate);
+  if (*len == 0) {
+    return Baton(RdKafka::ERR_NO_ERROR);
+  }
+
+  *payload = static_cast<char*>(malloc(*len));
+  if (*payload == NULL) {
+    *len = 0;
+    return Baton(RdKafka::ERR__FAIL, "Could not allocate the message payload");
+  }
+
+  str->WriteUtf8(isolate, *payload, static_cast<int>(*len), NULL,
+    v8::String::NO_NULL_TERMINATION | v8::String::REPLACE_INVALID_UTF8);
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
+
+/**
+ * @brief Add a single header, copying key and value into the headers.
+ *
+ * Buffer values are added as they are. Anything else is converted to a
+ * UTF-8 string first.
+ */
+static void AddHeader(rd_kafka_headers_t* headers,
+                      v8::Local<v8::Value> key, v8::Local<v8::Value> value) {
+  Nan::Utf8String uKey(key);
+
+  if (node::Buffer::HasInstance(value)) {
+    rd_kafka_header_add(headers, *uKey, uKey.length(),
+      node::Buffer::Data(value), node::Buffer::Length(value));
+  } else {
+    Nan::Utf8String uValue(value);
+    rd_kafka_header_add(headers, *uKey, uKey.length(),
+      *uValue, uValue.length());
+  }
+}
+
+/**
+ * @brief Build librdkafka headers from the headers given to produce.
+ *
+ * Two layouts are accepted: an array of single property objects,
+ * [{ k1: v1 }, { k2: v2 }], or a flat array of alternating keys and values,
+ * [k1, v1, k2, v2], which is cheaper as no property names have to be
+ * enumerated. The layout is picked by looking at the first element.
+ *
+ * @return The headers, or NULL if there are none.
+ */
+static rd_kafka_headers_t* HeadersFromV8(v8::Local<v8::Value> value) {
+  if (!value->IsArray()) {
+    return NULL;
+  }
+
+  v8::Local<v8::Array> v8Headers = value.As<v8::Array>();
+  uint32_t length = v8Headers->Length();
+  if (length == 0) {
+    return NULL;
+  }
+
+  v8::Local<v8::Context> context = Nan::GetCurrentContext();
+  v8::Local<v8::Value> first = Nan::Get(v8Headers, 0).ToLocalChecked();
+
+  if (first->IsString()) {
+    rd_kafka_headers_t* headers = rd_kafka_headers_new(length / 2);
+    for (uint32_t i = 0; i + 1 < length; i += 2) {
+      AddHeader(headers, Nan::Get(v8Headers, i).ToLocalChecked(),
+        Nan::Get(v8Headers, i + 1).ToLocalChecked());
+    }
+    return headers;
+  }
+
+  rd_kafka_headers_t* headers = rd_kafka_headers_new(length);
+  for (uint32_t i = 0; i < length; i++) {
+    v8::Local<v8::Value> element = Nan::Get(v8Headers, i).ToLocalChecked();
+    if (!element->IsObject()) {
+      continue;
+    }
+
+    v8::Local<v8::Object> header = element.As<v8::Object>();
+    v8::Local<v8::Array> props = header->GetOwnPropertyNames(
+      context).ToLocalChecked();
+    if (props->Length() == 0) {
+      continue;
+    }
+
+    v8::Local<v8::Value> key = Nan::Get(props, 0).ToLocalChecked();
+    AddHeader(headers, key, Nan::Get(header, key).ToLocalChecked());
+  }
+
+  return headers;
+}
+
 /* Node exposed methods */
 
 /**
@@ -445,6 +955,13 @@ NAN_METHOD(Producer::NodeProduce) {
     return Nan::ThrowError("Need to specify a topic, partition, and message");
   }
 
+  Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
+
+  if (info.Length() > 5 && !producer->IsValidOpaque(info[5])) {
+    return Nan::ThrowError(
+      "Opaque must be a non-negative integer id in opaque id mode");
+  }
+
   // Second parameter is the partition
   int32_t partition;
 
@@ -460,24 +977,31 @@ NAN_METHOD(Producer::NodeProduce) {
 
   size_t message_buffer_length;
   void* message_buffer_data;
+  v8::Local<v8::Object> message_buffer_object;
+  // Strings are encoded once the arguments can no longer throw
+  v8::Local<v8::String> message_string;
 
   if (info[2]->IsNull()) {
     // This is okay for whatever reason
     message_buffer_length = 0;
     message_buffer_data = NULL;
+  } else if (info[2]->IsString()) {
+    message_string = info[2].As<v8::String>();
+    message_buffer_length = 0;
+    message_buffer_data = NULL;
   } else if (!node::Buffer::HasInstance(info[2])) {
-    return Nan::ThrowError("Message must be a buffer or null");
+    return Nan::ThrowError("Message must be a buffer, a string or null");
   } else {
-    v8::Local<v8::Object> message_buffer_object =
+    message_buffer_object =
       (info[2]->ToObject(Nan::GetCurrentContext())).ToLocalChecked();
 
     // v8 handles the garbage collection here so we need to make a copy of
     // the buffer or assign the buffer to a persistent handle.
 
-    // I'm not sure which would be the more performant option. I assume
-    // the persistent handle would be but for now we'll try this one
-    // which should be more memory-efficient and allow v8 to dispose of the
-    // buffer sooner
+    // librdkafka copies the buffer by default, which allows v8 to dispose of
+    // it sooner. In zero copy mode the buffer is assigned to a persistent
+    // handle instead, which lives until the delivery report, and saves the
+    // copy for large payloads.
 
     message_buffer_length = node::Buffer::Length(message_buffer_object);
     message_buffer_data = node::Buffer::Data(message_buffer_object);
@@ -491,7 +1015,12 @@ NAN_METHOD(Producer::NodeProduce) {
 
   size_t key_buffer_length;
   const void* key_buffer_data;
-  std::string * key = NULL;
+
+  // librdkafka copies keys, so a string key only has to live until the
+  // message is enqueued. Nan::Utf8String encodes short ones on the stack.
+  bool key_is_string = !info[3]->IsNull() && !info[3]->IsUndefined() &&
+    !node::Buffer::HasInstance(info[3]);
+  Nan::Utf8String keyUTF8(key_is_string ? info[3] : v8::Local<v8::Value>());
 
   if (info[3]->IsNull() || info[3]->IsUndefined()) {
     // This is okay for whatever reason
@@ -519,13 +1048,8 @@ NAN_METHOD(Producer::NodeProduce) {
     }
   } else {
     // If it was a string just use the utf8 value.
-    v8::Local<v8::String> val = Nan::To<v8::String>(info[3]).ToLocalChecked();
-    // Get string pointer for this thing
-    Nan::Utf8String keyUTF8(val);
-    key = new std::string(*keyUTF8);
-
-    key_buffer_data = key->data();
-    key_buffer_length = key->length();
+    key_buffer_data = *keyUTF8;
+    key_buffer_length = keyUTF8.length();
   }
 
   int64_t timestamp;
@@ -540,46 +1064,45 @@ NAN_METHOD(Producer::NodeProduce) {
     timestamp = 0;
   }
 
-  void* opaque = NULL;
-  // Opaque handling
-  if (info.Length() > 5 && !info[5]->IsUndefined()) {
-    // We need to create a persistent handle
-    opaque = new Nan::Persistent<v8::Value>(info[5]);
-    // To get the local from this later,
-    // v8::Local<v8::Object> object = Nan::New(persistent);
-  }
-
-  std::vector<RdKafka::Headers::Header> headers;
-  if (info.Length() > 6 && !info[6]->IsUndefined()) {
-    v8::Local<v8::Array> v8Headers = v8::Local<v8::Array>::Cast(info[6]);
-
-    if (v8Headers->Length() >= 1) {
-      for (unsigned int i = 0; i < v8Headers->Length(); i++) {
-        v8::Local<v8::Object> header = Nan::Get(v8Headers, i).ToLocalChecked()
-          ->ToObject(Nan::GetCurrentContext()).ToLocalChecked();
-        if (header.IsEmpty()) {
-          continue;
-        }
-
-        v8::Local<v8::Array> props = header->GetOwnPropertyNames(
-          Nan::GetCurrentContext()).ToLocalChecked();
-        Nan::MaybeLocal<v8::String> v8Key = Nan::To<v8::String>(
-            Nan::Get(props, 0).ToLocalChecked());
-        Nan::MaybeLocal<v8::String> v8Value = Nan::To<v8::String>(
-            Nan::Get(header, v8Key.ToLocalChecked()).ToLocalChecked());
 
-        Nan::Utf8String uKey(v8Key.ToLocalChecked());
-        std::string key(*uKey);
+  // A string is encoded straight into memory librdkafka takes over, rather
+  // than into a Buffer that would be copied again. Done before anything else
+  // is allocated for the message, so a failure has nothing to clean up.
+  bool free_payload = false;
+  if (!message_string.IsEmpty()) {
+    char* payload;
+    Baton b = NewUtf8Payload(message_string, &payload,
+      &message_buffer_length);
+    if (b.err() != RdKafka::ERR_NO_ERROR) {
+      info.GetReturnValue().Set(Nan::New<v8::Number>(b.err()));
+      return;
+    }
 
-        Nan::Utf8String uValue(v8Value.ToLocalChecked());
-        std::string value(*uValue);
-        headers.push_back(
-          RdKafka::Headers::Header(key, value.c_str(), value.size()));
-      }
+    if (payload) {
+      message_buffer_data = payload;
+      free_payload = true;
+    } else {
+      // empty string message should not end up as null message
+      static char empty_message[1] = { 0 };
+      message_buffer_data = empty_message;
     }
   }
 
-  Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
+  rd_kafka_headers_t* rd_headers = NULL;
+  if (info.Length() > 6) {
+    rd_headers = HeadersFromV8(info[6]);
+  }
+
+  // Opaque handling
+  v8::Local<v8::Value> v8Opaque;
+  if (info.Length() > 5 && !producer->IsNoOpaque(info[5])) {
+    v8Opaque = info[5];
+  }
+
+  // We need to create a persistent handle, unless the opaque is an id. To
+  // get the local from this later,
+  // v8::Local<v8::Object> object = Nan::New(persistent);
+  void* opaque = producer->NewOpaque(v8Opaque, message_buffer_object);
 
   // Let the JS library throw if we need to so the error can be more rich
   int error_code;
@@ -588,57 +1111,236 @@ NAN_METHOD(Producer::NodeProduce) {
     // Get string pointer for this thing
     Nan::Utf8String topicUTF8(Nan::To<v8::String>(info[0]).ToLocalChecked());
     std::string topic_name(*topicUTF8);
-    RdKafka::Headers *rd_headers = RdKafka::Headers::create(headers);
 
     Baton b = producer->Produce(message_buffer_data, message_buffer_length,
-     topic_name, partition, key_buffer_data, key_buffer_length,
-     timestamp, opaque, rd_headers);
+     topic_name, NULL, partition, key_buffer_data, key_buffer_length,
+     timestamp, opaque, rd_headers, free_payload);
 
     error_code = static_cast<int>(b.err());
-    if (error_code != 0 && rd_headers) {
-      delete rd_headers;
-    }
   } else {
-    // First parameter is a topic OBJECT
+    // First parameter is a topic OBJECT, whose configuration is used when
+    // the topic handle is first created
     Topic* topic = ObjectWrap::Unwrap<Topic>(info[0].As<v8::Object>());
 
-    // Unwrap it and turn it into an RdKafka::Topic*
-    Baton topic_baton = topic->toRDKafkaTopic(producer);
+    Baton b = producer->Produce(message_buffer_data, message_buffer_length,
+     topic->name(), topic->config(), partition, key_buffer_data,
+     key_buffer_length, timestamp, opaque, rd_headers, free_payload);
 
-    if (topic_baton.err() != RdKafka::ERR_NO_ERROR) {
-      // Let the JS library throw if we need to so the error can be more rich
-      error_code = static_cast<int>(topic_baton.err());
+    error_code = static_cast<int>(b.err());
+  }
 
-      return info.GetReturnValue().Set(Nan::New<v8::Number>(error_code));
+  if (error_code != 0 && rd_headers) {
+    rd_kafka_headers_destroy(rd_headers);
+  }
+
+  if (error_code != 0) {
+    // If there was an error enqueing this message, there will never
+    // be a delivery report for it, so we have to clean up the opaque
+    // data now, if there was any.
+    producer->FreeOpaque(opaque);
+
+    if (free_payload) {
+      free(message_buffer_data);
     }
+  }
 
-    RdKafka::Topic* rd_topic = topic_baton.data<RdKafka::Topic*>();
+  info.GetReturnValue().Set(Nan::New<v8::Number>(error_code));
+}
 
-    Baton b = producer->Produce(message_buffer_data, message_buffer_length,
-     rd_topic, partition, key_buffer_data, key_buffer_length, opaque);
+/**
+ * @brief Producer::NodeProduceBatch - produce an array of messages to a topic
+ *
+ * Synchronous for the same reasons as NodeProduce. Every message of the
+ * array is an object of the form
+ * { value, key, partition, timestamp, opaque, headers }, with the same
+ * types that NodeProduce accepts for its positional arguments.
+ *
+ * All of the messages are unpacked before anything is handed to librdkafka,
+ * which is then called for the whole batch with the connection entered once.
+ *
+ * A message that cannot be unpacked does not fail the batch. It is reported
+ * with ERR__INVALID_ARG and is not produced.
+ *
+ * @return An Int32Array with the error code of each message, in order.
+ *
+ * @sa Producer::ProduceBatch
+ */
+NAN_METHOD(Producer::NodeProduceBatch) {
+  Nan::HandleScope scope;
 
-    // Delete the topic when we are done.
-    delete rd_topic;
+  if (info.Length() < 2 || !info[0]->IsString()) {
+    return Nan::ThrowError("Need to specify a topic and an array of messages");
+  }
 
-    error_code = static_cast<int>(b.err());
+  if (!info[1]->IsArray()) {
+    return Nan::ThrowError("Messages must be an array");
   }
 
-  if (error_code != 0 && opaque) {
-    // If there was an error enqueing this message, there will never
-    // be a delivery report for it, so we have to clean up the opaque
-    // data now, if there was any.
+  v8::Local<v8::Array> v8Messages = info[1].As<v8::Array>();
+  uint32_t message_cnt = v8Messages->Length();
+
+  Nan::Utf8String topicUTF8(Nan::To<v8::String>(info[0]).ToLocalChecked());
+  std::string topic_name(*topicUTF8);
+
+  v8::Local<v8::String> valueField = Nan::New("value").ToLocalChecked();
+  v8::Local<v8::String> keyField = Nan::New("key").ToLocalChecked();
+  v8::Local<v8::String> partitionField = Nan::New("partition").ToLocalChecked();
+  v8::Local<v8::String> timestampField = Nan::New("timestamp").ToLocalChecked();
+  v8::Local<v8::String> opaqueField = Nan::New("opaque").ToLocalChecked();
+  v8::Local<v8::String> headersField = Nan::New("headers").ToLocalChecked();
+
+  // Empty buffers must not end up as null payloads or keys.
+  static char empty_buffer[1] = { 0 };
+
+  Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
+
+  std::vector<ProducerBatchMessage> messages(message_cnt);
+  // String keys of the whole batch, encoded back to back. librdkafka copies
+  // keys, so they only have to live until the batch is enqueued.
+  std::string string_keys;
+
+  for (uint32_t i = 0; i < message_cnt; i++) {
+    ProducerBatchMessage &message = messages[i];
+    message.payload = NULL;
+    message.payload_len = 0;
+    message.free_payload = false;
+    message.key = NULL;
+    message.key_len = 0;
+    message.key_is_string = false;
+    message.key_offset = 0;
+    message.partition = RdKafka::Topic::PARTITION_UA;
+    message.timestamp = 0;
+    message.opaque = NULL;
+    message.headers = NULL;
+    message.err = RdKafka::ERR_NO_ERROR;
+
+    v8::Local<v8::Value> v8Message = Nan::Get(v8Messages, i).ToLocalChecked();
+    if (!v8Message->IsObject()) {
+      message.err = RdKafka::ERR__INVALID_ARG;
+      continue;
+    }
+    v8::Local<v8::Object> object = v8Message.As<v8::Object>();
+
+    v8::Local<v8::Object> buffer;
+    v8::Local<v8::Value> value = Nan::Get(object, valueField).ToLocalChecked();
+    if (node::Buffer::HasInstance(value)) {
+      buffer = value.As<v8::Object>();
+      message.payload_len = node::Buffer::Length(value);
+      message.payload = node::Buffer::Data(value);
+      if (message.payload == NULL) {
+        message.payload = empty_buffer;
+      }
+    } else if (value->IsString()) {
+      char* payload;
+      Baton b = NewUtf8Payload(value.As<v8::String>(), &payload,
+        &message.payload_len);
+      if (b.err() != RdKafka::ERR_NO_ERROR) {
+        message.err = b.err();
+        continue;
+      }
+
+      message.payload = payload;
+      if (message.payload) {
+        message.free_payload = true;
+      } else {
+        message.payload = empty_buffer;
+      }
+    } else if (!value->IsNull() && !value->IsUndefined()) {
+      message.err = RdKafka::ERR__INVALID_ARG;
+      continue;
+    }
+
+    v8::Local<v8::Value> key = Nan::Get(object, keyField).ToLocalChecked();
+    if (node::Buffer::HasInstance(key)) {
+      message.key_len = node::Buffer::Length(key);
+      message.key = node::Buffer::Data(key);
+      if (message.key == NULL) {
+        message.key = empty_buffer;
+      }
+    } else if (!key->IsNull() && !key->IsUndefined()) {
+      v8::Local<v8::String> keyString =
+        Nan::To<v8::String>(key).ToLocalChecked();
+      v8::Isolate* isolate = v8::Isolate::GetCurrent();
+      message.key_len = keyString->Utf8Length(isolate);
+      message.key_offset = string_keys.size();
+      message.key_is_string = true;
+      string_keys.resize(message.key_offset + message.key_len);
+      keyString->WriteUtf8(isolate, &string_keys[message.key_offset],
+        static_cast<int>(message.key_len), NULL,
+        v8::String::NO_NULL_TERMINATION | v8::String::REPLACE_INVALID_UTF8);
+    }
+
+    v8::Local<v8::Value> partition =
+      Nan::Get(object, partitionField).ToLocalChecked();
+    if (!partition->IsNull() && !partition->IsUndefined()) {
+      message.partition = Nan::To<int32_t>(partition).FromJust();
+      if (message.partition < 0) {
+        message.partition = RdKafka::Topic::PARTITION_UA;
+      }
+    }
+
+    v8::Local<v8::Value> timestamp =
+      Nan::Get(object, timestampField).ToLocalChecked();
+    if (!timestamp->IsNull() && !timestamp->IsUndefined()) {
+      if (!timestamp->IsNumber()) {
+        message.err = RdKafka::ERR__INVALID_ARG;
+        continue;
+      }
+      message.timestamp = Nan::To<int64_t>(timestamp).FromJust();
+    }
+
+    v8::Local<v8::Value> opaque =
+      Nan::Get(object, opaqueField).ToLocalChecked();
+    if (!producer->IsValidOpaque(opaque)) {
+      message.err = RdKafka::ERR__INVALID_ARG;
+      continue;
+    }
+    if (producer->IsNoOpaque(opaque)) {
+      opaque = v8::Local<v8::Value>();
+    }
 
-    Nan::Persistent<v8::Value> *persistent =
-      static_cast<Nan::Persistent<v8::Value> *>(opaque);
-    persistent->Reset();
-    delete persistent;
+    message.headers =
+      HeadersFromV8(Nan::Get(object, headersField).ToLocalChecked());
+
+    message.opaque = producer->NewOpaque(opaque, buffer);
   }
 
-  if (key != NULL) {
-    delete key;
+  // The keys are not moved anymore once all of them are encoded
+  for (uint32_t i = 0; i < message_cnt; i++) {
+    if (messages[i].key_is_string) {
+      messages[i].key = string_keys.data() + messages[i].key_offset;
+    }
   }
 
-  info.GetReturnValue().Set(Nan::New<v8::Number>(error_code));
+  producer->ProduceBatch(topic_name, messages);
+
+  v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(
+    v8::Isolate::GetCurrent(), message_cnt * sizeof(int32_t));
+  int32_t* error_codes = static_cast<int32_t*>(
+    buffer->GetBackingStore()->Data());
+
+  for (uint32_t i = 0; i < message_cnt; i++) {
+    ProducerBatchMessage &message = messages[i];
+    error_codes[i] = static_cast<int32_t>(message.err);
+
+    if (message.err == RdKafka::ERR_NO_ERROR) {
+      continue;
+    }
+
+    // There will never be a delivery report for this message, so everything
+    // it would have released has to be released now.
+    producer->FreeOpaque(message.opaque);
+
+    if (message.free_payload) {
+      free(message.payload);
+    }
+
+    if (message.headers) {
+      rd_kafka_headers_destroy(message.headers);
+    }
+  }
+
+  info.GetReturnValue().Set(v8::Int32Array::New(buffer, 0, message_cnt));
 }
 
 NAN_METHOD(Producer::NodeSetPartitioner) {
@@ -668,7 +1370,7 @@ NAN_METHOD(Producer::NodeConnect) {
   Nan::Callback *callback = new Nan::Callback(cb);
 
   Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
-  Nan::AsyncQueueWorker(new Workers::ProducerConnect(callback, producer));
+  WorkerPool::Queue(new Workers::ProducerConnect(callback, producer));
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -686,13 +1388,29 @@ NAN_METHOD(Producer::NodePoll) {
   }
 }
 
+NAN_METHOD(Producer::NodeSetPollInBackground) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 1 || !info[0]->IsBoolean()) {
+    return Nan::ThrowError("Need to specify a boolean");
+  }
+
+  Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
+  Baton b = producer->SetPollInBackground(Nan::To<bool>(info[0]).FromJust());
+
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    return Nan::ThrowError(b.errstr().c_str());
+  }
+
+  info.GetReturnValue().Set(Nan::True());
+}
+
 Baton Producer::Flush(int timeout_ms) {
   RdKafka::ErrorCode response_code;
   if (IsConnected()) {
     scoped_shared_read_lock lock(m_connection_lock);
     if (IsConnected()) {
-      RdKafka::Producer* producer = dynamic_cast<RdKafka::Producer*>(m_client);
-      response_code = producer->flush(timeout_ms);
+      response_code = m_producer->flush(timeout_ms);
     } else {
       response_code = RdKafka::ERR__STATE;
     }
@@ -718,7 +1436,7 @@ NAN_METHOD(Producer::NodeFlush) {
 
   Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
 
-  Nan::AsyncQueueWorker(
+  WorkerPool::Queue(
     new Workers::ProducerFlush(callback, producer, timeout_ms));
 
   info.GetReturnValue().Set(Nan::Null());
@@ -737,7 +1455,7 @@ NAN_METHOD(Producer::NodeDisconnect) {
   Nan::Callback *callback = new Nan::Callback(cb);
 
   Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
-  Nan::AsyncQueueWorker(new Workers::ProducerDisconnect(callback, producer));
+  WorkerPool::Queue(new Workers::ProducerDisconnect(callback, producer));
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -755,7 +1473,7 @@ NAN_METHOD(Producer::NodeInitTransactions) {
   Nan::Callback *callback = new Nan::Callback(cb);
 
   Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
-  Nan::AsyncQueueWorker(new Workers::ProducerInitTransactions(callback, producer, timeout_ms));
+  WorkerPool::Queue(new Workers::ProducerInitTransactions(callback, producer, timeout_ms));
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -771,7 +1489,7 @@ NAN_METHOD(Producer::NodeBeginTransaction) {
   Nan::Callback *callback = new Nan::Callback(cb);
 
   Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
-  Nan::AsyncQueueWorker(new Workers::ProducerBeginTransaction(callback, producer));
+  WorkerPool::Queue(new Workers::ProducerBeginTransaction(callback, producer));
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -789,7 +1507,7 @@ NAN_METHOD(Producer::NodeCommitTransaction) {
   Nan::Callback *callback = new Nan::Callback(cb);
 
   Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
-  Nan::AsyncQueueWorker(new Workers::ProducerCommitTransaction(callback, producer, timeout_ms));
+  WorkerPool::Queue(new Workers::ProducerCommitTransaction(callback, producer, timeout_ms));
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -807,7 +1525,7 @@ NAN_METHOD(Producer::NodeAbortTransaction) {
   Nan::Callback *callback = new Nan::Callback(cb);
 
   Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
-  Nan::AsyncQueueWorker(new Workers::ProducerAbortTransaction(callback, producer, timeout_ms));
+  WorkerPool::Queue(new Workers::ProducerAbortTransaction(callback, producer, timeout_ms));
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -840,7 +1558,7 @@ NAN_METHOD(Producer::NodeSendOffsetsToTransaction) {
   Nan::Callback *callback = new Nan::Callback(cb);
 
   Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
-  Nan::AsyncQueueWorker(new Workers::ProducerSendOffsetsToTransaction(
+  WorkerPool::Queue(new Workers::ProducerSendOffsetsToTransaction(
     callback,
     producer,
     toppars,
@@ -851,4 +1569,137 @@ NAN_METHOD(Producer::NodeSendOffsetsToTransaction) {
   info.GetReturnValue().Set(Nan::Null());
 }
 
+/**
+ * @brief Open a produce channel on shared memory.
+ *
+ * Takes the record ring, the delivery ring, the topics records refer to by
+ * index and a callback that is called when deliveries were written. See
+ * ProduceChannel for the layout.
+ */
+NAN_METHOD(Producer::NodeOpenProduceChannel) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 4 || !info[0]->IsSharedArrayBuffer() ||
+      !info[1]->IsSharedArrayBuffer()) {
+    return Nan::ThrowError("Need to specify a record and a delivery ring");
+  }
+  if (!info[2]->IsArray()) {
+    return Nan::ThrowError("Need to specify an array of topics");
+  }
+  if (!info[3]->IsFunction()) {
+    return Nan::ThrowError("Need to specify a callback");
+  }
+
+  std::shared_ptr<v8::BackingStore> records =
+    info[0].As<v8::SharedArrayBuffer>()->GetBackingStore();
+  std::shared_ptr<v8::BackingStore> deliveries =
+    info[1].As<v8::SharedArrayBuffer>()->GetBackingStore();
+
+  std::string errstr = ProduceChannel::CheckRings(records->ByteLength(),
+    deliveries->ByteLength());
+  if (!errstr.empty()) {
+    return Nan::ThrowError(errstr.c_str());
+  }
+
+  v8::Local<v8::Array> topic_array = info[2].As<v8::Array>();
+  if (topic_array->Length() > 0xFFFF) {
+    return Nan::ThrowError("A produce channel takes at most 65535 topics");
+  }
+
+  std::vector<std::string> topics;
+  for (unsigned int i = 0; i < topic_array->Length(); i++) {
+    v8::Local<v8::Value> topic = Nan::Get(topic_array, i).ToLocalChecked();
+    if (!topic->IsString()) {
+      return Nan::ThrowError("Topics must be strings");
+    }
+    Nan::Utf8String topic_name(topic);
+    topics.push_back(std::string(*topic_name));
+  }
+
+  Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
+
+  scoped_shared_read_lock lock(producer->m_connection_lock);
+
+  if (!producer->IsConnected()) {
+    return Nan::ThrowError("Producer is disconnected");
+  }
+  if (producer->m_channel) {
+    return Nan::ThrowError("A produce channel is already open");
+  }
+  // Its messages carry slots as opaques, the shared handle could not route
+  // them
+  if (producer->m_shared) {
+    return Nan::ThrowError("A produce channel needs a handle of its own");
+  }
+
+  ProduceChannel* channel = new ProduceChannel(producer, records, deliveries,
+    topics, info[3].As<v8::Function>());
+  producer->m_dr_cb.SetChannel(channel);
+
+  Baton b = channel->Start();
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    producer->m_dr_cb.SetChannel(NULL);
+    channel->Close();
+    return Nan::ThrowError(b.errstr().c_str());
+  }
+
+  producer->m_channel = channel;
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
+NAN_METHOD(Producer::NodeWakeProduceChannel) {
+  Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
+
+  if (producer->m_channel) {
+    producer->m_channel->Wake();
+  }
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
+/**
+ * @brief Stop producing from the channel.
+ *
+ * Records written before are still produced. Their deliveries keep coming
+ * until the producer disconnects, which frees the channel.
+ */
+NAN_METHOD(Producer::NodeCloseProduceChannel) {
+  Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
+
+  if (producer->m_channel) {
+    producer->m_channel->Stop();
+  }
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
+/**
+ * @brief Connect through a handle shared with the other producers of the
+ * environment that have the same configuration and share theirs.
+ *
+ * Must be called before connecting.
+ */
+NAN_METHOD(Producer::NodeSetSharedHandle) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 1 || !info[0]->IsBoolean()) {
+    return Nan::ThrowError("Need to specify a boolean");
+  }
+
+  Producer* producer = ObjectWrap::Unwrap<Producer>(info.This());
+
+  if (producer->IsConnected()) {
+    return Nan::ThrowError("Producer is already connected");
+  }
+
+  producer->m_share_handle = Nan::To<bool>(info[0]).ToChecked();
+  // Connect runs on a worker thread, the environment is only known here
+  if (producer->m_share_handle) {
+    producer->m_shared_loop = SharedProducer::CurrentLoop();
+  }
+
+  info.GetReturnValue().Set(Nan::Null());
+}
+
 }  // namespace NodeKafka
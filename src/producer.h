@@ -13,13 +13,17 @@
 #include <nan.h>
 #include <node.h>
 #include <node_buffer.h>
+#include <atomic>
 #include <string>
+#include <vector>
 
 #include "rdkafkacpp.h"
 
 #include "src/common.h"
 #include "src/connection.h"
 #include "src/callbacks.h"
+#include "src/produce-channel.h"
+#include "src/shared-producer.h"
 #include "src/topic.h"
 
 namespace NodeKafka {
@@ -46,7 +50,34 @@ class ProducerMessage {
   bool m_is_empty;
 };
 
+/**
+ * @brief A single message of a produceBatch call.
+ *
+ * Everything is unpacked from v8 before the connection is entered, so
+ * key and payload point into buffers owned by the calling JS frame. String
+ * keys are encoded into a buffer shared by the batch, at key_offset. String
+ * payloads are encoded into memory from malloc, marked with free_payload,
+ * which like the headers is owned by this struct until librdkafka accepts
+ * the message.
+ */
+struct ProducerBatchMessage {
+  void* payload;
+  size_t payload_len;
+  bool free_payload;
+  const void* key;
+  size_t key_len;
+  bool key_is_string;
+  size_t key_offset;
+  int32_t partition;
+  int64_t timestamp;
+  void* opaque;
+  rd_kafka_headers_t* headers;
+  RdKafka::ErrorCode err;
+};
+
 class Producer : public Connection {
+  friend class ProduceChannel;
+
  public:
   static void Init(v8::Local<v8::Object>);
   static v8::Local<v8::Object> NewInstance(v8::Local<v8::Value>);
@@ -54,6 +85,7 @@ class Producer : public Connection {
   Baton Connect();
   void Disconnect();
   void Poll();
+  Baton SetPollInBackground(bool);
   #if RD_KAFKA_VERSION > 0x00090200
   Baton Flush(int timeout_ms);
   #endif
@@ -67,18 +99,29 @@ class Producer : public Connection {
     std::string topic, int32_t partition,
     std::string* key,
     int64_t timestamp, void* opaque,
-    RdKafka::Headers* headers);
+    rd_kafka_headers_t* headers);
 
   Baton Produce(void* message, size_t message_size,
     std::string topic, int32_t partition,
     const void* key, size_t key_len,
     int64_t timestamp, void* opaque,
-    RdKafka::Headers* headers);
+    rd_kafka_headers_t* headers);
+
+  Baton Produce(void* message, size_t message_size,
+    std::string topic, RdKafka::Conf* topic_conf, int32_t partition,
+    const void* key, size_t key_len,
+    int64_t timestamp, void* opaque,
+    rd_kafka_headers_t* headers, bool free_payload);
+
+  void ProduceBatch(std::string topic,
+    std::vector<ProducerBatchMessage> &messages);
 
   void ActivateDispatchers();
   void DeactivateDispatchers();
+  void Teardown();
 
   void ConfigureCallback(const std::string &string_key, const v8::Local<v8::Function> &cb, bool add) override;
+  void AddDispatcherMetrics(v8::Local<v8::Object>) override;
 
   Baton InitTransactions(int32_t timeout_ms);
   Baton BeginTransaction();
@@ -91,7 +134,7 @@ class Producer : public Connection {
   );
 
  protected:
-  static Nan::Persistent<v8::Function> constructor;
+  static PerIsolateFunction constructor;
   static void New(const Nan::FunctionCallbackInfo<v8::Value>&);
 
   Producer(Conf*, Conf*);
@@ -99,10 +142,12 @@ class Producer : public Connection {
 
  private:
   static NAN_METHOD(NodeProduce);
+  static NAN_METHOD(NodeProduceBatch);
   static NAN_METHOD(NodeSetPartitioner);
   static NAN_METHOD(NodeConnect);
   static NAN_METHOD(NodeDisconnect);
   static NAN_METHOD(NodePoll);
+  static NAN_METHOD(NodeSetPollInBackground);
   #if RD_KAFKA_VERSION > 0x00090200
   static NAN_METHOD(NodeFlush);
   #endif
@@ -111,9 +156,42 @@ class Producer : public Connection {
   static NAN_METHOD(NodeCommitTransaction);
   static NAN_METHOD(NodeAbortTransaction);
   static NAN_METHOD(NodeSendOffsetsToTransaction);
+  static NAN_METHOD(NodeOpenProduceChannel);
+  static NAN_METHOD(NodeWakeProduceChannel);
+  static NAN_METHOD(NodeCloseProduceChannel);
+  static NAN_METHOD(NodeSetSharedHandle);
+
+  int MessageFlags(bool free_payload);
+  bool IsValidOpaque(v8::Local<v8::Value>);
+  bool IsNoOpaque(v8::Local<v8::Value>);
+  void* NewOpaque(v8::Local<v8::Value>, v8::Local<v8::Object>);
+  void FreeOpaque(void*);
+
+  static void BackgroundPoll(void*);
+  void StopBackgroundPoll();
+
+  // m_client, cast once on connect
+  RdKafka::Producer* m_producer = NULL;
 
   Callbacks::Delivery m_dr_cb;
   Callbacks::Partitioner m_partitioner_cb;
+
+  uv_thread_t m_background_poll_thread;
+  std::atomic<bool> m_background_poll;
+  std::atomic<bool> m_background_poll_started;
+
+  // Open until disconnect, freed on the main thread after that
+  ProduceChannel* m_channel = NULL;
+
+  // Whether to connect through a handle shared with other producers, set
+  // before connecting
+  bool m_share_handle = false;
+  // Loop of the environment the producer was created in, once it shares
+  SharedProducer::Loop* m_shared_loop = NULL;
+  // The handle and the id the producer is a member of it with, while
+  // connected
+  SharedProducer* m_shared = NULL;
+  uint64_t m_shared_member = 0;
 };
 
 }  // namespace NodeKafka
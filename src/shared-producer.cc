@@ -0,0 +1,319 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "src/shared-producer.h"
+#include "src/callbacks.h"
+#include "src/common.h"
+#include "src/config.h"
+
+namespace NodeKafka {
+
+/**
+ * Opaques of reports whose member was gone, waiting for the thread of the
+ * environment. Freed once its async handle is closed and no shared handle
+ * refers to it anymore.
+ */
+struct SharedProducer::Loop {
+  uv_async_t async;
+  // Part of the key of its handles, unlike its address it is never reused
+  uint64_t id;
+
+  uv_mutex_t lock;
+  // Guarded by lock
+  std::vector<Opaque*> orphans;
+  // Set when the environment is torn down, what the opaques hold is gone
+  bool closing;
+
+  // Guarded by the handles lock
+  size_t handles;
+  bool closed;
+};
+
+namespace {
+
+// Handles by the loop and the configuration they were created with
+std::map<std::string, SharedProducer*>* handles;
+uint64_t next_member;
+uv_mutex_t handles_lock;
+uv_once_t handles_once = UV_ONCE_INIT;
+
+std::atomic<uint64_t> next_loop(1);
+
+// The loop of the environment running on this thread, if it shared a handle
+thread_local SharedProducer::Loop* current_loop = NULL;
+
+void InitHandles() {
+  handles = new std::map<std::string, SharedProducer*>();
+  next_member = 1;
+  uv_mutex_init(&handles_lock);
+}
+
+void FreeOpaques(const std::vector<SharedProducer::Opaque*>& opaques) {
+  Nan::HandleScope scope;
+  for (size_t i = 0; i < opaques.size(); i++) {
+    Callbacks::FreeOpaque(opaques[i]->opaque, opaques[i]->zero_copy,
+      opaques[i]->opaque_id);
+    delete opaques[i];
+  }
+}
+
+void FreeOrphans(uv_async_t* handle) {
+  SharedProducer::Loop* loop = static_cast<SharedProducer::Loop*>(handle->data);
+  std::vector<SharedProducer::Opaque*> opaques;
+  {
+    scoped_mutex_lock lock(loop->lock);
+    opaques.swap(loop->orphans);
+  }
+
+  FreeOpaques(opaques);
+}
+
+void DeleteLoop(SharedProducer::Loop* loop) {
+  uv_mutex_destroy(&loop->lock);
+  delete loop;
+}
+
+void LoopClosed(uv_handle_t* handle) {
+  SharedProducer::Loop* loop = static_cast<SharedProducer::Loop*>(handle->data);
+  bool unused;
+  {
+    scoped_mutex_lock lock(handles_lock);
+    loop->closed = true;
+    unused = loop->handles == 0;
+  }
+
+  // Otherwise the last handle to be released deletes it
+  if (unused) {
+    DeleteLoop(loop);
+  }
+}
+
+/**
+ * Environment cleanup hook of a loop. Handles still connected outlive it,
+ * the opaques of their orphaned reports are then dropped with what they hold.
+ */
+void CloseLoop(void* arg) {
+  SharedProducer::Loop* loop = static_cast<SharedProducer::Loop*>(arg);
+  std::vector<SharedProducer::Opaque*> opaques;
+  {
+    scoped_mutex_lock lock(loop->lock);
+    loop->closing = true;
+    opaques.swap(loop->orphans);
+  }
+
+  // Still on the thread of the isolate, so the handles can be let go of
+  FreeOpaques(opaques);
+
+  if (current_loop == loop) {
+    current_loop = NULL;
+  }
+  uv_close(reinterpret_cast<uv_handle_t*>(&loop->async), LoopClosed);
+}
+
+// Callbacks, opaques and the default topic configuration are set per member
+// and differ between members that are otherwise the same. The topic
+// configuration is compared by its own dump instead.
+bool IsPointer(const std::string& name) {
+  const std::string suffix = "_cb";
+  return name == "opaque" || name == "default_topic_conf" ||
+    name == "ssl_engine_callback_data" || (name.size() >= suffix.size() &&
+    name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0);
+}
+
+void AppendConfig(RdKafka::Conf* conf, std::string* key) {
+  std::list<std::string>* dump = conf->dump();
+  for (std::list<std::string>::iterator it = dump->begin();
+       it != dump->end(); ) {
+    const std::string& name = *it++;
+    const std::string& value = *it++;
+    if (IsPointer(name)) {
+      continue;
+    }
+    key->append(name);
+    key->append("=");
+    key->append(value);
+    key->append("\n");
+  }
+  delete dump;
+}
+
+}  // namespace
+
+SharedProducer::Loop* SharedProducer::CurrentLoop() {
+  if (current_loop == NULL) {
+    uv_once(&handles_once, InitHandles);
+
+    current_loop = new Loop();
+    current_loop->id = next_loop++;
+    uv_mutex_init(&current_loop->lock);
+    current_loop->closing = false;
+    current_loop->handles = 0;
+    current_loop->closed = false;
+
+    uv_async_init(Nan::GetCurrentEventLoop(), &current_loop->async,
+      FreeOrphans);
+    current_loop->async.data = current_loop;
+    // It must not keep the environment alive
+    uv_unref(reinterpret_cast<uv_handle_t*>(&current_loop->async));
+
+    node::AddEnvironmentCleanupHook(v8::Isolate::GetCurrent(), CloseLoop,
+      current_loop);
+  }
+  return current_loop;
+}
+
+SharedProducer::SharedProducer(const std::string& key, Loop* loop):
+  m_key(key),
+  m_producer(NULL),
+  m_loop(loop) {
+  uv_mutex_init(&m_members_lock);
+}
+
+SharedProducer::~SharedProducer() {
+  uv_mutex_destroy(&m_members_lock);
+}
+
+Baton SharedProducer::Acquire(Loop* loop, Conf* gconfig, Conf* tconfig,
+    Callbacks::Event* event_cb, Callbacks::Delivery* dr_cb,
+    SharedProducer** shared, uint64_t* member) {
+  // Callbacks the configuration owns would have to outlive its producer
+  if (gconfig->is_sasl_oauthbearer()) {
+    return Baton(RdKafka::ERR__INVALID_ARG,
+      "Producers using OAUTHBEARER cannot share a handle");
+  }
+
+  std::string transactional_id;
+  if (gconfig->get("transactional.id", transactional_id) ==
+        RdKafka::Conf::CONF_OK && !transactional_id.empty()) {
+    return Baton(RdKafka::ERR__INVALID_ARG,
+      "Transactional producers cannot share a handle");
+  }
+
+  // Orphaned opaques can only be freed in the environment of their member
+  std::string key = "loop=" + std::to_string(loop->id) + "\n";
+  AppendConfig(gconfig, &key);
+  if (tconfig) {
+    key.append("\n");
+    AppendConfig(tconfig, &key);
+  }
+
+  uv_once(&handles_once, InitHandles);
+  scoped_mutex_lock lock(handles_lock);
+
+  SharedProducer* producer;
+  std::map<std::string, SharedProducer*>::iterator it = handles->find(key);
+  if (it != handles->end()) {
+    producer = it->second;
+  } else {
+    producer = new SharedProducer(key, loop);
+
+    // The handle keeps the callbacks it was created with
+    std::string errstr;
+    gconfig->set("dr_cb",
+      static_cast<RdKafka::DeliveryReportCb*>(producer), errstr);
+    gconfig->set("event_cb", static_cast<RdKafka::EventCb*>(producer), errstr);
+    producer->m_producer = RdKafka::Producer::create(gconfig, errstr);
+    gconfig->set("dr_cb", dr_cb, errstr);
+    gconfig->set("event_cb", event_cb, errstr);
+
+    if (!producer->m_producer) {
+      delete producer;
+      return Baton(RdKafka::ERR__STATE, errstr);
+    }
+
+    (*handles)[key] = producer;
+    loop->handles++;
+  }
+
+  Member entry = { event_cb, dr_cb };
+  *member = next_member++;
+  {
+    scoped_mutex_lock members_lock(producer->m_members_lock);
+    producer->m_members[*member] = entry;
+  }
+
+  *shared = producer;
+  return Baton(RdKafka::ERR_NO_ERROR);
+}
+
+void SharedProducer::Release(uint64_t member) {
+  {
+    scoped_mutex_lock lock(handles_lock);
+    scoped_mutex_lock members_lock(m_members_lock);
+    m_members.erase(member);
+    if (!m_members.empty()) {
+      return;
+    }
+    handles->erase(m_key);
+  }
+
+  // Nobody can join anymore
+  delete m_producer;
+
+  // No report can come in anymore, so the loop may go too
+  Loop* loop = m_loop;
+  bool unused;
+  {
+    scoped_mutex_lock lock(handles_lock);
+    unused = --loop->handles == 0 && loop->closed;
+  }
+  delete this;
+
+  if (unused) {
+    DeleteLoop(loop);
+  }
+}
+
+RdKafka::Producer* SharedProducer::Handle() const {
+  return m_producer;
+}
+
+void SharedProducer::dr_cb(RdKafka::Message& message) {
+  Opaque* opaque = static_cast<Opaque*>(message.msg_opaque());
+  if (!opaque) {
+    return;
+  }
+
+  {
+    scoped_mutex_lock lock(m_members_lock);
+    std::map<uint64_t, Member>::iterator it = m_members.find(opaque->member);
+    if (it != m_members.end()) {
+      it->second.dr_cb->Deliver(message, opaque->opaque);
+      delete opaque;
+      return;
+    }
+  }
+
+  // Sent under the lock, the loop is not closed before it is marked closing
+  scoped_mutex_lock lock(m_loop->lock);
+  if (m_loop->closing) {
+    // Nothing it holds can be let go of off the thread of the isolate
+    delete opaque;
+    return;
+  }
+  m_loop->orphans.push_back(opaque);
+  uv_async_send(&m_loop->async);
+}
+
+void SharedProducer::event_cb(RdKafka::Event& event) {
+  scoped_mutex_lock lock(m_members_lock);
+  for (std::map<uint64_t, Member>::iterator it = m_members.begin();
+       it != m_members.end(); ++it) {
+    it->second.event_cb->event_cb(event);
+  }
+}
+
+}  // namespace NodeKafka
@@ -0,0 +1,110 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#ifndef SRC_SHARED_PRODUCER_H_
+#define SRC_SHARED_PRODUCER_H_
+
+#include <uv.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "rdkafkacpp.h"
+
+#include "src/errors.h"
+
+namespace NodeKafka {
+
+class Conf;
+
+namespace Callbacks {
+class Delivery;
+class Event;
+}  // namespace Callbacks
+
+/**
+ * @brief A librdkafka producer shared by every Producer of an environment,
+ * the main thread or a worker, that connects with the same configuration and
+ * asks for a shared handle.
+ *
+ * The handle is created by the first of them to connect and destroyed when
+ * the last one disconnects. It has callbacks of its own, so it does not
+ * depend on any of its members: events go to all members, delivery reports
+ * to the member that produced the message. For that, members produce every
+ * message with an Opaque wrapping their own.
+ *
+ * Reports of messages still in flight when their member disconnects are
+ * dropped, which is why producers flush before they disconnect. Their
+ * opaques hold handles, so they are queued to the thread of the environment
+ * to be freed. Handles are never shared across environments for that reason.
+ */
+class SharedProducer : public RdKafka::DeliveryReportCb,
+                       public RdKafka::EventCb {
+ public:
+  struct Opaque {
+    uint64_t member;
+    void* opaque;
+    // How the member encoded the opaque, see Callbacks::FreeOpaque
+    bool zero_copy;
+    bool opaque_id;
+  };
+
+  // Where the opaques of the reports of an environment are freed
+  struct Loop;
+
+  // The loop of the environment running on this thread, created on first use
+  static Loop* CurrentLoop();
+
+  /**
+   * Join the handle for the configuration, creating it if there is none.
+   *
+   * @param loop - Loop of the environment of the member, see CurrentLoop.
+   * @param gconfig - Global configuration of the member. Only used if the
+   * handle is created, its callbacks are restored afterwards.
+   * @param tconfig - Default topic configuration of the member, or NULL.
+   * @param shared - Set to the handle.
+   * @param member - Set to the id the member produces with.
+   */
+  static Baton Acquire(Loop* loop, Conf* gconfig, Conf* tconfig,
+    Callbacks::Event* event_cb, Callbacks::Delivery* dr_cb,
+    SharedProducer** shared, uint64_t* member);
+
+  // Leave the handle, destroying it if this was the last member
+  void Release(uint64_t member);
+
+  RdKafka::Producer* Handle() const;
+
+  void dr_cb(RdKafka::Message&);
+  void event_cb(RdKafka::Event&);
+
+ private:
+  struct Member {
+    Callbacks::Event* event_cb;
+    Callbacks::Delivery* dr_cb;
+  };
+
+  SharedProducer(const std::string& key, Loop* loop);
+  ~SharedProducer();
+
+  const std::string m_key;
+  RdKafka::Producer* m_producer;
+  // Outlives the handle
+  Loop* const m_loop;
+
+  std::map<uint64_t, Member> m_members;
+  // Taken by every callback, Release may not destroy a member while one is
+  // being called
+  uv_mutex_t m_members_lock;
+};
+
+}  // namespace NodeKafka
+
+#endif  // SRC_SHARED_PRODUCER_H_
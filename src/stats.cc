@@ -0,0 +1,425 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#include <cctype>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/stats.h"
+
+namespace NodeKafka {
+namespace Stats {
+
+namespace {
+
+// Fields used when no field names were given
+const char* kDefaultFields[] = {
+  "replyq", "msg_cnt", "msg_size", "txmsgs", "rxmsgs",
+  "outbuf_cnt", "waitresp_cnt", "rtt",
+  "msgq_cnt", "xmit_msgq_cnt", "fetchq_cnt", "consumer_lag",
+};
+
+// Fields that identify an entry, always kept
+const char* kIdentityFields[] = {
+  "name", "client_id", "type", "ts", "nodeid", "nodename", "topic",
+  "partition",
+};
+
+// Maps keyed by broker, topic and partition that are descended into
+bool IsStructuralField(const std::string& key) {
+  return key == "brokers" || key == "topics" || key == "partitions";
+}
+
+bool IsIdentityField(const std::string& key) {
+  for (size_t i = 0; i < sizeof(kIdentityFields) / sizeof(char*); i++) {
+    if (key == kIdentityFields[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Single pass parser for librdkafka's statistics JSON.
+ *
+ * Everything that is not selected by the filter is skipped without being
+ * materialized, so the cost is a scan of the input plus the selected
+ * fields. Runs on the librdkafka thread that emits the statistics.
+ */
+class Parser {
+ public:
+  Parser(const std::string& json, const Filter& filter):
+    m_pos(json.data()),
+    m_end(json.data() + json.size()),
+    m_filter(filter) {}
+
+  bool ParseRoot(Value* out) {
+    SkipWhitespace();
+    if (!ParseEntry(out)) {
+      return false;
+    }
+    SkipWhitespace();
+    return m_pos == m_end;
+  }
+
+ private:
+  const char* m_pos;
+  const char* m_end;
+  const Filter& m_filter;
+
+  void SkipWhitespace() {
+    while (m_pos < m_end &&
+           (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' ||
+            *m_pos == '\t')) {
+      m_pos++;
+    }
+  }
+
+  bool Consume(char c) {
+    SkipWhitespace();
+    if (m_pos < m_end && *m_pos == c) {
+      m_pos++;
+      return true;
+    }
+    return false;
+  }
+
+  bool Peek(char c) {
+    SkipWhitespace();
+    return m_pos < m_end && *m_pos == c;
+  }
+
+  static void AppendUtf8(std::string* out, unsigned int cp) {
+    if (cp < 0x80) {
+      out->push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+      out->push_back(static_cast<char>(0xC0 | (cp >> 6)));
+      out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+      out->push_back(static_cast<char>(0xE0 | (cp >> 12)));
+      out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+      out->push_back(static_cast<char>(0xF0 | (cp >> 18)));
+      out->push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+  }
+
+  // The four hex digits of a \u escape, with the \u already consumed
+  bool ParseHex4(unsigned int* out) {
+    if (m_end - m_pos < 4) {
+      return false;
+    }
+    // strtoul would stop at the first bad digit instead of failing
+    for (int i = 0; i < 4; i++) {
+      if (!std::isxdigit(static_cast<unsigned char>(m_pos[i]))) {
+        return false;
+      }
+    }
+    std::string hex(m_pos, 4);
+    m_pos += 4;
+    *out = std::strtoul(hex.c_str(), NULL, 16);
+    return true;
+  }
+
+  // Combines a surrogate pair, which JSON escapes characters outside the
+  // basic plane as. Unpaired surrogates become U+FFFD.
+  bool ParseCodePoint(unsigned int* out) {
+    unsigned int cp;
+    if (!ParseHex4(&cp)) {
+      return false;
+    }
+
+    if (cp >= 0xDC00 && cp <= 0xDFFF) {
+      cp = 0xFFFD;
+    } else if (cp >= 0xD800 && cp <= 0xDBFF) {
+      unsigned int low = 0;
+      if (m_end - m_pos >= 6 && m_pos[0] == '\\' && m_pos[1] == 'u') {
+        const char* pos = m_pos;
+        m_pos += 2;
+        if (!ParseHex4(&low)) {
+          return false;
+        }
+        if (low < 0xDC00 || low > 0xDFFF) {
+          // Not a pair, the escape is read on its own
+          m_pos = pos;
+          low = 0;
+        }
+      }
+      cp = low ? 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00) : 0xFFFD;
+    }
+
+    *out = cp;
+    return true;
+  }
+
+  // out may be NULL to skip the string
+  bool ParseString(std::string* out) {
+    if (!Consume('"')) {
+      return false;
+    }
+
+    while (m_pos < m_end) {
+      char c = *m_pos++;
+      if (c == '"') {
+        return true;
+      }
+      if (c != '\\') {
+        if (out) out->push_back(c);
+        continue;
+      }
+
+      if (m_pos >= m_end) {
+        return false;
+      }
+      char escaped = *m_pos++;
+      switch (escaped) {
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'n': c = '\n'; break;
+        case 'r': c = '\r'; break;
+        case 't': c = '\t'; break;
+        case 'u': {
+          unsigned int cp;
+          if (!ParseCodePoint(&cp)) {
+            return false;
+          }
+          if (out) {
+            AppendUtf8(out, cp);
+          }
+          continue;
+        }
+        default: c = escaped; break;
+      }
+      if (out) out->push_back(c);
+    }
+
+    return false;
+  }
+
+  bool ParseNumber(double* out) {
+    SkipWhitespace();
+    const char* start = m_pos;
+    while (m_pos < m_end &&
+           ((*m_pos >= '0' && *m_pos <= '9') || *m_pos == '-' ||
+            *m_pos == '+' || *m_pos == '.' || *m_pos == 'e' ||
+            *m_pos == 'E')) {
+      m_pos++;
+    }
+    if (m_pos == start) {
+      return false;
+    }
+    if (out) {
+      *out = std::strtod(std::string(start, m_pos - start).c_str(), NULL);
+    }
+    return true;
+  }
+
+  bool ParseLiteral(const char* literal) {
+    SkipWhitespace();
+    const char* p = m_pos;
+    while (*literal) {
+      if (p >= m_end || *p != *literal) {
+        return false;
+      }
+      p++;
+      literal++;
+    }
+    m_pos = p;
+    return true;
+  }
+
+  /**
+   * Parse any value into out, or skip it when out is NULL. Arrays and nulls
+   * are always skipped.
+   */
+  bool ParseValue(Value* out) {
+    SkipWhitespace();
+    if (m_pos >= m_end) {
+      return false;
+    }
+
+    switch (*m_pos) {
+      case '"':
+        if (out) out->kind = Value::STRING;
+        return ParseString(out ? &out->string : NULL);
+      case '{':
+        if (out) out->kind = Value::OBJECT;
+        return ParseMembers(out, &Parser::ParseValueMember);
+      case '[':
+        m_pos++;
+        if (Consume(']')) {
+          return true;
+        }
+        do {
+          if (!ParseValue(NULL)) {
+            return false;
+          }
+        } while (Consume(','));
+        return Consume(']');
+      case 't':
+        if (out) {
+          out->kind = Value::BOOLEAN;
+          out->boolean = true;
+        }
+        return ParseLiteral("true");
+      case 'f':
+        if (out) out->kind = Value::BOOLEAN;
+        return ParseLiteral("false");
+      case 'n':
+        return ParseLiteral("null");
+      default:
+        if (out) out->kind = Value::NUMBER;
+        return ParseNumber(out ? &out->number : NULL);
+    }
+  }
+
+  typedef bool (Parser::*MemberParser)(const std::string&, Value*);
+
+  /**
+   * Parse the members of an object, handing each key to parse_member which
+   * consumes the value and adds it to out if it should be kept.
+   */
+  bool ParseMembers(Value* out, MemberParser parse_member) {
+    if (!Consume('{')) {
+      return false;
+    }
+    if (Consume('}')) {
+      return true;
+    }
+
+    std::string key;
+    do {
+      key.clear();
+      if (!ParseString(&key) || !Consume(':')) {
+        return false;
+      }
+      if (!(this->*parse_member)(key, out)) {
+        return false;
+      }
+    } while (Consume(','));
+
+    return Consume('}');
+  }
+
+  bool Keep(Value* out, const std::string& key) {
+    Member member;
+    member.key = key;
+    if (!ParseValue(&member.value)) {
+      return false;
+    }
+    if (member.value.kind != Value::NONE) {
+      out->members.push_back(std::move(member));
+    }
+    return true;
+  }
+
+  // Member of an object that is kept as a whole
+  bool ParseValueMember(const std::string& key, Value* out) {
+    return out ? Keep(out, key) : ParseValue(NULL);
+  }
+
+  // Member of the root, of a broker or of a topic (partition)
+  bool ParseEntryMember(const std::string& key, Value* out) {
+    if (IsStructuralField(key) && Peek('{')) {
+      Member member;
+      member.key = key;
+      member.value.kind = Value::OBJECT;
+      if (!ParseMembers(&member.value, &Parser::ParseMapMember)) {
+        return false;
+      }
+      out->members.push_back(std::move(member));
+      return true;
+    }
+
+    if (IsIdentityField(key) || m_filter.Has(key)) {
+      return Keep(out, key);
+    }
+
+    return ParseValue(NULL);
+  }
+
+  // Member of a map keyed by broker, topic or partition
+  bool ParseMapMember(const std::string& key, Value* out) {
+    if (!Peek('{')) {
+      return ParseValue(NULL);
+    }
+
+    Member member;
+    member.key = key;
+    if (!ParseEntry(&member.value)) {
+      return false;
+    }
+    out->members.push_back(std::move(member));
+    return true;
+  }
+
+  bool ParseEntry(Value* out) {
+    out->kind = Value::OBJECT;
+    return ParseMembers(out, &Parser::ParseEntryMember);
+  }
+};
+
+}  // namespace
+
+Filter::Filter(const std::vector<std::string>& fields):
+  m_fields(fields.begin(), fields.end()) {
+  if (m_fields.empty()) {
+    m_fields.insert(std::begin(kDefaultFields), std::end(kDefaultFields));
+  }
+}
+
+bool Filter::Has(const std::string& field) const {
+  return m_fields.find(field) != m_fields.end();
+}
+
+/**
+ * @brief Parse a statistics JSON string, keeping only the broker, topic
+ * and partition maps plus the fields selected by filter.
+ *
+ * @returns The filtered tree, or null if json could not be parsed.
+ */
+std::shared_ptr<Value> Parse(const std::string& json, const Filter& filter) {
+  std::shared_ptr<Value> root = std::make_shared<Value>();
+  Parser parser(json, filter);
+  if (!parser.ParseRoot(root.get())) {
+    return std::shared_ptr<Value>();
+  }
+  return root;
+}
+
+v8::Local<v8::Value> ToV8Value(const Value& value) {
+  switch (value.kind) {
+    case Value::NUMBER:
+      return Nan::New<v8::Number>(value.number);
+    case Value::STRING:
+      return Nan::New<v8::String>(value.string).ToLocalChecked();
+    case Value::BOOLEAN:
+      return Nan::New<v8::Boolean>(value.boolean);
+    case Value::OBJECT: {
+      v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+      for (size_t i = 0; i < value.members.size(); i++) {
+        Nan::Set(obj,
+          Nan::New<v8::String>(value.members[i].key).ToLocalChecked(),
+          ToV8Value(value.members[i].value));
+      }
+      return obj;
+    }
+    default:
+      return Nan::Undefined();
+  }
+}
+
+}  // namespace Stats
+}  // namespace NodeKafka
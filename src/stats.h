@@ -0,0 +1,71 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#ifndef SRC_STATS_H_
+#define SRC_STATS_H_
+
+#include <nan.h>
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace NodeKafka {
+namespace Stats {
+
+struct Member;
+
+/**
+ * @brief A value of a filtered statistics tree.
+ *
+ * Only objects, numbers, strings and booleans are kept, arrays and nulls
+ * are dropped while parsing.
+ */
+struct Value {
+  enum Kind { NONE, NUMBER, STRING, BOOLEAN, OBJECT };
+
+  Kind kind = NONE;
+  double number = 0;
+  bool boolean = false;
+  std::string string;
+  std::vector<Member> members;
+};
+
+struct Member {
+  std::string key;
+  Value value;
+};
+
+/**
+ * @brief Names of the statistics fields to keep.
+ *
+ * A field is kept wherever it shows up: at the top level, for a broker or
+ * for a topic partition. Fields holding an object, like a broker's `rtt`,
+ * are kept as a whole.
+ */
+class Filter {
+ public:
+  explicit Filter(const std::vector<std::string>&);
+
+  bool Has(const std::string&) const;
+
+ private:
+  std::unordered_set<std::string> m_fields;
+};
+
+std::shared_ptr<Value> Parse(const std::string& json, const Filter& filter);
+
+v8::Local<v8::Value> ToV8Value(const Value&);
+
+}  // namespace Stats
+}  // namespace NodeKafka
+
+#endif  // SRC_STATS_H_
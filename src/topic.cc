@@ -45,6 +45,10 @@ std::string Topic::name() {
   return m_topic_name;
 }
 
+RdKafka::Conf* Topic::config() {
+  return m_config;
+}
+
 Baton Topic::toRDKafkaTopic(Connection* handle) {
   if (m_config) {
     return handle->CreateTopic(m_topic_name, m_config);
@@ -74,7 +78,7 @@ Baton offset_store (int32_t partition, int64_t offset) {
 
 */
 
-Nan::Persistent<v8::Function> Topic::constructor;
+PerIsolateFunction Topic::constructor;
 
 void Topic::Init(v8::Local<v8::Object> exports) {
   Nan::HandleScope scope;
@@ -147,7 +151,7 @@ v8::Local<v8::Object> Topic::NewInstance(v8::Local<v8::Value> arg) {
   const unsigned argc = 1;
 
   v8::Local<v8::Value> argv[argc] = { arg };
-  v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+  v8::Local<v8::Function> cons = constructor.Get();
   v8::Local<v8::Object> instance =
     Nan::NewInstance(cons, argc, argv).ToLocalChecked();
 
@@ -26,8 +26,11 @@ class Topic : public Nan::ObjectWrap {
 
   Baton toRDKafkaTopic(Connection *handle);
 
+  std::string name();
+  RdKafka::Conf* config();
+
  protected:
-  static Nan::Persistent<v8::Function> constructor;
+  static PerIsolateFunction constructor;
   static void New(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
   static NAN_METHOD(NodeGetMetadata);
@@ -35,7 +38,6 @@ class Topic : public Nan::ObjectWrap {
   // TopicConfig * config_;
 
   std::string errstr;
-  std::string name();
 
  private:
   Topic(std::string, RdKafka::Conf *);
@@ -0,0 +1,277 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#include <uv.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "src/worker-pool.h"
+
+namespace NodeKafka {
+namespace WorkerPool {
+
+namespace {
+
+/**
+ * Completions of the workers queued from the thread of one environment.
+ * Only referenced while there are workers in flight.
+ */
+struct Loop {
+  uv_async_t async;
+
+  // Guarded by the pool lock
+  std::vector<Nan::AsyncWorker*> completed;
+  // Queued or running on the pool
+  size_t outstanding;
+  // Set when the environment is torn down, nothing is called back anymore
+  bool closing;
+
+  // Only used on the thread of the loop
+  size_t in_flight;
+};
+
+struct Pool {
+  uv_mutex_t lock;
+  uv_cond_t cond;
+  // Signalled when a worker of a closing loop is done
+  uv_cond_t drained;
+
+  std::deque<std::pair<Nan::AsyncWorker*, Loop*>> queued;
+  std::vector<uv_thread_t> threads;
+  // Threads at an index at or above size take no work
+  unsigned int size;
+  unsigned int running;
+};
+
+Pool* pool = NULL;
+uv_once_t pool_once = UV_ONCE_INIT;
+std::atomic<unsigned int> configured_size(kDefaultSize);
+
+// The loop of the environment running on this thread, if it queued work
+thread_local Loop* current_loop = NULL;
+
+void Run(void* arg) {
+  const unsigned int index =
+    static_cast<unsigned int>(reinterpret_cast<uintptr_t>(arg));
+
+  uv_mutex_lock(&pool->lock);
+  for (;;) {
+    while (pool->queued.empty() || index >= pool->size) {
+      uv_cond_wait(&pool->cond, &pool->lock);
+    }
+
+    Nan::AsyncWorker* worker = pool->queued.front().first;
+    Loop* loop = pool->queued.front().second;
+    pool->queued.pop_front();
+    pool->running++;
+    uv_mutex_unlock(&pool->lock);
+
+    worker->Execute();
+
+    uv_mutex_lock(&pool->lock);
+    pool->running--;
+    loop->outstanding--;
+    loop->completed.push_back(worker);
+    if (loop->closing) {
+      uv_cond_broadcast(&pool->drained);
+    } else {
+      uv_async_send(&loop->async);
+    }
+  }
+}
+
+void Complete(uv_async_t* handle) {
+  Loop* loop = static_cast<Loop*>(handle->data);
+  std::vector<Nan::AsyncWorker*> completed;
+
+  uv_mutex_lock(&pool->lock);
+  loop->completed.swap(completed);
+  uv_mutex_unlock(&pool->lock);
+
+  // Same as the libuv threadpool completion of Nan::AsyncQueueWorker
+  for (size_t i = 0; i < completed.size(); i++) {
+    completed[i]->WorkComplete();
+    completed[i]->Destroy();
+  }
+
+  loop->in_flight -= completed.size();
+  if (loop->in_flight == 0) {
+    uv_unref(reinterpret_cast<uv_handle_t*>(handle));
+  }
+}
+
+void LoopClosed(uv_handle_t* handle) {
+  delete static_cast<Loop*>(handle->data);
+}
+
+/**
+ * Environment cleanup hook of a loop. Workers that did not start yet never
+ * will, the ones running are waited for, which takes at most their timeout.
+ * Their handles have to be closed on this thread before the loop is.
+ */
+void CloseLoop(void* arg) {
+  Loop* loop = static_cast<Loop*>(arg);
+  std::vector<Nan::AsyncWorker*> dropped;
+
+  uv_mutex_lock(&pool->lock);
+  loop->closing = true;
+  for (std::deque<std::pair<Nan::AsyncWorker*, Loop*>>::iterator it =
+         pool->queued.begin(); it != pool->queued.end();) {
+    if (it->second == loop) {
+      dropped.push_back(it->first);
+      loop->outstanding--;
+      it = pool->queued.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  while (loop->outstanding > 0) {
+    uv_cond_wait(&pool->drained, &pool->lock);
+  }
+  dropped.insert(dropped.end(), loop->completed.begin(),
+    loop->completed.end());
+  loop->completed.clear();
+  uv_mutex_unlock(&pool->lock);
+
+  // Still on the thread of the isolate, so the workers can let go of their
+  // handles, but nothing is called back
+  for (size_t i = 0; i < dropped.size(); i++) {
+    dropped[i]->Destroy();
+  }
+
+  if (current_loop == loop) {
+    current_loop = NULL;
+  }
+  uv_close(reinterpret_cast<uv_handle_t*>(&loop->async), LoopClosed);
+}
+
+void Init() {
+  pool = new Pool();
+  uv_mutex_init(&pool->lock);
+  uv_cond_init(&pool->cond);
+  uv_cond_init(&pool->drained);
+  pool->size = configured_size.load();
+  pool->running = 0;
+}
+
+Loop* CurrentLoop() {
+  if (current_loop == NULL) {
+    current_loop = new Loop();
+    current_loop->outstanding = 0;
+    current_loop->closing = false;
+    current_loop->in_flight = 0;
+
+    uv_async_init(Nan::GetCurrentEventLoop(), &current_loop->async,
+      Complete);
+    current_loop->async.data = current_loop;
+    uv_unref(reinterpret_cast<uv_handle_t*>(&current_loop->async));
+
+    node::AddEnvironmentCleanupHook(v8::Isolate::GetCurrent(), CloseLoop,
+      current_loop);
+  }
+  return current_loop;
+}
+
+/**
+ * Start threads until there is one for every queued or running worker, up
+ * to the pool size. Must be called with the pool lock held.
+ */
+void StartThreads() {
+  while (pool->threads.size() < pool->size &&
+         pool->queued.size() + pool->running > pool->threads.size()) {
+    uv_thread_t thread;
+    void* index = reinterpret_cast<void*>(
+      static_cast<uintptr_t>(pool->threads.size()));
+    if (uv_thread_create(&thread, Run, index) != 0) {
+      // The threads already running will get to the work eventually
+      break;
+    }
+    pool->threads.push_back(thread);
+  }
+}
+
+}  // namespace
+
+void Queue(Nan::AsyncWorker* worker) {
+  if (configured_size.load() == 0) {
+    Nan::AsyncQueueWorker(worker);
+    return;
+  }
+
+  uv_once(&pool_once, Init);
+
+  Loop* loop = CurrentLoop();
+  if (loop->in_flight++ == 0) {
+    uv_ref(reinterpret_cast<uv_handle_t*>(&loop->async));
+  }
+
+  uv_mutex_lock(&pool->lock);
+  pool->queued.push_back(std::make_pair(worker, loop));
+  loop->outstanding++;
+  StartThreads();
+  if (pool->threads.size() > pool->size) {
+    // A parked thread may be the one woken, make sure one that can take
+    // the worker sees it
+    uv_cond_broadcast(&pool->cond);
+  } else {
+    uv_cond_signal(&pool->cond);
+  }
+  uv_mutex_unlock(&pool->lock);
+}
+
+void SetSize(unsigned int size) {
+  configured_size.store(size);
+
+  // 0 only sends new work to the libuv threadpool, what is already queued
+  // on the pool still has to run there
+  if (size == 0) {
+    return;
+  }
+
+  uv_once(&pool_once, Init);
+
+  uv_mutex_lock(&pool->lock);
+  pool->size = size;
+  StartThreads();
+  uv_cond_broadcast(&pool->cond);
+  uv_mutex_unlock(&pool->lock);
+}
+
+unsigned int GetSize() {
+  return configured_size.load();
+}
+
+void AddMetrics(v8::Local<v8::Object> obj) {
+  uv_once(&pool_once, Init);
+
+  uv_mutex_lock(&pool->lock);
+  unsigned int threads = pool->threads.size();
+  unsigned int running = pool->running;
+  size_t queued = pool->queued.size();
+  uv_mutex_unlock(&pool->lock);
+
+  v8::Local<v8::Object> metrics = Nan::New<v8::Object>();
+  Nan::Set(metrics, Nan::New("size").ToLocalChecked(),
+    Nan::New<v8::Number>(configured_size.load()));
+  Nan::Set(metrics, Nan::New("threads").ToLocalChecked(),
+    Nan::New<v8::Number>(threads));
+  Nan::Set(metrics, Nan::New("running").ToLocalChecked(),
+    Nan::New<v8::Number>(running));
+  Nan::Set(metrics, Nan::New("queued").ToLocalChecked(),
+    Nan::New<v8::Number>(static_cast<double>(queued)));
+  Nan::Set(obj, Nan::New("workerPool").ToLocalChecked(), metrics);
+}
+
+}  // namespace WorkerPool
+}  // namespace NodeKafka
@@ -0,0 +1,55 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#ifndef SRC_WORKER_POOL_H_
+#define SRC_WORKER_POOL_H_
+
+#include <nan.h>
+
+namespace NodeKafka {
+
+/**
+ * @brief Threads owned by the binding that run the blocking workers.
+ *
+ * Workers block for up to their timeout waiting on librdkafka, so running
+ * them on the libuv threadpool would starve fs, dns and crypto work of the
+ * whole process. The pool is shared by all clients of the process, also by
+ * the ones created in worker threads. Completions are run on the loop of
+ * the thread that queued the worker. Workers of a thread whose environment
+ * is torn down are dropped without calling back.
+ *
+ * All functions must be called on the thread of a JS environment, the main
+ * thread or a worker thread.
+ */
+namespace WorkerPool {
+
+// Threads the pool starts when it is first used
+const unsigned int kDefaultSize = 4;
+
+/**
+ * Run worker on the pool, or on the libuv threadpool if the pool size is 0.
+ * Has the same ownership semantics as Nan::AsyncQueueWorker.
+ */
+void Queue(Nan::AsyncWorker* worker);
+
+/**
+ * Set the number of threads running workers. Threads are started as work
+ * comes in, the ones above a lowered size stay idle until it is raised
+ * again.
+ */
+void SetSize(unsigned int size);
+unsigned int GetSize();
+
+void AddMetrics(v8::Local<v8::Object>);
+
+}  // namespace WorkerPool
+}  // namespace NodeKafka
+
+#endif  // SRC_WORKER_POOL_H_
@@ -41,7 +41,7 @@ OffsetsForTimes::OffsetsForTimes(Nan::Callback *callback,
                                  Connection* handle,
                                  std::vector<RdKafka::TopicPartition*> & t,
                                  const int & timeout_ms) :
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "OffsetsForTimes"),
   m_handle(handle),
   m_topic_partitions(t),
   m_timeout_ms(timeout_ms) {}
@@ -83,7 +83,7 @@ void OffsetsForTimes::HandleErrorCallback() {
 ConnectionMetadata::ConnectionMetadata(
   Nan::Callback *callback, Connection* connection,
   std::string topic, int timeout_ms, bool all_topics) :
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "ConnectionMetadata"),
   m_connection(connection),
   m_topic(topic),
   m_timeout_ms(timeout_ms),
@@ -128,6 +128,49 @@ void ConnectionMetadata::HandleErrorCallback() {
   callback->Call(argc, argv);
 }
 
+/**
+ * @brief Worker refreshing the metadata cache of a connection.
+ *
+ * The metadata is only converted to JS for what changed.
+ *
+ * @sa NodeKafka::Connection::RefreshMetadataCache
+ */
+
+ConnectionRefreshMetadataCache::ConnectionRefreshMetadataCache(
+  Nan::Callback *callback, Connection* connection, int timeout_ms) :
+  ErrorAwareWorker(callback, "ConnectionRefreshMetadataCache"),
+  m_connection(connection),
+  m_timeout_ms(timeout_ms) {}
+
+ConnectionRefreshMetadataCache::~ConnectionRefreshMetadataCache() {}
+
+void ConnectionRefreshMetadataCache::Execute() {
+  Baton b = m_connection->RefreshMetadataCache(m_timeout_ms, &m_changes);
+
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    SetErrorBaton(b);
+  }
+}
+
+void ConnectionRefreshMetadataCache::HandleOKCallback() {
+  Nan::HandleScope scope;
+
+  const unsigned int argc = 2;
+  v8::Local<v8::Value> argv[argc] = { Nan::Null(),
+    MetadataCache::ChangesToV8Array(m_changes) };
+
+  callback->Call(argc, argv);
+}
+
+void ConnectionRefreshMetadataCache::HandleErrorCallback() {
+  Nan::HandleScope scope;
+
+  const unsigned int argc = 1;
+  v8::Local<v8::Value> argv[argc] = { GetErrorObject() };
+
+  callback->Call(argc, argv);
+}
+
 /**
  * @brief Client query watermark offsets worker
  *
@@ -140,7 +183,7 @@ void ConnectionMetadata::HandleErrorCallback() {
 ConnectionQueryWatermarkOffsets::ConnectionQueryWatermarkOffsets(
   Nan::Callback *callback, Connection* connection,
   std::string topic, int32_t partition, int timeout_ms) :
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "ConnectionQueryWatermarkOffsets"),
   m_connection(connection),
   m_topic(topic),
   m_partition(partition),
@@ -194,7 +237,7 @@ void ConnectionQueryWatermarkOffsets::HandleErrorCallback() {
  */
 
 ProducerConnect::ProducerConnect(Nan::Callback *callback, Producer* producer):
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "ProducerConnect"),
   producer(producer) {}
 
 ProducerConnect::~ProducerConnect() {}
@@ -245,7 +288,7 @@ void ProducerConnect::HandleErrorCallback() {
 
 ProducerDisconnect::ProducerDisconnect(Nan::Callback *callback,
   Producer* producer):
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "ProducerDisconnect"),
   producer(producer) {}
 
 ProducerDisconnect::~ProducerDisconnect() {}
@@ -279,7 +322,7 @@ void ProducerDisconnect::HandleErrorCallback() {
 
 ProducerFlush::ProducerFlush(Nan::Callback *callback,
   Producer* producer, int timeout_ms):
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "ProducerFlush"),
   producer(producer),
   timeout_ms(timeout_ms) {}
 
@@ -317,7 +360,7 @@ void ProducerFlush::HandleOKCallback() {
 
 ProducerInitTransactions::ProducerInitTransactions(Nan::Callback *callback,
   Producer* producer, const int & timeout_ms):
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "ProducerInitTransactions"),
   producer(producer),
   m_timeout_ms(timeout_ms) {}
 
@@ -362,7 +405,7 @@ void ProducerInitTransactions::HandleErrorCallback() {
  */
 
 ProducerBeginTransaction::ProducerBeginTransaction(Nan::Callback *callback, Producer* producer):
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "ProducerBeginTransaction"),
   producer(producer) {}
 
 ProducerBeginTransaction::~ProducerBeginTransaction() {}
@@ -408,7 +451,7 @@ void ProducerBeginTransaction::HandleErrorCallback() {
 
 ProducerCommitTransaction::ProducerCommitTransaction(Nan::Callback *callback,
   Producer* producer, const int & timeout_ms):
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "ProducerCommitTransaction"),
   producer(producer),
   m_timeout_ms(timeout_ms) {}
 
@@ -454,7 +497,7 @@ void ProducerCommitTransaction::HandleErrorCallback() {
 
 ProducerAbortTransaction::ProducerAbortTransaction(Nan::Callback *callback,
   Producer* producer, const int & timeout_ms):
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "ProducerAbortTransaction"),
   producer(producer),
   m_timeout_ms(timeout_ms) {}
 
@@ -504,7 +547,7 @@ ProducerSendOffsetsToTransaction::ProducerSendOffsetsToTransaction(
     std::vector<RdKafka::TopicPartition *> & t,
     KafkaConsumer* consumer,
     const int & timeout_ms):
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "ProducerSendOffsetsToTransaction"),
   producer(producer),
   m_topic_partitions(t),
   consumer(consumer),
@@ -556,7 +599,7 @@ void ProducerSendOffsetsToTransaction::HandleErrorCallback() {
 
 KafkaConsumerConnect::KafkaConsumerConnect(Nan::Callback *callback,
   KafkaConsumer* consumer):
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "KafkaConsumerConnect"),
   consumer(consumer) {}
 
 KafkaConsumerConnect::~KafkaConsumerConnect() {}
@@ -612,7 +655,7 @@ void KafkaConsumerConnect::HandleErrorCallback() {
 
 KafkaConsumerDisconnect::KafkaConsumerDisconnect(Nan::Callback *callback,
   KafkaConsumer* consumer):
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "KafkaConsumerDisconnect"),
   consumer(consumer) {}
 
 KafkaConsumerDisconnect::~KafkaConsumerDisconnect() {}
@@ -647,6 +690,10 @@ void KafkaConsumerDisconnect::HandleErrorCallback() {
   callback->Call(argc, argv);
 }
 
+// How long a loop waits for the main thread before checking whether it
+// should stop
+static const int kConsumeLoopRoomWaitMs = 100;
+
 /**
  * @brief KafkaConsumer get messages worker.
  *
@@ -672,11 +719,31 @@ KafkaConsumerConsumeLoop::KafkaConsumerConsumeLoop(Nan::Callback *callback,
                                      KafkaConsumer* consumer,
                                      const int & timeout_ms,
                                      const int & timeout_sleep_delay_ms) :
-  MessageWorker(callback),
+  KafkaConsumerConsumeLoop(callback, consumer, timeout_ms,
+                           timeout_sleep_delay_ms, 0, 0) {}
+
+/**
+ * @brief Batched flowing mode.
+ *
+ * With a batch size set, the loop thread collects up to batch_size messages,
+ * waiting at most batch_timeout_ms after the first one, and queues them with
+ * a single wake-up. Everything queued by the time the main thread runs is
+ * handed to the callback as one array, along with its EOF events.
+ */
+KafkaConsumerConsumeLoop::KafkaConsumerConsumeLoop(Nan::Callback *callback,
+                                     KafkaConsumer* consumer,
+                                     const int & timeout_ms,
+                                     const int & timeout_sleep_delay_ms,
+                                     const unsigned int & batch_size,
+                                     const int & batch_timeout_ms) :
+  MessageWorker(callback, "KafkaConsumerConsumeLoop"),
   consumer(consumer),
-  m_looping(true),
   m_timeout_ms(timeout_ms),
-  m_timeout_sleep_delay_ms(timeout_sleep_delay_ms) {
+  m_timeout_sleep_delay_ms(timeout_sleep_delay_ms),
+  m_batch_size(batch_size),
+  m_batch_timeout_ms(batch_timeout_ms),
+  m_looping(true) {
+  SetMaxPending(consumer->GetConsumeBacklogMax());
   uv_thread_create(&thread_event_loop, KafkaConsumerConsumeLoop::ConsumeLoop, (void*)this);
 }
 
@@ -696,8 +763,18 @@ void KafkaConsumerConsumeLoop::ConsumeLoop(void *arg) {
   ExecutionMessageBus bus(consumerLoop);
   KafkaConsumer* consumer = consumerLoop->consumer;
 
+  if (consumerLoop->m_batch_size > 0) {
+    consumerLoop->ConsumeBatch(bus);
+    return;
+  }
+
   // Do one check here before we move forward
   while (consumerLoop->m_looping && consumer->IsConnected()) {
+    // Leave messages with librdkafka while the main thread is behind
+    if (!bus.WaitForRoom(kConsumeLoopRoomWaitMs)) {
+      continue;
+    }
+
     Baton b = consumer->Consume(consumerLoop->m_timeout_ms);
     RdKafka::ErrorCode ec = b.err();
     if (ec == RdKafka::ERR_NO_ERROR) {
@@ -740,6 +817,108 @@ void KafkaConsumerConsumeLoop::ConsumeLoop(void *arg) {
   }
 }
 
+void KafkaConsumerConsumeLoop::ConsumeBatch(const ExecutionMessageBus& bus) {
+  std::vector<RdKafka::Message*> batch;
+  batch.reserve(m_batch_size);
+
+  while (m_looping && consumer->IsConnected()) {
+    if (!bus.WaitForRoom(kConsumeLoopRoomWaitMs)) {
+      continue;
+    }
+
+    // The first message of a batch waits as long as a single consume would,
+    // the rest only for whatever is left of the batch timeout.
+    uint64_t deadline = 0;
+    bool timed_out = false;
+
+    while (batch.size() < m_batch_size && m_looping) {
+      int timeout_ms = m_timeout_ms;
+      if (!batch.empty()) {
+        uint64_t now = uv_hrtime();
+        timeout_ms = now < deadline ?
+          static_cast<int>((deadline - now) / 1000000) : 0;
+      }
+
+      Baton b = consumer->Consume(timeout_ms);
+      RdKafka::ErrorCode ec = b.err();
+      if (ec == RdKafka::ERR_NO_ERROR) {
+        RdKafka::Message *message = b.data<RdKafka::Message*>();
+        switch (message->err()) {
+          case RdKafka::ERR__PARTITION_EOF:
+          case RdKafka::ERR_NO_ERROR:
+            if (batch.empty()) {
+              deadline = uv_hrtime() +
+                static_cast<uint64_t>(m_batch_timeout_ms) * 1000000;
+            }
+            batch.push_back(message);
+            break;
+
+          case RdKafka::ERR__TIMED_OUT:
+          case RdKafka::ERR__TIMED_OUT_QUEUE:
+            delete message;
+            timed_out = true;
+            break;
+
+          default:
+            // Unknown error. We need to break out of this
+            SetErrorBaton(b);
+            m_looping = false;
+            break;
+        }
+      } else if (ec == RdKafka::ERR_UNKNOWN_TOPIC_OR_PART ||
+                 ec == RdKafka::ERR_TOPIC_AUTHORIZATION_FAILED) {
+        bus.SendWarning(ec);
+      } else {
+        // Unknown error. We need to break out of this
+        SetErrorBaton(b);
+        m_looping = false;
+      }
+
+      if (timed_out) {
+        break;
+      }
+    }
+
+    // Hand over what we have even when stopping so nothing is leaked
+    if (!batch.empty()) {
+      bus.SendBatch(batch);
+      batch.clear();
+    } else if (timed_out && m_timeout_sleep_delay_ms > 0) {
+      // Nothing was fetched in time, which isn't really an error
+      #ifndef _WIN32
+      usleep(m_timeout_sleep_delay_ms*1000);
+      #else
+      _sleep(m_timeout_sleep_delay_ms);
+      #endif
+    }
+  }
+}
+
+void KafkaConsumerConsumeLoop::HandleMessageBatchCallback(
+    std::vector<RdKafka::Message*>& messages) {
+  if (m_batch_size == 0) {
+    MessageWorker::HandleMessageBatchCallback(messages);
+    return;
+  }
+
+  Nan::HandleScope scope;
+
+  const unsigned int argc = 4;
+  v8::Local<v8::Value> argv[argc];
+
+  v8::Local<v8::Array> returnArray = Nan::New<v8::Array>();
+  v8::Local<v8::Array> eofEventsArray = Nan::New<v8::Array>();
+  Conversion::Message::ToV8Arrays(messages, consumer->ZeroCopy(),
+    returnArray, eofEventsArray);
+
+  argv[0] = Nan::Null();
+  argv[1] = returnArray;
+  argv[2] = eofEventsArray;
+  argv[3] = Nan::Null();
+
+  callback->Call(argc, argv);
+}
+
 void KafkaConsumerConsumeLoop::HandleMessageCallback(RdKafka::Message* msg, RdKafka::ErrorCode ec) {
   Nan::HandleScope scope;
 
@@ -756,20 +935,18 @@ void KafkaConsumerConsumeLoop::HandleMessageCallback(RdKafka::Message* msg, RdKa
     switch (msg->err()) {
       case RdKafka::ERR__PARTITION_EOF: {
         argv[1] = Nan::Null();
-        v8::Local<v8::Object> eofEvent = Nan::New<v8::Object>();
-
-        Nan::Set(eofEvent, Nan::New<v8::String>("topic").ToLocalChecked(),
-          Nan::New<v8::String>(msg->topic_name()).ToLocalChecked());
-        Nan::Set(eofEvent, Nan::New<v8::String>("offset").ToLocalChecked(),
-          Nan::New<v8::Number>(msg->offset()));
-        Nan::Set(eofEvent, Nan::New<v8::String>("partition").ToLocalChecked(),
-          Nan::New<v8::Number>(msg->partition()));
-
-        argv[2] = eofEvent;
+        argv[2] = Conversion::Message::ToV8EofEvent(msg);
         break;
       }
       default:
-        argv[1] = Conversion::Message::ToV8Object(msg);
+        if (consumer->ZeroCopy()) {
+          // Ownership of the message moves to the value buffer
+          argv[1] = Conversion::Message::ToV8Object(msg, true, true,
+            consumer->ZeroCopy());
+          msg = NULL;
+        } else {
+          argv[1] = Conversion::Message::ToV8Object(msg);
+        }
         argv[2] = Nan::Null();
         break;
     }
@@ -810,8 +987,20 @@ KafkaConsumerConsumeNum::KafkaConsumerConsumeNum(Nan::Callback *callback,
                                      const uint32_t & num_messages,
                                      const int & timeout_ms,
                                      bool timeout_only_for_first_message) :
-  ErrorAwareWorker(callback),
+  KafkaConsumerConsumeNum(callback, consumer, std::string(), -1,
+    num_messages, timeout_ms, timeout_only_for_first_message) {}
+
+KafkaConsumerConsumeNum::KafkaConsumerConsumeNum(Nan::Callback *callback,
+                                     KafkaConsumer* consumer,
+                                     const std::string & topic,
+                                     const int32_t & partition,
+                                     const uint32_t & num_messages,
+                                     const int & timeout_ms,
+                                     bool timeout_only_for_first_message) :
+  ErrorAwareWorker(callback, "KafkaConsumerConsumeNum"),
   m_consumer(consumer),
+  m_topic(topic),
+  m_partition(partition),
   m_num_messages(num_messages),
   m_timeout_ms(timeout_ms),
   m_timeout_only_for_first_message(timeout_only_for_first_message) {}
@@ -820,61 +1009,15 @@ KafkaConsumerConsumeNum::~KafkaConsumerConsumeNum() {}
 
 void KafkaConsumerConsumeNum::Execute() {
   std::size_t max = static_cast<std::size_t>(m_num_messages);
-  bool looping = true;
-  int timeout_ms = m_timeout_ms;
-  std::size_t eof_event_count = 0;
-
-  while (m_messages.size() - eof_event_count < max && looping) {
-    // Get a message
-    Baton b = m_consumer->Consume(timeout_ms);
-    if (b.err() == RdKafka::ERR_NO_ERROR) {
-      RdKafka::Message *message = b.data<RdKafka::Message*>();
-      RdKafka::ErrorCode errorCode = message->err();
-      switch (errorCode) {
-        case RdKafka::ERR__PARTITION_EOF:
-          // If partition EOF and have consumed messages, retry with timeout 1
-          // This allows getting ready messages, while not waiting for new ones
-          if (m_messages.size() > eof_event_count) {
-            timeout_ms = 1;
-          }
-
-          // We will only go into this code path when `enable.partition.eof` is set to true
-          // In this case, consumer is also interested in EOF messages, so we return an EOF message
-          m_messages.push_back(message);
-          eof_event_count += 1;
-          break;
-        case RdKafka::ERR__TIMED_OUT:
-        case RdKafka::ERR__TIMED_OUT_QUEUE:
-          // Break of the loop if we timed out
-          delete message;
-          looping = false;
-          break;
-        case RdKafka::ERR_NO_ERROR:
-          m_messages.push_back(b.data<RdKafka::Message*>());
 
-          // This allows getting ready messages, while not waiting for new ones.
-          // This is useful when we want to get the as many messages as possible
-          // within the timeout but not wait if we already have one or more messages.
-          if (m_timeout_only_for_first_message) {
-            timeout_ms = 1;
-          }
-
-          break;
-        default:
-          // Set the error for any other errors and break
-          delete message;
-          if (m_messages.size() == eof_event_count) {
-            SetErrorBaton(Baton(errorCode));
-          }
-          looping = false;
-          break;
-      }
-    } else {
-      if (m_messages.size() == eof_event_count) {
-        SetErrorBaton(b);
-      }
-      looping = false;
-    }
+  Baton b = m_partition < 0 ?
+    m_consumer->ConsumeBatch(m_messages, max, m_timeout_ms,
+                             m_timeout_only_for_first_message, NULL) :
+    m_consumer->ConsumePartitionBatch(m_topic, m_partition, m_messages, max,
+                                      m_timeout_ms,
+                                      m_timeout_only_for_first_message);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    SetErrorBaton(b);
   }
 }
 
@@ -887,42 +1030,8 @@ void KafkaConsumerConsumeNum::HandleOKCallback() {
   v8::Local<v8::Array> returnArray = Nan::New<v8::Array>();
   v8::Local<v8::Array> eofEventsArray = Nan::New<v8::Array>();
 
-  if (m_messages.size() > 0) {
-    int returnArrayIndex = -1;
-    int eofEventsArrayIndex = -1;
-    for (std::vector<RdKafka::Message*>::iterator it = m_messages.begin();
-        it != m_messages.end(); ++it) {
-      RdKafka::Message* message = *it;
-
-      switch (message->err()) {
-        case RdKafka::ERR_NO_ERROR:
-          ++returnArrayIndex;
-          Nan::Set(returnArray, returnArrayIndex, Conversion::Message::ToV8Object(message));
-          break;
-        case RdKafka::ERR__PARTITION_EOF:
-          ++eofEventsArrayIndex;
-
-          // create EOF event
-          v8::Local<v8::Object> eofEvent = Nan::New<v8::Object>();
-
-          Nan::Set(eofEvent, Nan::New<v8::String>("topic").ToLocalChecked(),
-            Nan::New<v8::String>(message->topic_name()).ToLocalChecked());
-          Nan::Set(eofEvent, Nan::New<v8::String>("offset").ToLocalChecked(),
-            Nan::New<v8::Number>(message->offset()));
-          Nan::Set(eofEvent, Nan::New<v8::String>("partition").ToLocalChecked(),
-            Nan::New<v8::Number>(message->partition()));
-
-          // also store index at which position in the message array this event was emitted
-          // this way, we can later emit it at the right point in time
-          Nan::Set(eofEvent, Nan::New<v8::String>("messageIndex").ToLocalChecked(),
-            Nan::New<v8::Number>(returnArrayIndex));
-
-          Nan::Set(eofEventsArray, eofEventsArrayIndex, eofEvent);
-      }
-
-      delete message;
-    }
-  }
+  Conversion::Message::ToV8Arrays(m_messages, m_consumer->ZeroCopy(),
+    returnArray, eofEventsArray);
 
   argv[1] = returnArray;
   argv[2] = eofEventsArray;
@@ -961,7 +1070,7 @@ void KafkaConsumerConsumeNum::HandleErrorCallback() {
 KafkaConsumerConsume::KafkaConsumerConsume(Nan::Callback *callback,
                                      KafkaConsumer* consumer,
                                      const int & timeout_ms) :
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "KafkaConsumerConsume"),
   consumer(consumer),
   m_timeout_ms(timeout_ms) {}
 
@@ -989,9 +1098,15 @@ void KafkaConsumerConsume::HandleOKCallback() {
   v8::Local<v8::Value> argv[argc];
 
   argv[0] = Nan::Null();
-  argv[1] = Conversion::Message::ToV8Object(m_message);
-
-  delete m_message;
+  if (consumer->ZeroCopy()) {
+    // Ownership of the message moves to the value buffer
+    argv[1] = Conversion::Message::ToV8Object(m_message, true, true,
+      consumer->ZeroCopy());
+  } else {
+    argv[1] = Conversion::Message::ToV8Object(m_message);
+    delete m_message;
+  }
+  m_message = NULL;
 
   callback->Call(argc, argv);
 }
@@ -1019,7 +1134,7 @@ KafkaConsumerCommitted::KafkaConsumerCommitted(Nan::Callback *callback,
                                      KafkaConsumer* consumer,
                                      std::vector<RdKafka::TopicPartition*> & t,
                                      const int & timeout_ms) :
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "KafkaConsumerCommitted"),
   m_consumer(consumer),
   m_topic_partitions(t),
   m_timeout_ms(timeout_ms) {}
@@ -1057,6 +1172,52 @@ void KafkaConsumerCommitted::HandleErrorCallback() {
   callback->Call(argc, argv);
 }
 
+/**
+ * @brief KafkaConsumer query lag
+ *
+ * Gets the lag of every assigned partition against end offsets queried from
+ * the partition leaders.
+ *
+ * @see NodeKafka::KafkaConsumer::GetLag
+ */
+
+KafkaConsumerQueryLag::KafkaConsumerQueryLag(Nan::Callback *callback,
+                                             KafkaConsumer* consumer,
+                                             const int & timeout_ms) :
+  ErrorAwareWorker(callback, "KafkaConsumerQueryLag"),
+  m_consumer(consumer),
+  m_timeout_ms(timeout_ms) {}
+
+KafkaConsumerQueryLag::~KafkaConsumerQueryLag() {}
+
+void KafkaConsumerQueryLag::Execute() {
+  Baton b = m_consumer->GetLag(&m_lag, true, m_timeout_ms);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    SetErrorBaton(b);
+  }
+}
+
+void KafkaConsumerQueryLag::HandleOKCallback() {
+  Nan::HandleScope scope;
+
+  const unsigned int argc = 2;
+  v8::Local<v8::Value> argv[argc];
+
+  argv[0] = Nan::Null();
+  argv[1] = m_lag.ToV8Object();
+
+  callback->Call(argc, argv);
+}
+
+void KafkaConsumerQueryLag::HandleErrorCallback() {
+  Nan::HandleScope scope;
+
+  const unsigned int argc = 1;
+  v8::Local<v8::Value> argv[argc] = { GetErrorObject() };
+
+  callback->Call(argc, argv);
+}
+
 /**
  * @brief KafkaConsumer seek
  *
@@ -1073,7 +1234,7 @@ KafkaConsumerSeek::KafkaConsumerSeek(Nan::Callback *callback,
                                      KafkaConsumer* consumer,
                                      const RdKafka::TopicPartition * toppar,
                                      const int & timeout_ms) :
-  ErrorAwareWorker(callback),
+  ErrorAwareWorker(callback, "KafkaConsumerSeek"),
   m_consumer(consumer),
   m_toppar(toppar),
   m_timeout_ms(timeout_ms) {}
@@ -1119,6 +1280,56 @@ void KafkaConsumerSeek::HandleErrorCallback() {
   callback->Call(argc, argv);
 }
 
+/**
+ * @brief KafkaConsumer seek partitions
+ *
+ * Seeks every partition of the list with a single call, the callback gets
+ * the partitions with their errors.
+ *
+ * @see rd_kafka_seek_partitions
+ */
+
+KafkaConsumerSeekPartitions::KafkaConsumerSeekPartitions(
+    Nan::Callback *callback, KafkaConsumer* consumer,
+    rd_kafka_topic_partition_list_t* t, const int & timeout_ms) :
+  ErrorAwareWorker(callback, "KafkaConsumerSeekPartitions"),
+  m_consumer(consumer),
+  m_topic_partitions(t),
+  m_timeout_ms(timeout_ms) {}
+
+KafkaConsumerSeekPartitions::~KafkaConsumerSeekPartitions() {
+  rd_kafka_topic_partition_list_destroy(m_topic_partitions);
+}
+
+void KafkaConsumerSeekPartitions::Execute() {
+  Baton b = m_consumer->SeekPartitions(m_topic_partitions, m_timeout_ms);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    SetErrorBaton(b);
+  }
+}
+
+void KafkaConsumerSeekPartitions::HandleOKCallback() {
+  Nan::HandleScope scope;
+
+  const unsigned int argc = 2;
+  v8::Local<v8::Value> argv[argc];
+
+  argv[0] = Nan::Null();
+  argv[1] = Conversion::TopicPartition::ToTopicPartitionV8Array(
+    m_topic_partitions, true);
+
+  callback->Call(argc, argv);
+}
+
+void KafkaConsumerSeekPartitions::HandleErrorCallback() {
+  Nan::HandleScope scope;
+
+  const unsigned int argc = 1;
+  v8::Local<v8::Value> argv[argc] = { GetErrorObject() };
+
+  callback->Call(argc, argv);
+}
+
 /**
  * @brief createTopic
  *
@@ -1129,7 +1340,7 @@ AdminClientCreateTopic::AdminClientCreateTopic(Nan::Callback *callback,
                                                AdminClient* client,
                                                rd_kafka_NewTopic_t* topic,
                                                const int & timeout_ms) :
-  ErrorAwareWorker(callback),
+  AdminClientWorker(callback, "AdminClientCreateTopic"),
   m_client(client),
   m_topic(topic),
   m_timeout_ms(timeout_ms) {}
@@ -1146,6 +1357,18 @@ void AdminClientCreateTopic::Execute() {
   }
 }
 
+Baton AdminClientCreateTopic::Start(rd_kafka_queue_t* queue) {
+  return m_client->StartCreateTopic(m_topic, m_timeout_ms, queue, this);
+}
+
+void AdminClientCreateTopic::Finish(rd_kafka_event_t* event) {
+  Baton b = AdminClient::CreateTopicResult(event);
+  rd_kafka_event_destroy(event);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    SetErrorBaton(b);
+  }
+}
+
 void AdminClientCreateTopic::HandleOKCallback() {
   Nan::HandleScope scope;
 
@@ -1176,7 +1399,7 @@ AdminClientDeleteTopic::AdminClientDeleteTopic(Nan::Callback *callback,
                                                AdminClient* client,
                                                rd_kafka_DeleteTopic_t* topic,
                                                const int & timeout_ms) :
-  ErrorAwareWorker(callback),
+  AdminClientWorker(callback, "AdminClientDeleteTopic"),
   m_client(client),
   m_topic(topic),
   m_timeout_ms(timeout_ms) {}
@@ -1193,6 +1416,18 @@ void AdminClientDeleteTopic::Execute() {
   }
 }
 
+Baton AdminClientDeleteTopic::Start(rd_kafka_queue_t* queue) {
+  return m_client->StartDeleteTopic(m_topic, m_timeout_ms, queue, this);
+}
+
+void AdminClientDeleteTopic::Finish(rd_kafka_event_t* event) {
+  Baton b = AdminClient::DeleteTopicResult(event);
+  rd_kafka_event_destroy(event);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    SetErrorBaton(b);
+  }
+}
+
 void AdminClientDeleteTopic::HandleOKCallback() {
   Nan::HandleScope scope;
 
@@ -1224,7 +1459,7 @@ AdminClientCreatePartitions::AdminClientCreatePartitions(
                                          AdminClient* client,
                                          rd_kafka_NewPartitions_t* partitions,
                                          const int & timeout_ms) :
-  ErrorAwareWorker(callback),
+  AdminClientWorker(callback, "AdminClientCreatePartitions"),
   m_client(client),
   m_partitions(partitions),
   m_timeout_ms(timeout_ms) {}
@@ -1241,6 +1476,19 @@ void AdminClientCreatePartitions::Execute() {
   }
 }
 
+Baton AdminClientCreatePartitions::Start(rd_kafka_queue_t* queue) {
+  return m_client->StartCreatePartitions(m_partitions, m_timeout_ms, queue,
+                                         this);
+}
+
+void AdminClientCreatePartitions::Finish(rd_kafka_event_t* event) {
+  Baton b = AdminClient::CreatePartitionsResult(event);
+  rd_kafka_event_destroy(event);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    SetErrorBaton(b);
+  }
+}
+
 void AdminClientCreatePartitions::HandleOKCallback() {
   Nan::HandleScope scope;
 
@@ -1271,7 +1519,7 @@ AdminClientListGroups::AdminClientListGroups(
     Nan::Callback* callback, AdminClient* client, bool is_match_states_set,
     std::vector<rd_kafka_consumer_group_state_t>& match_states,
     const int& timeout_ms)
-    : ErrorAwareWorker(callback),
+    : AdminClientWorker(callback, "AdminClientListGroups"),
       m_client(client),
       m_is_match_states_set(is_match_states_set),
       m_match_states(match_states),
@@ -1291,6 +1539,20 @@ void AdminClientListGroups::Execute() {
   }
 }
 
+Baton AdminClientListGroups::Start(rd_kafka_queue_t* queue) {
+  return m_client->StartListGroups(m_is_match_states_set, m_match_states,
+                                   m_timeout_ms, queue, this);
+}
+
+void AdminClientListGroups::Finish(rd_kafka_event_t* event) {
+  // Kept until the worker is destroyed, the callback converts it
+  m_event_response = event;
+  Baton b = AdminClient::ListGroupsResult(event);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    SetErrorBaton(b);
+  }
+}
+
 void AdminClientListGroups::HandleOKCallback() {
   Nan::HandleScope scope;
 
@@ -1326,7 +1588,7 @@ AdminClientDescribeGroups::AdminClientDescribeGroups(
     Nan::Callback* callback, NodeKafka::AdminClient* client,
     std::vector<std::string>& groups, bool include_authorized_operations,
     const int& timeout_ms)
-    : ErrorAwareWorker(callback),
+    : AdminClientWorker(callback, "AdminClientDescribeGroups"),
       m_client(client),
       m_groups(groups),
       m_include_authorized_operations(include_authorized_operations),
@@ -1346,6 +1608,20 @@ void AdminClientDescribeGroups::Execute() {
   }
 }
 
+Baton AdminClientDescribeGroups::Start(rd_kafka_queue_t* queue) {
+  return m_client->StartDescribeGroups(m_groups,
+                                       m_include_authorized_operations,
+                                       m_timeout_ms, queue, this);
+}
+
+void AdminClientDescribeGroups::Finish(rd_kafka_event_t* event) {
+  m_event_response = event;
+  Baton b = AdminClient::DescribeGroupsResult(event);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    SetErrorBaton(b);
+  }
+}
+
 void AdminClientDescribeGroups::HandleOKCallback() {
   Nan::HandleScope scope;
 
@@ -1379,7 +1655,7 @@ AdminClientDeleteGroups::AdminClientDeleteGroups(
     rd_kafka_DeleteGroup_t **group_list,
     size_t group_cnt,
     const int& timeout_ms)
-    : ErrorAwareWorker(callback),
+    : AdminClientWorker(callback, "AdminClientDeleteGroups"),
       m_client(client),
       m_group_list(group_list),
       m_group_cnt(group_cnt),
@@ -1403,6 +1679,19 @@ void AdminClientDeleteGroups::Execute() {
   }
 }
 
+Baton AdminClientDeleteGroups::Start(rd_kafka_queue_t* queue) {
+  return m_client->StartDeleteGroups(m_group_list, m_group_cnt, m_timeout_ms,
+                                     queue, this);
+}
+
+void AdminClientDeleteGroups::Finish(rd_kafka_event_t* event) {
+  m_event_response = event;
+  Baton b = AdminClient::DeleteGroupsResult(event);
+  if (b.err() != RdKafka::ERR_NO_ERROR) {
+    SetErrorBaton(b);
+  }
+}
+
 void AdminClientDeleteGroups::HandleOKCallback() {
   Nan::HandleScope scope;
 
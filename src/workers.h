@@ -13,6 +13,7 @@
 
 #include <uv.h>
 #include <nan.h>
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -27,10 +28,20 @@ namespace Workers {
 
 class ErrorAwareWorker : public Nan::AsyncWorker {
  public:
-  explicit ErrorAwareWorker(Nan::Callback* callback_) :
-    Nan::AsyncWorker(callback_),
-    m_baton(RdKafka::ERR_NO_ERROR) {}
-  virtual ~ErrorAwareWorker() {}
+  /**
+   * @param name - Worker type, used as the async resource name and to keep
+   * track of the jobs in flight
+   */
+  explicit ErrorAwareWorker(Nan::Callback* callback_,
+                            const char* name = "ErrorAwareWorker") :
+    Nan::AsyncWorker(callback_, name),
+    m_baton(RdKafka::ERR_NO_ERROR),
+    m_in_flight(Metrics::WorkerGauge(name)) {
+    m_in_flight->fetch_add(1, std::memory_order_relaxed);
+  }
+  virtual ~ErrorAwareWorker() {
+    m_in_flight->fetch_sub(1, std::memory_order_relaxed);
+  }
 
   virtual void Execute() = 0;
   virtual void HandleOKCallback() = 0;
@@ -70,26 +81,45 @@ class ErrorAwareWorker : public Nan::AsyncWorker {
   }
 
   Baton m_baton;
+
+ private:
+  std::atomic<int64_t>* m_in_flight;
 };
 
 class MessageWorker : public ErrorAwareWorker {
  public:
-  explicit MessageWorker(Nan::Callback* callback_)
-      : ErrorAwareWorker(callback_), m_asyncdata() {
+  explicit MessageWorker(Nan::Callback* callback_,
+                         const char* name = "MessageWorker")
+      : ErrorAwareWorker(callback_, name), m_asyncdata(),
+        m_asyncdata_bytes(0), m_max_pending(0) {
     m_async = new uv_async_t;
     uv_async_init(
-      uv_default_loop(),
+      Nan::GetCurrentEventLoop(),
       m_async,
       m_async_message);
     m_async->data = this;
 
     uv_mutex_init(&m_async_lock);
+    uv_cond_init(&m_async_room);
   }
 
   virtual ~MessageWorker() {
+    // Messages that never reached the main thread
+    Forget(m_asyncdata.size(), m_asyncdata_bytes);
+
+    uv_cond_destroy(&m_async_room);
     uv_mutex_destroy(&m_async_lock);
   }
 
+  /**
+   * Limit the messages waiting for the main thread. Producers of messages
+   * are expected to call WaitForRoom before producing more, 0 disables it.
+   * Must be set before the worker starts producing.
+   */
+  void SetMaxPending(size_t max_pending) {
+    m_max_pending = max_pending;
+  }
+
   void WorkMessage() {
     if (!callback) {
       return;
@@ -103,14 +133,13 @@ class MessageWorker : public ErrorAwareWorker {
       // Copy the vector and empty it
       m_asyncdata.swap(message_queue);
       m_asyncwarning.swap(warning_queue);
+      Forget(message_queue.size(), m_asyncdata_bytes);
+      m_asyncdata_bytes = 0;
+      uv_cond_broadcast(&m_async_room);
     }
 
-    for (unsigned int i = 0; i < message_queue.size(); i++) {
-      HandleMessageCallback(message_queue[i], RdKafka::ERR_NO_ERROR);
-
-      // we are done with it. it is about to go out of scope
-      // for the last time so let's just free it up here. can't rely
-      // on the destructor
+    if (!message_queue.empty()) {
+      HandleMessageBatchCallback(message_queue);
     }
 
     for (unsigned int i = 0; i < warning_queue.size(); i++) {
@@ -124,9 +153,20 @@ class MessageWorker : public ErrorAwareWorker {
      void Send(RdKafka::Message* m) const {
        that_->Produce_(m);
      }
+     void SendBatch(const std::vector<RdKafka::Message*>& m) const {
+       that_->ProduceBatch_(m);
+     }
      void SendWarning(RdKafka::ErrorCode c) const {
        that_->ProduceWarning_(c);
      }
+     /**
+      * Wait until fewer messages than the limit wait for the main thread,
+      * or until timeout_ms passed. Returns whether there is room, callers
+      * check whether they should stop and then wait again if not.
+      */
+     bool WaitForRoom(int timeout_ms) const {
+       return that_->WaitForRoom_(timeout_ms);
+     }
     explicit ExecutionMessageBus(MessageWorker* that) : that_(that) {}
    private:
     MessageWorker* const that_;
@@ -135,6 +175,19 @@ class MessageWorker : public ErrorAwareWorker {
   virtual void Execute(const ExecutionMessageBus&) = 0;
   virtual void HandleMessageCallback(RdKafka::Message*, RdKafka::ErrorCode) = 0;
 
+  /**
+   * @brief Handle every message queued since the last wake-up.
+   *
+   * Hands the messages to HandleMessageCallback one at a time unless a worker
+   * wants to deliver them together.
+   */
+  virtual void HandleMessageBatchCallback(
+      std::vector<RdKafka::Message*>& messages) {
+    for (unsigned int i = 0; i < messages.size(); i++) {
+      HandleMessageCallback(messages[i], RdKafka::ERR_NO_ERROR);
+    }
+  }
+
   virtual void Destroy() {
     uv_close(reinterpret_cast<uv_handle_t*>(m_async), AsyncClose_);
   }
@@ -148,9 +201,44 @@ class MessageWorker : public ErrorAwareWorker {
   void Produce_(RdKafka::Message* m) {
     scoped_mutex_lock lock(m_async_lock);
     m_asyncdata.push_back(m);
+    Remember(m);
     uv_async_send(m_async);
   }
 
+  void ProduceBatch_(const std::vector<RdKafka::Message*>& m) {
+    scoped_mutex_lock lock(m_async_lock);
+    m_asyncdata.insert(m_asyncdata.end(), m.begin(), m.end());
+    for (size_t i = 0; i < m.size(); i++) {
+      Remember(m[i]);
+    }
+    uv_async_send(m_async);
+  }
+
+  bool WaitForRoom_(int timeout_ms) {
+    scoped_mutex_lock lock(m_async_lock);
+    if (m_max_pending == 0 || m_asyncdata.size() < m_max_pending) {
+      return true;
+    }
+    uv_cond_timedwait(&m_async_room, &m_async_lock,
+      static_cast<uint64_t>(timeout_ms) * 1000000);
+    return m_asyncdata.size() < m_max_pending;
+  }
+
+  // Account for a message in the backlog gauges, with m_async_lock held
+  void Remember(RdKafka::Message* m) {
+    m_asyncdata_bytes += m->len();
+    Metrics::consume_backlog_messages.fetch_add(1, std::memory_order_relaxed);
+    Metrics::consume_backlog_bytes.fetch_add(m->len(),
+      std::memory_order_relaxed);
+  }
+
+  static void Forget(size_t messages, size_t bytes) {
+    Metrics::consume_backlog_messages.fetch_sub(messages,
+      std::memory_order_relaxed);
+    Metrics::consume_backlog_bytes.fetch_sub(bytes,
+      std::memory_order_relaxed);
+  }
+
   void ProduceWarning_(RdKafka::ErrorCode c) {
     scoped_mutex_lock lock(m_async_lock);
     m_asyncwarning.push_back(c);
@@ -170,8 +258,12 @@ class MessageWorker : public ErrorAwareWorker {
 
   uv_async_t *m_async;
   uv_mutex_t m_async_lock;
+  // Signalled when the main thread took the queued messages
+  uv_cond_t m_async_room;
   std::vector<RdKafka::Message*> m_asyncdata;
+  size_t m_asyncdata_bytes;
   std::vector<RdKafka::ErrorCode> m_asyncwarning;
+  size_t m_max_pending;
 };
 
 namespace Handle {
@@ -212,6 +304,22 @@ class ConnectionMetadata : public ErrorAwareWorker {
   RdKafka::Metadata* m_metadata;
 };
 
+class ConnectionRefreshMetadataCache : public ErrorAwareWorker {
+ public:
+  ConnectionRefreshMetadataCache(Nan::Callback*, NodeKafka::Connection*, int);
+  ~ConnectionRefreshMetadataCache();
+
+  void Execute();
+  void HandleOKCallback();
+  void HandleErrorCallback();
+
+ private:
+  NodeKafka::Connection * m_connection;
+  int m_timeout_ms;
+
+  std::vector<MetadataCache::Change> m_changes;
+};
+
 class ConnectionQueryWatermarkOffsets : public ErrorAwareWorker {
  public:
   ConnectionQueryWatermarkOffsets(Nan::Callback*, NodeKafka::Connection*,
@@ -376,6 +484,9 @@ class KafkaConsumerConsumeLoop : public MessageWorker {
  public:
   KafkaConsumerConsumeLoop(Nan::Callback*,
     NodeKafka::KafkaConsumer*, const int &, const int &);
+  KafkaConsumerConsumeLoop(Nan::Callback*,
+    NodeKafka::KafkaConsumer*, const int &, const int &,
+    const unsigned int &, const int &);
   ~KafkaConsumerConsumeLoop();
 
   static void ConsumeLoop(void *arg);
@@ -384,12 +495,18 @@ class KafkaConsumerConsumeLoop : public MessageWorker {
   void HandleOKCallback();
   void HandleErrorCallback();
   void HandleMessageCallback(RdKafka::Message*, RdKafka::ErrorCode);
+  void HandleMessageBatchCallback(std::vector<RdKafka::Message*>&);
  private:
+  void ConsumeBatch(const ExecutionMessageBus&);
+
   uv_thread_t thread_event_loop;
   NodeKafka::KafkaConsumer* consumer;
   const int m_timeout_ms;
   unsigned int m_rand_seed;
   const int m_timeout_sleep_delay_ms;
+  // 0 delivers every message on its own
+  const unsigned int m_batch_size;
+  const int m_batch_timeout_ms;
   bool m_looping;
 };
 
@@ -423,6 +540,36 @@ class KafkaConsumerCommitted : public ErrorAwareWorker {
   const int m_timeout_ms;
 };
 
+class KafkaConsumerQueryLag : public ErrorAwareWorker {
+ public:
+  KafkaConsumerQueryLag(Nan::Callback*, NodeKafka::KafkaConsumer*,
+    const int &);
+  ~KafkaConsumerQueryLag();
+
+  void Execute();
+  void HandleOKCallback();
+  void HandleErrorCallback();
+ private:
+  NodeKafka::KafkaConsumer * m_consumer;
+  NodeKafka::ConsumerLag m_lag;
+  const int m_timeout_ms;
+};
+
+class KafkaConsumerSeekPartitions : public ErrorAwareWorker {
+ public:
+  KafkaConsumerSeekPartitions(Nan::Callback*, NodeKafka::KafkaConsumer*,
+    rd_kafka_topic_partition_list_t*, const int &);
+  ~KafkaConsumerSeekPartitions();
+
+  void Execute();
+  void HandleOKCallback();
+  void HandleErrorCallback();
+ private:
+  NodeKafka::KafkaConsumer * m_consumer;
+  rd_kafka_topic_partition_list_t* m_topic_partitions;
+  const int m_timeout_ms;
+};
+
 class KafkaConsumerSeek : public ErrorAwareWorker {
  public:
   KafkaConsumerSeek(Nan::Callback*, NodeKafka::KafkaConsumer*,
@@ -442,6 +589,8 @@ class KafkaConsumerConsumeNum : public ErrorAwareWorker {
  public:
   KafkaConsumerConsumeNum(Nan::Callback*, NodeKafka::KafkaConsumer*,
     const uint32_t &, const int &, bool);
+  KafkaConsumerConsumeNum(Nan::Callback*, NodeKafka::KafkaConsumer*,
+    const std::string &, const int32_t &, const uint32_t &, const int &, bool);
   ~KafkaConsumerConsumeNum();
 
   void Execute();
@@ -449,6 +598,9 @@ class KafkaConsumerConsumeNum : public ErrorAwareWorker {
   void HandleErrorCallback();
  private:
   NodeKafka::KafkaConsumer * m_consumer;
+  // Partition queue to read from, or the consumer queue if m_partition < 0
+  const std::string m_topic;
+  const int32_t m_partition;
   const uint32_t m_num_messages;
   const int m_timeout_ms;
   const bool m_timeout_only_for_first_message;
@@ -458,13 +610,46 @@ class KafkaConsumerConsumeNum : public ErrorAwareWorker {
 /**
  * @brief Create a kafka topic on a remote broker cluster
  */
-class AdminClientCreateTopic : public ErrorAwareWorker {
+/**
+ * @brief Base of the admin workers.
+ *
+ * Besides running on the thread pool, an admin worker can be completed
+ * through the admin client's shared result queue: the request is started on
+ * the main thread, its result is handed over by the dispatcher thread and
+ * the callbacks then run on the main thread, so no thread pool thread is
+ * held while waiting for the cluster.
+ */
+class AdminClientWorker : public ErrorAwareWorker {
+ public:
+  AdminClientWorker(Nan::Callback* callback_, const char* name) :
+    ErrorAwareWorker(callback_, name) {}
+  virtual ~AdminClientWorker() {}
+
+  // Issue the request on queue, with this worker as the opaque
+  virtual Baton Start(rd_kafka_queue_t* queue) = 0;
+  // Take the result of the request. Runs on the dispatcher thread.
+  virtual void Finish(rd_kafka_event_t* event) = 0;
+
+  void Fail(const Baton& baton) {
+    SetErrorBaton(baton);
+  }
+
+  // Run the callbacks and delete the worker, on the main thread
+  void Complete() {
+    WorkComplete();
+    Destroy();
+  }
+};
+
+class AdminClientCreateTopic : public AdminClientWorker {
  public:
   AdminClientCreateTopic(Nan::Callback*, NodeKafka::AdminClient*,
     rd_kafka_NewTopic_t*, const int &);
   ~AdminClientCreateTopic();
 
   void Execute();
+  Baton Start(rd_kafka_queue_t*);
+  void Finish(rd_kafka_event_t*);
   void HandleOKCallback();
   void HandleErrorCallback();
  private:
@@ -476,13 +661,15 @@ class AdminClientCreateTopic : public ErrorAwareWorker {
 /**
  * @brief Delete a kafka topic on a remote broker cluster
  */
-class AdminClientDeleteTopic : public ErrorAwareWorker {
+class AdminClientDeleteTopic : public AdminClientWorker {
  public:
   AdminClientDeleteTopic(Nan::Callback*, NodeKafka::AdminClient*,
     rd_kafka_DeleteTopic_t*, const int &);
   ~AdminClientDeleteTopic();
 
   void Execute();
+  Baton Start(rd_kafka_queue_t*);
+  void Finish(rd_kafka_event_t*);
   void HandleOKCallback();
   void HandleErrorCallback();
  private:
@@ -494,13 +681,15 @@ class AdminClientDeleteTopic : public ErrorAwareWorker {
 /**
  * @brief Delete a kafka topic on a remote broker cluster
  */
-class AdminClientCreatePartitions : public ErrorAwareWorker {
+class AdminClientCreatePartitions : public AdminClientWorker {
  public:
   AdminClientCreatePartitions(Nan::Callback*, NodeKafka::AdminClient*,
     rd_kafka_NewPartitions_t*, const int &);
   ~AdminClientCreatePartitions();
 
   void Execute();
+  Baton Start(rd_kafka_queue_t*);
+  void Finish(rd_kafka_event_t*);
   void HandleOKCallback();
   void HandleErrorCallback();
  private:
@@ -512,7 +701,7 @@ class AdminClientCreatePartitions : public ErrorAwareWorker {
 /**
  * @brief List consumer groups on a remote broker cluster.
  */
-class AdminClientListGroups : public ErrorAwareWorker {
+class AdminClientListGroups : public AdminClientWorker {
  public:
   AdminClientListGroups(Nan::Callback *, NodeKafka::AdminClient *, bool,
                         std::vector<rd_kafka_consumer_group_state_t> &,
@@ -520,6 +709,8 @@ class AdminClientListGroups : public ErrorAwareWorker {
   ~AdminClientListGroups();
 
   void Execute();
+  Baton Start(rd_kafka_queue_t*);
+  void Finish(rd_kafka_event_t*);
   void HandleOKCallback();
   void HandleErrorCallback();
 
@@ -528,19 +719,21 @@ class AdminClientListGroups : public ErrorAwareWorker {
   const bool m_is_match_states_set;
   std::vector<rd_kafka_consumer_group_state_t> m_match_states;
   const int m_timeout_ms;
-  rd_kafka_event_t *m_event_response;
+  rd_kafka_event_t *m_event_response = NULL;
 };
 
 /**
  * @brief Describe consumer groups on a remote broker cluster.
  */
-class AdminClientDescribeGroups : public ErrorAwareWorker {
+class AdminClientDescribeGroups : public AdminClientWorker {
  public:
   AdminClientDescribeGroups(Nan::Callback *, NodeKafka::AdminClient *,
                             std::vector<std::string> &, bool, const int &);
   ~AdminClientDescribeGroups();
 
   void Execute();
+  Baton Start(rd_kafka_queue_t*);
+  void Finish(rd_kafka_event_t*);
   void HandleOKCallback();
   void HandleErrorCallback();
 
@@ -549,19 +742,21 @@ class AdminClientDescribeGroups : public ErrorAwareWorker {
   std::vector<std::string> m_groups;
   const bool m_include_authorized_operations;
   const int m_timeout_ms;
-  rd_kafka_event_t *m_event_response;
+  rd_kafka_event_t *m_event_response = NULL;
 };
 
 /**
  * @brief Delete consumer groups on a remote broker cluster.
  */
-class AdminClientDeleteGroups : public ErrorAwareWorker {
+class AdminClientDeleteGroups : public AdminClientWorker {
  public:
   AdminClientDeleteGroups(Nan::Callback *, NodeKafka::AdminClient *,
                             rd_kafka_DeleteGroup_t **, size_t, const int &);
   ~AdminClientDeleteGroups();
 
   void Execute();
+  Baton Start(rd_kafka_queue_t*);
+  void Finish(rd_kafka_event_t*);
   void HandleOKCallback();
   void HandleErrorCallback();
 
@@ -570,7 +765,7 @@ class AdminClientDeleteGroups : public ErrorAwareWorker {
   rd_kafka_DeleteGroup_t **m_group_list;
   size_t m_group_cnt;
   const int m_timeout_ms;
-  rd_kafka_event_t *m_event_response;
+  rd_kafka_event_t *m_event_response = NULL;
 };
 
 }  // namespace Workers
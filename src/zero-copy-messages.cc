@@ -0,0 +1,101 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#include "src/zero-copy-messages.h"
+
+namespace NodeKafka {
+
+ZeroCopyMessages::ZeroCopyMessages():
+  m_open(true) {}
+
+ZeroCopyMessages::~ZeroCopyMessages() {
+  Release();
+}
+
+Nan::MaybeLocal<v8::Object> ZeroCopyMessages::NewBuffer(
+    RdKafka::Message* message) {
+  if (!m_open) {
+    return Nan::MaybeLocal<v8::Object>();
+  }
+
+  Entry* entry = new Entry();
+  entry->owner = this;
+  entry->message = message;
+
+  Nan::MaybeLocal<v8::Object> buffer = Nan::NewBuffer(
+    static_cast<char*>(message->payload()), message->len(), Free, entry);
+  if (buffer.IsEmpty()) {
+    // The free callback is not run when the buffer cannot be created
+    delete entry;
+    return buffer;
+  }
+
+  entry->buffer.Reset(v8::Isolate::GetCurrent(),
+    buffer.ToLocalChecked().As<v8::Uint8Array>()->Buffer());
+  entry->buffer.SetWeak();
+  m_entries.insert(entry);
+
+  return buffer;
+}
+
+void ZeroCopyMessages::Release() {
+  m_open = false;
+
+  if (m_entries.empty()) {
+    return;
+  }
+
+  // Detaching may run the free callback of a buffer right away
+  std::set<Entry*> entries;
+  entries.swap(m_entries);
+
+  Nan::HandleScope scope;
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  for (std::set<Entry*>::iterator it = entries.begin();
+       it != entries.end(); ++it) {
+    Entry* entry = *it;
+    entry->owner = NULL;
+
+    if (entry->buffer.IsEmpty()) {
+      // Collected, only the free callback has yet to run
+      delete entry->message;
+      entry->message = NULL;
+      continue;
+    }
+
+    v8::Local<v8::ArrayBuffer> buffer = entry->buffer.Get(isolate);
+    entry->buffer.Reset();
+    if (!buffer->IsDetachable()) {
+      // Never the case for buffers over external memory; the message has
+      // to stay with the buffer
+      continue;
+    }
+
+    delete entry->message;
+    entry->message = NULL;
+    // The entry may be gone after this
+    buffer->Detach();
+  }
+}
+
+void ZeroCopyMessages::Open() {
+  m_open = true;
+}
+
+void ZeroCopyMessages::Free(char* data, void* hint) {
+  Entry* entry = static_cast<Entry*>(hint);
+  if (entry->owner) {
+    entry->owner->m_entries.erase(entry);
+  }
+  delete entry->message;
+  delete entry;
+}
+
+}  // namespace NodeKafka
@@ -0,0 +1,70 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+#ifndef SRC_ZERO_COPY_MESSAGES_H_
+#define SRC_ZERO_COPY_MESSAGES_H_
+
+#include <nan.h>
+
+#include <set>
+
+#include "rdkafkacpp.h"
+
+namespace NodeKafka {
+
+/**
+ * @brief The consumed messages whose value buffers point straight into them.
+ *
+ * A buffer keeps its message alive until it is garbage collected, which may
+ * well be after its consumer disconnected. The handle cannot be destroyed
+ * while any of its messages is, so Release empties the buffers still alive
+ * and deletes their messages before a disconnect.
+ *
+ * Only used on the main thread, which is also where Node runs the free
+ * callbacks of buffers.
+ */
+class ZeroCopyMessages {
+ public:
+  ZeroCopyMessages();
+  ~ZeroCopyMessages();
+
+  /**
+   * Create a buffer for the payload of the message, which owns the message
+   * from then on.
+   *
+   * @returns An empty handle when the messages were released or the buffer
+   * could not be created, in which case the message is still the caller's.
+   */
+  Nan::MaybeLocal<v8::Object> NewBuffer(RdKafka::Message*);
+
+  /**
+   * Detach every buffer still alive, which leaves it empty, and delete its
+   * message. No more buffers are created until Open.
+   */
+  void Release();
+  void Open();
+
+ private:
+  struct Entry {
+    ZeroCopyMessages* owner;
+    RdKafka::Message* message;
+    // Weak, it does not keep the buffer from being collected
+    v8::Global<v8::ArrayBuffer> buffer;
+  };
+
+  static void Free(char*, void*);
+
+  bool m_open;
+  std::set<Entry*> m_entries;
+};
+
+}  // namespace NodeKafka
+
+#endif  // SRC_ZERO_COPY_MESSAGES_H_
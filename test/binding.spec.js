@@ -40,6 +40,49 @@ module.exports = {
     'exports version': function() {
       t.ok(addon.librdkafkaVersion);
     },
+    'exports setWorkerPoolSize': function() {
+      t.equal(typeof(addon.setWorkerPoolSize), 'function');
+      t.throws(function() { addon.setWorkerPoolSize('4'); });
+      addon.setWorkerPoolSize(4);
+    },
+    'loads in several worker threads': function(cb) {
+      var Worker = require('worker_threads').Worker;
+      var path = require('bindings')({
+        bindings: 'confluent-kafka-javascript',
+        path: true
+      });
+      var source = [
+        'var wt = require("worker_threads");',
+        'var addon = require(wt.workerData.path);',
+        'var producer = new addon.Producer(wt.workerData.producerConfig, {});',
+        'var consumer = new addon.KafkaConsumer(wt.workerData.consumerConfig, {});',
+        'wt.parentPort.postMessage(typeof(producer.produce) + typeof(consumer.consume));'
+      ].join('\n');
+
+      var exited = 0;
+      for (var i = 0; i < 2; i++) {
+        var worker = new Worker(source, {
+          eval: true,
+          workerData: {
+            path: path,
+            producerConfig: producerConfig,
+            consumerConfig: consumerConfig
+          }
+        });
+        worker.on('message', function(m) {
+          t.equal(m, 'functionfunction');
+        });
+        worker.on('error', cb);
+        worker.on('exit', function(code) {
+          t.equal(code, 0);
+          if (++exited === 2) {
+            // Still usable on the main thread once the workers are gone
+            t.equal(typeof(new addon.Producer(producerConfig, {})), 'object');
+            cb();
+          }
+        });
+      }
+    },
     'Producer client': {
       'beforeEach': function() {
         client = new addon.Producer(producerConfig, {});
@@ -56,10 +99,35 @@ module.exports = {
         });
       },
       'has necessary methods from superclass': function() {
-        var methods = ['connect', 'disconnect', 'configureCallbacks', 'getMetadata'];
+        var methods = ['connect', 'disconnect', 'configureCallbacks', 'getMetadata', 'setStatsFields', 'getNativeMetrics',
+          'setLatencyHistograms', 'getLatencyHistograms', 'resetLatencyHistograms'];
         methods.forEach(function(m) {
           t.equal(typeof(client[m]), 'function', 'Client is missing ' + m + ' method');
         });
+      },
+      'has produce methods': function() {
+        var methods = ['produce', 'produceBatch', 'setPollInBackground', 'setSharedHandle'];
+        methods.forEach(function(m) {
+          t.equal(typeof(client[m]), 'function', 'Client is missing ' + m + ' method');
+        });
+      },
+      'reports native metrics': function() {
+        var metrics = client.getNativeMetrics();
+        t.equal(metrics.dispatchers.event.wakeups, 0);
+        t.equal(metrics.dispatchers.deliveryReport.depth, 0);
+        t.equal(typeof(metrics.messagesConverted), 'number');
+        t.equal(typeof(metrics.connectionLock.waitNs), 'number');
+        t.equal(typeof(metrics.workersInFlight), 'object');
+        t.equal(typeof(metrics.workerPool.size), 'number');
+        t.equal(metrics.workerPool.queued, 0);
+      },
+      'has no latency histograms before anything is delivered': function() {
+        client.setLatencyHistograms(true);
+        t.deepStrictEqual(client.getLatencyHistograms(), {});
+        client.resetLatencyHistograms();
+        t.throws(function() {
+          client.setLatencyHistograms();
+        });
       }
     }
   },
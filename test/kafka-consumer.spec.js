@@ -44,5 +44,197 @@ module.exports = {
       t.deepStrictEqual(client.topicConfig, {});
       t.notEqual(topicConfig, client.topicConfig);
     },
+    'zero_copy_consume is not passed to librdkafka': function () {
+      var zeroCopyClient = new KafkaConsumer({
+        'client.id': 'kafka-mocha',
+        'group.id': 'kafka-mocha-grp',
+        'metadata.broker.list': 'localhost:9092',
+        'zero_copy_consume': true
+      }, topicConfig);
+      t.equal(zeroCopyClient.globalConfig.zero_copy_consume, undefined);
+    },
+    'stats_fields is not passed to librdkafka': function () {
+      var statsClient = new KafkaConsumer({
+        'client.id': 'kafka-mocha',
+        'group.id': 'kafka-mocha-grp',
+        'metadata.broker.list': 'localhost:9092',
+        'statistics.interval.ms': 1000,
+        'stats_fields': 'rtt, consumer_lag'
+      }, topicConfig);
+      t.equal(statsClient.globalConfig.stats_fields, undefined);
+    },
+    'latency_histograms is not passed to librdkafka': function () {
+      var histogramClient = new KafkaConsumer({
+        'client.id': 'kafka-mocha',
+        'group.id': 'kafka-mocha-grp',
+        'metadata.broker.list': 'localhost:9092',
+        'latency_histograms': true
+      }, topicConfig);
+      t.equal(histogramClient.globalConfig.latency_histograms, undefined);
+    },
+    'batched consume loop emits messages and eof events in order': function () {
+      var events = [];
+      client.setDefaultConsumeLoopBatch(100, 10);
+      client._client = {
+        consumeLoop: function(timeoutMs, retryReadInterval, size, batchTimeoutMs, cb) {
+          t.equal(size, 100);
+          t.equal(batchTimeoutMs, 10);
+          cb(null, [{ offset: 1 }, { offset: 2 }],
+            [{ partition: 0, messageIndex: 0 }], null);
+        }
+      };
+      client.on('data', function(message) {
+        events.push('data ' + message.offset);
+      });
+      client.on('partition.eof', function(eof) {
+        t.equal(eof.messageIndex, undefined);
+        events.push('eof ' + eof.partition);
+      });
+      client._consumeLoop(1000, function(err, message) {
+        t.ifError(err);
+        events.push('cb ' + message.offset);
+      });
+      t.deepStrictEqual(events,
+        ['data 1', 'cb 1', 'eof 0', 'data 2', 'cb 2']);
+    },
+    'event_driven_consume is not passed to librdkafka': function () {
+      var eventClient = new KafkaConsumer({
+        'client.id': 'kafka-mocha',
+        'group.id': 'kafka-mocha-grp',
+        'metadata.broker.list': 'localhost:9092',
+        'event_driven_consume': true
+      }, topicConfig);
+      t.equal(eventClient.globalConfig.event_driven_consume, undefined);
+    },
+    'event driven consume loop reads batches on queue events': function () {
+      var sizes = [];
+      var events = [];
+      var eventClient = new KafkaConsumer({
+        'client.id': 'kafka-mocha',
+        'group.id': 'kafka-mocha-grp',
+        'metadata.broker.list': 'localhost:9092',
+        'event_driven_consume': true
+      }, topicConfig);
+      eventClient._client = {
+        consumeOnEvents: function(size, cb) {
+          sizes.push(size);
+          cb(null, [{ offset: 1 }], [], null);
+          cb(null, null, null, 3);
+        }
+      };
+      eventClient.on('data', function(message) {
+        events.push('data ' + message.offset);
+      });
+      eventClient.on('warning', function(warning) {
+        events.push('warning ' + warning.code);
+      });
+      eventClient._consumeLoop(1000, function(err, message) {
+        t.ifError(err);
+        events.push('cb ' + message.offset);
+      });
+      t.deepStrictEqual(events, ['data 1', 'cb 1', 'warning 3']);
+
+      eventClient.setDefaultConsumeLoopBatch(100, 10);
+      eventClient._client.consumeOnEvents = function(size) {
+        sizes.push(size);
+      };
+      eventClient._consumeLoop(1000, function() {});
+      t.deepStrictEqual(sizes, [1000, 100]);
+    },
+    'consumePartition reads from the given partition queue': function () {
+      var emitted = [];
+      client._client = {
+        consumePartition: function(topic, partition, timeoutMs, number, timeoutOnlyForFirst, cb) {
+          t.equal(topic, 'topic');
+          t.equal(partition, 3);
+          t.equal(number, 10);
+          cb(null, [{ partition: 3, offset: 7 }], []);
+        }
+      };
+      client.on('data', function(message) {
+        emitted.push(message.offset);
+      });
+      client.consumePartition('topic', 3, 10, function(err, messages) {
+        t.ifError(err);
+        t.equal(messages.length, 1);
+      });
+      t.deepStrictEqual(emitted, [7]);
+    },
+    'offset_tracking is not passed to librdkafka': function () {
+      var trackingClient = new KafkaConsumer({
+        'client.id': 'kafka-mocha',
+        'group.id': 'kafka-mocha-grp',
+        'metadata.broker.list': 'localhost:9092',
+        'enable.auto.offset.store': false,
+        'offset_tracking': true,
+        'offset_tracking_interval_ms': 100
+      }, topicConfig);
+      t.equal(trackingClient.globalConfig.offset_tracking, undefined);
+      t.equal(trackingClient.globalConfig.offset_tracking_interval_ms, undefined);
+    },
+    'resolveOffset passes the message offset': function () {
+      var resolved = [];
+      client.isConnected = function() { return true; };
+      client._client = {
+        resolveOffset: function(topic, partition, offset) {
+          resolved.push([topic, partition, offset]);
+          return 0;
+        }
+      };
+      client.resolveOffset({ topic: 'topic', partition: 1, offset: '41' });
+      t.deepStrictEqual(resolved, [['topic', 1, 41]]);
+    },
+    'getLag throws the error code of the binding': function () {
+      client.isConnected = function() { return true; };
+      client._client = {
+        getLag: function() {
+          return -172;
+        }
+      };
+      t.throws(function() {
+        client.getLag();
+      }, function(e) {
+        return e.code === -172;
+      });
+    },
+    'seekPartitions wraps the errors of partitions': function () {
+      client._client = {
+        seekPartitions: function(toppars, timeout, cb) {
+          t.equal(toppars.length, 2);
+          t.equal(timeout, 500);
+          cb(null, [
+            { topic: 'topic', partition: 0, offset: 5 },
+            { topic: 'topic', partition: 1, offset: 5,
+              error: { message: 'Local: Erroneous state', code: -172 } }
+          ]);
+        }
+      };
+      client.seekPartitions([
+        { topic: 'topic', partition: 0, offset: 5 },
+        { topic: 'topic', partition: 1, offset: 5 }
+      ], 500, function(err, partitions) {
+        t.ifError(err);
+        t.equal(partitions[0].error, undefined);
+        t.equal(partitions[1].error.code, -172);
+        t.equal(partitions[1].error.origin, 'local');
+      });
+    },
+    'queryLag passes the timeout and the lag': function () {
+      var lag = { topics: ['topic'], lag: new Float64Array([3]) };
+      var timeouts = [];
+      client.isConnected = function() { return true; };
+      client._client = {
+        queryLag: function(timeout, cb) {
+          timeouts.push(timeout);
+          cb(null, lag);
+        }
+      };
+      client.queryLag(function(err, result) {
+        t.ifError(err);
+        t.equal(result, lag);
+      });
+      client.queryLag(250, function() {});
+      t.deepStrictEqual(timeouts, [1000, 250]);
+    },
   },
 };
@@ -64,6 +64,91 @@ module.exports = {
       t.deepStrictEqual(client.topicConfig, {});
       t.notEqual(topicConfig, client.topicConfig);
     },
+    'zero_copy_produce is not passed to librdkafka': function () {
+      var zeroCopyClient = new Producer({
+        'client.id': 'kafka-mocha',
+        'metadata.broker.list': 'localhost:9092',
+        'zero_copy_produce': true
+      }, topicConfig);
+      t.equal(zeroCopyClient.globalConfig.zero_copy_produce, undefined);
+      t.equal(typeof(zeroCopyClient._cb_configs.event.delivery_cb), 'function');
+      t.equal(zeroCopyClient._cb_configs.event.delivery_cb.zero_copy, true);
+    },
+    'splits delivery report batches for delivery-report listeners': function () {
+      var batchClient = new Producer({
+        'client.id': 'kafka-mocha',
+        'metadata.broker.list': 'localhost:9092',
+        'dr_batch_size': 10
+      }, topicConfig);
+      t.equal(batchClient.globalConfig.dr_batch_size, undefined);
+      t.equal(batchClient._cb_configs.event.delivery_cb.dr_batch_size, 10);
+
+      var batches = 0;
+      var reports = [];
+      batchClient.on('delivery-report-batch', function() {
+        batches++;
+      });
+      batchClient.on('delivery-report', function(err, report) {
+        reports.push({ err: err, report: report });
+      });
+
+      batchClient._cb_configs.event.delivery_cb(null, {
+        topic: ['topic', 'topic'],
+        partition: new Int32Array([0, 1]),
+        offset: new Float64Array([10, -1]),
+        error: new Int32Array([0, -192]),
+        timestamp: new Float64Array([-1, 5]),
+        opaque: [undefined, 'opaque'],
+      });
+
+      t.equal(batches, 1);
+      t.equal(reports.length, 2);
+      t.equal(reports[0].err, null);
+      t.equal(reports[0].report.offset, 10);
+      t.equal(reports[0].report.timestamp, undefined);
+      t.equal(reports[1].err.code, -192);
+      t.equal(reports[1].report.partition, 1);
+      t.equal(reports[1].report.opaque, 'opaque');
+      t.equal(reports[1].report.timestamp, 5);
+    },
+    'dr_backlog_max is passed with the delivery callback and emits drain': function () {
+      var backlogClient = new Producer({
+        'client.id': 'kafka-mocha',
+        'metadata.broker.list': 'localhost:9092',
+        'dr_cb': true,
+        'dr_backlog_max': 1000,
+        'dr_backlog_max_bytes': 1048576
+      }, topicConfig);
+      t.equal(backlogClient.globalConfig.dr_backlog_max, undefined);
+      t.equal(backlogClient.globalConfig.dr_backlog_max_bytes, undefined);
+      t.equal(backlogClient._cb_configs.event.delivery_cb.dr_backlog_max, 1000);
+      t.equal(backlogClient._cb_configs.event.delivery_cb.dr_backlog_max_bytes, 1048576);
+
+      var drains = 0;
+      backlogClient.on('drain', function() {
+        drains++;
+      });
+      backlogClient._cb_configs.event.drain_cb();
+      t.equal(drains, 1);
+    },
+    'dr_opaque_ids is passed with the delivery callback': function () {
+      var idClient = new Producer({
+        'client.id': 'kafka-mocha',
+        'metadata.broker.list': 'localhost:9092',
+        'dr_cb': true,
+        'dr_opaque_ids': true
+      }, topicConfig);
+      t.equal(idClient.globalConfig.dr_opaque_ids, undefined);
+      t.equal(idClient._cb_configs.event.delivery_cb.opaque_ids, true);
+    },
+    'shared_handle is not passed to librdkafka': function () {
+      var sharedClient = new Producer({
+        'client.id': 'kafka-mocha',
+        'metadata.broker.list': 'localhost:9092',
+        'shared_handle': true
+      }, topicConfig);
+      t.equal(sharedClient.globalConfig.shared_handle, undefined);
+    },
     'disconnect method': {
       'calls flush before it runs': function(next) {
         var providedTimeout = 1;
@@ -95,6 +180,104 @@ module.exports = {
 
         client.disconnect(next);
       }
+    },
+    'produceBatch method': {
+      'throws when not connected': function() {
+        t.throws(function() {
+          client.produceBatch('topic', [{ value: Buffer.from('a') }]);
+        }, /not connected/);
+      },
+      'requires messages to be an array': function() {
+        client._isConnected = true;
+        t.throws(function() {
+          client.produceBatch('topic', { value: Buffer.from('a') });
+        }, TypeError);
+      }
+    },
+    'setPollInBackground waits for the connection': function() {
+      var listeners = client.listenerCount('ready');
+      client.setPollInBackground(true);
+      t.equal(client.pollInterval, undefined);
+      t.equal(client.listenerCount('ready'), listeners + 1);
+    },
+    'setPollInBackground keeps only the last call before connecting': function() {
+      var listeners = client.listenerCount('ready');
+      client.setPollInBackground(true);
+      client.setPollInBackground(true);
+      t.equal(client.listenerCount('ready'), listeners + 1);
+      client.setPollInBackground(false);
+      t.equal(client.listenerCount('ready'), listeners);
+    },
+    'setMetadataRefreshInterval emits metadata changes': function() {
+      var timeouts = [];
+      var emitted = [];
+      client._isConnected = true;
+      client._client = {
+        refreshMetadataCache: function(timeout, cb) {
+          timeouts.push(timeout);
+          cb(null, [{ type: 'leader_changed', topic: 'topic', partition: 0, previousLeader: 1, leader: 2 }]);
+        },
+      };
+      client.on('metadata-change', function(changes) {
+        emitted.push(changes);
+      });
+
+      client.setMetadataRefreshInterval(1000);
+      t.notEqual(client._metadataRefreshInterval, undefined);
+      t.equal(timeouts.length, 1);
+      t.equal(emitted.length, 1);
+      t.equal(emitted[0][0].leader, 2);
+
+      client.setMetadataRefreshInterval(0);
+      t.equal(client._metadataRefreshInterval, undefined);
+    },
+    'setMetadataRefreshInterval keeps only the listeners of the last call': function() {
+      var ready = client.listenerCount('ready');
+      var disconnected = client.listenerCount('disconnected');
+
+      client._isConnected = false;
+      client.setMetadataRefreshInterval(1000);
+      client.setMetadataRefreshInterval(1000);
+      t.equal(client.listenerCount('ready'), ready + 1);
+
+      client._isConnected = true;
+      client._client = {
+        refreshMetadataCache: function(timeout, cb) {
+          cb(null, []);
+        },
+      };
+      client.setMetadataRefreshInterval(1000);
+      client.setMetadataRefreshInterval(1000);
+      t.equal(client.listenerCount('ready'), ready);
+      t.equal(client.listenerCount('disconnected'), disconnected + 1);
+
+      client.setMetadataRefreshInterval(0);
+      t.equal(client.listenerCount('disconnected'), disconnected);
+    },
+    'partitionForKey method': {
+      'matches the Java client murmur2 partitioner': function() {
+        // Java murmur2("foobar") is -790332482
+        var expected = (-790332482 & 0x7fffffff) % 10;
+        t.equal(Producer.partitionForKey('foobar', 10), expected);
+        t.equal(Producer.partitionForKey(Buffer.from('foobar'), 10, 'murmur2'), expected);
+      },
+      'hashes binary keys': function() {
+        var key = Buffer.from([0, 255, 0, 128]);
+        var partition = Producer.partitionForKey(key, 7, 'fnv1a');
+        t.ok(partition >= 0 && partition < 7);
+        t.equal(Producer.partitionForKey(key, 7, 'fnv1a'), partition);
+      },
+      'rejects partitioners that do not hash the key': function() {
+        t.throws(function() {
+          Producer.partitionForKey('key', 10, 'random');
+        });
+        t.throws(function() {
+          Producer.partitionForKey('key', 10, 'sticky');
+        });
+        t.throws(function() {
+          Producer.partitionForKey('key', 0);
+        }, TypeError);
+      }
     }
   },
 };
@@ -0,0 +1,191 @@
+/*
+ * confluent-kafka-javascript - Node.js wrapper  for RdKafka C/C++ library
+ *
+ * Copyright (c) 2016-2023 Blizzard Entertainment
+ *           (c) 2023 Confluent, Inc.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE.txt file for details.
+ */
+
+var ProduceChannel = require('../../lib/producer/produce-channel');
+var LibrdKafkaError = require('../../lib/error');
+var os = require('os');
+var t = require('assert');
+
+var le = os.endianness() === 'LE';
+
+// Stands in for the native side, which reads the rings it is handed
+function FakeClient() {
+  this.wakes = 0;
+  this.closed = false;
+}
+
+FakeClient.prototype.openProduceChannel = function(records, deliveries, topics, cb) {
+  this.records = records;
+  this.deliveries = deliveries;
+  this.topics = topics;
+  this.cb = cb;
+};
+
+FakeClient.prototype.wakeProduceChannel = function() {
+  this.wakes++;
+};
+
+FakeClient.prototype.closeProduceChannel = function() {
+  this.closed = true;
+};
+
+FakeClient.prototype.header = function(ring) {
+  return new Int32Array(ring, 0, 32);
+};
+
+FakeClient.prototype.record = function(position) {
+  return new DataView(this.records, 128 + position);
+};
+
+FakeClient.prototype.deliver = function(id, err, partition, topic, offset) {
+  var header = this.header(this.deliveries);
+  var head = Atomics.load(header, 0) >>> 0;
+  var slots = (this.deliveries.byteLength - 128) / 32;
+  var slot = new DataView(this.deliveries, 128 + (head & (slots - 1)) * 32);
+  slot.setUint32(0, id, le);
+  slot.setInt32(4, err, le);
+  slot.setInt32(8, partition, le);
+  slot.setUint32(12, topic, le);
+  slot.setFloat64(16, offset, le);
+  slot.setFloat64(24, 0, le);
+  Atomics.store(header, 0, head + 1);
+};
+
+var client;
+var channel;
+
+module.exports = {
+  'Produce channel': {
+    'beforeEach': function() {
+      client = new FakeClient();
+      channel = new ProduceChannel(client, {
+        topics: ['a', 'b'],
+        bufferSize: 1024,
+        deliverySlots: 4
+      });
+      channel._open();
+    },
+    'hands the rings and topics to the client': function() {
+      t.equal(client.records.byteLength, 128 + 1024);
+      t.equal(client.deliveries.byteLength, 128 + 4 * 32);
+      t.deepStrictEqual(client.topics, ['a', 'b']);
+    },
+    'requires valid options': function() {
+      t.throws(function() {
+        new ProduceChannel(client, { topics: [] });
+      }, TypeError);
+      t.throws(function() {
+        new ProduceChannel(client, { topics: ['a'], bufferSize: 1000 });
+      }, TypeError);
+      t.throws(function() {
+        new ProduceChannel(client, { topics: ['a'], deliverySlots: 3 });
+      }, TypeError);
+    },
+    'frames records': function() {
+      var id = channel.produce('b', 3, Buffer.from('value'), 'key', 1000,
+        [{ name: 'header' }]);
+      t.equal(id, 0);
+
+      var record = client.record(0);
+      var size = record.getUint32(0, le);
+      t.equal(size, 32 + 3 + 5 + 8 + 4 + 6);
+      t.equal(record.getUint32(4, le), 0);
+      t.equal(record.getUint16(8, le), 1);
+      t.equal(record.getUint16(10, le), 1);
+      t.equal(record.getInt32(12, le), 3);
+      t.equal(record.getInt32(16, le), 3);
+      t.equal(record.getInt32(20, le), 5);
+      t.equal(record.getFloat64(24, le), 1000);
+
+      var data = Buffer.from(client.records, 128 + 32, size - 32);
+      t.equal(data.toString('latin1', 0, 8), 'keyvalue');
+      t.equal(new DataView(client.records, 128 + 32 + 8).getUint32(0, le), 4);
+      t.equal(data.toString('latin1', 16, 26), 'nameheader');
+
+      // Published aligned to 8 bytes
+      t.equal(Atomics.load(client.header(client.records), 0), 64);
+    },
+    'marks null keys and values': function() {
+      channel.produce('a', null, null);
+      var record = client.record(0);
+      t.equal(record.getInt32(12, le), -1);
+      t.equal(record.getInt32(16, le), -1);
+      t.equal(record.getInt32(20, le), -1);
+    },
+    'rejects unknown topics': function() {
+      t.throws(function() {
+        channel.produce('c', null, 'value');
+      }, TypeError);
+    },
+    'throws queue full when the ring has no room': function() {
+      var value = Buffer.alloc(200);
+      for (var i = 0; i < 4; i++) {
+        channel.produce('a', null, value);
+      }
+      t.throws(function() {
+        channel.produce('a', null, value);
+      }, function(e) {
+        return e instanceof LibrdKafkaError &&
+          e.code === LibrdKafkaError.codes.ERR__QUEUE_FULL;
+      });
+    },
+    'skips to the start instead of wrapping a record': function() {
+      var value = Buffer.alloc(340);
+      var header = client.header(client.records);
+      channel.produce('a', null, value);
+      channel.produce('a', null, value);
+      // Everything was produced
+      Atomics.store(header, 16, Atomics.load(header, 0));
+
+      channel.produce('a', null, value);
+      t.equal(client.record(752).getUint32(0, le), 0xFFFFFFFF);
+      t.equal(client.record(0).getUint32(4, le), 2);
+      t.equal(Atomics.load(header, 0), 1024 + 376);
+    },
+    'wakes the client only while it is parked': function() {
+      channel.produce('a', null, 'value');
+      t.equal(client.wakes, 0);
+
+      Atomics.store(client.header(client.records), 17, 1);
+      channel.produce('a', null, 'value');
+      t.equal(client.wakes, 1);
+    },
+    'emits the deliveries written by the client': function() {
+      var reports;
+      channel.on('delivery-reports', function(r) {
+        reports = r;
+      });
+
+      client.deliver(0, 0, 2, 1, 42);
+      client.deliver(1, LibrdKafkaError.codes.ERR__MSG_TIMED_OUT, -1, 0, -1001);
+      client.cb();
+
+      t.equal(reports.length, 2);
+      t.equal(reports[0].id, 0);
+      t.equal(reports[0].topic, 'b');
+      t.equal(reports[0].partition, 2);
+      t.equal(reports[0].offset, 42);
+      t.equal(reports[0].error, null);
+      t.equal(reports[1].topic, 'a');
+      t.equal(reports[1].error.code, LibrdKafkaError.codes.ERR__MSG_TIMED_OUT);
+
+      // The slots are handed back
+      t.equal(Atomics.load(client.header(client.deliveries), 16), 2);
+    },
+    'closes once': function() {
+      channel.produce('a', null, 'value');
+      t.equal(channel.close(), false);
+      t.equal(client.closed, true);
+      t.throws(function() {
+        channel.produce('a', null, 'value');
+      });
+    }
+  }
+};
@@ -292,6 +292,88 @@ describe.each([[true], [false]])('Consumer', (isAutoCommit) => {
         expect(hitConcurrencyLimit).toBeTrue()
     });
 
+    it('consumes partitions concurrently, in order within a partition', async () => {
+        const partitionsConsumedConcurrently = 2
+        const partitions = partitionsConsumedConcurrently + 1
+        topicName = `test-topic-${secureRandom()}`
+        await createTopic({ topic: topicName, partitions })
+        await consumer.connect()
+        await producer.connect()
+        await consumer.subscribe({ topic: topicName })
+
+        let inProgress = 0
+        let maxInProgress = 0
+        const messagesConsumed = []
+        consumer.run({
+            partitionsConsumedConcurrently,
+            eachMessage: async event => {
+                inProgress++
+                maxInProgress = Math.max(maxInProgress, inProgress)
+                await sleep(1)
+                messagesConsumed.push(event)
+                inProgress--
+            },
+        })
+
+        await waitForConsumerToJoinGroup(consumer)
+
+        const messages = Array(100)
+            .fill()
+            .map((_, i) => {
+                const value = secureRandom()
+                return { key: `key-${value}`, value: `value-${value}`, partition: i % partitions }
+            })
+
+        await producer.send({ topic: topicName, messages })
+        await waitForMessages(messagesConsumed, { number: messages.length })
+
+        expect(maxInProgress).toBe(partitionsConsumedConcurrently)
+        for (let partition = 0; partition < partitions; partition++) {
+            const offsets = messagesConsumed
+                .filter(event => event.partition === partition)
+                .map(event => Number(event.message.offset))
+            expect(offsets).toEqual([...offsets].sort((a, b) => a - b))
+        }
+    });
+
+    it('does not hold up other partitions behind a slow handler', async () => {
+        const partitionsConsumedConcurrently = 2
+        topicName = `test-topic-${secureRandom()}`
+        await createTopic({ topic: topicName, partitions: partitionsConsumedConcurrently })
+        await consumer.connect()
+        await producer.connect()
+        await consumer.subscribe({ topic: topicName })
+
+        const messages = Array(50)
+            .fill()
+            .map((_, i) => {
+                const value = secureRandom()
+                return { key: `key-${value}`, value: `value-${value}`, partition: i % partitionsConsumedConcurrently }
+            })
+
+        /* Partition 0 is stuck on its first message until all of partition 1 is consumed. */
+        let unblock
+        const blocked = new Promise(resolve => unblock = resolve)
+        const messagesConsumed = []
+        consumer.run({
+            partitionsConsumedConcurrently,
+            eachMessage: async event => {
+                if (event.partition === 0 && messagesConsumed.every(e => e.partition !== 0))
+                    await blocked
+                messagesConsumed.push(event)
+                if (messagesConsumed.filter(e => e.partition === 1).length === messages.length / 2)
+                    unblock()
+            },
+        })
+
+        await waitForConsumerToJoinGroup(consumer)
+
+        await producer.send({ topic: topicName, messages })
+        await waitForMessages(messagesConsumed, { number: messages.length })
+
+        expect(messagesConsumed.findIndex(event => event.partition === 0)).toBe(messages.length / 2)
+    });
+
     it('consume GZIP messages', async () => {
         /* Discard and recreate producer with the compression set */
         producer = createProducer({
@@ -632,6 +632,32 @@ export interface GlobalConfig {
      * @default true
      */
     "event_cb"?: boolean;
+
+    /**
+     * Parse statistics natively and emit only these fields (per broker, topic partition or top level) as a `stats` object on `event.stats`, instead of the raw JSON `message`. Accepts an array or a comma-separated list of field names, or `true` for a default set of counters and queue depths.
+     */
+    "stats_fields"?: boolean | string | string[];
+
+    /**
+     * AdminClient only. Collect the results of all admin operations on one queue served by a single native thread, instead of holding a libuv threadpool thread for every operation in flight.
+     *
+     * @default false
+     */
+    "shared_result_queue"?: boolean;
+
+    /**
+     * Number of queued events past which `event.log` and `event.stats` events are dropped until the event loop catches up. Errors are always kept. 0 never drops anything.
+     *
+     * @default 10000
+     */
+    "event_backlog_max"?: number;
+
+    /**
+     * Record per topic latency histograms natively, readable with `getLatencyHistograms()`. Producers measure the time from produce to a successful delivery report, consumers the time from the message timestamp to the message being consumed. Has no effect on the AdminClient.
+     *
+     * @default false
+     */
+    "latency_histograms"?: boolean;
 }
 
 export interface ProducerGlobalConfig extends GlobalConfig {
@@ -775,6 +801,48 @@ export interface ProducerGlobalConfig extends GlobalConfig {
      * @default 10
      */
     "sticky.partitioning.linger.ms"?: number;
+
+    /**
+     * Produce message payloads without copying them. The Buffer of every message is referenced until its delivery report has been handled, and must not be modified until then.
+     *
+     * @default false
+     */
+    "zero_copy_produce"?: boolean;
+
+    /**
+     * Deliver up to this many delivery reports at once, with a single `delivery-report-batch` event. `delivery-report` is still emitted for every report if it has listeners. 0 disables batching.
+     *
+     * @default 0
+     */
+    "dr_batch_size"?: number;
+
+    /**
+     * Number of delivery reports waiting for the event loop at which `produce()` fails with `ERR__QUEUE_FULL`, until the backlog is down to half and a `drain` event is emitted. 0 for no limit.
+     *
+     * @default 0
+     */
+    "dr_backlog_max"?: number;
+
+    /**
+     * Memory held by delivery reports waiting for the event loop at which `produce()` fails with `ERR__QUEUE_FULL`, until the backlog is down to half and a `drain` event is emitted. 0 for no limit.
+     *
+     * @default 0
+     */
+    "dr_backlog_max_bytes"?: number;
+
+    /**
+     * Produce with non-negative integer opaques that are handed back as is in delivery reports, rather than arbitrary values that need a handle kept alive for every message. `produce()` throws for any other opaque.
+     *
+     * @default false
+     */
+    "dr_opaque_ids"?: boolean;
+
+    /**
+     * Connect through one librdkafka instance shared by all producers of the same thread, the main thread or a worker, that have the same configuration and set this, instead of one per producer. Each producer still gets only its own delivery reports, events go to all of them. A flush waits for the messages of all of them. Not available with transactions, OAUTHBEARER or produce channels.
+     *
+     * @default false
+     */
+    "shared_handle"?: boolean;
 }
 
 export interface ConsumerGlobalConfig extends GlobalConfig {
@@ -956,6 +1024,48 @@ export interface ConsumerGlobalConfig extends GlobalConfig {
      * @default false
      */
     "check.crcs"?: boolean;
+
+    /**
+     * Consume message values without copying them. Each value Buffer references librdkafka's fetch memory and keeps its message alive until it is garbage collected. Buffers still alive when the consumer disconnects are emptied, so copy values that need to outlive it.
+     *
+     * @default false
+     */
+    "zero_copy_consume"?: boolean;
+
+    /**
+     * Give every assigned partition its own queue, read with `consumePartition()`, so partitions can be consumed in parallel. Rebalances and errors are still only served by `consume()`, which must keep being called.
+     *
+     * @default false
+     */
+    "partition_queues"?: boolean;
+
+    /**
+     * Track consumed messages until they are passed to `resolveOffset()`, in any order, and store the offset up to which every message of a partition was resolved in batches. Requires `enable.auto.offset.store` to be false. When set, the KafkaJS consumer also uses it for the offsets it stores itself.
+     *
+     * @default false
+     */
+    "offset_tracking"?: boolean;
+
+    /**
+     * How often the offsets found by `offset_tracking` are stored, at the latest. They are always stored before a commit, a revoke or a disconnect.
+     *
+     * @default 500
+     */
+    "offset_tracking_interval_ms"?: number;
+
+    /**
+     * Number of messages read by the consume loop that may wait for the event loop. Once reached the loop stops consuming until the event loop catches up. 0 for no limit.
+     *
+     * @default 10000
+     */
+    "consume_backlog_max"?: number;
+
+    /**
+     * Make the consume loop read on the event loop whenever librdkafka has messages for the consumer, instead of a background thread waiting on timeouts. Messages are read in batches of the consume loop batch size, or 1000 if it is unset. Only the flowing consume loop reads this way, `consume(number, cb)` still waits on a worker thread. Cannot be combined with `partition_queues`.
+     *
+     * @default false
+     */
+    "event_driven_consume"?: boolean;
 }
 
 export interface TopicConfig {
@@ -280,6 +280,7 @@ export type ConsumerSubscribeTopics = { topics: (string | RegExp)[]; replace?: b
 
 export type ConsumerRunConfig = {
   eachBatchAutoResolve?: boolean,
+  partitionsConsumedConcurrently?: number,
   eachMessage?: EachMessageHandler
   eachBatch?: EachBatchHandler
 }
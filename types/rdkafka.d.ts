@@ -64,11 +64,33 @@ export interface Metadata {
     brokers: BrokerMetadata[];
 }
 
+export interface MetadataChange {
+    type: 'topic_added' | 'topic_removed' | 'partitions_changed' | 'leader_changed' | 'replicas_changed';
+    topic: string;
+    // Set for leader_changed and replicas_changed
+    partition?: number;
+    leader?: number;
+    previousLeader?: number;
+    // Set for topic_added, topic_removed and partitions_changed
+    partitionCount?: number;
+    previousPartitionCount?: number;
+}
+
 export interface WatermarkOffsets{
     lowOffset: number;
     highOffset: number;
 }
 
+export interface ConsumerLag {
+    topics: string[];
+    topicIndex: Int32Array;
+    partition: Int32Array;
+    position: Float64Array;
+    lowOffset: Float64Array;
+    highOffset: Float64Array;
+    lag: Float64Array;
+}
+
 export interface TopicPartition {
     topic: string;
     partition: number;
@@ -93,10 +115,23 @@ export interface DeliveryReport extends TopicPartitionOffset {
     opaque?: any;
 }
 
+export interface DeliveryReportBatch {
+    topic: string[];
+    partition: Int32Array;
+    offset: Float64Array;
+    error: Int32Array;
+    timestamp: Float64Array;
+    opaque: any[];
+    key?: MessageKey[];
+    value?: MessageValue[];
+}
+
 export type NumberNullUndefined = number | null | undefined;
 
 export type MessageKey = Buffer | string | null | undefined;
 export type MessageHeader = { [key: string]: string | Buffer };
+// Alternating keys and values: [key1, value1, key2, value2]
+export type FlatMessageHeaders = (string | Buffer)[];
 export type MessageValue = Buffer | null;
 export type SubscribeTopic = string | RegExp;
 export type SubscribeTopicList = SubscribeTopic[];
@@ -111,6 +146,30 @@ export interface Message extends TopicPartitionOffset {
     opaque?: any;
 }
 
+export interface ProducerBatchMessage {
+    value?: MessageValue | string;
+    key?: MessageKey;
+    partition?: NumberNullUndefined;
+    timestamp?: NumberNullUndefined;
+    opaque?: any;
+    headers?: MessageHeader[] | FlatMessageHeaders;
+}
+
+export interface ProduceChannelOptions {
+    topics: string[];
+    bufferSize?: number;
+    deliverySlots?: number;
+}
+
+export interface ProduceChannelDeliveryReport {
+    id: number;
+    topic: string;
+    partition: number;
+    offset: number;
+    timestamp: number;
+    error: LibrdKafkaError | null;
+}
+
 export interface ReadStreamOptions extends ReadableOptions {
     topics: SubscribeTopicList | SubscribeTopic | ((metadata: Metadata) => SubscribeTopicList);
     waitInterval?: number;
@@ -143,9 +202,9 @@ export interface ConsumerStream extends Readable {
     close(cb?: () => void): void;
 }
 
-type KafkaClientEvents = 'disconnected' | 'ready' | 'connection.failure' | 'event.error' | 'event.stats' | 'event.log' | 'event.event' | 'event.throttle';
+type KafkaClientEvents = 'disconnected' | 'ready' | 'connection.failure' | 'event.error' | 'event.stats' | 'event.log' | 'event.event' | 'event.throttle' | 'metadata-change';
 type KafkaConsumerEvents = 'data' | 'partition.eof' | 'rebalance' | 'rebalance.error' | 'subscribed' | 'unsubscribed' | 'unsubscribe' | 'offset.commit' | KafkaClientEvents;
-type KafkaProducerEvents = 'delivery-report' | KafkaClientEvents;
+type KafkaProducerEvents = 'delivery-report' | 'delivery-report-batch' | 'drain' | KafkaClientEvents;
 
 type EventListenerMap = {
     // ### Client
@@ -159,6 +218,7 @@ type EventListenerMap = {
     'event.log': (eventData: any) => void,
     'event.event': (eventData: any) => void,
     'event.throttle': (eventData: any) => void,
+    'metadata-change': (changes: MetadataChange[]) => void,
     // ### Consumer only
     // domain events
     'data': (arg: Message) => void,
@@ -174,10 +234,63 @@ type EventListenerMap = {
     // ### Producer only
     // delivery
     'delivery-report': (error: LibrdKafkaError, report: DeliveryReport) => void,
+    'delivery-report-batch': (batch: DeliveryReportBatch) => void,
+    // backpressure
+    'drain': () => void,
 }
 
 type EventListener<K extends string> = K extends keyof EventListenerMap ? EventListenerMap[K] : never;
 
+export interface DispatcherMetrics {
+    wakeups: number;
+    items: number;
+    depth: number;
+    depthHighWater: number;
+    bytes: number;
+    dropped: number;
+}
+
+export interface NativeMetrics {
+    dispatchers: {
+        event: DispatcherMetrics;
+        deliveryReport?: DispatcherMetrics;
+        rebalance?: DispatcherMetrics;
+        offsetCommit?: DispatcherMetrics;
+        oauthBearerTokenRefresh?: DispatcherMetrics;
+    };
+    messagesConverted: number;
+    connectionLock: {
+        waits: number;
+        waitNs: number;
+    };
+    consumeBacklog: {
+        messages: number;
+        bytes: number;
+    };
+    workersInFlight: { [workerType: string]: number };
+    workerPool: {
+        size: number;
+        threads: number;
+        running: number;
+        queued: number;
+    };
+}
+
+export interface LatencyHistogram {
+    count: number;
+    min: number;
+    max: number;
+    mean: number;
+    p50: number;
+    p90: number;
+    p99: number;
+    p999: number;
+}
+
+export interface LatencyHistograms {
+    [topic: string]: LatencyHistogram;
+}
+
 export abstract class Client<Events extends string> extends EventEmitter {
     constructor(globalConf: GlobalConfig, SubClientType: any, topicConf: TopicConfig);
 
@@ -196,11 +309,21 @@ export abstract class Client<Events extends string> extends EventEmitter {
 
     getMetadata(metadataOptions?: MetadataOptions, cb?: (err: LibrdKafkaError, data: Metadata) => any): any;
 
+    setMetadataRefreshInterval(interval: number): this;
+
+    getCachedTopicMetadata(topic: string): TopicMetadata | null;
+
     queryWatermarkOffsets(topic: string, partition: number, timeout: number, cb?: (err: LibrdKafkaError, offsets: WatermarkOffsets) => any): any;
     queryWatermarkOffsets(topic: string, partition: number, cb?: (err: LibrdKafkaError, offsets: WatermarkOffsets) => any): any;
 
     setSaslCredentials(username: string, password: string): void;
 
+    getNativeMetrics(): NativeMetrics;
+
+    getLatencyHistograms(): LatencyHistograms;
+
+    resetLatencyHistograms(): void;
+
     on<E extends Events>(event: E, listener: EventListener<E>): this;
     once<E extends Events>(event: E, listener: EventListener<E>): this;
 }
@@ -225,13 +348,25 @@ export class KafkaConsumer extends Client<KafkaConsumerEvents> {
     committed(timeout: number, cb: (err: LibrdKafkaError, topicPartitions: TopicPartitionOffset[]) => void): this;
 
     consume(number: number, cb?: (err: LibrdKafkaError, messages: Message[]) => void): void;
+    consumePartition(topic: string, partition: number, number: number, cb?: (err: LibrdKafkaError, messages: Message[]) => void): void;
     consume(cb: (err: LibrdKafkaError, messages: Message[]) => void): void;
     consume(): void;
 
+    setPartitionQueues(enabled: boolean): void;
+
     getWatermarkOffsets(topic: string, partition: number): WatermarkOffsets;
 
+    getLag(): ConsumerLag;
+
+    queryLag(timeout: number, cb: (err: LibrdKafkaError, lag: ConsumerLag) => void): this;
+    queryLag(cb: (err: LibrdKafkaError, lag: ConsumerLag) => void): this;
+
     offsetsStore(topicPartitions: TopicPartitionOffset[]): any;
 
+    resolveOffset(topicPartitionOffset: TopicPartitionOffset): any;
+
+    resetOffsetTracking(): void;
+
     pause(topicPartitions: TopicPartition[]): any;
 
     position(toppars?: TopicPartition[]): TopicPartitionOffset[];
@@ -240,10 +375,14 @@ export class KafkaConsumer extends Client<KafkaConsumerEvents> {
 
     seek(toppar: TopicPartitionOffset, timeout: number | null, cb: (err: LibrdKafkaError) => void): this;
 
+    seekPartitions(toppars: TopicPartitionOffset[], timeout: number | null, cb: (err: LibrdKafkaError, partitions: (TopicPartitionOffset & { error?: LibrdKafkaError })[]) => void): this;
+
     setDefaultConsumeTimeout(timeoutMs: number): void;
 
     setDefaultConsumeLoopTimeoutDelay(timeoutMs: number): void;
 
+    setDefaultConsumeLoopBatch(size: number, timeoutMs: number): void;
+
     subscribe(topics: SubscribeTopicList): this;
 
     subscription(): string[];
@@ -258,6 +397,17 @@ export class KafkaConsumer extends Client<KafkaConsumerEvents> {
     static createReadStream(conf: ConsumerGlobalConfig, topicConfig: ConsumerTopicConfig, streamOptions: ReadStreamOptions | number): ConsumerStream;
 }
 
+export class ProduceChannel extends EventEmitter {
+    readonly topics: string[];
+
+    produce(topic: string, partition: NumberNullUndefined, value: MessageValue | string, key?: MessageKey, timestamp?: NumberNullUndefined, headers?: MessageHeader[] | FlatMessageHeaders): number;
+
+    close(): boolean;
+
+    on(event: 'delivery-reports', listener: (reports: ProduceChannelDeliveryReport[]) => void): this;
+    once(event: 'delivery-reports', listener: (reports: ProduceChannelDeliveryReport[]) => void): this;
+}
+
 export class Producer extends Client<KafkaProducerEvents> {
     constructor(conf: ProducerGlobalConfig | ProducerTopicConfig, topicConf?: ProducerTopicConfig);
 
@@ -265,12 +415,20 @@ export class Producer extends Client<KafkaProducerEvents> {
 
     poll(): this;
 
-    produce(topic: string, partition: NumberNullUndefined, message: MessageValue, key?: MessageKey, timestamp?: NumberNullUndefined, opaque?: any, headers?: MessageHeader[]): any;
+    produce(topic: string, partition: NumberNullUndefined, message: MessageValue | string, key?: MessageKey, timestamp?: NumberNullUndefined, opaque?: any, headers?: MessageHeader[] | FlatMessageHeaders): any;
+
+    produceBatch(topic: string, messages: ProducerBatchMessage[]): Int32Array;
+
+    openProduceChannel(options: ProduceChannelOptions): ProduceChannel;
 
     setPollInterval(interval: number): this;
 
+    setPollInBackground(set: boolean): this;
+
     static createWriteStream(conf: ProducerGlobalConfig, topicConf: ProducerTopicConfig, streamOptions: WriteStreamOptions): ProducerStream;
 
+    static partitionForKey(key: Buffer | string, partitionCount: number, partitioner?: 'consistent' | 'consistent_random' | 'murmur2' | 'murmur2_random' | 'fnv1a' | 'fnv1a_random'): number;
+
     initTransactions(cb: (err: LibrdKafkaError) => void): void;
     initTransactions(timeout: number, cb: (err: LibrdKafkaError) => void): void;
     beginTransaction(cb: (err: LibrdKafkaError) => void): void;
@@ -296,6 +454,8 @@ export const features: string[];
 
 export const librdkafkaVersion: string;
 
+export function setWorkerPoolSize(size: number): void;
+
 export function createReadStream(conf: ConsumerGlobalConfig, topicConf: ConsumerTopicConfig, streamOptions: ReadStreamOptions | number): ConsumerStream;
 
 export function createWriteStream(conf: ProducerGlobalConfig, topicConf: ProducerTopicConfig, streamOptions: WriteStreamOptions): ProducerStream;
@@ -456,4 +616,5 @@ export type RdKafka = {
   Topic: (name: string) => string,
   features: typeof features,
   librdkafkaVersion: typeof librdkafkaVersion,
+  setWorkerPoolSize: typeof setWorkerPoolSize,
 }